@@ -12,6 +12,7 @@ VERSION = v0.1.5
 # Basic configuration
 # -------------------------------------------------
 QT += core gui widgets network dbus charts
+greaterThan(QT_MAJOR_VERSION, 5): QT += opengl openglwidgets
 CONFIG += c++17 release
 # CONFIG += debug
 
@@ -23,6 +24,16 @@ LIBS += -lssl -lcrypto
 
 unix:!macx: LIBS += -lX11
 
+# forkpty
+unix:!macx: LIBS += -lutil
+
+# In-process SSH transport (qmake CONFIG+=qtissh_libssh)
+qtissh_libssh {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libssh
+    DEFINES += QTISSH_HAVE_LIBSSH
+}
+
 # -------------------------------------------------
 # Source files, headers and UI
 # -------------------------------------------------
@@ -33,6 +44,11 @@ SOURCES += \
     src/serverconfig.cpp \
     src/servermanager.cpp \
     src/sshterminal.cpp \
+    src/ptyprocess.cpp \
+    src/sshconnectionbroker.cpp \
+    src/libsshsession.cpp \
+    src/libsshchannel.cpp \
+    src/libsshsftp.cpp \
     src/filetransfer.cpp \
     src/filetransfermanager.cpp \
     src/sftpconnection.cpp \
@@ -42,6 +58,17 @@ SOURCES += \
     src/terminalchar.cpp \
     src/terminalscreen.cpp \
     src/vt100parser.cpp \
+    src/printablescanner.cpp \
+    src/utf8decoder.cpp \
+    src/terminalcommand.cpp \
+    src/scrollbackbuffer.cpp \
+    src/scrollbacksegments.cpp \
+    src/glyphcache.cpp \
+    src/terminalglview.cpp \
+    src/terminalselection.cpp \
+    src/terminalsearchindex.cpp \
+    src/terminalsearchbar.cpp \
+    src/terminalworker.cpp \
     src/vt100terminal.cpp \
     src/thememanager.cpp \
     src/settingsmanager.cpp \
@@ -62,6 +89,7 @@ SOURCES += \
     src/metricbutton.cpp \
         metricbutton.h \
         monitoringdialog.cpp \
+    src/metricsstream.cpp \
     src/servermonitoringbar.cpp \
     src/networkdiscoverydialog.cpp \
     src/connectionlogsdialog.cpp \
@@ -75,6 +103,12 @@ HEADERS += \
     src/serverconfig.h \
     src/servermanager.h \
     src/sshterminal.h \
+    src/ptyprocess.h \
+    src/sshconnectionbroker.h \
+    src/sshtransport.h \
+    src/libsshsession.h \
+    src/libsshchannel.h \
+    src/libsshsftp.h \
     src/filetransfer.h \
     src/filetransfermanager.h \
     src/sftpconnection.h \
@@ -84,6 +118,17 @@ HEADERS += \
     src/terminalchar.h \
     src/terminalscreen.h \
     src/vt100parser.h \
+    src/printablescanner.h \
+    src/utf8decoder.h \
+    src/terminalcommand.h \
+    src/scrollbackbuffer.h \
+    src/scrollbacksegments.h \
+    src/glyphcache.h \
+    src/terminalglview.h \
+    src/terminalselection.h \
+    src/terminalsearchindex.h \
+    src/terminalsearchbar.h \
+    src/terminalworker.h \
     src/vt100terminal.h \
     src/thememanager.h \
     src/settingsmanager.h \
@@ -102,6 +147,7 @@ HEADERS += \
     src/keychainstore.h \
     src/quickcommandsdialog.h \
     src/monitoringdialog.h \
+    src/metricsstream.h \
     src/servermonitoringbar.h \
     src/networkdiscoverydialog.h \
     src/connectionlogsdialog.h \
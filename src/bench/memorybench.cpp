@@ -0,0 +1,68 @@
+// Fills a TerminalScreen with generated output and prints its memory use.
+//
+//   qtissh-memory-bench [lines] [columns] [rows] [spill-directory]
+//
+// Defaults to 10000 lines of 200 columns on a 200x50 screen, with the
+// scrollback sized to keep all of them. Every line is a different run of
+// printable ASCII in one of eight colors, like colored log output.
+
+#include "terminalscreen.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QVector>
+
+namespace {
+
+int argument(const QStringList &arguments, int index, int fallback)
+{
+    bool ok = false;
+    const int value = arguments.value(index).toInt(&ok);
+    return ok && value > 0 ? value : fallback;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList arguments = app.arguments();
+    const int lines = argument(arguments, 1, 10000);
+    const int columns = argument(arguments, 2, 200);
+    const int rows = argument(arguments, 3, 50);
+    const QString spillDirectory = arguments.value(4);
+
+    TerminalScreen screen(rows, columns);
+    screen.setMaxHistorySize(lines);
+    if (!spillDirectory.isEmpty()) {
+        screen.setHistorySpillDirectory(spillDirectory);
+    }
+
+    QVector<uint> text(columns);
+    QElapsedTimer timer;
+    timer.start();
+    for (int line = 0; line < lines; ++line) {
+        for (int column = 0; column < columns; ++column) {
+            text[column] = 0x21 + uint(line * 7 + column) % 94;
+        }
+        screen.setCurrentForegroundColor(static_cast<TerminalColor>(1 + line % 8));
+        screen.insertRun(text.constData(), columns);
+        screen.moveCursorToColumn(0);
+        screen.lineFeed();
+    }
+    const qint64 elapsed = timer.elapsed();
+
+    // What the same cells took before they were packed
+    const qint64 unpacked = qint64(lines + rows) * columns * qint64(sizeof(TerminalChar));
+
+    QTextStream out(stdout);
+    out << "lines " << lines << ", columns " << columns << ", rows " << rows
+        << (spillDirectory.isEmpty() ? QString() : ", spilled to " + spillDirectory) << "\n"
+        << "history lines:     " << screen.historySize() << "\n"
+        << "styles:            " << screen.styleTableSize() << "\n"
+        << "memoryFootprint(): " << screen.memoryFootprint() / 1024 << " KiB\n"
+        << "unpacked cells:    " << unpacked / 1024 << " KiB ("
+        << sizeof(TerminalChar) << " B per TerminalChar, " << sizeof(TerminalCell) << " B per TerminalCell)\n"
+        << "fill time:         " << elapsed << " ms\n";
+    return 0;
+}
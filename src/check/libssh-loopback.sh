@@ -0,0 +1,52 @@
+#!/bin/sh
+# Starts a throwaway sshd on 127.0.0.1 and runs qtissh-libssh-check against it.
+#
+#   src/check/libssh-loopback.sh [path/to/qtissh-libssh-check] [port]
+#
+# Build the check with cmake -DQTISSH_WITH_LIBSSH=ON -DQTISSH_BUILD_CHECKS=ON.
+# No root needed: the server only accepts the current user with a key made
+# here, and everything is removed on exit.
+
+set -eu
+
+check=${1:-./qtissh-libssh-check}
+port=${2:-2222}
+sshd=${SSHD:-/usr/sbin/sshd}
+
+if [ ! -x "$check" ]; then
+    echo "no check binary at $check" >&2
+    exit 2
+fi
+
+dir=$(mktemp -d)
+pid=
+cleanup() {
+    [ -n "$pid" ] && kill "$pid" 2>/dev/null || true
+    rm -rf "$dir"
+}
+trap cleanup EXIT INT TERM
+
+ssh-keygen -q -t ed25519 -N '' -f "$dir/host_key"
+ssh-keygen -q -t ed25519 -N '' -f "$dir/client_key"
+cp "$dir/client_key.pub" "$dir/authorized_keys"
+chmod 600 "$dir/authorized_keys"
+
+# No system sshd_config, so nothing there can get in the way
+"$sshd" -D -f /dev/null -p "$port" -o ListenAddress=127.0.0.1 \
+    -h "$dir/host_key" -o PidFile=none -o UsePAM=no -o StrictModes=no \
+    -o AuthorizedKeysFile="$dir/authorized_keys" -o Subsystem="sftp internal-sftp" \
+    -E "$dir/sshd.log" &
+pid=$!
+
+tries=0
+until grep -q "Server listening" "$dir/sshd.log" 2>/dev/null; do
+    tries=$((tries + 1))
+    if [ "$tries" -gt 50 ] || ! kill -0 "$pid" 2>/dev/null; then
+        echo "sshd did not start:" >&2
+        cat "$dir/sshd.log" >&2 2>/dev/null || true
+        exit 2
+    fi
+    sleep 0.1
+done
+
+"$check" 127.0.0.1 "$port" "$(id -un)" "$dir/client_key"
@@ -0,0 +1,248 @@
+// Runs the libssh backend against a live sshd and reports each step.
+//
+//   qtissh-libssh-check host port user key-file
+//
+// Meant for a throwaway local server; libssh-loopback.sh starts one and
+// runs this against it. Host keys are not verified. Exits non-zero when
+// any step fails.
+
+#include "libsshchannel.h"
+#include "libsshsftp.h"
+#include "serverconfig.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+#include <functional>
+
+namespace {
+
+constexpr int TIMEOUT = 20000;  // milliseconds per step
+
+QTextStream &out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+int failures = 0;
+
+void report(const QString &step, const QString &error)
+{
+    if (error.isEmpty()) {
+        out() << "ok      " << step << "\n";
+    } else {
+        out() << "FAILED  " << step << ": " << error << "\n";
+        ++failures;
+    }
+    out().flush();
+}
+
+// Runs the event loop until done() holds; false on timeout
+bool spin(const std::function<bool()> &done)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!done()) {
+        if (timer.elapsed() > TIMEOUT) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    return true;
+}
+
+struct CommandResult {
+    QByteArray output;
+    int exitCode = -1;
+    QString error;
+};
+
+CommandResult run(const ServerConfig &config, const QString &command, const QByteArray &input = QByteArray(),
+                  int rows = 0, int columns = 0)
+{
+    CommandResult result;
+    bool done = false;
+    LibSshChannel channel;
+    QObject::connect(&channel, &LibSshChannel::dataReceived, [&](const QByteArray &data) {
+        result.output += data;
+    });
+    QObject::connect(&channel, &LibSshChannel::finished, [&](int exitCode) {
+        result.exitCode = exitCode;
+        done = true;
+    });
+    QObject::connect(&channel, &LibSshChannel::errorOccurred, [&]() {
+        result.error = channel.errorString();
+        done = true;
+    });
+    channel.start(config, command, rows, columns);
+    channel.write(input);
+    channel.closeWrite();
+    if (!spin([&]() { return done; })) {
+        result.error = "timed out";
+        channel.kill();
+    }
+    return result;
+}
+
+void checkCommands(const ServerConfig &config)
+{
+    CommandResult echo = run(config, "echo qtissh");
+    report("exec echo", !echo.error.isEmpty() ? echo.error
+                        : echo.output != "qtissh\n" ? "got \"" + QString::fromUtf8(echo.output) + "\""
+                        : QString());
+
+    CommandResult status = run(config, "exit 3");
+    report("exit status", !status.error.isEmpty() ? status.error
+                          : status.exitCode != 3 ? QString("exit code %1").arg(status.exitCode)
+                          : QString());
+
+    CommandResult pty = run(config, "stty size", QByteArray(), 24, 80);
+    report("pty size", !pty.error.isEmpty() ? pty.error
+                       : pty.output.trimmed() != "24 80" ? "got \"" + QString::fromUtf8(pty.output.trimmed()) + "\""
+                       : QString());
+
+    // More than any window, both ways
+    QByteArray data(8 * 1024 * 1024, Qt::Uninitialized);
+    for (int i = 0; i < data.size(); ++i) {
+        data[i] = char('a' + (i * 7 + i / 4096) % 26);
+    }
+    CommandResult cat = run(config, "cat", data);
+    report("8 MiB through cat", !cat.error.isEmpty() ? cat.error
+                                : cat.output != data ? QString("got %1 bytes back").arg(cat.output.size())
+                                : QString());
+}
+
+void checkSftp(const ServerConfig &config, const QString &localDirectory)
+{
+    LibSshSftp sftp;
+    bool ready = false;
+    QString closedError;
+    quint32 waiting = 0;
+    bool done = false;
+    QString error;
+    QString path;
+    QList<RemoteFileInfo> files;
+
+    QObject::connect(&sftp, &LibSshSftp::ready, [&]() { ready = true; });
+    QObject::connect(&sftp, &LibSshSftp::closed, [&](const QString &reason) {
+        closedError = reason.isEmpty() ? QString("closed") : reason;
+    });
+    QObject::connect(&sftp, &LibSshSftp::pathResolved, [&](quint32 request, const QString &resolved) {
+        done = done || request == waiting;
+        path = resolved;
+    });
+    QObject::connect(&sftp, &LibSshSftp::directoryListed, [&](quint32 request, const QList<RemoteFileInfo> &listed) {
+        done = done || request == waiting;
+        files = listed;
+    });
+    QObject::connect(&sftp, &LibSshSftp::completed, [&](quint32 request) {
+        done = done || request == waiting;
+    });
+    QObject::connect(&sftp, &LibSshSftp::failed, [&](quint32 request, const QString &reason) {
+        if (request == waiting) {
+            done = true;
+            error = reason;
+        }
+    });
+    const auto wait = [&](quint32 request) {
+        waiting = request;
+        done = false;
+        error.clear();
+        if (!spin([&]() { return done || !closedError.isEmpty(); })) {
+            return QString("timed out");
+        }
+        return !error.isEmpty() ? error : closedError;
+    };
+
+    sftp.start(config);
+    if (!spin([&]() { return ready || !closedError.isEmpty(); })) {
+        closedError = "timed out";
+    }
+    report("sftp version", closedError);
+    if (!ready) {
+        return;
+    }
+
+    QString result = wait(sftp.realPath("."));
+    report("sftp realpath", result);
+    if (!result.isEmpty()) {
+        return;
+    }
+    const QString directory = path + QString("/qtissh-check-%1").arg(QCoreApplication::applicationPid());
+    result = wait(sftp.makeDirectory(directory));
+    report("sftp mkdir", result);
+    if (!result.isEmpty()) {
+        return;
+    }
+
+    // Several chunks, the last a short one
+    QByteArray data(1024 * 1024 + 123, Qt::Uninitialized);
+    for (int i = 0; i < data.size(); ++i) {
+        data[i] = char(i * 31 + i / 1000);
+    }
+    const QString source = QDir(localDirectory).filePath("source");
+    const QString copy = QDir(localDirectory).filePath("copy");
+    QFile file(source);
+    file.open(QIODevice::WriteOnly);
+    file.write(data);
+    file.close();
+
+    const QString remote = directory + "/data";
+    report("sftp upload", wait(sftp.upload(source, remote)));
+
+    result = wait(sftp.listDirectory(directory));
+    if (result.isEmpty()) {
+        if (files.size() != 1 || files.first().name != "data") {
+            result = QString("listed %1 entries").arg(files.size());
+        } else if (files.first().size != data.size()) {
+            result = QString("listed size %1").arg(files.first().size);
+        }
+    }
+    report("sftp list", result);
+
+    result = wait(sftp.download(remote, copy));
+    if (result.isEmpty()) {
+        QFile copied(copy);
+        copied.open(QIODevice::ReadOnly);
+        if (copied.readAll() != data) {
+            result = "downloaded data differs";
+        }
+    }
+    report("sftp download", result);
+
+    report("sftp rename", wait(sftp.rename(remote, remote + ".old")));
+    report("sftp remove", wait(sftp.remove(remote + ".old")));
+    report("sftp rmdir", wait(sftp.removeDirectory(directory)));
+    sftp.close();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList arguments = app.arguments();
+    if (arguments.size() != 5) {
+        out() << "usage: qtissh-libssh-check host port user key-file\n";
+        return 2;
+    }
+
+    ServerConfig config("check", arguments.at(1), arguments.at(2).toInt(), arguments.at(3), AuthType::PublicKey);
+    config.setKeyPath(arguments.at(4));
+    config.setStrictHostKeyChecking(false);
+
+    // Wakes the loop now and then so timeouts are noticed
+    QTimer tick;
+    tick.start(100);
+
+    checkCommands(config);
+    QTemporaryDir localDirectory;
+    checkSftp(config, localDirectory.path());
+
+    out() << (failures ? QString("%1 step(s) failed\n").arg(failures) : QString("all steps passed\n"));
+    return failures ? 1 : 0;
+}
@@ -1,5 +1,11 @@
 #include "filetransfer.h"
 #include "passwordmanager.h"
+#include "sshconnectionbroker.h"
+#include "settingsmanager.h"
+#ifdef QTISSH_HAVE_LIBSSH
+#include "libsshchannel.h"
+#include "libsshsession.h"
+#endif
 #include <QUuid>
 #include <QFileInfo>
 #include <QDir>
@@ -43,6 +49,10 @@ FileTransfer::FileTransfer(const QString &localPath, const QString &remotePath,
 
 void FileTransfer::setupProcess()
 {
+#ifdef QTISSH_HAVE_LIBSSH
+    m_channel = nullptr;
+    m_file = nullptr;
+#endif
     connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
             this, &FileTransfer::onProcessFinished);
     connect(m_process, &QProcess::errorOccurred, this, &FileTransfer::onProcessError);
@@ -96,6 +106,14 @@ void FileTransfer::start()
     
     m_status = TransferStatus::InProgress;
     emit statusChanged(m_status);
+
+#ifdef QTISSH_HAVE_LIBSSH
+    if (SettingsManager::instance().sshBackend() == SSHBackend::LibSsh
+        && LibSshSession::supports(m_config)) {
+        startNative();
+        return;
+    }
+#endif
     
     QStringList args = buildScpCommand();
     QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
@@ -135,6 +153,12 @@ QStringList FileTransfer::buildWrappedCommand() const
 void FileTransfer::cancel()
 {
     if (m_status == TransferStatus::InProgress) {
+#ifdef QTISSH_HAVE_LIBSSH
+        if (m_channel) {
+            m_channel->disconnect(this);
+            m_channel->kill();
+        }
+#endif
         m_process->kill();
         m_progressTimer->stop();
         m_status = TransferStatus::Cancelled;
@@ -219,6 +243,7 @@ QStringList FileTransfer::buildScpCommand() const
 
     // Custom SSH options (from profile + server)
     args << m_config.sshOptionArgs();
+    args << SSHConnectionBroker::instance().clientArgs(m_config);
     
     QString remoteTarget = QString("%1@%2:%3")
                                .arg(m_config.username(), m_config.host(), m_remotePath);
@@ -347,3 +372,96 @@ void FileTransfer::onReadyRead()
     QByteArray errData = m_process->readAllStandardError();
     parseScpOutput(errData);
 }
+
+#ifdef QTISSH_HAVE_LIBSSH
+void FileTransfer::startNative()
+{
+    // A cat on an exec channel of the shared session stands in for scp;
+    // timestamps are not preserved
+    const bool upload = m_type == TransferType::Upload;
+    const QString remote = "'" + QString(m_remotePath).replace("'", "'\\''") + "'";
+
+    m_file = new QFile(m_localPath, this);
+    if (!m_file->open(upload ? QIODevice::ReadOnly : QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_status = TransferStatus::Failed;
+        m_errorMessage = QString("Could not open %1: %2").arg(m_localPath, m_file->errorString());
+        emit error(m_errorMessage);
+        emit statusChanged(m_status);
+        emit finished(false);
+        return;
+    }
+
+    m_channel = new LibSshChannel(this);
+    connect(m_channel, &LibSshChannel::dataReceived, this, [this](const QByteArray &data) {
+        m_file->write(data);
+        m_transferredBytes += data.size();
+        emit progressChanged(progressPercent());
+    });
+    connect(m_channel, &LibSshChannel::bytesWritten, this, [this](qint64 bytes) {
+        m_transferredBytes += bytes;
+        emit progressChanged(progressPercent());
+        feedUpload();
+    });
+    connect(m_channel, &LibSshChannel::standardErrorReceived, this, [this](const QByteArray &data) {
+        m_remoteErrors.append(data);
+    });
+    connect(m_channel, &LibSshChannel::finished, this, &FileTransfer::onNativeFinished);
+    connect(m_channel, &LibSshChannel::errorOccurred, this, &FileTransfer::onNativeError);
+
+    m_channel->start(m_config, (upload ? "cat > " : "cat ") + remote);
+    if (upload) {
+        feedUpload();
+    }
+}
+
+void FileTransfer::feedUpload()
+{
+    if (m_type != TransferType::Upload || !m_file || !m_file->isOpen()) {
+        return;
+    }
+    // Keep a chunk queued ahead of the channel without reading the whole file
+    while (!m_file->atEnd() && m_channel->bytesToWrite() < UPLOAD_CHUNK) {
+        const QByteArray chunk = m_file->read(UPLOAD_CHUNK);
+        if (chunk.isEmpty()) {
+            break;
+        }
+        m_channel->write(chunk);
+    }
+    if (m_file->atEnd()) {
+        m_channel->closeWrite();
+    }
+}
+
+void FileTransfer::onNativeFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    if (m_status != TransferStatus::InProgress) {
+        return;
+    }
+    m_file->close();
+    if ((exitStatus == QProcess::NormalExit && exitCode == 0) || m_remoteErrors.isEmpty()) {
+        onProcessFinished(exitCode, exitStatus);
+        return;
+    }
+    m_status = TransferStatus::Failed;
+    m_errorMessage = QString::fromUtf8(m_remoteErrors).trimmed();
+    emit error(m_errorMessage);
+    emit finished(false);
+    emit statusChanged(m_status);
+}
+
+void FileTransfer::onNativeError()
+{
+    if (m_status != TransferStatus::InProgress) {
+        return;
+    }
+    m_file->close();
+    m_status = TransferStatus::Failed;
+    m_errorMessage = m_channel->errorString();
+    if (m_errorMessage.isEmpty()) {
+        m_errorMessage = "SSH transfer failed.";
+    }
+    emit error(m_errorMessage);
+    emit statusChanged(m_status);
+    emit finished(false);
+}
+#endif // QTISSH_HAVE_LIBSSH
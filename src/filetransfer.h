@@ -7,6 +7,9 @@
 #include <QFileInfo>
 #include "serverconfig.h"
 
+class QFile;
+class LibSshChannel;
+
 enum class TransferType {
     Upload,
     Download
@@ -86,6 +89,19 @@ private:
     void cleanupAskPass();
     void parseScpOutput(const QByteArray &data);
     void setProgress(int percent);
+
+#ifdef QTISSH_HAVE_LIBSSH
+    void startNative();
+    void feedUpload();
+    void onNativeFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onNativeError();
+
+    LibSshChannel *m_channel;
+    QFile *m_file;
+    QByteArray m_remoteErrors;
+
+    static constexpr qint64 UPLOAD_CHUNK = 256 * 1024;
+#endif
 };
 
 #endif // FILETRANSFER_H
@@ -0,0 +1,154 @@
+#include "glyphcache.h"
+#include <QPainter>
+#include <QFontInfo>
+#include <QtMath>
+#include <QDebug>
+
+GlyphCache::GlyphCache()
+    : m_cellWidth(8)
+    , m_cellHeight(12)
+    , m_baseline(10)
+    , m_devicePixelRatio(1.0)
+    , m_nextSlot(0)
+    , m_generation(0)
+{
+    for (int variant = Regular; variant <= BoldItalic; ++variant) {
+        m_metrics.append(QFontMetrics(m_fonts[variant]));
+    }
+}
+
+void GlyphCache::setFont(const QFont &font)
+{
+    if (!QFontInfo(font).fixedPitch()) {
+        qWarning() << "Terminal font" << font.family() << "is not monospaced; glyphs may overlap";
+    }
+    
+    const QFontMetrics regular(font);
+    m_cellWidth = regular.horizontalAdvance(QLatin1Char('M'));  // 'M' is typically the widest character
+    m_cellHeight = regular.height();
+    m_baseline = regular.ascent();
+    
+    m_metrics.clear();
+    for (int variant = Regular; variant <= BoldItalic; ++variant) {
+        QFont variantFont = font;
+        variantFont.setBold(variant & Bold);
+        variantFont.setItalic(variant & Italic);
+        
+        // Synthetic or differently hinted bold faces can be wider than the
+        // regular face; pull them back to the grid so runs stay aligned
+        const int advance = QFontMetrics(variantFont).horizontalAdvance(QLatin1Char('M'));
+        if (advance != m_cellWidth) {
+            variantFont.setLetterSpacing(QFont::AbsoluteSpacing, m_cellWidth - advance);
+        }
+        
+        const QFontMetrics metrics(variantFont);
+        m_cellHeight = qMax(m_cellHeight, metrics.height());
+        m_baseline = qMax(m_baseline, metrics.ascent());
+        m_fonts[variant] = variantFont;
+        m_metrics.append(metrics);
+    }
+    clear();
+}
+
+void GlyphCache::setDevicePixelRatio(qreal ratio)
+{
+    if (!qFuzzyCompare(ratio, m_devicePixelRatio)) {
+        m_devicePixelRatio = ratio;
+        clear();
+    }
+}
+
+void GlyphCache::clear()
+{
+    m_glyphs.clear();
+    m_pages.clear();
+    m_nextSlot = 0;
+    ++m_generation;
+}
+
+void GlyphCache::drawRun(QPainter &painter, const QPoint &origin, const TerminalCell *cells, int length,
+                         QRgb color, int variant)
+{
+    for (int i = 0; i < length; ++i) {
+        const uint codepoint = cells[i].codepoint;
+        if (codepoint == ' ' || codepoint == 0) {
+            continue;
+        }
+        
+        const QRect target(origin.x() + i * m_cellWidth, origin.y(), m_cellWidth, m_cellHeight);
+        const Glyph cached = glyph(codepoint, color, variant);
+        if (cached.page >= 0) {
+            painter.drawImage(target, m_pages.at(cached.page), cached.source);
+        } else {
+            painter.setFont(m_fonts[variant]);
+            painter.setPen(QColor(color));
+            painter.drawText(target, Qt::AlignLeft | Qt::AlignTop, QString::fromUcs4(reinterpret_cast<const char32_t *>(&codepoint), 1));
+        }
+    }
+}
+
+GlyphCache::Glyph GlyphCache::glyph(uint codepoint, QRgb color, int variant)
+{
+    const quint64 key = (static_cast<quint64>(color & 0xFFFFFF) << 32)
+                      | (static_cast<quint64>(variant) << 24)
+                      | (codepoint & 0x1FFFFF);
+    
+    QHash<quint64, Glyph>::const_iterator it = m_glyphs.constFind(key);
+    if (it != m_glyphs.constEnd()) {
+        return it.value();
+    }
+    
+    // Entries for glyphs drawn as text do not use atlas slots, so bound them separately
+    if (m_glyphs.size() >= MAX_GLYPHS) {
+        clear();
+    }
+    
+    const Glyph rendered = renderGlyph(codepoint, color, variant);
+    m_glyphs.insert(key, rendered);
+    return rendered;
+}
+
+GlyphCache::Glyph GlyphCache::renderGlyph(uint codepoint, QRgb color, int variant)
+{
+    Glyph glyph;
+    glyph.page = -1;
+    
+    const QString text = QString::fromUcs4(reinterpret_cast<const char32_t *>(&codepoint), 1);
+    const QFont &font = m_fonts[variant];
+    if (m_metrics.at(variant).horizontalAdvance(text) > m_cellWidth) {
+        return glyph;
+    }
+    
+    const int slotWidth = qCeil(m_cellWidth * m_devicePixelRatio);
+    const int slotHeight = qCeil(m_cellHeight * m_devicePixelRatio);
+    const int pageSize = qMax(PAGE_SIZE, qMax(slotWidth, slotHeight));
+    const int columns = pageSize / slotWidth;
+    const int slotsPerPage = columns * (pageSize / slotHeight);
+    
+    // Start over once the atlas is full; live glyphs are re-rendered on demand
+    if (m_nextSlot == slotsPerPage * MAX_PAGES) {
+        clear();
+    }
+    
+    const int page = m_nextSlot / slotsPerPage;
+    const int slot = m_nextSlot % slotsPerPage;
+    if (page == m_pages.size()) {
+        QImage image(pageSize, pageSize, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        m_pages.append(image);
+    }
+    ++m_nextSlot;
+    
+    glyph.page = page;
+    glyph.source = QRect((slot % columns) * slotWidth, (slot / columns) * slotHeight, slotWidth, slotHeight);
+    
+    QPainter painter(&m_pages[page]);
+    painter.setClipRect(glyph.source);
+    painter.translate(glyph.source.topLeft());
+    painter.scale(m_devicePixelRatio, m_devicePixelRatio);
+    painter.setFont(font);
+    painter.setPen(QColor(color));
+    painter.drawText(QRect(0, 0, m_cellWidth, m_cellHeight), Qt::AlignLeft | Qt::AlignTop, text);
+    
+    return glyph;
+}
@@ -0,0 +1,115 @@
+#ifndef GLYPHCACHE_H
+#define GLYPHCACHE_H
+
+#include <QFont>
+#include <QFontMetrics>
+#include <QImage>
+#include <QHash>
+#include <QVector>
+#include <QPoint>
+#include <QRect>
+#include "terminalchar.h"
+
+class QPainter;
+
+/**
+ * @brief Atlas of pre-rendered terminal glyphs
+ *
+ * Each (code point, bold/italic, color) combination is rasterized once into
+ * a cell-sized slot of an atlas page and blitted from there afterwards, so
+ * repainting text does not shape every cell again. Glyphs wider than a cell
+ * are not cached and are drawn as text instead.
+ *
+ * The font variants and their metrics are built once per setFont() and
+ * indexed by Variant, so drawing never constructs a QFont.
+ */
+class GlyphCache
+{
+public:
+    enum Variant {
+        Regular = 0,
+        Bold = 1,
+        Italic = 2,
+        BoldItalic = Bold | Italic
+    };
+    
+    GlyphCache();
+    
+    /**
+     * @brief Variant index for the bold and italic bits of a cell style
+     */
+    static int variant(TextAttributes attributes)
+    {
+        return ((attributes & TextAttribute::Bold) ? Bold : Regular)
+             | ((attributes & TextAttribute::Italic) ? Italic : Regular);
+    }
+    
+    /**
+     * @brief Set the base font; derives the variants and cell size and clears the cache
+     *
+     * The cell is as wide as the regular 'M' and as tall as the tallest
+     * variant. Bold and italic variants whose advance differs from the cell
+     * width get letter spacing that brings them back onto the grid.
+     */
+    void setFont(const QFont &font);
+    
+    int cellWidth() const { return m_cellWidth; }
+    int cellHeight() const { return m_cellHeight; }
+    int baseline() const { return m_baseline; }
+    
+    /**
+     * @brief Match the atlas resolution to the target device
+     */
+    void setDevicePixelRatio(qreal ratio);
+    
+    void clear();
+    
+    /**
+     * @brief Draw cells as one run of glyphs starting at origin
+     *
+     * Blank cells are skipped; the caller paints the run background.
+     */
+    void drawRun(QPainter &painter, const QPoint &origin, const TerminalCell *cells, int length,
+                 QRgb color, int variant);
+    
+    struct Glyph {
+        int page;       // -1 if the glyph is drawn as text
+        QRect source;   // Slot in device pixels
+    };
+    
+    /**
+     * @brief Look up a glyph, rasterizing it into the atlas on first use
+     */
+    Glyph glyph(uint codepoint, QRgb color, int variant);
+    
+    int glyphCount() const { return m_glyphs.size(); }
+    const QVector<QImage> &pages() const { return m_pages; }
+    const QFont &font(int variant) const { return m_fonts[variant]; }
+    const QFontMetrics &metrics(int variant) const { return m_metrics.at(variant); }
+    
+    /**
+     * @brief Incremented whenever the atlas is cleared and slots are reused
+     */
+    quint64 generation() const { return m_generation; }
+    
+private:
+    Glyph renderGlyph(uint codepoint, QRgb color, int variant);
+    
+    QFont m_fonts[4];
+    QVector<QFontMetrics> m_metrics;  // Indexed by variant
+    int m_cellWidth;
+    int m_cellHeight;
+    int m_baseline;
+    qreal m_devicePixelRatio;
+    
+    QHash<quint64, Glyph> m_glyphs;
+    QVector<QImage> m_pages;
+    int m_nextSlot;
+    quint64 m_generation;
+    
+    static constexpr int PAGE_SIZE = 512;  // Device pixels
+    static constexpr int MAX_PAGES = 8;
+    static constexpr int MAX_GLYPHS = 65536;
+};
+
+#endif // GLYPHCACHE_H
@@ -122,6 +122,34 @@
         <translation>No se pudo eliminar el archivo de registro.</translation>
     </message>
 </context>
+<context>
+    <name>LibSshSession</name>
+    <message>
+        <location filename="../libsshsession.cpp" line="188"/>
+        <source>The host key of %1 is not known. Connect once with the OpenSSH backend to accept it.</source>
+        <translation>La clave de host de %1 no es conocida. Conéctate una vez con el backend OpenSSH para aceptarla.</translation>
+    </message>
+    <message>
+        <location filename="../libsshsession.cpp" line="196"/>
+        <source>The host key of %1 has changed. Refusing to connect.</source>
+        <translation>La clave de host de %1 ha cambiado. Se rechaza la conexión.</translation>
+    </message>
+    <message>
+        <location filename="../libsshsession.cpp" line="233"/>
+        <source>Authentication to %1 failed.</source>
+        <translation>Falló la autenticación en %1.</translation>
+    </message>
+    <message>
+        <location filename="../libsshsession.cpp" line="275"/>
+        <source>Connection to %1 closed.</source>
+        <translation>Se cerró la conexión con %1.</translation>
+    </message>
+    <message>
+        <location filename="../libsshsession.cpp" line="75"/>
+        <source>Could not create an SSH session.</source>
+        <translation>No se pudo crear una sesión SSH.</translation>
+    </message>
+</context>
 <context>
     <name>MainWindow</name>
     <message>
@@ -247,6 +275,11 @@ Click &apos;Add&apos; to add a new server.</source>
         <source>&amp;Paste</source>
         <translation>&amp;Pegar</translation>
     </message>
+    <message>
+        <location filename="../mainwindow.cpp" line="187"/>
+        <source>&amp;Find...</source>
+        <translation>&amp;Buscar...</translation>
+    </message>
     <message>
         <location filename="../mainwindow.cpp" line="188"/>
         <source>&amp;Options...</source>
@@ -902,6 +935,19 @@ This will also delete all subfolders.</source>
         <translation>Abre primero una pestaña de terminal SSH para ejecutar el fragmento.</translation>
     </message>
 </context>
+<context>
+    <name>MetricsStream</name>
+    <message>
+        <location filename="../metricsstream.cpp" line="167"/>
+        <source>Server metrics are only available from Linux hosts.</source>
+        <translation>Las métricas del servidor solo están disponibles en equipos Linux.</translation>
+    </message>
+    <message>
+        <location filename="../metricsstream.cpp" line="241"/>
+        <source>Failed to start ssh for metrics. Make sure it is installed and in PATH.</source>
+        <translation>No se pudo iniciar ssh para las métricas. Asegúrate de que esté instalado y en el PATH.</translation>
+    </message>
+</context>
 <context>
     <name>MonitoringDialog</name>
     <message>
@@ -1149,6 +1195,86 @@ This will also delete all subfolders.</source>
         <source>Toggle Window hotkey:</source>
         <translation>Atajo para mostrar/ocultar ventana:</translation>
     </message>
+    <message>
+        <location filename="../settingsdialog.cpp" line="61"/>
+        <source>Legacy (per character)</source>
+        <translation>Heredado (por carácter)</translation>
+    </message>
+    <message>
+        <location filename="../settingsdialog.cpp" line="62"/>
+        <source>Table-driven (byte level)</source>
+        <translation>Basado en tabla (nivel de byte)</translation>
+    </message>
+    <message>
+        <location filename="../settingsdialog.cpp" line="63"/>
+        <source>Escape sequence parser used for terminal output</source>
+        <translation>Analizador de secuencias de escape usado para la salida del terminal</translation>
+    </message>
+    <message>
+        <location filename="../settingsdialog.cpp" line="64"/>
+        <source>Parser Engine:</source>
+        <translation>Motor del analizador:</translation>
+    </message>
+    <message>
+        <location filename="../settingsdialog.cpp" line="73"/>
+        <source>Lines of history kept per terminal</source>
+        <translation>Líneas de historial que se guardan por terminal</translation>
+    </message>
+    <message>
+        <location filename="../settingsdialog.cpp" line="74"/>
+        <source>Scrollback Lines:</source>
+        <translation>Líneas de desplazamiento:</translation>
+    </message>
+    <message>
+        <location filename="../settingsdialog.cpp" line="77"/>
+        <source>Store older scrollback in the cache directory</source>
+        <translation>Guardar el historial antiguo en el directorio de caché</translation>
+    </message>
+    <message>
+        <location filename="../settingsdialog.cpp" line="78"/>
+        <source>Scrollback on Disk:</source>
+        <translation>Historial en disco:</translation>
+    </message>
+    <message>
+        <location filename="../settingsdialog.cpp" line="80"/>
+        <source>Software (QPainter)</source>
+        <translation>Software (QPainter)</translation>
+    </message>
+    <message>
+        <location filename="../settingsdialog.cpp" line="81"/>
+        <source>OpenGL</source>
+        <translation>OpenGL</translation>
+    </message>
+    <message>
+        <location filename="../settingsdialog.cpp" line="82"/>
+        <source>How terminal text is drawn; OpenGL uses Mesa software rendering when there is no GPU</source>
+        <translation>Cómo se dibuja el texto del terminal; OpenGL usa el renderizado por software de Mesa cuando no hay GPU</translation>
+    </message>
+    <message>
+        <location filename="../settingsdialog.cpp" line="83"/>
+        <source>Renderer:</source>
+        <translation>Renderizador:</translation>
+    </message>
+    <message>
+        <location filename="../settingsdialog.cpp" line="87"/>
+        <source>OpenSSH (ssh binary)</source>
+        <translation>OpenSSH (binario ssh)</translation>
+    </message>
+    <message>
+        <location filename="../settingsdialog.cpp" line="89"/>
+        <source>In process (libssh)</source>
+        <translation>En proceso (libssh)</translation>
+    </message>
+    <message>
+        <location filename="../settingsdialog.cpp" line="91"/>
+        <source>Used for new connections; servers with jump hosts, tunnels, agent forwarding or custom options always use OpenSSH</source>
+        <translation>Se usa en las conexiones nuevas; los servidores con host de salto, túneles, reenvío del agente u opciones personalizadas siempre usan OpenSSH</translation>
+    </message>
+    <message>
+        <location filename="../settingsdialog.cpp" line="92"/>
+        <source>SSH Backend:</source>
+        <translation>Backend SSH:</translation>
+    </message>
 </context>
 <context>
     <name>QuickCommandsDialog</name>
@@ -1463,6 +1589,49 @@ Reconectando en 3 segundos (intento %1/3)...</translation>
         <translation>Selecciona un fragmento para ejecutar.</translation>
     </message>
 </context>
+<context>
+    <name>TerminalSearchBar</name>
+    <message>
+        <location filename="../terminalsearchbar.cpp" line="23"/>
+        <source>Find</source>
+        <translation>Buscar</translation>
+    </message>
+    <message>
+        <location filename="../terminalsearchbar.cpp" line="31"/>
+        <source>Match case</source>
+        <translation>Coincidir mayúsculas y minúsculas</translation>
+    </message>
+    <message>
+        <location filename="../terminalsearchbar.cpp" line="37"/>
+        <source>Regular expression</source>
+        <translation>Expresión regular</translation>
+    </message>
+    <message>
+        <location filename="../terminalsearchbar.cpp" line="46"/>
+        <source>Previous match (Shift+Enter)</source>
+        <translation>Coincidencia anterior (Mayús+Intro)</translation>
+    </message>
+    <message>
+        <location filename="../terminalsearchbar.cpp" line="51"/>
+        <source>Next match (Enter)</source>
+        <translation>Coincidencia siguiente (Intro)</translation>
+    </message>
+    <message>
+        <location filename="../terminalsearchbar.cpp" line="56"/>
+        <source>Close (Esc)</source>
+        <translation>Cerrar (Esc)</translation>
+    </message>
+    <message>
+        <location filename="../terminalsearchbar.cpp" line="92"/>
+        <source>No matches</source>
+        <translation>Sin coincidencias</translation>
+    </message>
+    <message>
+        <location filename="../terminalsearchbar.cpp" line="94"/>
+        <source>%1 of %2%3</source>
+        <translation>%1 de %2%3</translation>
+    </message>
+</context>
 <context>
     <name>TransferQueueWidget</name>
     <message>
@@ -0,0 +1,355 @@
+#include "libsshchannel.h"
+
+#ifdef QTISSH_HAVE_LIBSSH
+
+#include "libsshsession.h"
+#include <QElapsedTimer>
+
+LibSshChannel::LibSshChannel(QObject *parent)
+    : SSHTransport(parent)
+    , m_channel(nullptr)
+    , m_state(NotStarted)
+    , m_rows(0)
+    , m_columns(0)
+    , m_resizePending(false)
+    , m_eofRequested(false)
+    , m_eofSent(false)
+    , m_readEnabled(true)
+{
+}
+
+LibSshChannel::~LibSshChannel()
+{
+    // The owner is already half destroyed; don't call back into it
+    blockSignals(true);
+    release();
+}
+
+void LibSshChannel::start(const ServerConfig &config, const QString &command, int rows, int columns)
+{
+    if (isRunning()) {
+        return;
+    }
+    release();
+    m_command = command.toUtf8();
+    m_subsystem.clear();
+    m_rows = rows;
+    m_columns = columns;
+    open(config);
+}
+
+void LibSshChannel::startSubsystem(const ServerConfig &config, const QString &subsystem)
+{
+    if (isRunning()) {
+        return;
+    }
+    release();
+    m_command.clear();
+    m_subsystem = subsystem.toUtf8();
+    m_rows = 0;
+    m_columns = 0;
+    open(config);
+}
+
+void LibSshChannel::open(const ServerConfig &config)
+{
+    m_resizePending = false;
+    m_writeBuffer.clear();
+    m_eofRequested = false;
+    m_eofSent = false;
+    m_error.clear();
+
+    m_state = WaitingForSession;
+    m_session = LibSshSession::acquire(config);
+    m_session->addChannel(this);
+}
+
+void LibSshChannel::closeWrite()
+{
+    m_eofRequested = true;
+    if (m_session) {
+        m_session->wake();
+    }
+}
+
+bool LibSshChannel::isRunning() const
+{
+    return m_state != NotStarted && m_state != Finished;
+}
+
+void LibSshChannel::write(const QByteArray &data)
+{
+    if (!isRunning() || m_eofRequested || data.isEmpty()) {
+        return;
+    }
+    // Appended behind anything still queued to keep the byte order
+    m_writeBuffer.append(data);
+    if (m_state == Open) {
+        flushOutput();
+    }
+    if (!m_writeBuffer.isEmpty()) {
+        m_session->wake();
+    }
+}
+
+void LibSshChannel::setWindowSize(int rows, int columns)
+{
+    if (rows <= 0 || columns <= 0 || m_rows <= 0) {
+        return;
+    }
+    m_rows = rows;
+    m_columns = columns;
+    m_resizePending = true;
+    if (m_session) {
+        m_session->wake();
+    }
+}
+
+void LibSshChannel::setReadEnabled(bool enable)
+{
+    // Unread data is not acknowledged, so the server's window closes
+    m_readEnabled = enable;
+    if (enable && m_session) {
+        m_session->wake();
+    }
+}
+
+void LibSshChannel::terminate()
+{
+    if (m_state == Open) {
+        // Closing the channel hangs up its pty; the exit status follows
+        ssh_channel_request_send_signal(m_channel, "TERM");
+        ssh_channel_send_eof(m_channel);
+        ssh_channel_close(m_channel);
+        m_session->wake();
+    } else if (isRunning()) {
+        kill();
+    }
+}
+
+void LibSshChannel::kill()
+{
+    if (isRunning()) {
+        finish(-1, QProcess::CrashExit);
+    }
+}
+
+bool LibSshChannel::waitForFinished(int msecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (isRunning()) {
+        const int left = msecs < 0 ? 100 : msecs - int(timer.elapsed());
+        if (left <= 0) {
+            return false;
+        }
+        // Keep the session alive for the duration; it may finish us
+        QSharedPointer<LibSshSession> session = m_session;
+        session->poll(qMin(left, 100));
+    }
+    return true;
+}
+
+bool LibSshChannel::needsPolling() const
+{
+    switch (m_state) {
+    case Opening:
+    case RequestingPty:
+    case Starting:
+        return true;
+    case Open:
+        if (!m_writeBuffer.isEmpty() || m_resizePending || (m_eofRequested && !m_eofSent)) {
+            return true;
+        }
+        // Output left in libssh's buffers, past the read cap or read for us while
+        // servicing another channel, never makes the socket readable again
+        return m_readEnabled && (ssh_channel_poll(m_channel, 0) > 0 || ssh_channel_poll(m_channel, 1) > 0);
+    default:
+        return false;
+    }
+}
+
+bool LibSshChannel::advance(int rc)
+{
+    if (rc == SSH_AGAIN) {
+        return false;
+    }
+    if (rc != SSH_OK) {
+        fail(QProcess::FailedToStart, QString::fromUtf8(ssh_get_error(m_session->handle())));
+        return false;
+    }
+    return true;
+}
+
+void LibSshChannel::service()
+{
+    if (!m_session) {
+        return;
+    }
+    if (m_session->state() == LibSshSession::Failed) {
+        if (m_state == Open) {
+            m_error = m_session->errorString();
+            finish(-1, QProcess::CrashExit);
+        } else if (isRunning()) {
+            fail(QProcess::FailedToStart, m_session->errorString());
+        }
+        return;
+    }
+
+    switch (m_state) {
+    case WaitingForSession:
+        if (m_session->state() != LibSshSession::Ready) {
+            return;
+        }
+        m_channel = ssh_channel_new(m_session->handle());
+        if (!m_channel) {
+            fail(QProcess::FailedToStart, QString::fromUtf8(ssh_get_error(m_session->handle())));
+            return;
+        }
+        m_state = Opening;
+        Q_FALLTHROUGH();
+    case Opening:
+        if (!advance(ssh_channel_open_session(m_channel))) {
+            return;
+        }
+        m_state = m_rows > 0 ? RequestingPty : Starting;
+        if (m_state == Starting) {
+            service();
+            return;
+        }
+        Q_FALLTHROUGH();
+    case RequestingPty:
+        if (!advance(ssh_channel_request_pty_size(m_channel, "xterm-256color", m_columns, m_rows))) {
+            return;
+        }
+        m_resizePending = false;
+        m_state = Starting;
+        Q_FALLTHROUGH();
+    case Starting: {
+        const int rc = !m_subsystem.isEmpty()
+            ? ssh_channel_request_subsystem(m_channel, m_subsystem.constData())
+            : m_command.isEmpty()
+            ? ssh_channel_request_shell(m_channel)
+            : ssh_channel_request_exec(m_channel, m_command.constData());
+        if (!advance(rc)) {
+            return;
+        }
+        m_state = Open;
+        Q_FALLTHROUGH();
+    }
+    case Open:
+        if (m_resizePending) {
+            m_resizePending = ssh_channel_change_pty_size(m_channel, m_columns, m_rows) == SSH_AGAIN;
+        }
+        flushOutput();
+        if (m_readEnabled) {
+            readAvailable();
+        }
+        // The server closes the channel after sending the exit status; output
+        // still unread while reading is off is delivered first
+        if (m_state == Open && m_readEnabled && ssh_channel_is_closed(m_channel)) {
+            const int status = ssh_channel_get_exit_status(m_channel);
+            if (status < 0) {
+                finish(-1, QProcess::CrashExit);
+            } else {
+                finish(status, QProcess::NormalExit);
+            }
+        }
+        return;
+    case NotStarted:
+    case Finished:
+        return;
+    }
+}
+
+void LibSshChannel::readAvailable()
+{
+    // Drain each stream in large reads and hand it out as one batch
+    for (int stream = 0; stream < 2 && m_state == Open; ++stream) {
+        QByteArray data;
+        while (data.size() < MAX_READ_PER_EVENT) {
+            const int offset = data.size();
+            data.resize(offset + READ_CHUNK);
+            const int count = ssh_channel_read_nonblocking(m_channel, data.data() + offset,
+                                                           READ_CHUNK, stream);
+            data.resize(offset + qMax(0, count));
+            if (count == SSH_ERROR) {
+                m_error = QString::fromUtf8(ssh_get_error(m_session->handle()));
+                emit errorOccurred(QProcess::ReadError);
+                break;
+            }
+            if (count < READ_CHUNK) {
+                break;
+            }
+        }
+        if (data.isEmpty()) {
+            continue;
+        }
+        if (stream == 0) {
+            emit dataReceived(data);
+        } else {
+            emit standardErrorReceived(data);
+        }
+    }
+}
+
+void LibSshChannel::flushOutput()
+{
+    while (m_state == Open && !m_writeBuffer.isEmpty()) {
+        // Never more than the peer's window, so the write cannot stall
+        const uint32_t window = ssh_channel_window_size(m_channel);
+        if (window == 0) {
+            return;
+        }
+        const int size = int(qMin<qint64>(m_writeBuffer.size(), qint64(window)));
+        const int written = ssh_channel_write(m_channel, m_writeBuffer.constData(), uint32_t(size));
+        if (written == SSH_ERROR) {
+            m_error = QString::fromUtf8(ssh_get_error(m_session->handle()));
+            m_writeBuffer.clear();
+            emit errorOccurred(QProcess::WriteError);
+            return;
+        }
+        if (written <= 0) {
+            return;
+        }
+        m_writeBuffer.remove(0, written);
+        emit bytesWritten(written);
+    }
+    if (m_state == Open && m_eofRequested && !m_eofSent) {
+        m_eofSent = ssh_channel_send_eof(m_channel) != SSH_AGAIN;
+    }
+}
+
+void LibSshChannel::fail(QProcess::ProcessError error, const QString &message)
+{
+    m_error = message;
+    release();
+    emit errorOccurred(error);
+}
+
+void LibSshChannel::finish(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    release();
+    emit finished(exitCode, exitStatus);
+}
+
+void LibSshChannel::release()
+{
+    if (m_channel) {
+        if (ssh_channel_is_open(m_channel)) {
+            ssh_channel_close(m_channel);
+        }
+        ssh_channel_free(m_channel);
+        m_channel = nullptr;
+    }
+    if (m_session) {
+        m_session->removeChannel(this);
+        m_session.reset();
+    }
+    m_writeBuffer.clear();
+    if (m_state != NotStarted) {
+        m_state = Finished;
+    }
+}
+
+#endif // QTISSH_HAVE_LIBSSH
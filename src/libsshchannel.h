@@ -0,0 +1,112 @@
+#ifndef LIBSSHCHANNEL_H
+#define LIBSSHCHANNEL_H
+
+#ifdef QTISSH_HAVE_LIBSSH
+
+#include <QSharedPointer>
+#include <libssh/libssh.h>
+#include "serverconfig.h"
+#include "sshtransport.h"
+
+class LibSshSession;
+
+/**
+ * @brief Shell, command or subsystem on a channel of a shared libssh session
+ *
+ * start() returns at once; the channel opens when the server's session is
+ * ready and is then serviced from the session's notifier. Remote output is
+ * drained in large reads into one dataReceived per event, stderr into
+ * standardErrorReceived (with a pty the server merges both). Input is
+ * queued and sent as the peer's window allows, so write() never blocks
+ * however much is pasted or uploaded.
+ */
+class LibSshChannel : public SSHTransport
+{
+    Q_OBJECT
+
+public:
+    explicit LibSshChannel(QObject *parent = nullptr);
+    ~LibSshChannel();
+
+    /**
+     * @brief Open a shell, or run command when it is not empty
+     *
+     * rows and columns above zero request a pty of that size.
+     */
+    void start(const ServerConfig &config, const QString &command, int rows = 0, int columns = 0);
+
+    /**
+     * @brief Start a subsystem such as "sftp" instead of a shell
+     */
+    void startSubsystem(const ServerConfig &config, const QString &subsystem);
+
+    /**
+     * @brief Send end of file once the queued input is out
+     */
+    void closeWrite();
+
+    bool isRunning() const override;
+    void write(const QByteArray &data) override;
+    qint64 bytesToWrite() const override { return m_writeBuffer.size(); }
+    void setWindowSize(int rows, int columns) override;
+    void setReadEnabled(bool enable) override;
+    void terminate() override;
+    void kill() override;
+    bool waitForFinished(int msecs = 30000) override;
+    QString errorString() const override { return m_error; }
+
+    /**
+     * @brief Advance the channel; called by the session
+     */
+    void service();
+
+    /**
+     * @brief Whether a request is in flight, input waits for the peer's window
+     * or output is already buffered by libssh
+     */
+    bool needsPolling() const;
+
+signals:
+    void standardErrorReceived(const QByteArray &data);
+    void bytesWritten(qint64 bytes);
+
+private:
+    enum State {
+        NotStarted,
+        WaitingForSession,
+        Opening,
+        RequestingPty,
+        Starting,
+        Open,
+        Finished
+    };
+
+    void open(const ServerConfig &config);
+    bool advance(int rc);
+    void readAvailable();
+    void flushOutput();
+    void fail(QProcess::ProcessError error, const QString &message);
+    void finish(int exitCode, QProcess::ExitStatus exitStatus);
+    void release();
+
+    QSharedPointer<LibSshSession> m_session;
+    ssh_channel m_channel;
+    State m_state;
+    QByteArray m_command;
+    QByteArray m_subsystem;
+    int m_rows;
+    int m_columns;
+    bool m_resizePending;
+    QByteArray m_writeBuffer;
+    bool m_eofRequested;
+    bool m_eofSent;
+    bool m_readEnabled;
+    QString m_error;
+
+    static constexpr int READ_CHUNK = 64 * 1024;
+    static constexpr int MAX_READ_PER_EVENT = 1024 * 1024;  // Then let the event loop run
+};
+
+#endif // QTISSH_HAVE_LIBSSH
+
+#endif // LIBSSHCHANNEL_H
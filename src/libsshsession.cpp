@@ -0,0 +1,352 @@
+#include "libsshsession.h"
+
+#ifdef QTISSH_HAVE_LIBSSH
+
+#include "libsshchannel.h"
+#include "passwordmanager.h"
+#include <QHash>
+#include <QHostAddress>
+#include <QSocketNotifier>
+#include <QThread>
+#include <QWeakPointer>
+
+namespace {
+QHash<QString, QWeakPointer<LibSshSession>> &sessions()
+{
+    static QHash<QString, QWeakPointer<LibSshSession>> registry;
+    return registry;
+}
+}
+
+QSharedPointer<LibSshSession> LibSshSession::acquire(const ServerConfig &config)
+{
+    QSharedPointer<LibSshSession> session = sessions().value(config.id()).toStrongRef();
+    if (!session || session->state() == Failed) {
+        session = QSharedPointer<LibSshSession>(new LibSshSession(config), &QObject::deleteLater);
+        sessions().insert(config.id(), session);
+        session->start();
+    }
+    return session;
+}
+
+bool LibSshSession::supports(const ServerConfig &config)
+{
+    return config.jumpHost().isEmpty()
+        && config.tunnels().trimmed().isEmpty()
+        && config.sshOptionArgs().isEmpty()
+        && !config.forwardAgent();
+}
+
+LibSshSession::LibSshSession(const ServerConfig &config)
+    : QObject(nullptr)
+    , m_config(config)
+    , m_lookupId(-1)
+    , m_session(ssh_new())
+    , m_event(nullptr)
+    , m_key(nullptr)
+    , m_state(Resolving)
+    , m_readNotifier(nullptr)
+{
+    m_pollTimer.setInterval(POLL_INTERVAL);
+    connect(&m_pollTimer, &QTimer::timeout, this, &LibSshSession::process);
+}
+
+LibSshSession::~LibSshSession()
+{
+    if (sessions().value(m_config.id()).isNull()) {
+        sessions().remove(m_config.id());
+    }
+    if (m_lookupId >= 0) {
+        QHostInfo::abortHostLookup(m_lookupId);
+    }
+    delete m_readNotifier;
+    if (m_event) {
+        ssh_event_remove_session(m_event, m_session);
+        ssh_event_free(m_event);
+    }
+    if (m_key) {
+        ssh_key_free(m_key);
+    }
+    if (m_session) {
+        if (ssh_is_connected(m_session)) {
+            ssh_disconnect(m_session);
+        }
+        ssh_free(m_session);
+    }
+}
+
+void LibSshSession::start()
+{
+    if (!m_session) {
+        fail(tr("Could not create an SSH session."));
+        return;
+    }
+
+    const QByteArray host = m_config.host().toUtf8();
+    const QByteArray user = m_config.username().toUtf8();
+    const int port = m_config.port();
+    ssh_options_set(m_session, SSH_OPTIONS_HOST, host.constData());
+    ssh_options_set(m_session, SSH_OPTIONS_PORT, &port);
+    if (!user.isEmpty()) {
+        ssh_options_set(m_session, SSH_OPTIONS_USER, user.constData());
+    }
+    // Same host aliases and defaults as the ssh binary; explicit options above win
+    ssh_options_parse_config(m_session, nullptr);
+    ssh_set_blocking(m_session, 0);
+
+    // Cheapest first; a method that is denied moves on to the next
+    m_authMethods << AuthNone;
+    switch (m_config.authType()) {
+    case AuthType::Password:
+        m_authMethods << AuthPassword;
+        break;
+    case AuthType::PublicKey:
+        if (!m_config.keyPath().isEmpty()) {
+            m_authMethods << AuthKeyFile;
+        }
+        break;
+    case AuthType::SSHAgent:
+        break;
+    }
+    m_authMethods << AuthAgent << AuthAutoKeys;
+
+    // The name ssh_connect() would look up, aliases applied
+    char *hostName = nullptr;
+    if (ssh_options_get(m_session, SSH_OPTIONS_HOST, &hostName) == SSH_OK) {
+        m_hostName = QString::fromUtf8(hostName);
+        ssh_string_free_char(hostName);
+    }
+    char *proxyCommand = nullptr;
+    const bool proxied = ssh_options_get(m_session, SSH_OPTIONS_PROXYCOMMAND, &proxyCommand) == SSH_OK;
+    if (proxied) {
+        ssh_string_free_char(proxyCommand);
+    }
+    // Literal addresses and proxy commands need no lookup
+    if (proxied || m_hostName.isEmpty() || !QHostAddress(m_hostName).isNull()) {
+        connectToHost();
+        return;
+    }
+    m_lookupId = QHostInfo::lookupHost(m_hostName, this, SLOT(onHostResolved(QHostInfo)));
+}
+
+void LibSshSession::onHostResolved(const QHostInfo &info)
+{
+    m_lookupId = -1;
+    if (info.error() != QHostInfo::NoError || info.addresses().isEmpty()) {
+        fail(tr("Could not resolve %1: %2").arg(m_hostName, info.errorString()));
+        return;
+    }
+    // ssh_connect() gets the address; verifyHost() puts the name back
+    const QByteArray address = info.addresses().first().toString().toUtf8();
+    ssh_options_set(m_session, SSH_OPTIONS_HOST, address.constData());
+    connectToHost();
+}
+
+void LibSshSession::connectToHost()
+{
+    m_state = Connecting;
+    m_pollTimer.start();
+    process();
+}
+
+void LibSshSession::addChannel(LibSshChannel *channel)
+{
+    if (!m_channels.contains(channel)) {
+        m_channels.append(channel);
+    }
+    wake();
+}
+
+void LibSshSession::removeChannel(LibSshChannel *channel)
+{
+    m_channels.removeAll(channel);
+}
+
+void LibSshSession::wake()
+{
+    // The lookup result starts the connection itself
+    if (m_state != Failed && m_state != Resolving && !m_pollTimer.isActive()) {
+        m_pollTimer.start();
+    }
+}
+
+void LibSshSession::poll(int msecs)
+{
+    if (m_state == Ready) {
+        ssh_event_dopoll(m_event, msecs);
+        serviceChannels();
+        return;
+    }
+    process();
+    if (m_state != Ready && m_state != Failed) {
+        QThread::msleep(qMin(msecs, POLL_INTERVAL));
+    }
+}
+
+void LibSshSession::process()
+{
+    switch (m_state) {
+    case Resolving:
+        return;
+    case Connecting: {
+        const int rc = ssh_connect(m_session);
+        if (rc == SSH_AGAIN) {
+            return;
+        }
+        if (rc != SSH_OK) {
+            fail(QString::fromUtf8(ssh_get_error(m_session)));
+            return;
+        }
+        if (!verifyHost()) {
+            return;
+        }
+        m_state = Authenticating;
+        authenticate();
+        return;
+    }
+    case Authenticating:
+        authenticate();
+        return;
+    case Ready:
+        // Read whatever the socket has, then let the channels move data
+        ssh_event_dopoll(m_event, 0);
+        serviceChannels();
+        return;
+    case Failed:
+        m_pollTimer.stop();
+        return;
+    }
+}
+
+bool LibSshSession::verifyHost()
+{
+    if (!m_hostName.isEmpty()) {
+        ssh_options_set(m_session, SSH_OPTIONS_HOST, m_hostName.toUtf8().constData());
+    }
+    switch (ssh_session_is_known_server(m_session)) {
+    case SSH_KNOWN_HOSTS_OK:
+        return true;
+    case SSH_KNOWN_HOSTS_NOT_FOUND:
+    case SSH_KNOWN_HOSTS_UNKNOWN:
+        if (!m_config.strictHostKeyChecking()) {
+            // Like StrictHostKeyChecking=no with a throwaway known_hosts
+            return true;
+        }
+        fail(tr("The host key of %1 is not known. Connect once with the OpenSSH backend to accept it.")
+                 .arg(m_config.host()));
+        return false;
+    case SSH_KNOWN_HOSTS_CHANGED:
+    case SSH_KNOWN_HOSTS_OTHER:
+        if (!m_config.strictHostKeyChecking()) {
+            return true;
+        }
+        fail(tr("The host key of %1 has changed. Refusing to connect.").arg(m_config.host()));
+        return false;
+    case SSH_KNOWN_HOSTS_ERROR:
+        break;
+    }
+    fail(QString::fromUtf8(ssh_get_error(m_session)));
+    return false;
+}
+
+void LibSshSession::authenticate()
+{
+    while (!m_authMethods.isEmpty()) {
+        const int rc = tryAuthMethod(m_authMethods.first());
+        if (rc == SSH_AUTH_AGAIN) {
+            return;
+        }
+        if (rc == SSH_AUTH_SUCCESS) {
+            m_authMethods.clear();
+            if (m_key) {
+                ssh_key_free(m_key);
+                m_key = nullptr;
+            }
+            m_event = ssh_event_new();
+            ssh_event_add_session(m_event, m_session);
+            m_readNotifier = new QSocketNotifier(ssh_get_fd(m_session), QSocketNotifier::Read, this);
+            connect(m_readNotifier, &QSocketNotifier::activated, this, &LibSshSession::process);
+            m_state = Ready;
+            emit ready();
+            serviceChannels();
+            return;
+        }
+        if (rc == SSH_AUTH_ERROR) {
+            fail(QString::fromUtf8(ssh_get_error(m_session)));
+            return;
+        }
+        m_authMethods.removeFirst();
+    }
+    fail(tr("Authentication to %1 failed.").arg(m_config.host()));
+}
+
+int LibSshSession::tryAuthMethod(AuthMethod method)
+{
+    switch (method) {
+    case AuthNone:
+        return ssh_userauth_none(m_session, nullptr);
+    case AuthPassword: {
+        const QString password = m_config.password();
+        if (password.isEmpty() || password.startsWith(PasswordManager::instance().storagePrefix())) {
+            return SSH_AUTH_DENIED;
+        }
+        return ssh_userauth_password(m_session, nullptr, password.toUtf8().constData());
+    }
+    case AuthKeyFile:
+        if (!m_key && ssh_pki_import_privkey_file(m_config.keyPath().toLocal8Bit().constData(),
+                                                  nullptr, nullptr, nullptr, &m_key) != SSH_OK) {
+            return SSH_AUTH_DENIED;
+        }
+        return ssh_userauth_publickey(m_session, nullptr, m_key);
+    case AuthAgent:
+        return ssh_userauth_agent(m_session, nullptr);
+    case AuthAutoKeys:
+        return ssh_userauth_publickey_auto(m_session, nullptr, nullptr);
+    }
+    return SSH_AUTH_DENIED;
+}
+
+void LibSshSession::serviceChannels()
+{
+    // Channels may finish and drop out while being serviced
+    const QList<LibSshChannel*> channels = m_channels;
+    for (LibSshChannel *channel : channels) {
+        if (m_channels.contains(channel)) {
+            channel->service();
+        }
+    }
+    // Checked once all are serviced: reading one channel buffers packets for the others
+    bool pending = false;
+    for (LibSshChannel *channel : channels) {
+        pending = pending || (m_channels.contains(channel) && channel->needsPolling());
+    }
+
+    if (!ssh_is_connected(m_session)) {
+        fail(tr("Connection to %1 closed.").arg(m_config.host()));
+        return;
+    }
+    // The notifier covers incoming data; requests in flight and queued input are polled
+    if (pending) {
+        m_pollTimer.start();
+    } else {
+        m_pollTimer.stop();
+    }
+}
+
+void LibSshSession::fail(const QString &error)
+{
+    m_state = Failed;
+    m_error = error;
+    m_pollTimer.stop();
+    if (m_readNotifier) {
+        m_readNotifier->setEnabled(false);
+    }
+    emit failed(error);
+
+    const QList<LibSshChannel*> channels = m_channels;
+    for (LibSshChannel *channel : channels) {
+        channel->service();
+    }
+}
+
+#endif // QTISSH_HAVE_LIBSSH
@@ -0,0 +1,118 @@
+#ifndef LIBSSHSESSION_H
+#define LIBSSHSESSION_H
+
+#ifdef QTISSH_HAVE_LIBSSH
+
+#include <QObject>
+#include <QList>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QHostInfo>
+#include <libssh/libssh.h>
+#include "serverconfig.h"
+
+class QSocketNotifier;
+class LibSshChannel;
+
+/**
+ * @brief One in-process SSH connection shared by all channels to a server
+ *
+ * The session runs libssh in non-blocking mode on the GUI thread: the
+ * host name is looked up through QHostInfo first, as ssh_connect() would
+ * resolve it synchronously, then the handshake, host key check and
+ * authentication advance one step per event, and once ready a QSocketNotifier on the socket drives
+ * ssh_event_dopoll() and then lets every channel move its data. A short
+ * poll timer only runs while the handshake or a channel request is in
+ * progress, or a channel has input the peer's window could not take yet.
+ *
+ * Sessions are shared per server through acquire() and disconnect when
+ * the last channel lets go.
+ */
+class LibSshSession : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum State {
+        Resolving,
+        Connecting,
+        Authenticating,
+        Ready,
+        Failed
+    };
+
+    static QSharedPointer<LibSshSession> acquire(const ServerConfig &config);
+
+    /**
+     * @brief Whether the in-process transport can serve config
+     *
+     * Jump hosts, tunnels, agent forwarding and custom OpenSSH options need
+     * the ssh binary.
+     */
+    static bool supports(const ServerConfig &config);
+
+    ~LibSshSession();
+
+    State state() const { return m_state; }
+    QString errorString() const { return m_error; }
+    ssh_session handle() const { return m_session; }
+
+    void addChannel(LibSshChannel *channel);
+    void removeChannel(LibSshChannel *channel);
+
+    /**
+     * @brief Service the session from the event loop soon
+     */
+    void wake();
+
+    /**
+     * @brief Wait up to msecs for socket activity and service it
+     */
+    void poll(int msecs);
+
+signals:
+    void ready();
+    void failed(const QString &error);
+
+private slots:
+    void process();
+    void onHostResolved(const QHostInfo &info);
+
+private:
+    enum AuthMethod {
+        AuthNone,
+        AuthPassword,
+        AuthKeyFile,
+        AuthAgent,
+        AuthAutoKeys
+    };
+
+    explicit LibSshSession(const ServerConfig &config);
+
+    void start();
+    void connectToHost();
+    bool verifyHost();
+    void authenticate();
+    int tryAuthMethod(AuthMethod method);
+    void serviceChannels();
+    void fail(const QString &error);
+
+    ServerConfig m_config;
+    QString m_hostName;  // After ssh config aliases; known_hosts is keyed on it
+    int m_lookupId;
+    ssh_session m_session;
+    ssh_event m_event;
+    ssh_key m_key;
+    State m_state;
+    QString m_error;
+    QSocketNotifier *m_readNotifier;
+    QTimer m_pollTimer;
+    QList<LibSshChannel*> m_channels;
+    QList<AuthMethod> m_authMethods;  // Still to try, in order
+
+    static constexpr int POLL_INTERVAL = 10;  // milliseconds
+};
+
+#endif // QTISSH_HAVE_LIBSSH
+
+#endif // LIBSSHSESSION_H
@@ -0,0 +1,599 @@
+#include "libsshsftp.h"
+
+#ifdef QTISSH_HAVE_LIBSSH
+
+#include "libsshchannel.h"
+#include <QDateTime>
+#include <QFile>
+#include <QtEndian>
+
+namespace {
+// Message types and flags from draft-ietf-secsh-filexfer-02 (version 3)
+enum : quint8 {
+    SSH_FXP_INIT = 1,
+    SSH_FXP_VERSION = 2,
+    SSH_FXP_OPEN = 3,
+    SSH_FXP_CLOSE = 4,
+    SSH_FXP_READ = 5,
+    SSH_FXP_WRITE = 6,
+    SSH_FXP_OPENDIR = 11,
+    SSH_FXP_READDIR = 12,
+    SSH_FXP_REMOVE = 13,
+    SSH_FXP_MKDIR = 14,
+    SSH_FXP_RMDIR = 15,
+    SSH_FXP_REALPATH = 16,
+    SSH_FXP_RENAME = 18,
+    SSH_FXP_STATUS = 101,
+    SSH_FXP_HANDLE = 102,
+    SSH_FXP_DATA = 103,
+    SSH_FXP_NAME = 104
+};
+
+enum : quint32 {
+    SSH_FX_OK = 0,
+    SSH_FX_EOF = 1,
+
+    SSH_FILEXFER_ATTR_SIZE = 0x00000001,
+    SSH_FILEXFER_ATTR_UIDGID = 0x00000002,
+    SSH_FILEXFER_ATTR_PERMISSIONS = 0x00000004,
+    SSH_FILEXFER_ATTR_ACMODTIME = 0x00000008,
+    SSH_FILEXFER_ATTR_EXTENDED = 0x80000000,
+
+    SSH_FXF_READ = 0x00000001,
+    SSH_FXF_WRITE = 0x00000002,
+    SSH_FXF_CREAT = 0x00000008,
+    SSH_FXF_TRUNC = 0x00000010
+};
+
+constexpr quint32 PROTOCOL_VERSION = 3;
+
+void appendUint32(QByteArray &out, quint32 value)
+{
+    char bytes[4];
+    qToBigEndian(value, bytes);
+    out.append(bytes, 4);
+}
+
+void appendUint64(QByteArray &out, quint64 value)
+{
+    char bytes[8];
+    qToBigEndian(value, bytes);
+    out.append(bytes, 8);
+}
+
+void appendString(QByteArray &out, const QByteArray &value)
+{
+    appendUint32(out, quint32(value.size()));
+    out.append(value);
+}
+
+QByteArray encodePath(const QString &path)
+{
+    QByteArray out;
+    appendString(out, path.toUtf8());
+    return out;
+}
+
+// Bounds-checked reads; a short packet leaves ok false
+struct Reader {
+    const QByteArray &data;
+    int pos = 0;
+    bool ok = true;
+
+    quint32 uint32()
+    {
+        if (!ok || data.size() - pos < 4) {
+            ok = false;
+            return 0;
+        }
+        const quint32 value = qFromBigEndian<quint32>(data.constData() + pos);
+        pos += 4;
+        return value;
+    }
+
+    quint64 uint64()
+    {
+        const quint64 high = uint32();
+        return (high << 32) | uint32();
+    }
+
+    QByteArray string()
+    {
+        const quint32 size = uint32();
+        if (!ok || size > quint32(data.size() - pos)) {
+            ok = false;
+            return QByteArray();
+        }
+        const QByteArray value = data.mid(pos, int(size));
+        pos += int(size);
+        return value;
+    }
+};
+
+QString permissionString(quint32 mode)
+{
+    QString result;
+    switch (mode & 0170000) {
+    case 0040000:
+        result += QLatin1Char('d');
+        break;
+    case 0120000:
+        result += QLatin1Char('l');
+        break;
+    default:
+        result += QLatin1Char('-');
+        break;
+    }
+    const char flags[] = "rwxrwxrwx";
+    for (int i = 0; i < 9; ++i) {
+        result += (mode & (0400 >> i)) ? QLatin1Char(flags[i]) : QLatin1Char('-');
+    }
+    return result;
+}
+
+QString childPath(const QString &directory, const QString &name)
+{
+    return directory.endsWith(QLatin1Char('/')) ? directory + name : directory + QLatin1Char('/') + name;
+}
+}
+
+LibSshSftp::LibSshSftp(QObject *parent)
+    : QObject(parent)
+    , m_channel(new LibSshChannel(this))
+    , m_running(false)
+    , m_ready(false)
+    , m_nextId(1)
+{
+    connect(m_channel, &LibSshChannel::dataReceived, this, &LibSshSftp::onData);
+    connect(m_channel, &LibSshChannel::finished, this, [this]() {
+        const QString error = m_channel->errorString();
+        shutDown(error.isEmpty() ? tr("The server closed the SFTP session.") : error);
+    });
+    connect(m_channel, &LibSshChannel::errorOccurred, this, [this]() {
+        shutDown(m_channel->errorString());
+        m_channel->kill();
+    });
+}
+
+LibSshSftp::~LibSshSftp()
+{
+    blockSignals(true);
+    close();
+}
+
+void LibSshSftp::start(const ServerConfig &config)
+{
+    if (m_running) {
+        return;
+    }
+    m_running = true;
+    m_buffer.clear();
+    m_channel->startSubsystem(config, QStringLiteral("sftp"));
+
+    // Queued until the channel opens; the server answers with its version
+    QByteArray init;
+    appendUint32(init, 5);
+    init.append(char(SSH_FXP_INIT));
+    appendUint32(init, PROTOCOL_VERSION);
+    m_channel->write(init);
+}
+
+void LibSshSftp::close()
+{
+    if (!m_running) {
+        return;
+    }
+    shutDown(QString());
+    m_channel->terminate();
+}
+
+quint32 LibSshSftp::realPath(const QString &path)
+{
+    return begin(RealPath, path, SSH_FXP_REALPATH, encodePath(path));
+}
+
+quint32 LibSshSftp::listDirectory(const QString &path)
+{
+    return begin(List, path, SSH_FXP_OPENDIR, encodePath(path));
+}
+
+quint32 LibSshSftp::makeDirectory(const QString &path)
+{
+    QByteArray payload = encodePath(path);
+    appendUint32(payload, 0);  // No attributes; the server's umask applies
+    return begin(Simple, path, SSH_FXP_MKDIR, payload);
+}
+
+quint32 LibSshSftp::removeDirectory(const QString &path)
+{
+    return begin(Simple, path, SSH_FXP_RMDIR, encodePath(path));
+}
+
+quint32 LibSshSftp::remove(const QString &path)
+{
+    return begin(Simple, path, SSH_FXP_REMOVE, encodePath(path));
+}
+
+quint32 LibSshSftp::rename(const QString &oldPath, const QString &newPath)
+{
+    QByteArray payload = encodePath(oldPath);
+    appendString(payload, newPath.toUtf8());
+    return begin(Simple, oldPath, SSH_FXP_RENAME, payload);
+}
+
+quint32 LibSshSftp::download(const QString &remotePath, const QString &localPath)
+{
+    if (!m_running) {
+        return failLater(tr("Not connected."));
+    }
+    QFile *file = new QFile(localPath, this);
+    if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        const QString error = tr("Could not open %1: %2").arg(localPath, file->errorString());
+        delete file;
+        return failLater(error);
+    }
+    QByteArray payload = encodePath(remotePath);
+    appendUint32(payload, SSH_FXF_READ);
+    appendUint32(payload, 0);
+    const quint32 request = begin(Download, remotePath, SSH_FXP_OPEN, payload);
+    m_operations[request].file = file;
+    return request;
+}
+
+quint32 LibSshSftp::upload(const QString &localPath, const QString &remotePath)
+{
+    if (!m_running) {
+        return failLater(tr("Not connected."));
+    }
+    QFile *file = new QFile(localPath, this);
+    if (!file->open(QIODevice::ReadOnly)) {
+        const QString error = tr("Could not open %1: %2").arg(localPath, file->errorString());
+        delete file;
+        return failLater(error);
+    }
+    QByteArray payload = encodePath(remotePath);
+    appendUint32(payload, SSH_FXF_WRITE | SSH_FXF_CREAT | SSH_FXF_TRUNC);
+    appendUint32(payload, 0);
+    const quint32 request = begin(Upload, remotePath, SSH_FXP_OPEN, payload);
+    m_operations[request].file = file;
+    return request;
+}
+
+quint32 LibSshSftp::begin(Kind kind, const QString &path, quint8 type, const QByteArray &payload)
+{
+    if (!m_running) {
+        return failLater(tr("Not connected."));
+    }
+    const quint32 request = m_nextId++;
+    m_operations.insert(request, {kind, path, QByteArray(), {}, nullptr, 0, 0, false, false});
+    send(request, type, payload);
+    return request;
+}
+
+quint32 LibSshSftp::failLater(const QString &error)
+{
+    // Queued so the caller can map the request number first
+    const quint32 request = m_nextId++;
+    QMetaObject::invokeMethod(this, [this, request, error]() {
+        emit failed(request, error);
+    }, Qt::QueuedConnection);
+    return request;
+}
+
+void LibSshSftp::send(quint32 request, quint8 type, const QByteArray &payload, qint64 offset, int length)
+{
+    const quint32 id = m_nextId++;
+    m_packets.insert(id, {request, offset, length});
+
+    QByteArray packet;
+    packet.reserve(9 + payload.size());
+    appendUint32(packet, quint32(payload.size() + 5));
+    packet.append(char(type));
+    appendUint32(packet, id);
+    packet.append(payload);
+    m_channel->write(packet);
+}
+
+void LibSshSftp::onData(const QByteArray &data)
+{
+    m_buffer.append(data);
+    int pos = 0;
+    while (m_running && m_buffer.size() - pos >= 4) {
+        const quint32 length = qFromBigEndian<quint32>(m_buffer.constData() + pos);
+        if (length < 1 || length > quint32(MAX_PACKET)) {
+            shutDown(tr("Invalid SFTP packet from the server."));
+            m_channel->kill();
+            return;
+        }
+        if (quint32(m_buffer.size() - pos - 4) < length) {
+            break;
+        }
+        const quint8 type = quint8(m_buffer.at(pos + 4));
+        const QByteArray body = m_buffer.mid(pos + 5, int(length) - 1);
+        pos += 4 + int(length);
+
+        if (type == SSH_FXP_VERSION) {
+            m_ready = true;
+            emit ready();
+            continue;
+        }
+        Reader reader{body};
+        const quint32 id = reader.uint32();
+        if (reader.ok) {
+            handle(type, id, body.mid(4));
+        }
+    }
+    m_buffer.remove(0, pos);
+}
+
+void LibSshSftp::handle(quint8 type, quint32 id, const QByteArray &body)
+{
+    const auto packetIt = m_packets.find(id);
+    if (packetIt == m_packets.end()) {
+        return;
+    }
+    const Packet packet = *packetIt;
+    m_packets.erase(packetIt);
+    // Replies for an operation that already failed are dropped
+    const auto operationIt = m_operations.find(packet.operation);
+    if (operationIt == m_operations.end()) {
+        return;
+    }
+    Operation &op = *operationIt;
+
+    Reader reader{body};
+    switch (type) {
+    case SSH_FXP_STATUS: {
+        const quint32 code = reader.uint32();
+        const QString message = QString::fromUtf8(reader.string());
+        onStatus(packet.operation, op, code, message);
+        return;
+    }
+    case SSH_FXP_HANDLE: {
+        const QByteArray handle = reader.string();
+        if (reader.ok) {
+            onHandle(packet.operation, op, handle);
+            return;
+        }
+        break;
+    }
+    case SSH_FXP_DATA: {
+        const QByteArray data = reader.string();
+        if (reader.ok && op.kind == Download) {
+            onFileData(packet.operation, op, packet, data);
+            return;
+        }
+        break;
+    }
+    case SSH_FXP_NAME:
+        onName(packet.operation, op, body);
+        return;
+    default:
+        break;
+    }
+    fail(packet.operation, tr("Unexpected SFTP reply from the server."));
+}
+
+void LibSshSftp::onStatus(quint32 request, Operation &op, quint32 code, const QString &message)
+{
+    if (op.closing) {
+        // A write can still fail as the file is closed
+        if (code != SSH_FX_OK && op.kind == Upload) {
+            fail(request, message);
+        } else {
+            succeed(request);
+        }
+        return;
+    }
+
+    if (code == SSH_FX_EOF && op.kind == List) {
+        closeHandle(request, op);
+        return;
+    }
+    if (code == SSH_FX_EOF && op.kind == Download) {
+        --op.inFlight;
+        op.done = true;
+        pump(request, op);
+        return;
+    }
+    if (code == SSH_FX_OK && op.kind == Simple) {
+        succeed(request);
+        return;
+    }
+    if (code == SSH_FX_OK && op.kind == Upload) {
+        --op.inFlight;
+        pump(request, op);
+        return;
+    }
+    fail(request, message.isEmpty() ? tr("SFTP error %1.").arg(code) : message);
+}
+
+void LibSshSftp::onHandle(quint32 request, Operation &op, const QByteArray &handle)
+{
+    op.handle = handle;
+    if (op.kind == List) {
+        QByteArray payload;
+        appendString(payload, handle);
+        send(request, SSH_FXP_READDIR, payload);
+        return;
+    }
+    pump(request, op);
+}
+
+void LibSshSftp::onName(quint32 request, Operation &op, const QByteArray &body)
+{
+    Reader reader{body};
+    const quint32 count = reader.uint32();
+    QList<RemoteFileInfo> entries;
+    for (quint32 i = 0; i < count && reader.ok; ++i) {
+        RemoteFileInfo info;
+        info.name = QString::fromUtf8(reader.string());
+        const QString longName = QString::fromUtf8(reader.string());
+        info.size = 0;
+        info.isDirectory = false;
+
+        const quint32 flags = reader.uint32();
+        quint32 uid = 0;
+        quint32 gid = 0;
+        if (flags & SSH_FILEXFER_ATTR_SIZE) {
+            info.size = qint64(reader.uint64());
+        }
+        if (flags & SSH_FILEXFER_ATTR_UIDGID) {
+            uid = reader.uint32();
+            gid = reader.uint32();
+        }
+        if (flags & SSH_FILEXFER_ATTR_PERMISSIONS) {
+            const quint32 mode = reader.uint32();
+            info.permissions = permissionString(mode);
+            info.isDirectory = (mode & 0170000) == 0040000;
+        }
+        if (flags & SSH_FILEXFER_ATTR_ACMODTIME) {
+            reader.uint32();
+            info.lastModified = QDateTime::fromSecsSinceEpoch(reader.uint32());
+        }
+        if (flags & SSH_FILEXFER_ATTR_EXTENDED) {
+            const quint32 extended = reader.uint32();
+            for (quint32 j = 0; j < extended && reader.ok; ++j) {
+                reader.string();
+                reader.string();
+            }
+        }
+
+        // Names only appear in the ls -l style long name
+        const QStringList fields = longName.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+        info.owner = fields.size() > 3 ? fields.at(2) : QString::number(uid);
+        info.group = fields.size() > 3 ? fields.at(3) : QString::number(gid);
+        info.path = childPath(op.path, info.name);
+        entries.append(info);
+    }
+    if (!reader.ok) {
+        fail(request, tr("Invalid SFTP reply from the server."));
+        return;
+    }
+
+    if (op.kind == RealPath) {
+        if (entries.isEmpty()) {
+            fail(request, tr("The server did not resolve %1.").arg(op.path));
+            return;
+        }
+        op.path = entries.first().name;
+        succeed(request);
+        return;
+    }
+    if (op.kind != List) {
+        fail(request, tr("Unexpected SFTP reply from the server."));
+        return;
+    }
+    for (const RemoteFileInfo &info : entries) {
+        if (info.name != QLatin1String(".") && info.name != QLatin1String("..")) {
+            op.files.append(info);
+        }
+    }
+    QByteArray payload;
+    appendString(payload, op.handle);
+    send(request, SSH_FXP_READDIR, payload);
+}
+
+void LibSshSftp::onFileData(quint32 request, Operation &op, const Packet &packet, const QByteArray &data)
+{
+    --op.inFlight;
+    if (!op.file->seek(packet.offset) || op.file->write(data) != data.size()) {
+        fail(request, tr("Could not write %1: %2").arg(op.file->fileName(), op.file->errorString()));
+        return;
+    }
+    // A short read is not the end of the file; ask for the rest of the chunk
+    if (data.size() < packet.length && !op.done) {
+        QByteArray payload;
+        appendString(payload, op.handle);
+        appendUint64(payload, quint64(packet.offset + data.size()));
+        appendUint32(payload, quint32(packet.length - data.size()));
+        send(request, SSH_FXP_READ, payload, packet.offset + data.size(), packet.length - data.size());
+        ++op.inFlight;
+    }
+    pump(request, op);
+}
+
+void LibSshSftp::pump(quint32 request, Operation &op)
+{
+    if (op.handle.isEmpty() || op.closing) {
+        return;
+    }
+    while (!op.done && op.inFlight < MAX_IN_FLIGHT) {
+        QByteArray payload;
+        appendString(payload, op.handle);
+        appendUint64(payload, quint64(op.offset));
+        if (op.kind == Download) {
+            appendUint32(payload, CHUNK);
+            send(request, SSH_FXP_READ, payload, op.offset, CHUNK);
+            op.offset += CHUNK;
+        } else {
+            const QByteArray chunk = op.file->read(CHUNK);
+            if (chunk.isEmpty()) {
+                op.done = true;
+                break;
+            }
+            appendString(payload, chunk);
+            send(request, SSH_FXP_WRITE, payload);
+            op.offset += chunk.size();
+        }
+        ++op.inFlight;
+    }
+    if (op.done && op.inFlight == 0) {
+        closeHandle(request, op);
+    }
+}
+
+void LibSshSftp::closeHandle(quint32 request, Operation &op)
+{
+    op.closing = true;
+    QByteArray payload;
+    appendString(payload, op.handle);
+    send(request, SSH_FXP_CLOSE, payload);
+}
+
+void LibSshSftp::succeed(quint32 request)
+{
+    const Operation op = m_operations.take(request);
+    delete op.file;
+    switch (op.kind) {
+    case RealPath:
+        emit pathResolved(request, op.path);
+        break;
+    case List:
+        emit directoryListed(request, op.files);
+        break;
+    default:
+        emit completed(request);
+        break;
+    }
+}
+
+void LibSshSftp::fail(quint32 request, const QString &error)
+{
+    const Operation op = m_operations.take(request);
+    if (!op.handle.isEmpty() && !op.closing && m_running) {
+        // Nobody waits for this reply any more
+        QByteArray payload;
+        appendString(payload, op.handle);
+        send(0, SSH_FXP_CLOSE, payload);
+    }
+    delete op.file;
+    emit failed(request, error);
+}
+
+void LibSshSftp::shutDown(const QString &error)
+{
+    if (!m_running) {
+        return;
+    }
+    m_running = false;
+    m_ready = false;
+    m_packets.clear();
+    const QList<quint32> requests = m_operations.keys();
+    for (quint32 request : requests) {
+        fail(request, error.isEmpty() ? tr("Disconnected.") : error);
+    }
+    emit closed(error);
+}
+
+#endif // QTISSH_HAVE_LIBSSH
@@ -0,0 +1,110 @@
+#ifndef LIBSSHSFTP_H
+#define LIBSSHSFTP_H
+
+#ifdef QTISSH_HAVE_LIBSSH
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include "serverconfig.h"
+#include "sftpconnection.h"
+
+class QFile;
+class LibSshChannel;
+
+/**
+ * @brief SFTP (protocol version 3) on the "sftp" subsystem of a shared libssh session
+ *
+ * The client speaks the wire protocol itself over a LibSshChannel rather
+ * than using libssh's blocking sftp API, so it runs from the session's
+ * notifier like every other channel. Each call returns a request number
+ * that the matching result signal carries back. Transfers keep a few
+ * reads or writes in flight to cover the round trip.
+ */
+class LibSshSftp : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LibSshSftp(QObject *parent = nullptr);
+    ~LibSshSftp();
+
+    void start(const ServerConfig &config);
+    void close();
+    bool isReady() const { return m_ready; }
+
+    quint32 realPath(const QString &path);
+    quint32 listDirectory(const QString &path);
+    quint32 makeDirectory(const QString &path);
+    quint32 removeDirectory(const QString &path);
+    quint32 remove(const QString &path);
+    quint32 rename(const QString &oldPath, const QString &newPath);
+    quint32 download(const QString &remotePath, const QString &localPath);
+    quint32 upload(const QString &localPath, const QString &remotePath);
+
+signals:
+    void ready();
+    void closed(const QString &error);  // Empty after close()
+    void pathResolved(quint32 request, const QString &path);
+    void directoryListed(quint32 request, const QList<RemoteFileInfo> &files);
+    void completed(quint32 request);
+    void failed(quint32 request, const QString &error);
+
+private:
+    enum Kind {
+        RealPath,
+        List,
+        Simple,
+        Download,
+        Upload
+    };
+
+    struct Operation {
+        Kind kind;
+        QString path;
+        QByteArray handle;
+        QList<RemoteFileInfo> files;
+        QFile *file;
+        qint64 offset;  // Next read or write
+        int inFlight;
+        bool done;      // Nothing more to read or write
+        bool closing;
+    };
+
+    struct Packet {
+        quint32 operation;
+        qint64 offset;
+        int length;
+    };
+
+    quint32 begin(Kind kind, const QString &path, quint8 type, const QByteArray &payload);
+    quint32 failLater(const QString &error);
+    void send(quint32 request, quint8 type, const QByteArray &payload, qint64 offset = 0, int length = 0);
+    void onData(const QByteArray &data);
+    void handle(quint8 type, quint32 id, const QByteArray &body);
+    void onStatus(quint32 request, Operation &op, quint32 code, const QString &message);
+    void onHandle(quint32 request, Operation &op, const QByteArray &handle);
+    void onName(quint32 request, Operation &op, const QByteArray &body);
+    void onFileData(quint32 request, Operation &op, const Packet &packet, const QByteArray &data);
+    void pump(quint32 request, Operation &op);
+    void closeHandle(quint32 request, Operation &op);
+    void succeed(quint32 request);
+    void fail(quint32 request, const QString &error);
+    void shutDown(const QString &error);
+
+    LibSshChannel *m_channel;
+    QByteArray m_buffer;
+    bool m_running;
+    bool m_ready;
+    quint32 m_nextId;
+    QHash<quint32, Operation> m_operations;  // By request number
+    QHash<quint32, Packet> m_packets;        // By packet id
+
+    static constexpr int CHUNK = 32 * 1024;  // What every server accepts
+    static constexpr int MAX_IN_FLIGHT = 8;
+    static constexpr int MAX_PACKET = 256 * 1024;
+};
+
+#endif // QTISSH_HAVE_LIBSSH
+
+#endif // LIBSSHSFTP_H
@@ -2,6 +2,7 @@
 #include "applockmanager.h"
 #include "applockdialog.h"
 #include "settingsmanager.h"
+#include "scrollbacksegments.h"
 
 #include <QApplication>
 #include <QDir>
@@ -37,6 +38,9 @@ int main(int argc, char *argv[])
             return 1;
         }
 
+    // The only instance: segment files still in the cache outlived a crash
+    ScrollbackSegments::removeStaleSegments(ScrollbackSegments::defaultDirectory());
+
     // Global application password: gate access to the whole app.
     if (AppLockManager::instance().isEnabled()
         && !AppLockDialog::prompt()) {
@@ -183,6 +183,11 @@ void MainWindow::setupUI()
     pasteAction->setShortcut(QKeySequence::Paste);
     connect(pasteAction, &QAction::triggered, this, &MainWindow::onPasteClicked);
     
+    // Ctrl+F belongs to the remote application (e.g. readline, less)
+    QAction *findAction = editMenu->addAction(tr("&Find..."));
+    findAction->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_F));
+    connect(findAction, &QAction::triggered, this, &MainWindow::onFindClicked);
+    
     editMenu->addSeparator();
     
     QAction *optionsAction = editMenu->addAction(tr("&Options..."));
@@ -518,6 +523,13 @@ void MainWindow::onPasteClicked()
     }
 }
 
+void MainWindow::onFindClicked()
+{
+    if (SSHTerminal *terminal = currentTerminal()) {
+        terminal->showSearchBar();
+    }
+}
+
 void MainWindow::onCutClicked()
 {
     // Cut is usually not applicable in a terminal, but we can copy
@@ -533,6 +545,11 @@ void MainWindow::onOptionsClicked()
     dialog.setCursorStyle(sm.cursorStyle());
     dialog.setForegroundColor(sm.terminalForeground());
     dialog.setBackgroundColor(sm.terminalBackground());
+    dialog.setParserEngine(sm.parserEngine());
+    dialog.setScrollbackLines(sm.scrollbackLines());
+    dialog.setScrollbackOnDisk(sm.scrollbackOnDisk());
+    dialog.setRenderer(sm.renderer());
+    dialog.setSshBackend(sm.sshBackend());
     dialog.setMinimizeToTray(sm.minimizeToTray());
     dialog.setGlobalQuickConnect(sm.globalQuickConnect());
     dialog.setGlobalToggleWindow(sm.globalToggleWindow());
@@ -546,6 +563,10 @@ void MainWindow::onOptionsClicked()
         VT100Terminal::CursorStyle style = static_cast<VT100Terminal::CursorStyle>(dialog.cursorStyle());
         QColor fg = dialog.foregroundColor();
         QColor bg = dialog.backgroundColor();
+        ParserEngine engine = dialog.parserEngine();
+        int scrollbackLines = dialog.scrollbackLines();
+        bool scrollbackOnDisk = dialog.scrollbackOnDisk();
+        TerminalRenderer renderer = dialog.renderer();
         
         // Save to settings
         sm.setTerminalFont(font);
@@ -553,6 +574,12 @@ void MainWindow::onOptionsClicked()
         sm.setCursorStyle(style);
         sm.setTerminalForeground(fg);
         sm.setTerminalBackground(bg);
+        sm.setParserEngine(engine);
+        sm.setScrollbackLines(scrollbackLines);
+        sm.setScrollbackOnDisk(scrollbackOnDisk);
+        sm.setRenderer(renderer);
+        // Picked up by the next connection; open sessions keep their transport
+        sm.setSshBackend(dialog.sshBackend());
         sm.setMinimizeToTray(dialog.minimizeToTray());
         sm.setGlobalQuickConnect(dialog.globalQuickConnect());
         sm.setGlobalToggleWindow(dialog.globalToggleWindow());
@@ -565,10 +592,16 @@ void MainWindow::onOptionsClicked()
             QWidget *widget = m_tabWidget->widget(i);
             if (auto *split = qobject_cast<TerminalSplitWidget*>(widget)) {
                 split->applySettings(font, style, fg, bg);
+                split->setParserEngine(engine);
+                split->setScrollback(scrollbackLines, scrollbackOnDisk);
+                split->setRenderer(renderer);
             } else if (auto *terminal = qobject_cast<SSHTerminal*>(widget)) {
                 terminal->setTerminalFont(font);
                 terminal->setCursorStyle(style);
                 terminal->setTerminalColors(fg, bg);
+                terminal->setParserEngine(engine);
+                terminal->setScrollback(scrollbackLines, scrollbackOnDisk);
+                terminal->setRenderer(renderer);
             }
         }
     }
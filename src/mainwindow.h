@@ -52,6 +52,7 @@ private slots:
     void onCopyClicked();
     void onPasteClicked();
     void onCutClicked();
+    void onFindClicked();
     void onSnippetsClicked();
     void onCommandHistoryClicked();
     void onExportServersClicked();
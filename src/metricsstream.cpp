@@ -0,0 +1,240 @@
+#include "metricsstream.h"
+#include "sshconnectionbroker.h"
+#include <QFile>
+#include <QHash>
+#include <QProcessEnvironment>
+#include <QVector>
+#include <QWeakPointer>
+#include <QDebug>
+
+namespace {
+QHash<QString, QWeakPointer<MetricsStream>> &streams()
+{
+    static QHash<QString, QWeakPointer<MetricsStream>> registry;
+    return registry;
+}
+}
+
+QSharedPointer<MetricsStream> MetricsStream::acquire(const ServerConfig &config, int intervalMs)
+{
+    QSharedPointer<MetricsStream> stream = streams().value(config.id()).toStrongRef();
+    if (!stream) {
+        stream = QSharedPointer<MetricsStream>(new MetricsStream(config, intervalMs), &QObject::deleteLater);
+        streams().insert(config.id(), stream);
+        stream->start();
+    }
+    return stream;
+}
+
+MetricsStream::MetricsStream(const ServerConfig &config, int intervalMs)
+    : QObject(nullptr)
+    , m_config(config)
+    , m_interval(qMax(1000, intervalMs))
+    , m_process(nullptr)
+    , m_fatal(false)
+{
+    m_restartTimer.setSingleShot(true);
+    m_restartTimer.setInterval(RESTART_DELAY);
+    connect(&m_restartTimer, &QTimer::timeout, this, &MetricsStream::start);
+}
+
+MetricsStream::~MetricsStream()
+{
+    m_restartTimer.stop();
+    if (streams().value(m_config.id()).isNull()) {
+        streams().remove(m_config.id());
+    }
+    if (m_process) {
+        m_process->disconnect(this);
+        if (m_process->state() != QProcess::NotRunning) {
+            m_process->terminate();
+            if (!m_process->waitForFinished(1000)) {
+                m_process->kill();
+            }
+        }
+    }
+    cleanupAskPass();
+}
+
+QString MetricsStream::remoteScript() const
+{
+    // One line of POSIX sh without single quotes, so it survives being
+    // passed through any login shell inside sh -c '...'. Everything but
+    // sleep and who is a builtin. Records are
+    // "S <centiseconds> <cpu busy> <cpu total> <mem total kB> <mem available kB>
+    //  <rx bytes> <tx bytes> <uptime s> <users>", deltas where it matters.
+    return QStringLiteral(
+        "[ -r /proc/stat ] || { echo \"E no-proc\"; exit 1; }; "
+        "pb=0; pt=0; pr=0; px=0; pu=0; n=0; us=0; "
+        "while :; do "
+        "read -r c u ni sy id io iq si st rest < /proc/stat; "
+        "b=$((u+ni+sy+iq+si+st)); t=$((b+id+io)); "
+        "mt=0; ma=0; "
+        "while read -r k v rest; do case $k in MemTotal:) mt=$v;; MemAvailable:) ma=$v;; esac; done < /proc/meminfo; "
+        "r=0; x=0; "
+        "while IFS=: read -r i d; do [ -n \"$d\" ] || continue; set -- $d; "
+        "case ${i##* } in lo) ;; *) r=$((r+$1)); x=$((x+$9));; esac; done < /proc/net/dev; "
+        "read -r up rest < /proc/uptime; ut=${up%.*}; uc=${up#*.}; uc=${uc#0}; cs=$((ut*100+uc)); "
+        "if [ $n -eq 0 ]; then us=$(who 2>/dev/null | wc -l); fi; n=$((n+1)); [ $n -lt %2 ] || n=0; "
+        "if [ $pt -gt 0 ]; then "
+        "echo \"S $((cs-pu)) $((b-pb)) $((t-pt)) $mt $ma $((r-pr)) $((x-px)) $ut $us\"; sleep %1; "
+        "else sleep 1; fi; "
+        "pb=$b; pt=$t; pr=$r; px=$x; pu=$cs; "
+        "done")
+        .arg(qMax(1, m_interval / 1000))
+        .arg(USERS_EVERY);
+}
+
+void MetricsStream::start()
+{
+    if (m_fatal || (m_process && m_process->state() != QProcess::NotRunning)) {
+        return;
+    }
+    if (m_process) {
+        m_process->deleteLater();
+    }
+    m_buffer.clear();
+
+    m_process = new QProcess(this);
+    connect(m_process, &QProcess::readyReadStandardOutput, this, &MetricsStream::onReadyRead);
+    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &MetricsStream::onProcessFinished);
+    connect(m_process, &QProcess::errorOccurred, this, &MetricsStream::onProcessError);
+
+    SSHConnectionBroker &broker = SSHConnectionBroker::instance();
+    const bool viaMaster = broker.isMasterReady(m_config);
+    QStringList args = SSHConnectionBroker::connectionArgs(m_config);
+    args << broker.clientArgs(m_config);
+    // Quiet between records, so a dead link has to be detected to reopen it
+    args << "-o" << "ServerAliveInterval=15";
+
+    args << QString("%1@%2").arg(m_config.username(), m_config.host());
+    args << QString("exec sh -c '%1'").arg(remoteScript());
+
+    // Through the master there is nothing to authenticate
+    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+    cleanupAskPass();
+    if (!viaMaster) {
+        m_askPassPath = SSHConnectionBroker::writeAskPass(m_config);
+        if (!m_askPassPath.isEmpty()) {
+            SSHConnectionBroker::useAskPass(env, m_askPassPath);
+        }
+    }
+    m_process->setProcessEnvironment(env);
+    m_process->setStandardErrorFile(QProcess::nullDevice());
+    m_process->start("ssh", args);
+}
+
+void MetricsStream::onReadyRead()
+{
+    // Output of the remote script means ssh has logged in
+    cleanupAskPass();
+    m_buffer += m_process->readAllStandardOutput();
+
+    int start = 0;
+    int newline;
+    while ((newline = m_buffer.indexOf('\n', start)) >= 0) {
+        parseRecord(m_buffer.mid(start, newline - start));
+        start = newline + 1;
+    }
+    m_buffer.remove(0, start);
+
+    // Only login banners and the like get this long
+    if (m_buffer.size() > MAX_LINE) {
+        m_buffer.clear();
+    }
+}
+
+void MetricsStream::parseRecord(const QByteArray &line)
+{
+    const QList<QByteArray> fields = line.trimmed().split(' ');
+    if (fields.isEmpty()) {
+        return;
+    }
+
+    if (fields.first() == "E") {
+        m_fatal = true;
+        emit errorOccurred(tr("Server metrics are only available from Linux hosts."));
+        return;
+    }
+    if (fields.first() != "S" || fields.size() < 10) {
+        return;
+    }
+
+    QVector<qint64> values;
+    for (int i = 1; i < fields.size(); ++i) {
+        bool ok = false;
+        values.append(fields.at(i).toLongLong(&ok));
+        if (!ok) {
+            return;
+        }
+    }
+    const qint64 centiseconds = values[0];
+    const qint64 cpuBusy = values[1];
+    const qint64 cpuTotal = values[2];
+    const qint64 memoryTotal = values[3];
+    const qint64 memoryAvailable = values[4];
+    const qint64 received = values[5];
+    const qint64 sent = values[6];
+
+    ServerMetrics metrics;
+    metrics.lastUpdate = QDateTime::currentDateTime();
+    if (cpuTotal > 0) {
+        metrics.cpuUsage = qBound(0.0, 100.0 * double(cpuBusy) / double(cpuTotal), 100.0);
+    }
+    metrics.memoryTotal = memoryTotal / 1024.0;
+    metrics.memoryUsed = (memoryTotal - memoryAvailable) / 1024.0;
+    if (metrics.memoryTotal > 0) {
+        metrics.memoryUsage = (metrics.memoryUsed / metrics.memoryTotal) * 100.0;
+    }
+    if (centiseconds > 0) {
+        metrics.networkRx = qMax<qint64>(0, received) * 100.0 / double(centiseconds);
+        metrics.networkTx = qMax<qint64>(0, sent) * 100.0 / double(centiseconds);
+    }
+    metrics.uptime = formatUptime(values[7]);
+    metrics.userCount = int(values[8]);
+
+    emit metricsUpdated(metrics);
+}
+
+QString MetricsStream::formatUptime(qint64 seconds)
+{
+    const qint64 days = seconds / 86400;
+    const qint64 hours = (seconds % 86400) / 3600;
+    const qint64 minutes = (seconds % 3600) / 60;
+    if (days > 0) {
+        return QString("%1d %2h %3m").arg(days).arg(hours).arg(minutes);
+    }
+    if (hours > 0) {
+        return QString("%1h %2m").arg(hours).arg(minutes);
+    }
+    return QString("%1m").arg(minutes);
+}
+
+void MetricsStream::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    Q_UNUSED(exitStatus)
+    cleanupAskPass();
+    if (!m_fatal) {
+        qDebug() << "Metrics stream ended with exit code:" << exitCode;
+        m_restartTimer.start();
+    }
+}
+
+void MetricsStream::onProcessError(QProcess::ProcessError error)
+{
+    if (error != QProcess::FailedToStart) {
+        return;
+    }
+    cleanupAskPass();
+    m_fatal = true;
+    emit errorOccurred(tr("Failed to start ssh for metrics. Make sure it is installed and in PATH."));
+}
+
+void MetricsStream::cleanupAskPass()
+{
+    if (!m_askPassPath.isEmpty()) {
+        QFile::remove(m_askPassPath);
+        m_askPassPath.clear();
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef METRICSSTREAM_H
+#define METRICSSTREAM_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QProcess>
+#include <QSharedPointer>
+#include <QTimer>
+#include "serverconfig.h"
+
+struct ServerMetrics {
+    double cpuUsage = 0.0;
+    double memoryUsage = 0.0;
+    double memoryTotal = 0.0;
+    double memoryUsed = 0.0;
+    double networkRx = 0.0;  // Bytes per second
+    double networkTx = 0.0;
+    QString uptime;
+    int userCount = 0;
+    QDateTime lastUpdate;
+};
+
+/**
+ * @brief Long-lived metrics feed from one server
+ *
+ * A single ssh channel runs a small shell loop on the server that reads
+ * /proc/stat, /proc/meminfo, /proc/net/dev and /proc/uptime with shell
+ * builtins and prints one compact record per interval: CPU and network
+ * counters as deltas since the previous record, plus the time between
+ * them, so rates come out exact without the client tracking counters.
+ * Only `sleep`, and `who` every USERS_EVERY records, fork on the server.
+ *
+ * Streams are shared per server through acquire(); the channel closes
+ * when the last holder drops its pointer. A channel that drops is
+ * reopened after RESTART_DELAY.
+ */
+class MetricsStream : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Running stream for config, started on first use
+     *
+     * intervalMs only applies to a stream that is not running yet.
+     */
+    static QSharedPointer<MetricsStream> acquire(const ServerConfig &config, int intervalMs);
+
+    ~MetricsStream();
+
+    int interval() const { return m_interval; }
+
+signals:
+    void metricsUpdated(const ServerMetrics &metrics);
+    void errorOccurred(const QString &error);
+
+private slots:
+    void start();
+    void onReadyRead();
+    void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onProcessError(QProcess::ProcessError error);
+
+private:
+    MetricsStream(const ServerConfig &config, int intervalMs);
+
+    QString remoteScript() const;
+    void parseRecord(const QByteArray &line);
+    static QString formatUptime(qint64 seconds);
+    void cleanupAskPass();
+
+    ServerConfig m_config;
+    int m_interval;
+    QProcess *m_process;
+    QTimer m_restartTimer;
+    QByteArray m_buffer;
+    QString m_askPassPath;  // Until ssh has logged in
+    bool m_fatal;  // The server cannot provide metrics; don't restart
+
+    static constexpr int RESTART_DELAY = 10000;  // milliseconds
+    static constexpr int USERS_EVERY = 12;  // Records between `who` runs
+    static constexpr int MAX_LINE = 4096;
+};
+
+#endif // METRICSSTREAM_H
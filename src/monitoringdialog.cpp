@@ -1,5 +1,6 @@
 #include "monitoringdialog.h"
 #include "passwordmanager.h"
+#include "sshconnectionbroker.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QLabel>
@@ -84,6 +85,7 @@ void MonitoringDialog::startProcess()
         args << "-o" << "ForwardAgent=yes";
     }
     args << m_config.sshOptionArgs();
+    args << SSHConnectionBroker::instance().clientArgs(m_config);
 
     QString command = "uptime; echo '==== Memory ===='; free -m; "
                       "echo '==== Disk ===='; df -h; "
@@ -0,0 +1,179 @@
+#include "printablescanner.h"
+#include <QtAlgorithms>
+#include <QByteArray>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PRINTABLESCANNER_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(PRINTABLESCANNER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define PRINTABLESCANNER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PRINTABLESCANNER_TARGET_AVX2
+#endif
+
+namespace {
+
+inline bool isPrintableAscii(uchar byte)
+{
+    return byte >= 0x20 && byte < 0x7F;
+}
+
+int scanScalar(const uchar *data, int length)
+{
+    int i = 0;
+    while (i < length && isPrintableAscii(data[i])) {
+        ++i;
+    }
+    return i;
+}
+
+#ifdef PRINTABLESCANNER_X86
+
+int scanSSE2(const uchar *data, int length)
+{
+    // As signed bytes, 0x20-0x7F are exactly the values greater than 0x1F;
+    // C0 controls and everything from 0x80 up fall below that
+    const __m128i lowest = _mm_set1_epi8(0x1F);
+    const __m128i del = _mm_set1_epi8(0x7F);
+    
+    int i = 0;
+    for (; i + 16 <= length; i += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i printable = _mm_andnot_si128(_mm_cmpeq_epi8(block, del),
+                                                   _mm_cmpgt_epi8(block, lowest));
+        const uint mask = static_cast<uint>(_mm_movemask_epi8(printable));
+        if (mask != 0xFFFF) {
+            return i + qCountTrailingZeroBits(~mask);
+        }
+    }
+    return i + scanScalar(data + i, length - i);
+}
+
+PRINTABLESCANNER_TARGET_AVX2
+int scanAVX2(const uchar *data, int length)
+{
+    const __m256i lowest = _mm256_set1_epi8(0x1F);
+    const __m256i del = _mm256_set1_epi8(0x7F);
+    
+    int i = 0;
+    for (; i + 32 <= length; i += 32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        const __m256i printable = _mm256_andnot_si256(_mm256_cmpeq_epi8(block, del),
+                                                      _mm256_cmpgt_epi8(block, lowest));
+        const uint mask = static_cast<uint>(_mm256_movemask_epi8(printable));
+        if (mask != 0xFFFFFFFFu) {
+            return i + qCountTrailingZeroBits(~mask);
+        }
+    }
+    return i + scanSSE2(data + i, length - i);
+}
+
+bool cpuHasAVX2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    // AVX state must also be enabled by the OS (OSXSAVE + XCR0 bits 1 and 2)
+    if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // PRINTABLESCANNER_X86
+
+PrintableScanner::Implementation bestImplementation()
+{
+#ifdef PRINTABLESCANNER_X86
+    return cpuHasAVX2() ? PrintableScanner::AVX2 : PrintableScanner::SSE2;
+#else
+    return PrintableScanner::Scalar;
+#endif
+}
+
+PrintableScanner::Implementation detectImplementation()
+{
+    // QTISSH_SCANNER=scalar|sse2|avx2 allows comparing implementations
+    const QByteArray forced = qgetenv("QTISSH_SCANNER").toLower();
+    if (forced == "scalar") {
+        return PrintableScanner::Scalar;
+    }
+    if (forced == "sse2") {
+        return qMin(PrintableScanner::SSE2, bestImplementation());
+    }
+    return bestImplementation();
+}
+
+PrintableScanner::Implementation initialImplementation()
+{
+    // Detected once, however many worker threads get here first
+    static const PrintableScanner::Implementation initial = detectImplementation();
+    return initial;
+}
+
+int dispatchFirstCall(const uchar *data, int length);
+
+} // namespace
+
+std::atomic<PrintableScanner::ScanFunction> PrintableScanner::s_scan(dispatchFirstCall);
+std::atomic<PrintableScanner::Implementation> PrintableScanner::s_implementation(PrintableScanner::Scalar);
+
+namespace {
+
+int dispatchFirstCall(const uchar *data, int length)
+{
+    PrintableScanner::setImplementation(initialImplementation());
+    return PrintableScanner::asciiRunLength(data, length);
+}
+
+} // namespace
+
+PrintableScanner::Implementation PrintableScanner::implementation()
+{
+    if (s_scan.load(std::memory_order_relaxed) == dispatchFirstCall) {
+        setImplementation(initialImplementation());
+    }
+    return s_implementation.load(std::memory_order_relaxed);
+}
+
+const char *PrintableScanner::implementationName()
+{
+    switch (implementation()) {
+    case AVX2:
+        return "AVX2";
+    case SSE2:
+        return "SSE2";
+    case Scalar:
+        break;
+    }
+    return "scalar";
+}
+
+void PrintableScanner::setImplementation(Implementation implementation)
+{
+    const Implementation chosen = qMin(implementation, bestImplementation());
+    ScanFunction scan = scanScalar;
+    switch (chosen) {
+#ifdef PRINTABLESCANNER_X86
+    case AVX2:
+        scan = scanAVX2;
+        break;
+    case SSE2:
+        scan = scanSSE2;
+        break;
+#endif
+    default:
+        break;
+    }
+    s_implementation.store(chosen, std::memory_order_relaxed);
+    s_scan.store(scan, std::memory_order_relaxed);
+}
@@ -0,0 +1,48 @@
+#ifndef PRINTABLESCANNER_H
+#define PRINTABLESCANNER_H
+
+#include <QtGlobal>
+#include <atomic>
+
+/**
+ * @brief Vectorized search for runs of printable ASCII in terminal input
+ *
+ * Scans 16 (SSE2) or 32 (AVX2) bytes at a time for the first byte that is a
+ * C0 control, DEL or outside ASCII. The implementation is picked once at
+ * runtime from the CPU features; other architectures use a scalar loop.
+ * Every terminal parses on its own worker thread, so the choice is kept in
+ * atomics.
+ */
+class PrintableScanner
+{
+public:
+    enum Implementation {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    /**
+     * @brief Length of the leading run of bytes in the range 0x20-0x7E
+     */
+    static int asciiRunLength(const uchar *data, int length)
+    {
+        return s_scan.load(std::memory_order_relaxed)(data, length);
+    }
+
+    static Implementation implementation();
+    static const char *implementationName();
+
+    /**
+     * @brief Forces an implementation, falling back if the CPU lacks it
+     */
+    static void setImplementation(Implementation implementation);
+
+private:
+    typedef int (*ScanFunction)(const uchar *data, int length);
+
+    static std::atomic<ScanFunction> s_scan;
+    static std::atomic<Implementation> s_implementation;
+};
+
+#endif // PRINTABLESCANNER_H
@@ -0,0 +1,394 @@
+#include "ptyprocess.h"
+#include <QSocketNotifier>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QFile>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#if defined(Q_OS_MACOS)
+#include <util.h>
+#elif defined(Q_OS_FREEBSD)
+#include <libutil.h>
+#else
+#include <pty.h>
+#endif
+
+extern char **environ;
+#endif
+
+PtyProcess::PtyProcess(QObject *parent)
+    : SSHTransport(parent)
+    , m_pid(-1)
+    , m_master(-1)
+    , m_readNotifier(nullptr)
+    , m_writeNotifier(nullptr)
+    , m_readEnabled(true)
+    , m_reapTimer(new QTimer(this))
+    , m_process(nullptr)
+{
+    // Polls for the exit status once the child has closed its terminal
+    m_reapTimer->setInterval(REAP_INTERVAL);
+    connect(m_reapTimer, &QTimer::timeout, this, &PtyProcess::reap);
+}
+
+PtyProcess::~PtyProcess()
+{
+    // The owner is already half destroyed; don't call back into it
+    blockSignals(true);
+#ifdef Q_OS_UNIX
+    if (isRunning()) {
+        kill();
+        waitForFinished(1000);
+    }
+    closeMaster();
+#endif
+}
+
+void PtyProcess::start(const QString &program, const QStringList &arguments,
+                       const QProcessEnvironment &environment, int rows, int columns)
+{
+    if (isRunning()) {
+        return;
+    }
+    m_writeBuffer.clear();
+
+#ifdef Q_OS_UNIX
+    // Everything the child needs is prepared before forking
+    QList<QByteArray> argumentData;
+    argumentData << QFile::encodeName(program);
+    for (const QString &argument : arguments) {
+        argumentData << argument.toLocal8Bit();
+    }
+    QVector<char *> argv;
+    for (QByteArray &argument : argumentData) {
+        argv.append(argument.data());
+    }
+    argv.append(nullptr);
+
+    QList<QByteArray> environmentData;
+    for (const QString &variable : environment.toStringList()) {
+        environmentData << variable.toLocal8Bit();
+    }
+    QVector<char *> envp;
+    for (QByteArray &variable : environmentData) {
+        envp.append(variable.data());
+    }
+    envp.append(nullptr);
+
+    // A failed exec reports its errno here; a successful one closes the pipe
+    int status[2];
+    if (::pipe(status) != 0) {
+        emit errorOccurred(QProcess::FailedToStart);
+        return;
+    }
+    ::fcntl(status[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(status[1], F_SETFD, FD_CLOEXEC);
+
+    struct winsize size = {};
+    size.ws_row = static_cast<unsigned short>(qMax(1, rows));
+    size.ws_col = static_cast<unsigned short>(qMax(1, columns));
+
+    int master = -1;
+    const pid_t pid = ::forkpty(&master, nullptr, nullptr, &size);
+    if (pid < 0) {
+        ::close(status[0]);
+        ::close(status[1]);
+        emit errorOccurred(QProcess::FailedToStart);
+        return;
+    }
+
+    if (pid == 0) {
+        // Child: the pty slave is already stdin, stdout, stderr and controlling terminal
+        ::close(status[0]);
+        sigset_t signals;
+        sigemptyset(&signals);
+        ::sigprocmask(SIG_SETMASK, &signals, nullptr);
+        ::signal(SIGPIPE, SIG_DFL);
+        if (!environment.isEmpty()) {
+            environ = envp.data();
+        }
+        ::execvp(argv.first(), argv.data());
+
+        const int error = errno;
+        const ssize_t written = ::write(status[1], &error, sizeof(error));
+        Q_UNUSED(written)
+        ::_exit(127);
+    }
+
+    ::close(status[1]);
+    int error = 0;
+    ssize_t received;
+    do {
+        received = ::read(status[0], &error, sizeof(error));
+    } while (received < 0 && errno == EINTR);
+    ::close(status[0]);
+
+    if (received > 0) {
+        ::close(master);
+        ::waitpid(pid, nullptr, 0);
+        emit errorOccurred(QProcess::FailedToStart);
+        return;
+    }
+
+    m_pid = pid;
+    m_master = master;
+    ::fcntl(master, F_SETFL, ::fcntl(master, F_GETFL) | O_NONBLOCK);
+    ::fcntl(master, F_SETFD, FD_CLOEXEC);
+
+    m_readNotifier = new QSocketNotifier(master, QSocketNotifier::Read, this);
+    m_readNotifier->setEnabled(m_readEnabled);
+    connect(m_readNotifier, &QSocketNotifier::activated, this, &PtyProcess::onReadable);
+    m_writeNotifier = new QSocketNotifier(master, QSocketNotifier::Write, this);
+    m_writeNotifier->setEnabled(false);
+    connect(m_writeNotifier, &QSocketNotifier::activated, this, &PtyProcess::onWritable);
+#else
+    Q_UNUSED(rows)
+    Q_UNUSED(columns)
+    delete m_process;
+    m_process = new QProcess(this);
+    m_process->setProcessEnvironment(environment);
+    m_process->setProcessChannelMode(QProcess::MergedChannels);
+    connect(m_process, &QProcess::readyRead, this, [this]() {
+        // Pipes cannot be paused; the output waits in QProcess's buffer instead
+        if (m_readEnabled) {
+            emit dataReceived(m_process->readAll());
+        }
+    });
+    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &PtyProcess::finished);
+    connect(m_process, &QProcess::errorOccurred, this, &PtyProcess::errorOccurred);
+    m_process->start(program, arguments);
+#endif
+}
+
+bool PtyProcess::isRunning() const
+{
+#ifdef Q_OS_UNIX
+    return m_pid > 0;
+#else
+    return m_process && m_process->state() != QProcess::NotRunning;
+#endif
+}
+
+void PtyProcess::write(const QByteArray &data)
+{
+#ifdef Q_OS_UNIX
+    if (m_master < 0 || data.isEmpty()) {
+        return;
+    }
+    // Appended behind anything still queued to keep the byte order
+    m_writeBuffer.append(data);
+    onWritable();
+#else
+    if (m_process) {
+        m_process->write(data);
+    }
+#endif
+}
+
+void PtyProcess::setReadEnabled(bool enable)
+{
+    m_readEnabled = enable;
+#ifdef Q_OS_UNIX
+    // Unread output fills the pty, which then blocks the program's writes
+    if (m_readNotifier) {
+        m_readNotifier->setEnabled(enable);
+    }
+#else
+    if (enable && m_process && m_process->bytesAvailable() > 0) {
+        emit dataReceived(m_process->readAll());
+    }
+#endif
+}
+
+qint64 PtyProcess::bytesToWrite() const
+{
+#ifdef Q_OS_UNIX
+    return m_writeBuffer.size();
+#else
+    return m_process ? m_process->bytesToWrite() : 0;
+#endif
+}
+
+void PtyProcess::setWindowSize(int rows, int columns)
+{
+#ifdef Q_OS_UNIX
+    if (m_master < 0 || rows <= 0 || columns <= 0) {
+        return;
+    }
+    // The kernel signals the foreground process group; ssh sends a window-change request
+    struct winsize size = {};
+    size.ws_row = static_cast<unsigned short>(rows);
+    size.ws_col = static_cast<unsigned short>(columns);
+    ::ioctl(m_master, TIOCSWINSZ, &size);
+#else
+    Q_UNUSED(rows)
+    Q_UNUSED(columns)
+#endif
+}
+
+void PtyProcess::terminate()
+{
+#ifdef Q_OS_UNIX
+    if (m_pid > 0) {
+        ::kill(pid_t(m_pid), SIGTERM);
+    }
+#else
+    if (m_process) {
+        m_process->terminate();
+    }
+#endif
+}
+
+void PtyProcess::kill()
+{
+#ifdef Q_OS_UNIX
+    if (m_pid > 0) {
+        ::kill(pid_t(m_pid), SIGKILL);
+    }
+#else
+    if (m_process) {
+        m_process->kill();
+    }
+#endif
+}
+
+bool PtyProcess::waitForFinished(int msecs)
+{
+#ifdef Q_OS_UNIX
+    if (m_pid <= 0) {
+        return false;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    while (!collectExitStatus()) {
+        if (msecs >= 0 && timer.elapsed() >= msecs) {
+            return false;
+        }
+        QThread::msleep(REAP_INTERVAL / 2);
+    }
+    return true;
+#else
+    return m_process && m_process->waitForFinished(msecs);
+#endif
+}
+
+void PtyProcess::onReadable()
+{
+#ifdef Q_OS_UNIX
+    // Drain what is there in large reads and hand it out as one batch
+    QByteArray data;
+    bool closed = false;
+    while (data.size() < MAX_READ_PER_EVENT) {
+        const int offset = data.size();
+        data.resize(offset + READ_CHUNK);
+        const ssize_t count = ::read(m_master, data.data() + offset, READ_CHUNK);
+        if (count > 0) {
+            data.resize(offset + int(count));
+            if (count < READ_CHUNK) {
+                break;
+            }
+            continue;
+        }
+        data.resize(offset);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        // End of file or EIO: the child side of the terminal is closed
+        closed = count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+        break;
+    }
+
+    if (!data.isEmpty()) {
+        emit dataReceived(data);
+    }
+    if (closed) {
+        closeMaster();
+        reap();
+    }
+#endif
+}
+
+void PtyProcess::onWritable()
+{
+#ifdef Q_OS_UNIX
+    while (!m_writeBuffer.isEmpty()) {
+        const ssize_t count = ::write(m_master, m_writeBuffer.constData(), size_t(m_writeBuffer.size()));
+        if (count > 0) {
+            m_writeBuffer.remove(0, int(count));
+        } else if (count < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                m_writeBuffer.clear();
+            }
+            break;
+        }
+    }
+    if (m_writeNotifier) {
+        m_writeNotifier->setEnabled(!m_writeBuffer.isEmpty());
+    }
+#endif
+}
+
+void PtyProcess::reap()
+{
+    if (collectExitStatus()) {
+        m_reapTimer->stop();
+    } else if (!m_reapTimer->isActive()) {
+        m_reapTimer->start();
+    }
+}
+
+void PtyProcess::closeMaster()
+{
+#ifdef Q_OS_UNIX
+    delete m_readNotifier;
+    m_readNotifier = nullptr;
+    delete m_writeNotifier;
+    m_writeNotifier = nullptr;
+    if (m_master >= 0) {
+        ::close(m_master);
+        m_master = -1;
+    }
+    m_writeBuffer.clear();
+#endif
+}
+
+bool PtyProcess::collectExitStatus()
+{
+#ifdef Q_OS_UNIX
+    if (m_pid <= 0) {
+        return true;
+    }
+
+    int status = 0;
+    pid_t result;
+    do {
+        result = ::waitpid(pid_t(m_pid), &status, WNOHANG);
+    } while (result < 0 && errno == EINTR);
+    if (result == 0) {
+        return false;
+    }
+
+    m_pid = -1;
+    m_reapTimer->stop();
+    closeMaster();
+    if (result > 0 && WIFEXITED(status)) {
+        emit finished(WEXITSTATUS(status), QProcess::NormalExit);
+    } else {
+        emit finished(result > 0 && WIFSIGNALED(status) ? WTERMSIG(status) : -1, QProcess::CrashExit);
+    }
+    return true;
+#else
+    return true;
+#endif
+}
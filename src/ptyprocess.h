@@ -0,0 +1,84 @@
+#ifndef PTYPROCESS_H
+#define PTYPROCESS_H
+
+#include <QByteArray>
+#include <QStringList>
+#include <QProcess>
+#include "sshtransport.h"
+
+class QSocketNotifier;
+class QTimer;
+
+/**
+ * @brief Child process attached to a local pseudo-terminal
+ *
+ * The program runs on the slave side of a new pty (forkpty), so it sees a
+ * real terminal: ssh forwards the pty's window size to the server as a
+ * window-change request whenever setWindowSize() changes it, and prompts
+ * for passwords on the same stream as the session output. The master side
+ * is non-blocking and serviced through QSocketNotifiers: everything
+ * readable is drained in large reads and handed out as one dataReceived,
+ * and writes the pty cannot take yet are queued until it is writable.
+ *
+ * This is the OpenSSH SSHTransport. Platforms without ptys run the
+ * program through a QProcess over pipes; there setWindowSize() has no
+ * effect.
+ */
+class PtyProcess : public SSHTransport
+{
+    Q_OBJECT
+
+public:
+    explicit PtyProcess(QObject *parent = nullptr);
+    ~PtyProcess();
+
+    /**
+     * @brief Start program with a terminal of rows x columns
+     *
+     * Failure to start is reported through errorOccurred(FailedToStart).
+     */
+    void start(const QString &program, const QStringList &arguments,
+               const QProcessEnvironment &environment, int rows, int columns);
+
+    bool isRunning() const override;
+
+    /**
+     * @brief Queue data for the program's terminal input
+     */
+    void write(const QByteArray &data) override;
+    qint64 bytesToWrite() const override;
+
+    /**
+     * @brief Resize the terminal; the program gets SIGWINCH
+     */
+    void setWindowSize(int rows, int columns) override;
+    void setReadEnabled(bool enable) override;
+
+    void terminate() override;
+    void kill() override;
+    bool waitForFinished(int msecs = 30000) override;
+
+private slots:
+    void onReadable();
+    void onWritable();
+    void reap();
+
+private:
+    void closeMaster();
+    bool collectExitStatus();
+
+    qint64 m_pid;
+    int m_master;
+    QSocketNotifier *m_readNotifier;
+    QSocketNotifier *m_writeNotifier;
+    bool m_readEnabled;
+    QTimer *m_reapTimer;
+    QByteArray m_writeBuffer;
+    QProcess *m_process;  // Pipe fallback without ptys
+
+    static constexpr int READ_CHUNK = 64 * 1024;
+    static constexpr int MAX_READ_PER_EVENT = 1024 * 1024;  // Then let the event loop run
+    static constexpr int REAP_INTERVAL = 20;  // milliseconds
+};
+
+#endif // PTYPROCESS_H
@@ -1,5 +1,6 @@
 #include "remoteeditor.h"
 #include "passwordmanager.h"
+#include "sshconnectionbroker.h"
 #include <QPlainTextEdit>
 #include <QLabel>
 #include <QPushButton>
@@ -73,6 +74,7 @@ QStringList RemoteEditor::buildSshBaseArgs() const
         args << "-o" << "UserKnownHostsFile=/dev/null";
     }
     args << m_config.sshOptionArgs();
+    args << SSHConnectionBroker::instance().clientArgs(m_config);
 
     return args;
 }
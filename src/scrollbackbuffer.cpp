@@ -0,0 +1,444 @@
+#include "scrollbackbuffer.h"
+#include <QDebug>
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+void appendVarint(QByteArray &data, quint32 value)
+{
+    while (value >= 0x80) {
+        data.append(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    data.append(static_cast<char>(value));
+}
+
+bool readVarint(const uchar *&data, const uchar *end, quint32 &value)
+{
+    value = 0;
+    for (int shift = 0; data < end && shift < 35; shift += 7) {
+        const uchar byte = *data++;
+        value |= static_cast<quint32>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+ScrollbackBuffer::ScrollbackBuffer(int capacity)
+    : m_slotCount(0)
+    , m_slotWidth(0)
+    , m_start(0)
+    , m_hotCount(0)
+    , m_coldSkip(0)
+    , m_coldCount(0)
+    , m_nextSerial(0)
+    , m_coldBytes(0)
+    , m_segments(nullptr)
+    , m_capacity(qMax(0, capacity))
+{
+}
+
+ScrollbackBuffer::~ScrollbackBuffer()
+{
+    delete m_segments;
+}
+
+void ScrollbackBuffer::setCapacity(int capacity)
+{
+    capacity = qMax(0, capacity);
+    if (capacity == m_capacity) {
+        return;
+    }
+    
+    // Keep the newest lines; the hot lines always fit the new ring size
+    m_capacity = capacity;
+    while (size() > m_capacity) {
+        dropOldest();
+    }
+    reallocate(qMin(hotCapacity(), qMax(m_hotCount, INITIAL_SLOTS)), m_slotWidth);
+}
+
+void ScrollbackBuffer::push(const TerminalCell *cells, int length, bool wrapped)
+{
+    if (m_capacity == 0) {
+        return;
+    }
+    
+    length = qMin(length, int(LENGTH_MASK));
+    if (length > m_slotWidth) {
+        reallocate(m_slotCount, length);
+    }
+    
+    if (size() >= m_capacity) {
+        dropOldest();
+    }
+    if (m_hotCount == hotCapacity()) {
+        evictOldestHot();
+    }
+    if (m_hotCount == m_slotCount) {
+        reallocate(qMin(hotCapacity(), qMax(INITIAL_SLOTS, m_slotCount * 2)), m_slotWidth);
+    }
+    
+    const int slot = slotOf(m_hotCount);
+    ++m_hotCount;
+    std::copy(cells, cells + length, m_cells.data() + slot * m_slotWidth);
+    m_lengths[slot] = static_cast<quint16>(length | (wrapped ? WRAPPED_FLAG : 0));
+}
+
+void ScrollbackBuffer::removeLast()
+{
+    // The slot is simply reused by the next push
+    if (m_hotCount > 0) {
+        --m_hotCount;
+    }
+}
+
+void ScrollbackBuffer::markStyles(QVector<bool> &used) const
+{
+    const auto mark = [&used](const TerminalCell *cells, int length) {
+        for (int i = 0; i < length; ++i) {
+            if (cells[i].style < static_cast<quint32>(used.size())) {
+                used[cells[i].style] = true;
+            }
+        }
+    };
+    
+    // The front block may list styles of lines already dropped; that only keeps them longer
+    for (const ColdBlock &block : m_blocks) {
+        for (quint32 style : block.styles) {
+            if (style < static_cast<quint32>(used.size())) {
+                used[style] = true;
+            }
+        }
+    }
+    mark(m_pendingCells.constData(), m_pendingCells.size());
+    for (int i = 0; i < m_hotCount; ++i) {
+        const int slot = slotOf(i);
+        mark(m_cells.constData() + slot * m_slotWidth, m_lengths.at(slot) & LENGTH_MASK);
+    }
+}
+
+const TerminalCell *ScrollbackBuffer::line(int index) const
+{
+    if (index < 0 || index >= size()) {
+        return nullptr;
+    }
+    
+    if (index < m_coldCount) {
+        const int absolute = index + m_coldSkip;
+        const DecodedBlock &block = decodedBlock(absolute / BLOCK_LINES);
+        return block.cells.constData() + block.offsets.at(absolute % BLOCK_LINES);
+    }
+    index -= m_coldCount;
+    
+    if (index < m_pendingLengths.size()) {
+        int offset = 0;
+        for (int i = 0; i < index; ++i) {
+            offset += m_pendingLengths.at(i) & LENGTH_MASK;
+        }
+        return m_pendingCells.constData() + offset;
+    }
+    index -= m_pendingLengths.size();
+    
+    return m_cells.constData() + slotOf(index) * m_slotWidth;
+}
+
+int ScrollbackBuffer::lineLength(int index) const
+{
+    if (index < 0 || index >= size()) {
+        return 0;
+    }
+    
+    if (index < m_coldCount) {
+        const int absolute = index + m_coldSkip;
+        const DecodedBlock &block = decodedBlock(absolute / BLOCK_LINES);
+        const int line = absolute % BLOCK_LINES;
+        return block.offsets.at(line + 1) - block.offsets.at(line);
+    }
+    index -= m_coldCount;
+    
+    if (index < m_pendingLengths.size()) {
+        return m_pendingLengths.at(index) & LENGTH_MASK;
+    }
+    index -= m_pendingLengths.size();
+    
+    return m_lengths.at(slotOf(index)) & LENGTH_MASK;
+}
+
+bool ScrollbackBuffer::isWrapped(int index) const
+{
+    if (index < 0 || index >= size()) {
+        return false;
+    }
+    
+    if (index < m_coldCount) {
+        const int absolute = index + m_coldSkip;
+        return decodedBlock(absolute / BLOCK_LINES).wrapped.at(absolute % BLOCK_LINES);
+    }
+    index -= m_coldCount;
+    
+    if (index < m_pendingLengths.size()) {
+        return m_pendingLengths.at(index) & WRAPPED_FLAG;
+    }
+    index -= m_pendingLengths.size();
+    
+    return m_lengths.at(slotOf(index)) & WRAPPED_FLAG;
+}
+
+void ScrollbackBuffer::clear()
+{
+    m_cells = QVector<TerminalCell>();
+    m_lengths = QVector<quint16>();
+    m_slotCount = 0;
+    m_start = 0;
+    m_hotCount = 0;
+    
+    m_pendingCells = QVector<TerminalCell>();
+    m_pendingLengths = QVector<quint16>();
+    
+    m_blocks.clear();
+    m_decoded.clear();
+    m_coldSkip = 0;
+    m_coldCount = 0;
+    m_coldBytes = 0;
+    
+    if (m_segments) {
+        const QString directory = m_segments->directory();
+        delete m_segments;
+        m_segments = new ScrollbackSegments(directory);
+    }
+}
+
+void ScrollbackBuffer::setSpillDirectory(const QString &directory)
+{
+    if (directory == spillDirectory()) {
+        return;
+    }
+    
+    // Bring spilled blocks back before dropping the old segment files
+    if (m_segments) {
+        for (ColdBlock &block : m_blocks) {
+            if (block.data.isEmpty()) {
+                const QByteArray spilled = m_segments->read(block.location);
+                block.data = QByteArray(spilled.constData(), spilled.size());
+                m_coldBytes += block.data.size();
+            }
+        }
+        delete m_segments;
+        m_segments = nullptr;
+    }
+    
+    if (!directory.isEmpty()) {
+        m_segments = new ScrollbackSegments(directory);
+    }
+}
+
+QString ScrollbackBuffer::spillDirectory() const
+{
+    return m_segments ? m_segments->directory() : QString();
+}
+
+qint64 ScrollbackBuffer::diskUsage() const
+{
+    return m_segments ? m_segments->diskUsage() : 0;
+}
+
+qint64 ScrollbackBuffer::memoryFootprint() const
+{
+    qint64 bytes = (m_cells.capacity() + m_pendingCells.capacity()) * static_cast<qint64>(sizeof(TerminalCell));
+    bytes += (m_lengths.capacity() + m_pendingLengths.capacity()) * static_cast<qint64>(sizeof(quint16));
+    bytes += m_coldBytes + m_blocks.size() * static_cast<qint64>(sizeof(ColdBlock));
+    for (const ColdBlock &block : m_blocks) {
+        bytes += block.styles.capacity() * static_cast<qint64>(sizeof(quint32));
+    }
+    for (const DecodedBlock &block : m_decoded) {
+        bytes += block.cells.capacity() * static_cast<qint64>(sizeof(TerminalCell));
+        bytes += block.offsets.capacity() * static_cast<qint64>(sizeof(int));
+    }
+    return bytes;
+}
+
+void ScrollbackBuffer::reallocate(int slotCount, int slotWidth)
+{
+    QVector<TerminalCell> cells(slotCount * slotWidth);
+    QVector<quint16> lengths(slotCount, 0);
+    
+    // Copy the stored lines in order, oldest into slot 0
+    for (int i = 0; i < m_hotCount; ++i) {
+        const int from = slotOf(i);
+        const int length = m_lengths.at(from) & LENGTH_MASK;
+        const TerminalCell *source = m_cells.constData() + from * m_slotWidth;
+        std::copy(source, source + length, cells.data() + i * slotWidth);
+        lengths[i] = m_lengths.at(from);
+    }
+    
+    m_cells = cells;
+    m_lengths = lengths;
+    m_slotCount = slotCount;
+    m_slotWidth = slotWidth;
+    m_start = 0;
+}
+
+void ScrollbackBuffer::evictOldestHot()
+{
+    const int length = m_lengths.at(m_start) & LENGTH_MASK;
+    const TerminalCell *source = m_cells.constData() + m_start * m_slotWidth;
+    const int offset = m_pendingCells.size();
+    m_pendingCells.resize(offset + length);
+    std::copy(source, source + length, m_pendingCells.data() + offset);
+    m_pendingLengths.append(m_lengths.at(m_start));
+    
+    m_start = (m_start + 1) % m_slotCount;
+    --m_hotCount;
+    
+    if (m_pendingLengths.size() == BLOCK_LINES) {
+        compressPending();
+    }
+}
+
+void ScrollbackBuffer::dropOldest()
+{
+    if (m_coldCount > 0) {
+        --m_coldCount;
+        if (++m_coldSkip == BLOCK_LINES) {
+            m_coldBytes -= m_blocks.first().data.size();
+            m_blocks.removeFirst();
+            m_coldSkip = 0;
+            releaseSpilledBlocks();
+        }
+    } else if (!m_pendingLengths.isEmpty()) {
+        m_pendingCells.remove(0, m_pendingLengths.first() & LENGTH_MASK);
+        m_pendingLengths.removeFirst();
+    } else if (m_hotCount > 0) {
+        m_start = (m_start + 1) % m_slotCount;
+        --m_hotCount;
+    }
+}
+
+void ScrollbackBuffer::compressPending()
+{
+    // Layout before zlib: line lengths with wrap flags, code points, then (style, run) pairs
+    QByteArray raw;
+    raw.reserve(m_pendingLengths.size() * 2 + m_pendingCells.size() + 64);
+    
+    for (quint16 length : m_pendingLengths) {
+        appendVarint(raw, length);
+    }
+    for (const TerminalCell &cell : m_pendingCells) {
+        appendVarint(raw, cell.codepoint);
+    }
+    
+    QVector<quint32> styles;
+    const int total = m_pendingCells.size();
+    for (int i = 0; i < total; ) {
+        const quint32 style = m_pendingCells.at(i).style;
+        int run = 1;
+        while (i + run < total && m_pendingCells.at(i + run).style == style) {
+            ++run;
+        }
+        appendVarint(raw, style);
+        appendVarint(raw, static_cast<quint32>(run));
+        styles.append(style);
+        i += run;
+    }
+    std::sort(styles.begin(), styles.end());
+    styles.erase(std::unique(styles.begin(), styles.end()), styles.end());
+    styles.squeeze();
+    
+    ColdBlock block;
+    block.serial = m_nextSerial++;
+    block.data = qCompress(raw, COMPRESSION_LEVEL);
+    block.location.segment = -1;
+    block.styles = styles;
+    
+    // Keep the block in memory if it cannot be spilled
+    if (m_segments && m_segments->append(block.data, block.location)) {
+        block.data = QByteArray();
+    } else {
+        m_coldBytes += block.data.size();
+    }
+    m_blocks.append(block);
+    m_coldCount += BLOCK_LINES;
+    
+    m_pendingCells.resize(0);
+    m_pendingLengths.resize(0);
+}
+
+void ScrollbackBuffer::releaseSpilledBlocks()
+{
+    if (!m_segments) {
+        return;
+    }
+    
+    // Segments before the oldest spilled block no longer hold live lines
+    for (const ColdBlock &block : m_blocks) {
+        if (block.data.isEmpty()) {
+            m_segments->releaseBefore(block.location.segment);
+            return;
+        }
+    }
+    m_segments->releaseBefore(INT_MAX);
+}
+
+const ScrollbackBuffer::DecodedBlock &ScrollbackBuffer::decodedBlock(int blockIndex) const
+{
+    const ColdBlock &block = m_blocks.at(blockIndex);
+    for (int i = 0; i < m_decoded.size(); ++i) {
+        if (m_decoded.at(i).serial == block.serial) {
+            if (i > 0) {
+                m_decoded.move(i, 0);
+            }
+            return m_decoded.first();
+        }
+    }
+    
+    DecodedBlock decoded;
+    decoded.serial = block.serial;
+    decoded.offsets.fill(0, BLOCK_LINES + 1);
+    decoded.wrapped.fill(false, BLOCK_LINES);
+    
+    const QByteArray raw = qUncompress(block.data.isEmpty() && m_segments
+                                       ? m_segments->read(block.location)
+                                       : block.data);
+    const uchar *data = reinterpret_cast<const uchar *>(raw.constData());
+    const uchar *end = data + raw.size();
+    
+    bool ok = true;
+    quint32 value = 0;
+    for (int i = 0; i < BLOCK_LINES && ok; ++i) {
+        ok = readVarint(data, end, value);
+        decoded.offsets[i + 1] = decoded.offsets.at(i) + static_cast<int>(value & LENGTH_MASK);
+        decoded.wrapped[i] = value & WRAPPED_FLAG;
+    }
+    
+    if (ok) {
+        const int total = decoded.offsets.at(BLOCK_LINES);
+        decoded.cells.resize(total);
+        TerminalCell *cells = decoded.cells.data();
+        for (int i = 0; i < total && readVarint(data, end, value); ++i) {
+            cells[i].codepoint = value;
+        }
+        
+        quint32 run = 0;
+        for (int i = 0; i < total && readVarint(data, end, value) && readVarint(data, end, run); ) {
+            const int last = qMin(total, i + static_cast<int>(run));
+            for (; i < last; ++i) {
+                cells[i].style = value;
+            }
+        }
+    } else {
+        qWarning() << "ScrollbackBuffer: Corrupt scrollback block" << block.serial;
+        decoded.offsets.fill(0, BLOCK_LINES + 1);
+    }
+    
+    m_decoded.prepend(decoded);
+    while (m_decoded.size() > DECODED_BLOCKS) {
+        m_decoded.removeLast();
+    }
+    return m_decoded.first();
+}
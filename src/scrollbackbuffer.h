@@ -0,0 +1,145 @@
+#ifndef SCROLLBACKBUFFER_H
+#define SCROLLBACKBUFFER_H
+
+#include <QVector>
+#include <QList>
+#include <QByteArray>
+#include "terminalchar.h"
+#include "scrollbacksegments.h"
+
+/**
+ * @brief Two-tier scrollback line store
+ *
+ * The newest lines are kept uncompressed in a fixed-capacity ring of equally
+ * sized slots backed by one flat cell allocation, so pushing a line is O(1).
+ * Lines falling out of the ring are gathered into blocks that are packed
+ * (variable-length code points, run-length encoded styles, then zlib) and
+ * only expanded again when one of their lines is read. With a spill
+ * directory set, packed blocks are written to segment files on disk instead
+ * of being kept in memory.
+ */
+class ScrollbackBuffer
+{
+public:
+    explicit ScrollbackBuffer(int capacity = 1000);
+    ~ScrollbackBuffer();
+    
+    int capacity() const { return m_capacity; }
+    void setCapacity(int capacity);
+    
+    int size() const { return m_coldCount + m_pendingLengths.size() + m_hotCount; }
+    bool isEmpty() const { return size() == 0; }
+    
+    /**
+     * @brief Number of lines held uncompressed
+     */
+    int hotSize() const { return m_pendingLengths.size() + m_hotCount; }
+    
+    /**
+     * @brief Append a line, evicting the oldest one when full
+     *
+     * wrapped marks a row that was soft-wrapped, i.e. continues on the next.
+     */
+    void push(const TerminalCell *cells, int length, bool wrapped = false);
+    void push(const TerminalLine &line, bool wrapped = false) { push(line.constData(), line.size(), wrapped); }
+    
+    /**
+     * @brief Cells of line index (0 = oldest)
+     *
+     * The pointer stays valid until the next call that modifies the buffer
+     * or reads another compressed line.
+     */
+    const TerminalCell *line(int index) const;
+    int lineLength(int index) const;
+    bool isWrapped(int index) const;
+    
+    /**
+     * @brief Number of newest lines removeLast() can take back
+     *
+     * Only lines still in the uncompressed ring can be removed.
+     */
+    int removableLines() const { return m_hotCount; }
+    void removeLast();
+    
+    /**
+     * @brief Set used[id] for every style id a stored cell refers to
+     *
+     * Compressed blocks remember the styles they hold, so only the
+     * uncompressed lines are read. Ids at or past used.size() are ignored.
+     */
+    void markStyles(QVector<bool> &used) const;
+    
+    /**
+     * @brief Spill compressed blocks to segment files in directory
+     *
+     * An empty directory disables spilling and loads spilled blocks back
+     * into memory.
+     */
+    void setSpillDirectory(const QString &directory);
+    QString spillDirectory() const;
+    
+    void clear();
+    qint64 memoryFootprint() const;
+    qint64 diskUsage() const;
+    
+private:
+    Q_DISABLE_COPY(ScrollbackBuffer)
+    
+    struct ColdBlock {
+        quint64 serial;
+        QByteArray data;    // Empty when spilled
+        ScrollbackSegments::Location location;
+        QVector<quint32> styles;  // Distinct style ids of its cells, sorted
+    };
+    
+    struct DecodedBlock {
+        quint64 serial;
+        QVector<TerminalCell> cells;
+        QVector<int> offsets;   // BLOCK_LINES + 1 entries
+        QVector<bool> wrapped;  // BLOCK_LINES entries
+    };
+    
+    int hotCapacity() const { return qMin(m_capacity, HOT_LINES); }
+    int slotOf(int index) const { return (m_start + index) % m_slotCount; }
+    void reallocate(int slotCount, int slotWidth);
+    
+    void evictOldestHot();
+    void dropOldest();
+    void compressPending();
+    void releaseSpilledBlocks();
+    const DecodedBlock &decodedBlock(int blockIndex) const;
+    
+    // Hot ring; lengths carry the WRAPPED_FLAG bit
+    QVector<TerminalCell> m_cells;
+    QVector<quint16> m_lengths;
+    int m_slotCount;
+    int m_slotWidth;
+    int m_start;
+    int m_hotCount;
+    
+    // Lines evicted from the ring waiting to fill a block
+    QVector<TerminalCell> m_pendingCells;
+    QVector<quint16> m_pendingLengths;
+    
+    // Cold tier, oldest block first; every block holds BLOCK_LINES lines
+    QList<ColdBlock> m_blocks;
+    int m_coldSkip;     // Lines already dropped from the front block
+    int m_coldCount;
+    quint64 m_nextSerial;
+    qint64 m_coldBytes;
+    
+    mutable QList<DecodedBlock> m_decoded;  // Most recently used first
+    ScrollbackSegments *m_segments;         // Null unless spilling
+    
+    int m_capacity;
+    
+    static constexpr int INITIAL_SLOTS = 64;
+    static constexpr int HOT_LINES = 2048;
+    static constexpr int BLOCK_LINES = 256;
+    static constexpr int DECODED_BLOCKS = 4;
+    static constexpr int COMPRESSION_LEVEL = 1;    // zlib: favour push throughput
+    static constexpr quint16 WRAPPED_FLAG = 0x8000;
+    static constexpr quint16 LENGTH_MASK = 0x7FFF; // Longest line stored
+};
+
+#endif // SCROLLBACKBUFFER_H
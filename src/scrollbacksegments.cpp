@@ -0,0 +1,129 @@
+#include "scrollbacksegments.h"
+#include <QTemporaryFile>
+#include <QDir>
+#include <QStandardPaths>
+#include <QDebug>
+
+namespace {
+const char SEGMENT_PATTERN[] = "scrollback-*.seg";
+}
+
+ScrollbackSegments::ScrollbackSegments(const QString &directory)
+    : m_directory(directory)
+    , m_nextId(0)
+    , m_diskUsage(0)
+{
+    QDir().mkpath(m_directory);
+}
+
+ScrollbackSegments::~ScrollbackSegments()
+{
+    for (const Segment &segment : m_segments) {
+        removeSegment(segment);
+    }
+}
+
+QString ScrollbackSegments::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/scrollback";
+}
+
+void ScrollbackSegments::removeStaleSegments(const QString &directory)
+{
+    QDir dir(directory);
+    const QStringList files = dir.entryList(QStringList() << SEGMENT_PATTERN, QDir::Files);
+    for (const QString &file : files) {
+        if (!dir.remove(file)) {
+            qWarning() << "ScrollbackSegments: Cannot remove stale segment" << dir.filePath(file);
+        }
+    }
+}
+
+bool ScrollbackSegments::append(const QByteArray &data, Location &location)
+{
+    if (m_segments.isEmpty() || m_segments.last().file->size() + data.size() > SEGMENT_SIZE) {
+        Segment segment;
+        segment.id = m_nextId;
+        segment.file = new QTemporaryFile(m_directory + "/scrollback-XXXXXX.seg");
+        segment.map = nullptr;
+        segment.mappedSize = 0;
+        
+        if (!segment.file->open()) {
+            qWarning() << "ScrollbackSegments: Cannot create segment in" << m_directory
+                       << segment.file->errorString();
+            delete segment.file;
+            return false;
+        }
+        ++m_nextId;
+        m_segments.append(segment);
+    }
+    
+    Segment &segment = m_segments.last();
+    const qint64 offset = segment.file->size();
+    segment.file->seek(offset);
+    if (segment.file->write(data) != data.size()) {
+        qWarning() << "ScrollbackSegments: Write failed" << segment.file->errorString();
+        segment.file->resize(offset);
+        return false;
+    }
+    
+    location.segment = segment.id;
+    location.offset = offset;
+    location.size = data.size();
+    m_diskUsage += data.size();
+    return true;
+}
+
+QByteArray ScrollbackSegments::read(const Location &location)
+{
+    Segment *segment = findSegment(location.segment);
+    if (!segment) {
+        return QByteArray();
+    }
+    
+    // Remap when the block was appended after the current mapping was made
+    if (location.offset + location.size > segment->mappedSize) {
+        segment->file->flush();
+        if (segment->map) {
+            segment->file->unmap(segment->map);
+        }
+        segment->mappedSize = segment->file->size();
+        segment->map = segment->file->map(0, segment->mappedSize);
+        if (!segment->map) {
+            qWarning() << "ScrollbackSegments: Cannot map segment" << segment->file->errorString();
+            segment->mappedSize = 0;
+            return QByteArray();
+        }
+    }
+    
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(segment->map + location.offset),
+                                   location.size);
+}
+
+void ScrollbackSegments::releaseBefore(int segment)
+{
+    // The segment being written is never released
+    while (m_segments.size() > 1 && m_segments.first().id < segment) {
+        removeSegment(m_segments.first());
+        m_segments.removeFirst();
+    }
+}
+
+ScrollbackSegments::Segment *ScrollbackSegments::findSegment(int id)
+{
+    for (Segment &segment : m_segments) {
+        if (segment.id == id) {
+            return &segment;
+        }
+    }
+    return nullptr;
+}
+
+void ScrollbackSegments::removeSegment(const Segment &segment)
+{
+    m_diskUsage -= segment.file->size();
+    if (segment.map) {
+        segment.file->unmap(segment.map);
+    }
+    delete segment.file;
+}
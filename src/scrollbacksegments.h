@@ -0,0 +1,86 @@
+#ifndef SCROLLBACKSEGMENTS_H
+#define SCROLLBACKSEGMENTS_H
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+
+class QTemporaryFile;
+
+/**
+ * @brief Append-only segment files holding spilled scrollback blocks
+ *
+ * Blocks are appended to temporary files in a cache directory and read back
+ * through a memory mapping of the segment, so only the pages actually
+ * scrolled through are brought into memory. Segment files are removed when
+ * released or when the store is destroyed.
+ */
+class ScrollbackSegments
+{
+public:
+    struct Location {
+        int segment;
+        qint64 offset;
+        int size;
+    };
+    
+    explicit ScrollbackSegments(const QString &directory);
+    ~ScrollbackSegments();
+    
+    /**
+     * @brief Cache directory terminals spill their scrollback to
+     */
+    static QString defaultDirectory();
+    
+    /**
+     * @brief Delete segment files left behind by a process that did not exit cleanly
+     *
+     * Only call while no store of this process uses directory, i.e. at startup.
+     */
+    static void removeStaleSegments(const QString &directory);
+    
+    QString directory() const { return m_directory; }
+    
+    /**
+     * @brief Append data to the current segment, starting a new one when full
+     * @return false if the data could not be written
+     */
+    bool append(const QByteArray &data, Location &location);
+    
+    /**
+     * @brief Data stored at location, backed by the segment mapping
+     *
+     * The returned array does not own its data; it stays valid until the
+     * next append, read or release.
+     */
+    QByteArray read(const Location &location);
+    
+    /**
+     * @brief Remove segments older than the given one
+     */
+    void releaseBefore(int segment);
+    
+    qint64 diskUsage() const { return m_diskUsage; }
+    
+private:
+    Q_DISABLE_COPY(ScrollbackSegments)
+    
+    struct Segment {
+        int id;
+        QTemporaryFile *file;
+        uchar *map;
+        qint64 mappedSize;
+    };
+    
+    Segment *findSegment(int id);
+    void removeSegment(const Segment &segment);
+    
+    QString m_directory;
+    QList<Segment> m_segments;
+    int m_nextId;
+    qint64 m_diskUsage;
+    
+    static const qint64 SEGMENT_SIZE = 32 * 1024 * 1024;
+};
+
+#endif // SCROLLBACKSEGMENTS_H
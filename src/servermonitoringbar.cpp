@@ -21,9 +21,6 @@ ServerMonitoringBar::ServerMonitoringBar(const ServerConfig &config, QWidget *pa
     setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
     setupUI();
     
-    m_refreshTimer.setSingleShot(false);
-    connect(&m_refreshTimer, &QTimer::timeout, this, &ServerMonitoringBar::onRefreshTimeout);
-    
     m_historyCleanupTimer.setSingleShot(false);
     m_historyCleanupTimer.setInterval(60000);
     connect(&m_historyCleanupTimer, &QTimer::timeout, this, &ServerMonitoringBar::cleanupOldHistory);
@@ -128,6 +125,11 @@ void ServerMonitoringBar::setupUI()
     m_usersLabel = new QLabel("Users: --", this);
     m_usersLabel->setMinimumWidth(80);
     m_usersLabel->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+
+    // Typing latency, measured locally from keystroke to echo
+    m_latencyLabel = new QLabel("Echo: -- ms", this);
+    m_latencyLabel->setMinimumWidth(100);
+    m_latencyLabel->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
     
     // Add all to main layout
     mainLayout->addLayout(cpuLayout);
@@ -139,6 +141,8 @@ void ServerMonitoringBar::setupUI()
     mainLayout->addWidget(m_uptimeLabel);
     mainLayout->addWidget(createSeparator());
     mainLayout->addWidget(m_usersLabel);
+    mainLayout->addWidget(createSeparator());
+    mainLayout->addWidget(m_latencyLabel);
     mainLayout->addStretch();
     
     // Style
@@ -178,13 +182,22 @@ QWidget* ServerMonitoringBar::createSeparator()
 
 void ServerMonitoringBar::startMonitoring(int intervalMs)
 {
-    m_refreshTimer.start(intervalMs);
-    emit metricsRequested();
+    if (m_metricsStream) {
+        return;
+    }
+    m_metricsStream = MetricsStream::acquire(m_config, intervalMs);
+    connect(m_metricsStream.data(), &MetricsStream::metricsUpdated, this, &ServerMonitoringBar::updateMetrics);
+    connect(m_metricsStream.data(), &MetricsStream::errorOccurred, this, &ServerMonitoringBar::errorOccurred);
 }
 
 void ServerMonitoringBar::stopMonitoring()
 {
-    m_refreshTimer.stop();
+    if (!m_metricsStream) {
+        return;
+    }
+    // The channel closes once no bar for this server follows it
+    m_metricsStream->disconnect(this);
+    m_metricsStream.reset();
 }
 
 void ServerMonitoringBar::updateMetrics(const ServerMetrics &metrics)
@@ -217,6 +230,14 @@ void ServerMonitoringBar::addHistoryPoint(MetricButton::MetricType type, double
     }
 }
 
+void ServerMonitoringBar::setInputLatency(int lastMs, int averageMs, int worstMs)
+{
+    m_latencyLabel->setText(QString("Echo: %1 ms").arg(lastMs));
+    m_latencyLabel->setToolTip(QString("Keystroke to echo over the last keys: average %1 ms, worst %2 ms")
+                                   .arg(averageMs)
+                                   .arg(worstMs));
+}
+
 void ServerMonitoringBar::updateButtonHistory(MetricButton::MetricType type)
 {
     // This could trigger UI updates for hover charts if they're visible
@@ -251,11 +272,6 @@ void ServerMonitoringBar::updateLabels()
     m_usersLabel->setText(QString("Users: %1").arg(m_currentMetrics.userCount));
 }
 
-void ServerMonitoringBar::onRefreshTimeout()
-{
-    emit metricsRequested();
-}
-
 void ServerMonitoringBar::onMetricButtonHoverChart(MetricButton::MetricType type, const QPoint &globalPos)
 {
     if (m_destroying) return;
@@ -6,8 +6,10 @@
 #include <QVector>
 #include <QDateTime>
 #include <QPointer>
+#include <QSharedPointer>
 #include "serverconfig.h"
 #include "metricbutton.h"
+#include "metricsstream.h"
 
 class QLabel;
 class QHBoxLayout;
@@ -18,18 +20,6 @@ class QLineSeries;
 class QValueAxis;
 class QDateTimeAxis;
 
-struct ServerMetrics {
-    double cpuUsage = 0.0;
-    double memoryUsage = 0.0;
-    double memoryTotal = 0.0;
-    double memoryUsed = 0.0;
-    double networkRx = 0.0;
-    double networkTx = 0.0;
-    QString uptime;
-    int userCount = 0;
-    QDateTime lastUpdate;
-};
-
 class ServerMonitoringBar : public QWidget
 {
     Q_OBJECT
@@ -37,17 +27,23 @@ public:
     explicit ServerMonitoringBar(const ServerConfig &config, QWidget *parent = nullptr);
     ~ServerMonitoringBar();
     
+    /**
+     * @brief Follow the server's shared MetricsStream
+     */
     void startMonitoring(int intervalMs = 5000);
     void stopMonitoring();
     void updateMetrics(const ServerMetrics &metrics);
     void addHistoryPoint(MetricButton::MetricType type, double value);
+
+    /**
+     * @brief Show the keystroke-to-echo latency of the terminal in use
+     */
+    void setInputLatency(int lastMs, int averageMs, int worstMs);
     
 signals:
-    void metricsRequested();
     void errorOccurred(const QString &error);
 
 private slots:
-    void onRefreshTimeout();
     void onMetricButtonHoverChart(MetricButton::MetricType type, const QPoint &globalPos);
     void onMetricButtonHistoryRequested(MetricButton::MetricType type);
     void onMetricButtonHoverChartHidden(MetricButton::MetricType type);
@@ -66,17 +62,18 @@ private:
     void updateButtonHistory(MetricButton::MetricType type);
     
     ServerConfig m_config;
-    QTimer m_refreshTimer;
     QTimer m_historyCleanupTimer;
     QTimer m_hoverChartUpdateTimer;
     QTimer m_historyDialogUpdateTimer;
     ServerMetrics m_currentMetrics;
+    QSharedPointer<MetricsStream> m_metricsStream;
     
     QLabel *m_cpuLabel;
     QLabel *m_memoryLabel;
     QLabel *m_networkLabel;
     QLabel *m_uptimeLabel;
     QLabel *m_usersLabel;
+    QLabel *m_latencyLabel;
     
     MetricButton *m_cpuButton;
     MetricButton *m_memoryButton;
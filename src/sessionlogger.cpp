@@ -37,7 +37,12 @@ QString SessionLogger::startSession(const ServerConfig &config)
 
 void SessionLogger::append(const QString &logPath, const QString &text)
 {
-    if (logPath.isEmpty() || text.isEmpty()) {
+    append(logPath, text.toUtf8());
+}
+
+void SessionLogger::append(const QString &logPath, const QByteArray &data)
+{
+    if (logPath.isEmpty() || data.isEmpty()) {
         return;
     }
     QFile file(logPath);
@@ -45,7 +50,7 @@ void SessionLogger::append(const QString &logPath, const QString &text)
         return;
     }
     file.write("[" + QDateTime::currentDateTime().toString("HH:mm:ss").toUtf8() + "] ");
-    file.write(text.toUtf8());
+    file.write(data);
     file.close();
 }
 
@@ -2,6 +2,7 @@
 #define SESSIONLOGGER_H
 
 #include <QString>
+#include <QByteArray>
 #include <QDir>
 #include "serverconfig.h"
 
@@ -18,6 +19,7 @@ public:
 
     static QString startSession(const ServerConfig &config);
     static void append(const QString &logPath, const QString &text);
+    static void append(const QString &logPath, const QByteArray &data);
     static void closeSession(const QString &logPath);
 };
 
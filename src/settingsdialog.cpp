@@ -25,6 +25,11 @@ public:
     QComboBox *cursorComboBox;
     QPushButton *foregroundButton;
     QPushButton *backgroundButton;
+    QComboBox *parserComboBox;
+    QSpinBox *scrollbackSpinBox;
+    QCheckBox *scrollbackOnDiskCheckBox;
+    QComboBox *rendererComboBox;
+    QComboBox *sshBackendComboBox;
     QCheckBox *minimizeToTrayCheckBox;
     QKeySequenceEdit *quickConnectKeyEdit;
     QKeySequenceEdit *toggleWindowKeyEdit;
@@ -56,6 +61,36 @@ public:
         backgroundButton = new QPushButton(dialog);
         formLayout->addRow(new QLabel(QObject::tr("Background:"), dialog), backgroundButton);
 
+        parserComboBox = new QComboBox(dialog);
+        parserComboBox->addItem(QObject::tr("Legacy (per character)"), static_cast<int>(ParserEngine::Legacy));
+        parserComboBox->addItem(QObject::tr("Table-driven (byte level)"), static_cast<int>(ParserEngine::TableDriven));
+        parserComboBox->setToolTip(QObject::tr("Escape sequence parser used for terminal output"));
+        formLayout->addRow(new QLabel(QObject::tr("Parser Engine:"), dialog), parserComboBox);
+
+        scrollbackSpinBox = new QSpinBox(dialog);
+        scrollbackSpinBox->setRange(0, 10000000);
+        scrollbackSpinBox->setSingleStep(1000);
+        scrollbackSpinBox->setToolTip(QObject::tr("Lines of history kept per terminal"));
+        formLayout->addRow(new QLabel(QObject::tr("Scrollback Lines:"), dialog), scrollbackSpinBox);
+
+        scrollbackOnDiskCheckBox = new QCheckBox(dialog);
+        scrollbackOnDiskCheckBox->setText(QObject::tr("Store older scrollback in the cache directory"));
+        formLayout->addRow(new QLabel(QObject::tr("Scrollback on Disk:"), dialog), scrollbackOnDiskCheckBox);
+
+        rendererComboBox = new QComboBox(dialog);
+        rendererComboBox->addItem(QObject::tr("Software (QPainter)"), static_cast<int>(TerminalRenderer::Raster));
+        rendererComboBox->addItem(QObject::tr("OpenGL"), static_cast<int>(TerminalRenderer::OpenGL));
+        rendererComboBox->setToolTip(QObject::tr("How terminal text is drawn; OpenGL uses Mesa software rendering when there is no GPU"));
+        formLayout->addRow(new QLabel(QObject::tr("Renderer:"), dialog), rendererComboBox);
+
+        sshBackendComboBox = new QComboBox(dialog);
+        sshBackendComboBox->addItem(QObject::tr("OpenSSH (ssh binary)"), static_cast<int>(SSHBackend::OpenSSH));
+#ifdef QTISSH_HAVE_LIBSSH
+        sshBackendComboBox->addItem(QObject::tr("In process (libssh)"), static_cast<int>(SSHBackend::LibSsh));
+#endif
+        sshBackendComboBox->setToolTip(QObject::tr("Used for new connections; servers with jump hosts, tunnels, agent forwarding or custom options always use OpenSSH"));
+        formLayout->addRow(new QLabel(QObject::tr("SSH Backend:"), dialog), sshBackendComboBox);
+
         minimizeToTrayCheckBox = new QCheckBox(dialog);
         minimizeToTrayCheckBox->setText(QObject::tr("Minimize to system tray instead of quitting"));
         formLayout->addRow(new QLabel(QObject::tr("System Tray:"), dialog), minimizeToTrayCheckBox);
@@ -173,6 +208,57 @@ QColor SettingsDialog::backgroundColor() const
     return m_backgroundColor;
 }
 
+void SettingsDialog::setParserEngine(ParserEngine engine)
+{
+    ui->parserComboBox->setCurrentIndex(ui->parserComboBox->findData(static_cast<int>(engine)));
+}
+
+ParserEngine SettingsDialog::parserEngine() const
+{
+    return static_cast<ParserEngine>(ui->parserComboBox->currentData().toInt());
+}
+
+void SettingsDialog::setScrollbackLines(int lines)
+{
+    ui->scrollbackSpinBox->setValue(lines);
+}
+
+int SettingsDialog::scrollbackLines() const
+{
+    return ui->scrollbackSpinBox->value();
+}
+
+void SettingsDialog::setScrollbackOnDisk(bool enable)
+{
+    ui->scrollbackOnDiskCheckBox->setChecked(enable);
+}
+
+bool SettingsDialog::scrollbackOnDisk() const
+{
+    return ui->scrollbackOnDiskCheckBox->isChecked();
+}
+
+void SettingsDialog::setRenderer(TerminalRenderer renderer)
+{
+    ui->rendererComboBox->setCurrentIndex(ui->rendererComboBox->findData(static_cast<int>(renderer)));
+}
+
+TerminalRenderer SettingsDialog::renderer() const
+{
+    return static_cast<TerminalRenderer>(ui->rendererComboBox->currentData().toInt());
+}
+
+void SettingsDialog::setSshBackend(SSHBackend backend)
+{
+    const int index = ui->sshBackendComboBox->findData(static_cast<int>(backend));
+    ui->sshBackendComboBox->setCurrentIndex(qMax(0, index));
+}
+
+SSHBackend SettingsDialog::sshBackend() const
+{
+    return static_cast<SSHBackend>(ui->sshBackendComboBox->currentData().toInt());
+}
+
 void SettingsDialog::setMinimizeToTray(bool enable)
 {
     ui->minimizeToTrayCheckBox->setChecked(enable);
@@ -5,6 +5,7 @@
 #include <QFont>
 #include <QColor>
 #include "vt100terminal.h"
+#include "sshtransport.h"
 
 namespace Ui {
 class SettingsDialog;
@@ -33,6 +34,21 @@ public:
     void setBackgroundColor(const QColor &color);
     QColor backgroundColor() const;
 
+    void setParserEngine(ParserEngine engine);
+    ParserEngine parserEngine() const;
+
+    void setScrollbackLines(int lines);
+    int scrollbackLines() const;
+
+    void setScrollbackOnDisk(bool enable);
+    bool scrollbackOnDisk() const;
+
+    void setRenderer(TerminalRenderer renderer);
+    TerminalRenderer renderer() const;
+
+    void setSshBackend(SSHBackend backend);
+    SSHBackend sshBackend() const;
+
     void setMinimizeToTray(bool enable);
     bool minimizeToTray() const;
 
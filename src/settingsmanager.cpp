@@ -13,6 +13,11 @@ SettingsManager::SettingsManager(QObject *parent)
     : QObject(parent)
     , m_settings(QDir::homePath() + "/.config/QTiSSH/settings.conf", QSettings::IniFormat)
     , m_terminalFontSize(0)
+    , m_parserEngine(ParserEngine::TableDriven)
+    , m_scrollbackLines(10000)
+    , m_scrollbackOnDisk(false)
+    , m_renderer(TerminalRenderer::Raster)
+    , m_sshBackend(SSHBackend::OpenSSH)
     , m_minimizeToTray(false)
     , m_useKeychain(true)
 {
@@ -77,6 +82,61 @@ QColor SettingsManager::terminalBackground() const
     return m_terminalBackground;
 }
 
+void SettingsManager::setParserEngine(ParserEngine engine)
+{
+    m_parserEngine = engine;
+    m_settings.setValue("terminal/parserEngine", static_cast<int>(engine));
+}
+
+ParserEngine SettingsManager::parserEngine() const
+{
+    return m_parserEngine;
+}
+
+void SettingsManager::setScrollbackLines(int lines)
+{
+    m_scrollbackLines = lines;
+    m_settings.setValue("terminal/scrollbackLines", lines);
+}
+
+int SettingsManager::scrollbackLines() const
+{
+    return m_scrollbackLines;
+}
+
+void SettingsManager::setScrollbackOnDisk(bool enable)
+{
+    m_scrollbackOnDisk = enable;
+    m_settings.setValue("terminal/scrollbackOnDisk", enable);
+}
+
+bool SettingsManager::scrollbackOnDisk() const
+{
+    return m_scrollbackOnDisk;
+}
+
+void SettingsManager::setRenderer(TerminalRenderer renderer)
+{
+    m_renderer = renderer;
+    m_settings.setValue("terminal/renderer", static_cast<int>(renderer));
+}
+
+TerminalRenderer SettingsManager::renderer() const
+{
+    return m_renderer;
+}
+
+void SettingsManager::setSshBackend(SSHBackend backend)
+{
+    m_sshBackend = backend;
+    m_settings.setValue("connection/sshBackend", static_cast<int>(backend));
+}
+
+SSHBackend SettingsManager::sshBackend() const
+{
+    return m_sshBackend;
+}
+
 void SettingsManager::setTheme(ThemeManager::Theme theme)
 {
     m_theme = theme;
@@ -176,6 +236,25 @@ void SettingsManager::load()
     m_terminalForeground = QColor(m_settings.value("terminal/foreground", "#C0C0C0").toString());
     m_terminalBackground = QColor(m_settings.value("terminal/background", "#000000").toString());
 
+    // Default Parser: byte-level table-driven engine
+    m_parserEngine = static_cast<ParserEngine>(
+        m_settings.value("terminal/parserEngine", static_cast<int>(ParserEngine::TableDriven)).toInt()
+    );
+
+    // Default Scrollback: 10000 lines kept in memory (older blocks compressed)
+    m_scrollbackLines = qMax(0, m_settings.value("terminal/scrollbackLines", 10000).toInt());
+    m_scrollbackOnDisk = m_settings.value("terminal/scrollbackOnDisk", false).toBool();
+
+    // Default Renderer: QPainter; OpenGL is opt-in
+    m_renderer = static_cast<TerminalRenderer>(
+        m_settings.value("terminal/renderer", static_cast<int>(TerminalRenderer::Raster)).toInt()
+    );
+
+    // Default SSH Backend: the ssh binary; libssh is opt-in
+    m_sshBackend = static_cast<SSHBackend>(
+        m_settings.value("connection/sshBackend", static_cast<int>(SSHBackend::OpenSSH)).toInt()
+    );
+
     // Default Theme: Light (or match system eventually)
     m_theme = static_cast<ThemeManager::Theme>(
         m_settings.value("appearance/theme", static_cast<int>(ThemeManager::Light)).toInt()
@@ -7,6 +7,7 @@
 #include <QSettings>
 #include "vt100terminal.h"
 #include "thememanager.h"
+#include "sshtransport.h"
 
 class SettingsManager : public QObject
 {
@@ -30,6 +31,22 @@ public:
     void setTerminalBackground(const QColor &color);
     QColor terminalBackground() const;
 
+    void setParserEngine(ParserEngine engine);
+    ParserEngine parserEngine() const;
+
+    void setScrollbackLines(int lines);
+    int scrollbackLines() const;
+
+    void setScrollbackOnDisk(bool enable);
+    bool scrollbackOnDisk() const;
+
+    void setRenderer(TerminalRenderer renderer);
+    TerminalRenderer renderer() const;
+
+    // Connection Settings
+    void setSshBackend(SSHBackend backend);
+    SSHBackend sshBackend() const;
+
     // Theme Settings
     void setTheme(ThemeManager::Theme theme);
     ThemeManager::Theme theme() const;
@@ -63,6 +80,11 @@ private:
     VT100Terminal::CursorStyle m_cursorStyle;
     QColor m_terminalForeground;
     QColor m_terminalBackground;
+    ParserEngine m_parserEngine;
+    int m_scrollbackLines;
+    bool m_scrollbackOnDisk;
+    TerminalRenderer m_renderer;
+    SSHBackend m_sshBackend;
     ThemeManager::Theme m_theme;
     bool m_minimizeToTray;
     bool m_useKeychain;
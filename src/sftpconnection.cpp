@@ -1,5 +1,6 @@
 #include "sftpconnection.h"
 #include "passwordmanager.h"
+#include "sshconnectionbroker.h"
 #include <QRegularExpression>
 #include <QDateTime>
 #include <QDir>
@@ -7,6 +8,12 @@
 #include <QUuid>
 #include <QProcessEnvironment>
 
+#ifdef QTISSH_HAVE_LIBSSH
+#include "libsshsession.h"
+#include "libsshsftp.h"
+#include "settingsmanager.h"
+#endif
+
 SFTPConnection::SFTPConnection(const ServerConfig &config, QObject *parent)
     : QObject(parent)
     , m_config(config)
@@ -14,6 +21,9 @@ SFTPConnection::SFTPConnection(const ServerConfig &config, QObject *parent)
     , m_connected(false)
     , m_currentRemotePath("/")
 {
+#ifdef QTISSH_HAVE_LIBSSH
+    m_sftp = nullptr;
+#endif
     setupProcess();
 }
 
@@ -39,6 +49,17 @@ void SFTPConnection::connectToServer()
         return;
     }
 
+#ifdef QTISSH_HAVE_LIBSSH
+    if (m_sftp) {
+        return;
+    }
+    if (SettingsManager::instance().sshBackend() == SSHBackend::LibSsh
+        && LibSshSession::supports(m_config)) {
+        connectNative();
+        return;
+    }
+#endif
+
     QStringList args = buildSftpCommand();
     QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
     setupAskPass();
@@ -57,6 +78,62 @@ void SFTPConnection::connectToServer()
     }
 }
 
+#ifdef QTISSH_HAVE_LIBSSH
+void SFTPConnection::connectNative()
+{
+    // The sftp subsystem on the shared session; no askpass, the session authenticates
+    m_sftp = new LibSshSftp(this);
+    connect(m_sftp, &LibSshSftp::ready, this, [this]() {
+        m_connected = true;
+        emit connected();
+        trackRequest(m_sftp->realPath("."), "pwd");
+    });
+    connect(m_sftp, &LibSshSftp::closed, this, [this](const QString &error) {
+        m_sftp->deleteLater();
+        m_sftp = nullptr;
+        m_sftpRequests.clear();
+        m_connected = false;
+        emit disconnected();
+        if (!error.isEmpty()) {
+            emit connectionError(error);
+        }
+    });
+    connect(m_sftp, &LibSshSftp::pathResolved, this, [this](quint32 request, const QString &path) {
+        m_sftpRequests.remove(request);
+        m_currentRemotePath = path;
+        emit directoryChanged(path);
+        listDirectory();
+    });
+    connect(m_sftp, &LibSshSftp::directoryListed, this, [this](quint32 request, const QList<RemoteFileInfo> &files) {
+        m_sftpRequests.remove(request);
+        emit directoryListed(files);
+    });
+    connect(m_sftp, &LibSshSftp::completed, this, [this](quint32 request) {
+        const QString command = m_sftpRequests.take(request);
+        emit operationCompleted(command);
+        // Same refresh as after the sftp binary's commands
+        if (!command.startsWith("get") && !command.startsWith("put")) {
+            listDirectory();
+        }
+    });
+    connect(m_sftp, &LibSshSftp::failed, this, [this](quint32 request, const QString &error) {
+        emit operationFailed(m_sftpRequests.take(request), error);
+    });
+    m_sftp->start(m_config);
+}
+
+void SFTPConnection::trackRequest(quint32 request, const QString &command)
+{
+    m_sftpRequests.insert(request, command);
+}
+
+QString SFTPConnection::remotePath(const QString &path) const
+{
+    // The protocol has no working directory; relative names are the browser's
+    return path.startsWith('/') ? path : QDir::cleanPath(m_currentRemotePath + "/" + path);
+}
+#endif // QTISSH_HAVE_LIBSSH
+
 void SFTPConnection::setupAskPass()
 {
     QString pwd = m_config.password();
@@ -90,6 +167,13 @@ void SFTPConnection::cleanupAskPass()
 
 void SFTPConnection::disconnect()
 {
+#ifdef QTISSH_HAVE_LIBSSH
+    if (m_sftp) {
+        // Reports the disconnect through closed()
+        m_sftp->close();
+        return;
+    }
+#endif
     if (m_process->state() == QProcess::Running) {
         sendCommand("quit");
         m_process->waitForFinished(3000);
@@ -139,6 +223,7 @@ QStringList SFTPConnection::buildSftpCommand()
 
     // Custom SSH options (from profile + server)
     args << m_config.sshOptionArgs();
+    args << SSHConnectionBroker::instance().clientArgs(m_config);
     
     // Add connection string
     args << QString("%1@%2").arg(m_config.username()).arg(m_config.host());
@@ -157,41 +242,89 @@ void SFTPConnection::sendCommand(const QString &command)
 void SFTPConnection::listDirectory(const QString &path)
 {
     QString targetPath = path.isEmpty() ? m_currentRemotePath : path;
+#ifdef QTISSH_HAVE_LIBSSH
+    if (m_sftp) {
+        trackRequest(m_sftp->listDirectory(remotePath(targetPath)), QString("ls -la %1").arg(targetPath));
+        return;
+    }
+#endif
     sendCommand(QString("ls -la %1").arg(targetPath));
 }
 
 void SFTPConnection::changeDirectory(const QString &path)
 {
+#ifdef QTISSH_HAVE_LIBSSH
+    if (m_sftp) {
+        trackRequest(m_sftp->realPath(remotePath(path)), QString("cd %1").arg(path));
+        return;
+    }
+#endif
     sendCommand(QString("cd %1").arg(path));
 }
 
 void SFTPConnection::createDirectory(const QString &name)
 {
+#ifdef QTISSH_HAVE_LIBSSH
+    if (m_sftp) {
+        trackRequest(m_sftp->makeDirectory(remotePath(name)), QString("mkdir %1").arg(name));
+        return;
+    }
+#endif
     sendCommand(QString("mkdir %1").arg(name));
 }
 
 void SFTPConnection::removeDirectory(const QString &path)
 {
+#ifdef QTISSH_HAVE_LIBSSH
+    if (m_sftp) {
+        trackRequest(m_sftp->removeDirectory(remotePath(path)), QString("rmdir %1").arg(path));
+        return;
+    }
+#endif
     sendCommand(QString("rmdir %1").arg(path));
 }
 
 void SFTPConnection::deleteFile(const QString &path)
 {
+#ifdef QTISSH_HAVE_LIBSSH
+    if (m_sftp) {
+        trackRequest(m_sftp->remove(remotePath(path)), QString("rm %1").arg(path));
+        return;
+    }
+#endif
     sendCommand(QString("rm %1").arg(path));
 }
 
 void SFTPConnection::renameFile(const QString &oldPath, const QString &newPath)
 {
+#ifdef QTISSH_HAVE_LIBSSH
+    if (m_sftp) {
+        trackRequest(m_sftp->rename(remotePath(oldPath), remotePath(newPath)), QString("rename %1 %2").arg(oldPath).arg(newPath));
+        return;
+    }
+#endif
     sendCommand(QString("rename %1 %2").arg(oldPath).arg(newPath));
 }
 
 void SFTPConnection::downloadFile(const QString &remotePath, const QString &localPath)
 {
+#ifdef QTISSH_HAVE_LIBSSH
+    if (m_sftp) {
+        trackRequest(m_sftp->download(this->remotePath(remotePath), localPath), QString("get %1 %2").arg(remotePath).arg(localPath));
+        return;
+    }
+#endif
     sendCommand(QString("get %1 %2").arg(remotePath).arg(localPath));
 }
 
 void SFTPConnection::uploadFile(const QString &localPath, const QString &remotePath)
 {
+#ifdef QTISSH_HAVE_LIBSSH
+    if (m_sftp) {
+        trackRequest(m_sftp->upload(localPath, this->remotePath(remotePath)), QString("put %1 %2").arg(localPath).arg(remotePath));
+        return;
+    }
+#endif
     sendCommand(QString("put %1 %2").arg(localPath).arg(remotePath));
 }
 
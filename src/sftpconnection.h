@@ -5,8 +5,11 @@
 #include <QProcess>
 #include <QFileInfo>
 #include <QDir>
+#include <QHash>
 #include "serverconfig.h"
 
+class LibSshSftp;
+
 struct RemoteFileInfo {
     QString name;
     QString path;
@@ -78,6 +81,15 @@ private:
     QStringList buildSftpCommand();
     void setupAskPass();
     void cleanupAskPass();
+
+#ifdef QTISSH_HAVE_LIBSSH
+    void connectNative();
+    void trackRequest(quint32 request, const QString &command);
+    QString remotePath(const QString &path) const;
+
+    LibSshSftp *m_sftp;                      // Set while the libssh backend serves the session
+    QHash<quint32, QString> m_sftpRequests;  // Request number to the command it stands for
+#endif
 };
 
 #endif // SFTPCONNECTION_H
@@ -0,0 +1,271 @@
+#include "sshconnectionbroker.h"
+#include "passwordmanager.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QProcessEnvironment>
+#include <QStandardPaths>
+#include <QUuid>
+
+SSHConnectionBroker& SSHConnectionBroker::instance()
+{
+    static SSHConnectionBroker inst;
+    return inst;
+}
+
+SSHConnectionBroker::SSHConnectionBroker(QObject *parent)
+    : QObject(parent)
+{
+    m_askPassTimer.setInterval(ASKPASS_CHECK_INTERVAL);
+    connect(&m_askPassTimer, &QTimer::timeout, this, &SSHConnectionBroker::removeUsedAskPass);
+    if (QCoreApplication::instance()) {
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit,
+                this, &SSHConnectionBroker::shutdown);
+    }
+}
+
+SSHConnectionBroker::~SSHConnectionBroker()
+{
+    shutdown();
+}
+
+QStringList SSHConnectionBroker::clientArgs(const ServerConfig &config)
+{
+    if (!canShare(config)) {
+        return QStringList();
+    }
+
+    Master &master = m_masters[config.id()];
+    if (master.socketPath.isEmpty()) {
+        master.socketPath = socketPath(config.id());
+    }
+    const bool retry = master.failedAt == 0
+        || QDateTime::currentMSecsSinceEpoch() - master.failedAt >= RETRY_DELAY;
+    if (!master.process && retry) {
+        startMaster(config, master);
+    }
+
+    // ControlMaster=no never makes a client a master; a missing socket
+    // just means a direct connection
+    QStringList args;
+    args << "-o" << "ControlMaster=no";
+    args << "-o" << "ControlPath=" + master.socketPath;
+    return args;
+}
+
+bool SSHConnectionBroker::isMasterReady(const ServerConfig &config) const
+{
+    const auto it = m_masters.constFind(config.id());
+    // ssh -M only listens on the ControlPath once the login succeeded
+    return it != m_masters.constEnd() && it->process
+        && it->process->state() == QProcess::Running && QFile::exists(it->socketPath);
+}
+
+void SSHConnectionBroker::shutdown()
+{
+    for (auto it = m_masters.begin(); it != m_masters.end(); ++it) {
+        Master &master = it.value();
+        if (master.process) {
+            master.process->disconnect(this);
+            if (master.process->state() != QProcess::NotRunning) {
+                master.process->terminate();
+                if (!master.process->waitForFinished(1000)) {
+                    master.process->kill();
+                    master.process->waitForFinished(1000);
+                }
+            }
+            delete master.process;
+            master.process = nullptr;
+        }
+        QFile::remove(master.socketPath);
+        if (!master.askPassPath.isEmpty()) {
+            QFile::remove(master.askPassPath);
+        }
+    }
+    m_masters.clear();
+    m_askPassTimer.stop();
+}
+
+bool SSHConnectionBroker::canShare(const ServerConfig &config)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(config)
+    return false;
+#else
+    if (config.id().isEmpty() || config.host().isEmpty()) {
+        return false;
+    }
+    // Servers that set up their own multiplexing keep it
+    for (const QString &option : config.sshOptionArgs()) {
+        if (option.startsWith("Control", Qt::CaseInsensitive)) {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+QString SSHConnectionBroker::socketPath(const QString &serverId) const
+{
+    // Unix socket paths are limited to about 100 bytes and ssh splits
+    // option values on spaces, so fall back to the temp dir when needed
+    const QString name = QString("qtissh-%1-%2")
+                             .arg(QCoreApplication::applicationPid())
+                             .arg(QString::fromLatin1(QCryptographicHash::hash(
+                                 serverId.toUtf8(), QCryptographicHash::Sha1).toHex().left(12)));
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (dir.isEmpty() || dir.contains(' ') || QDir(dir).filePath(name).toLocal8Bit().size() > 100) {
+        dir = QDir::tempPath();
+    }
+    return QDir(dir).filePath(name);
+}
+
+void SSHConnectionBroker::startMaster(const ServerConfig &config, Master &master)
+{
+    // A socket left behind by a crashed master would make ours fail to bind
+    QFile::remove(master.socketPath);
+
+    QStringList args;
+    args << "-M" << "-N";
+    args << connectionArgs(config);
+
+    args << "-o" << "ControlPath=" + master.socketPath;
+    args << "-o" << "ControlPersist=no";
+    // A dead link must take the master down, or every client would hang on it
+    args << "-o" << QString("ServerAliveInterval=%1").arg(ALIVE_INTERVAL);
+
+    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+    master.askPassPath = writeAskPass(config);
+    if (!master.askPassPath.isEmpty()) {
+        useAskPass(env, master.askPassPath);
+        args << "-o" << "NumberOfPasswordPrompts=1";
+    } else {
+        // Nobody can answer prompts here; the terminal asks the user itself
+        args << "-o" << "BatchMode=yes";
+    }
+    args << QString("%1@%2").arg(config.username(), config.host());
+
+    QProcess *process = new QProcess(this);
+    process->setProcessEnvironment(env);
+    process->setStandardOutputFile(QProcess::nullDevice());
+    process->setStandardErrorFile(QProcess::nullDevice());
+    const QString serverId = config.id();
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, [this, serverId, process]() {
+        onMasterFinished(serverId, process);
+    });
+    connect(process, &QProcess::errorOccurred, this, [this, serverId, process](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) {
+            onMasterFinished(serverId, process);
+        }
+    });
+
+    master.process = process;
+    master.failedAt = 0;
+    process->start("ssh", args);
+
+    // The password only has to be on disk until the master has logged in
+    if (!master.askPassPath.isEmpty()) {
+        m_askPassTimer.start();
+    }
+}
+
+void SSHConnectionBroker::removeUsedAskPass()
+{
+    bool waiting = false;
+    for (auto it = m_masters.begin(); it != m_masters.end(); ++it) {
+        Master &master = it.value();
+        if (master.askPassPath.isEmpty()) {
+            continue;
+        }
+        // The ControlPath socket appears once authentication succeeded
+        if (QFile::exists(master.socketPath)) {
+            QFile::remove(master.askPassPath);
+            master.askPassPath.clear();
+        } else {
+            waiting = true;
+        }
+    }
+    if (!waiting) {
+        m_askPassTimer.stop();
+    }
+}
+
+void SSHConnectionBroker::onMasterFinished(const QString &serverId, QProcess *process)
+{
+    auto it = m_masters.find(serverId);
+    if (it == m_masters.end() || it->process != process) {
+        return;
+    }
+
+    Master &master = it.value();
+    if (process->exitStatus() != QProcess::NormalExit || process->exitCode() != 0
+        || process->error() == QProcess::FailedToStart) {
+        master.failedAt = QDateTime::currentMSecsSinceEpoch();
+    }
+    master.process = nullptr;
+    process->deleteLater();
+
+    QFile::remove(master.socketPath);
+    if (!master.askPassPath.isEmpty()) {
+        QFile::remove(master.askPassPath);
+        master.askPassPath.clear();
+    }
+}
+
+QStringList SSHConnectionBroker::connectionArgs(const ServerConfig &config)
+{
+    QStringList args;
+    args << "-p" << QString::number(config.port());
+
+    if (config.authType() == AuthType::PublicKey && !config.keyPath().isEmpty()) {
+        args << "-i" << config.keyPath();
+    }
+    if (!config.strictHostKeyChecking()) {
+        args << "-o" << "StrictHostKeyChecking=no";
+        args << "-o" << "UserKnownHostsFile=/dev/null";
+    } else {
+        args << "-o" << "StrictHostKeyChecking=yes";
+    }
+    if (!config.jumpHost().isEmpty()) {
+        args << "-J" << config.jumpHost();
+    }
+    if (config.forwardAgent() || config.authType() == AuthType::SSHAgent) {
+        args << "-o" << "ForwardAgent=yes";
+    }
+    args << config.sshOptionArgs();
+    return args;
+}
+
+void SSHConnectionBroker::useAskPass(QProcessEnvironment &env, const QString &askPassPath)
+{
+    env.insert("SSH_ASKPASS", askPassPath);
+    env.insert("SSH_ASKPASS_REQUIRE", "force");
+    env.insert("DISPLAY", ":0");
+}
+
+QString SSHConnectionBroker::writeAskPass(const ServerConfig &config)
+{
+    const QString pwd = config.password();
+    if (config.authType() != AuthType::Password || pwd.isEmpty()
+        || pwd.startsWith(PasswordManager::instance().storagePrefix())) {
+        return QString();
+    }
+
+    QString escaped = pwd;
+    escaped.replace("'", "'\\''");
+
+    const QString path = QDir::temp().filePath(
+        "qtissh-askpass-" + QUuid::createUuid().toString(QUuid::WithoutBraces));
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return QString();
+    }
+    file.write("#!/bin/sh\n");
+    file.write("echo '" + escaped.toUtf8() + "'\n");
+    file.close();
+    QFile::setPermissions(path, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+    return path;
+}
@@ -0,0 +1,99 @@
+#ifndef SSHCONNECTIONBROKER_H
+#define SSHCONNECTIONBROKER_H
+
+#include <QObject>
+#include <QHash>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QStringList>
+#include <QTimer>
+#include "serverconfig.h"
+
+/**
+ * @brief One shared SSH master connection per server
+ *
+ * Terminals, splits, SFTP, scp transfers, the remote editor and the
+ * metrics probe all start their own ssh, scp or sftp processes. Each of
+ * them adds clientArgs() to its command line, which points it at the
+ * server's ControlPath: while the master is up, the process only opens a
+ * channel on the master's connection instead of doing its own TCP, key
+ * exchange and authentication round trips.
+ *
+ * The master is started by the first clientArgs() call for a server and
+ * owned by the broker (ssh -M -N), so no session process ever inherits or
+ * outlives it. Clients use ControlMaster=no: until the master has
+ * authenticated, or if it could not (interactive-only auth, unknown host
+ * key), they connect directly exactly as before.
+ */
+class SSHConnectionBroker : public QObject
+{
+    Q_OBJECT
+
+public:
+    static SSHConnectionBroker& instance();
+
+    /**
+     * @brief ssh options that route a process for config through its master
+     *
+     * Empty when sharing is not possible: no Unix sockets, or the server's
+     * own options already configure ControlMaster or ControlPath.
+     */
+    QStringList clientArgs(const ServerConfig &config);
+
+    /**
+     * @brief Whether config's master is up and has authenticated
+     *
+     * A client started now goes through it and gets no login prompts.
+     */
+    bool isMasterReady(const ServerConfig &config) const;
+
+    /**
+     * @brief Close all master connections
+     */
+    void shutdown();
+
+    /**
+     * @brief ssh options for config's port, key, host key policy, jump host,
+     * agent forwarding and custom options
+     */
+    static QStringList connectionArgs(const ServerConfig &config);
+
+    /**
+     * @brief Write an SSH_ASKPASS script answering with config's password
+     *
+     * Empty when there is no usable stored password. The caller deletes the
+     * file, as soon as ssh has authenticated.
+     */
+    static QString writeAskPass(const ServerConfig &config);
+
+    /**
+     * @brief Make ssh started with env ask askPassPath for passwords
+     */
+    static void useAskPass(QProcessEnvironment &env, const QString &askPassPath);
+
+private:
+    struct Master {
+        QProcess *process = nullptr;
+        QString socketPath;
+        QString askPassPath;  // Removed once the master has logged in
+        qint64 failedAt = 0;  // msecs since epoch of the last failed start
+    };
+
+    explicit SSHConnectionBroker(QObject *parent = nullptr);
+    ~SSHConnectionBroker();
+
+    static bool canShare(const ServerConfig &config);
+    QString socketPath(const QString &serverId) const;
+    void startMaster(const ServerConfig &config, Master &master);
+    void onMasterFinished(const QString &serverId, QProcess *process);
+    void removeUsedAskPass();
+
+    QHash<QString, Master> m_masters;  // By server id
+    QTimer m_askPassTimer;  // Runs while a master's askpass script is on disk
+
+    static constexpr int RETRY_DELAY = 60 * 1000;  // After a failed master, in milliseconds
+    static constexpr int ALIVE_INTERVAL = 15;  // Seconds between keepalives on the master
+    static constexpr int ASKPASS_CHECK_INTERVAL = 250;  // milliseconds
+};
+
+#endif // SSHCONNECTIONBROKER_H
@@ -1,8 +1,15 @@
 #include "sshterminal.h"
 #include "ui_sshterminal.h"
 #include "passwordmanager.h"
+#include "sshconnectionbroker.h"
 #include "commandhistorymanager.h"
 #include "sessionlogger.h"
+#include "settingsmanager.h"
+#include "ptyprocess.h"
+#ifdef QTISSH_HAVE_LIBSSH
+#include "libsshchannel.h"
+#include "libsshsession.h"
+#endif
 #include <QApplication>
 #include <QClipboard>
 #include <QFont>
@@ -17,15 +24,19 @@ SSHTerminal::SSHTerminal(const ServerConfig &config, QWidget *parent)
     : QWidget(parent)
     , ui(new Ui::SSHTerminal)
     , m_config(config)
-    , m_process(new QProcess(this))
+    , m_process(nullptr)
     , m_connected(false)
     , m_waitingForPassword(false)
     , m_userClosed(false)
     , m_reconnectScheduled(false)
     , m_reconnectAttempts(0)
     , m_terminal(new VT100Terminal(this))
-    , m_inEscapeSequence(false)
-    , m_sizeSyncTimer(new QTimer(this))
+    , m_pasteOpen(false)
+    , m_typedLength(0)
+    , m_typedLineOverflow(false)
+    , m_inputEscape(NoEscape)
+    , m_latencySampleCount(0)
+    , m_latencySampleNext(0)
 {
     ui->setupUi(this);
     
@@ -33,32 +44,31 @@ SSHTerminal::SSHTerminal(const ServerConfig &config, QWidget *parent)
     ui->terminal->hide();
     ui->input->hide();
     ui->verticalLayout->insertWidget(0, m_terminal);
+    m_terminal->setParserEngine(SettingsManager::instance().parserEngine());
+    setScrollback(SettingsManager::instance().scrollbackLines(),
+                  SettingsManager::instance().scrollbackOnDisk());
+    m_terminal->setRenderer(SettingsManager::instance().renderer());
     
-    connect(m_process, &QProcess::readyReadStandardOutput, this, &SSHTerminal::onReadyReadStandardOutput);
-    connect(m_process, &QProcess::readyReadStandardError, this, &SSHTerminal::onReadyReadStandardError);
-    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-            this, &SSHTerminal::onProcessFinished);
-    connect(m_process, &QProcess::errorOccurred, this, &SSHTerminal::onProcessError);
+    setTransport(new PtyProcess(this));
+    m_inputTimer.setInterval(INPUT_INTERVAL);
+    connect(&m_inputTimer, &QTimer::timeout, this, &SSHTerminal::flushPendingInput);
     connect(ui->input, &QLineEdit::returnPressed, this, &SSHTerminal::onInputReturnPressed);
     
     // Connect new terminal input
     connect(m_terminal, &VT100Terminal::keyPressed, this, &SSHTerminal::onTerminalKeyPressed);
-    connect(m_terminal, &VT100Terminal::terminalSizeChanged, this, &SSHTerminal::onTerminalSizeChanged);
-    
-    // Keep retrying to sync the remote terminal size after connect. The remote
-    // shell may not be ready when the first attempt is made, and connection
-    // detection based on the prompt ($#>) can be missed with custom prompts.
-    m_sizeSyncTimer->setInterval(500);
-    connect(m_sizeSyncTimer, &QTimer::timeout, this, &SSHTerminal::onSizeSyncTimeout);
+    // Only the size a resize drag settles on goes to the remote end
+    connect(m_terminal, &VT100Terminal::terminalSizeSettled, this, &SSHTerminal::onTerminalSizeChanged);
+    connect(m_terminal, &VT100Terminal::backlogDrained, this, &SSHTerminal::onTerminalBacklogDrained);
+    connect(m_terminal, &VT100Terminal::inputEchoed, this, &SSHTerminal::recordInputLatency);
 }
 
 SSHTerminal::~SSHTerminal()
 {
     m_userClosed = true;
-    if (m_process->state() == QProcess::Running) {
+    if (m_process->isRunning()) {
         m_process->terminate();
         m_process->waitForFinished(1000);
-        if (m_process->state() == QProcess::Running) {
+        if (m_process->isRunning()) {
             m_process->kill();
         }
     }
@@ -79,6 +89,21 @@ void SSHTerminal::connectToServer()
                                 .arg(m_config.host())
                                 .arg(m_config.port()));
 
+#ifdef QTISSH_HAVE_LIBSSH
+    // In process when chosen and the server needs nothing only ssh can do
+    if (SettingsManager::instance().sshBackend() == SSHBackend::LibSsh
+        && LibSshSession::supports(m_config)) {
+        LibSshChannel *channel = new LibSshChannel(this);
+        setTransport(channel);
+        channel->start(m_config, QString(), m_terminal->terminalRows(), m_terminal->terminalColumns());
+        return;
+    }
+#endif
+    if (!qobject_cast<PtyProcess*>(m_process)) {
+        setTransport(new PtyProcess(this));
+    }
+    PtyProcess *process = static_cast<PtyProcess*>(m_process);
+
     QStringList args;
     args << "-p" << QString::number(m_config.port());
     
@@ -106,6 +131,9 @@ void SSHTerminal::connectToServer()
 
     // Custom SSH options (from profile + server)
     args << m_config.sshOptionArgs();
+    // Through an authenticated master there is no password prompt to answer
+    const bool viaMaster = SSHConnectionBroker::instance().isMasterReady(m_config);
+    args << SSHConnectionBroker::instance().clientArgs(m_config);
 
     // Force TERM variable on the server
     args << "-o" << "SetEnv=TERM=xterm-256color";
@@ -119,14 +147,12 @@ void SSHTerminal::connectToServer()
     // Set TERM environment variable
     QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
     env.insert("TERM", "xterm-256color");
-    m_process->setProcessEnvironment(env);
-
-    m_process->start("ssh", args);
 
-    // Retry sending the terminal size until the remote shell accepts it
-    m_sizeSyncTimer->start();
+    // ssh runs on a local pty of the grid's size and forwards later resizes itself
+    process->start("ssh", args, env, m_terminal->terminalRows(), m_terminal->terminalColumns());
     
-    if (m_config.authType() == AuthType::Password && !m_config.password().isEmpty()) {
+    m_waitingForPassword = false;
+    if (!viaMaster && m_config.authType() == AuthType::Password && !m_config.password().isEmpty()) {
         // Don't auto-answer if the password is still encrypted (master password locked)
         if (!m_config.password().startsWith(PasswordManager::instance().storagePrefix())) {
             m_waitingForPassword = true;
@@ -134,6 +160,28 @@ void SSHTerminal::connectToServer()
     }
 }
 
+void SSHTerminal::setTransport(SSHTransport *transport)
+{
+    if (m_process) {
+        m_process->disconnect(this);
+        m_process->deleteLater();
+    }
+    m_process = transport;
+    m_pendingInput.clear();
+    m_inputTimer.stop();
+    m_pasteOpen = false;
+    connect(m_process, &SSHTransport::dataReceived, this, &SSHTerminal::onProcessOutput);
+    connect(m_process, &SSHTransport::finished, this, &SSHTerminal::onProcessFinished);
+    connect(m_process, &SSHTransport::errorOccurred, this, &SSHTerminal::onProcessError);
+}
+
+void SSHTerminal::onTerminalBacklogDrained()
+{
+    if (m_process) {
+        m_process->setReadEnabled(true);
+    }
+}
+
 QStringList SSHTerminal::buildTunnelArguments() const
 {
     QStringList args;
@@ -168,11 +216,10 @@ void SSHTerminal::disconnectFromServer()
 {
     m_userClosed = true;
     m_reconnectScheduled = false;
-    m_sizeSyncTimer->stop();
-    if (m_process->state() == QProcess::Running) {
+    if (m_process->isRunning()) {
         m_process->write("exit\n");
         m_process->waitForFinished(1000);
-        if (m_process->state() == QProcess::Running) {
+        if (m_process->isRunning()) {
             m_process->terminate();
         }
     }
@@ -214,8 +261,9 @@ QString SSHTerminal::buildSSHCommand()
 
 void SSHTerminal::sendCommand(const QString &command)
 {
-    if (m_process->state() == QProcess::Running) {
-        m_process->write(command.toUtf8() + "\n");
+    if (m_process->isRunning()) {
+        // Multi-line snippets are a burst like a paste
+        queueInput(command.toUtf8() + "\n");
         addCommandToHistory(command);
     }
 }
@@ -230,7 +278,7 @@ void SSHTerminal::executeCommand(const QString &command)
 
 QString SSHTerminal::currentTypedLine() const
 {
-    return QString::fromUtf8(m_inputBuffer);
+    return QString::fromUtf8(m_typedLine, m_typedLength);
 }
 
 void SSHTerminal::addCommandToHistory(const QString &command)
@@ -241,17 +289,12 @@ void SSHTerminal::addCommandToHistory(const QString &command)
     CommandHistoryManager::instance().add(m_config.id(), command.trimmed());
 }
 
-void SSHTerminal::onReadyReadStandardOutput()
+void SSHTerminal::onProcessOutput(const QByteArray &data)
 {
-    QByteArray data = m_process->readAllStandardOutput();
-    QString output = QString::fromUtf8(data);
-    
-    m_outputBuffer += output;
-    
-    // Check for password prompt
-    if (m_waitingForPassword && 
-        (output.contains("password:", Qt::CaseInsensitive) || 
-         output.contains("Password:", Qt::CaseInsensitive))) {
+    // ssh's own prompts and errors arrive on the same terminal as the session.
+    // Check for password prompt. Detection works on the raw bytes; the
+    // terminal decodes UTF-8 itself and keeps split sequences intact.
+    if (m_waitingForPassword && data.toLower().contains("password:")) {
         m_waitingForPassword = false;
         if (!m_config.password().isEmpty()) {
             m_process->write(m_config.password().toUtf8() + "\n");
@@ -259,40 +302,30 @@ void SSHTerminal::onReadyReadStandardOutput()
     }
     
     // Check if connection established
-    if (!m_connected && (output.contains("$") || output.contains("#") || output.contains(">"))) {
+    if (!m_connected && (data.contains('$') || data.contains('#') || data.contains('>'))) {
         m_connected = true;
+        // From here on a "password:" is the remote's (sudo, passwd), never ssh's
+        m_waitingForPassword = false;
         m_reconnectAttempts = 0;
         emit connectionStateChanged(true);
-        // Sync terminal size once the shell is at a prompt
-        sendTerminalSize();
     }
     
-    writeLog(output);
+    writeLog(data);
     m_terminal->writeData(data);
-}
 
-void SSHTerminal::onReadyReadStandardError()
-{
-    QByteArray data = m_process->readAllStandardError();
-    QString error = QString::fromUtf8(data);
-    
-    writeLog(error);
-    
-    // Some SSH output goes to stderr that's not actually errors
-    if (error.contains("password:", Qt::CaseInsensitive)) {
-        m_terminal->writeData(data);
-        if (m_waitingForPassword && !m_config.password().isEmpty()) {
-            m_waitingForPassword = false;
-            m_process->write(m_config.password().toUtf8() + "\n");
-        }
-    } else {
-        m_terminal->writeData(data);
+    // Stop reading while the parser is behind; the remote side then blocks
+    // instead of its output queueing up in memory ahead of a Ctrl+C
+    if (m_terminal->isBacklogged()) {
+        m_process->setReadEnabled(false);
     }
 }
 
 void SSHTerminal::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
 {
-    m_sizeSyncTimer->stop();
+    m_pendingInput.clear();
+    m_inputTimer.stop();
+    m_pasteOpen = false;
+    m_waitingForPassword = false;
     m_connected = false;
     emit connectionStateChanged(false);
     stopSessionLog();
@@ -331,6 +364,10 @@ void SSHTerminal::onProcessError(QProcess::ProcessError error)
             errorMsg = "Unknown SSH error occurred.";
             break;
     }
+    // The in-process transport knows what actually went wrong
+    if (!m_process->errorString().isEmpty()) {
+        errorMsg = m_process->errorString();
+    }
     
     ui->terminal->appendPlainText("ERROR: " + errorMsg);
     emit errorOccurred(errorMsg);
@@ -353,69 +390,150 @@ void SSHTerminal::focusTerminal()
 
 void SSHTerminal::onTerminalKeyPressed(const QByteArray &data)
 {
-    if (m_process->state() == QProcess::Running) {
-        m_process->write(data);
+    sendKeystrokes(data);
+    trackTypedLine(data);
+}
+
+void SSHTerminal::sendKeystrokes(const QByteArray &data)
+{
+    if (!m_process->isRunning()) {
+        return;
     }
-    
-    // Capture the line being typed for per-server command history.
-    for (int i = 0; i < data.size(); ++i) {
-        char c = data.at(i);
-        if (c == '\r' || c == '\n') {
-            QString command = QString::fromUtf8(m_inputBuffer);
-            m_inputBuffer.clear();
-            if (!command.trimmed().isEmpty()) {
-                addCommandToHistory(command);
-            }
-        } else if (c == '\x7f' || c == '\b') {
-            QString line = QString::fromUtf8(m_inputBuffer);
-            if (!line.isEmpty()) {
-                line.chop(1);
+    // An interrupt also throws away the rest of a paste still waiting
+    if (data.contains('\x03')) {
+        dropPendingInput();
+    }
+    if (!m_pendingInput.isEmpty()) {
+        // Behind the burst, so the remote side sees the bytes in typing order
+        m_pendingInput.append(data);
+        return;
+    }
+    // Nothing waits in front: straight to the transport, no batching
+    m_process->write(data);
+    // Keys queued behind a paste are not timed, their output is the paste's echo
+    m_terminal->markInput();
+}
+
+void SSHTerminal::queueInput(const QByteArray &data)
+{
+    if (!m_process->isRunning() || data.isEmpty()) {
+        return;
+    }
+    m_pendingInput.append(data);
+    flushPendingInput();
+}
+
+void SSHTerminal::flushPendingInput()
+{
+    if (!m_process->isRunning()) {
+        m_pendingInput.clear();
+    }
+    // Keep at most a chunk queued in the transport so keystrokes never wait
+    // behind a whole paste, and cap each tick so the event loop stays responsive
+    int sent = 0;
+    while (!m_pendingInput.isEmpty() && sent < MAX_INPUT_PER_TICK
+           && m_process->bytesToWrite() < INPUT_CHUNK) {
+        int size = qMin(int(m_pendingInput.size()), INPUT_CHUNK);
+        if (size < m_pendingInput.size()) {
+            // Split neither a UTF-8 sequence nor a paste marker
+            const int escape = m_pendingInput.lastIndexOf('\x1b', size - 1);
+            if (escape > 0 && escape > size - 6) {
+                size = escape;
             }
-            m_inputBuffer = line.toUtf8();
-        } else if (c == '\x1b') {
-            m_inEscapeSequence = true;
-        } else if (m_inEscapeSequence) {
-            if (c >= 0x40 && c <= 0x7e) {
-                m_inEscapeSequence = false;
+            while (size > 1 && (uchar(m_pendingInput.at(size)) & 0xC0) == 0x80) {
+                --size;
             }
-        } else if (c >= 0x20 && c != 0x7f) {
-            m_inputBuffer.append(c);
         }
+        const QByteArray chunk = m_pendingInput.left(size);
+        m_pendingInput.remove(0, size);
+        const int start = chunk.lastIndexOf("\x1b[200~");
+        const int end = chunk.lastIndexOf("\x1b[201~");
+        if (start >= 0 || end >= 0) {
+            m_pasteOpen = start > end;
+        }
+        m_process->write(chunk);
+        sent += size;
+    }
+
+    if (m_pendingInput.isEmpty()) {
+        m_inputTimer.stop();
+    } else if (!m_inputTimer.isActive()) {
+        m_inputTimer.start();
     }
 }
 
-void SSHTerminal::onTerminalSizeChanged(int rows, int columns)
+void SSHTerminal::dropPendingInput()
 {
-    Q_UNUSED(rows)
-    Q_UNUSED(columns)
-    sendTerminalSize();
+    m_pendingInput.clear();
+    m_inputTimer.stop();
+    if (m_pasteOpen) {
+        // Close the paste so the remote line editor leaves paste mode
+        m_pasteOpen = false;
+        if (m_process->isRunning()) {
+            m_process->write("\x1b[201~");
+        }
+    }
 }
 
-void SSHTerminal::onSizeSyncTimeout()
+void SSHTerminal::trackTypedLine(const QByteArray &data)
 {
-    sendTerminalSize();
+    // Capture the line being typed for per-server command history. The
+    // bytes stay UTF-8; backspace drops one whole character from the end.
+    for (int i = 0; i < data.size(); ++i) {
+        const uchar c = static_cast<uchar>(data.at(i));
+        if (m_inputEscape == AfterEscape) {
+            // CSI and SS3 carry parameters; anything else is a two-byte sequence
+            m_inputEscape = (c == '[' || c == 'O') ? InEscapeSequence : NoEscape;
+        } else if (m_inputEscape == InEscapeSequence) {
+            if (c >= 0x40 && c <= 0x7e) {
+                m_inputEscape = NoEscape;
+            }
+        } else if (c == '\r' || c == '\n') {
+            // A line longer than the buffer was only partly seen; keep it out of history
+            if (!m_typedLineOverflow) {
+                addCommandToHistory(QString::fromUtf8(m_typedLine, m_typedLength));
+            }
+            m_typedLength = 0;
+            m_typedLineOverflow = false;
+        } else if (c == 0x7f || c == '\b') {
+            while (m_typedLength > 0 && (uchar(m_typedLine[m_typedLength - 1]) & 0xC0) == 0x80) {
+                --m_typedLength;
+            }
+            if (m_typedLength > 0) {
+                --m_typedLength;
+            }
+        } else if (c == 0x1b) {
+            m_inputEscape = AfterEscape;
+        } else if (c >= 0x20) {
+            if (m_typedLength < TYPED_LINE_CAPACITY) {
+                m_typedLine[m_typedLength++] = static_cast<char>(c);
+            } else {
+                m_typedLineOverflow = true;
+            }
+        }
+    }
 }
 
-void SSHTerminal::sendTerminalSize()
+void SSHTerminal::recordInputLatency(int elapsed)
 {
-    if (m_process->state() != QProcess::Running) {
-        return;
-    }
-    if (m_terminal->useAlternateBuffer()) {
-        return;
-    }
-    int rows = m_terminal->terminalRows();
-    int cols = m_terminal->terminalColumns();
-    if (rows <= 0 || cols <= 0) {
-        return;
-    }
-    if (rows == m_lastSentRows && cols == m_lastSentCols) {
-        return;
+    m_latencySamples[m_latencySampleNext] = int(elapsed);
+    m_latencySampleNext = (m_latencySampleNext + 1) % INPUT_LATENCY_SAMPLES;
+    m_latencySampleCount = qMin(m_latencySampleCount + 1, INPUT_LATENCY_SAMPLES);
+
+    int total = 0;
+    int worst = 0;
+    for (int i = 0; i < m_latencySampleCount; ++i) {
+        total += m_latencySamples[i];
+        worst = qMax(worst, m_latencySamples[i]);
     }
-    m_lastSentRows = rows;
-    m_lastSentCols = cols;
-    QByteArray cmd = QString("stty rows %1 cols %2\n").arg(rows).arg(cols).toUtf8();
-    m_process->write(cmd);
+    emit inputLatencyUpdated(elapsed, total / m_latencySampleCount, worst);
+}
+
+void SSHTerminal::onTerminalSizeChanged(int rows, int columns)
+{
+    // ssh notices the new pty size and sends a window-change request,
+    // which also reaches full-screen programs on the remote side
+    m_process->setWindowSize(rows, columns);
 }
 
 void SSHTerminal::startSessionLog()
@@ -432,10 +550,10 @@ void SSHTerminal::stopSessionLog()
     }
 }
 
-void SSHTerminal::writeLog(const QString &text)
+void SSHTerminal::writeLog(const QByteArray &data)
 {
     if (!m_sessionLogPath.isEmpty()) {
-        SessionLogger::append(m_sessionLogPath, text);
+        SessionLogger::append(m_sessionLogPath, data);
     }
 }
 
@@ -452,7 +570,7 @@ void SSHTerminal::scheduleAutoReconnect()
 
     QTimer::singleShot(3000, this, [this]() {
         m_reconnectScheduled = false;
-        if (!m_userClosed && !m_connected && m_process->state() != QProcess::Running) {
+        if (!m_userClosed && !m_connected && !m_process->isRunning()) {
             connectToServer();
         }
     });
@@ -463,14 +581,27 @@ void SSHTerminal::copy()
     m_terminal->copy();
 }
 
+void SSHTerminal::showSearchBar()
+{
+    m_terminal->showSearchBar();
+}
+
 void SSHTerminal::paste()
 {
-    // Send clipboard contents directly to the SSH process; the remote
-    // application (e.g. the shell) echoes it back into the terminal.
+    // Send clipboard contents to the SSH process; the remote application
+    // (e.g. the shell) echoes it back into the terminal.
     QString text = QApplication::clipboard()->text();
-    if (!text.isEmpty() && m_process->state() == QProcess::Running) {
-        m_process->write(text.toUtf8());
+    if (text.isEmpty() || !m_process->isRunning()) {
+        return;
     }
+    QByteArray data = text.toUtf8();
+    if (m_terminal->bracketedPaste()) {
+        // Like xterm, drop every ESC: removing only the markers can be
+        // bypassed by nesting them, letting the clipboard end the paste
+        data.replace("\x1b", "");
+        data = "\x1b[200~" + data + "\x1b[201~";
+    }
+    queueInput(data);
 }
 
 void SSHTerminal::setTerminalFont(const QFont &font)
@@ -487,3 +618,19 @@ void SSHTerminal::setTerminalColors(const QColor &foreground, const QColor &back
 {
     m_terminal->setDefaultColors(foreground, background);
 }
+
+void SSHTerminal::setParserEngine(ParserEngine engine)
+{
+    m_terminal->setParserEngine(engine);
+}
+
+void SSHTerminal::setScrollback(int lines, bool onDisk)
+{
+    m_terminal->setScrollbackLines(lines);
+    m_terminal->setScrollbackOnDisk(onDisk);
+}
+
+void SSHTerminal::setRenderer(TerminalRenderer renderer)
+{
+    m_terminal->setRenderer(renderer);
+}
@@ -6,6 +6,8 @@
 #include "serverconfig.h"
 #include "vt100terminal.h"
 
+class SSHTransport;
+
 namespace Ui {
 class SSHTerminal;
 }
@@ -28,9 +30,13 @@ public:
 
     void copy();
     void paste();
+    void showSearchBar();
     void setTerminalFont(const QFont &font);
     void setCursorStyle(VT100Terminal::CursorStyle style);
     void setTerminalColors(const QColor &foreground, const QColor &background);
+    void setParserEngine(ParserEngine engine);
+    void setScrollback(int lines, bool onDisk);
+    void setRenderer(TerminalRenderer renderer);
     void executeCommand(const QString &command);
     QString currentTypedLine() const;
     void focusTerminal();
@@ -39,30 +45,43 @@ signals:
     void connectionStateChanged(bool connected);
     void errorOccurred(const QString &error);
 
+    /**
+     * @brief Keystroke-to-echo round trip, in milliseconds
+     *
+     * lastMs is the newest sample; averageMs and worstMs cover the most
+     * recent INPUT_LATENCY_SAMPLES keystrokes.
+     */
+    void inputLatencyUpdated(int lastMs, int averageMs, int worstMs);
+
 private slots:
-    void onReadyReadStandardOutput();
-    void onReadyReadStandardError();
+    void onProcessOutput(const QByteArray &data);
     void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
     void onProcessError(QProcess::ProcessError error);
     void onInputReturnPressed();
     void onTerminalKeyPressed(const QByteArray &data);
     void onTerminalSizeChanged(int rows, int columns);
+    void onTerminalBacklogDrained();
+    void flushPendingInput();
 
 private:
     void sendCommand(const QString &command);
+    void sendKeystrokes(const QByteArray &data);
+    void queueInput(const QByteArray &data);
+    void dropPendingInput();
+    void trackTypedLine(const QByteArray &data);
+    void recordInputLatency(int elapsed);
     QString buildSSHCommand();
     QStringList buildTunnelArguments() const;
+    void setTransport(SSHTransport *transport);
     void addCommandToHistory(const QString &command);
     void scheduleAutoReconnect();
-    void writeLog(const QString &text);
+    void writeLog(const QByteArray &data);
     void startSessionLog();
     void stopSessionLog();
-    void sendTerminalSize();
-    void onSizeSyncTimeout();
 
     Ui::SSHTerminal *ui;
     ServerConfig m_config;
-    QProcess *m_process;
+    SSHTransport *m_process;
     VT100Terminal *m_terminal;
     bool m_connected;
     bool m_waitingForPassword;
@@ -70,12 +89,33 @@ private:
     bool m_reconnectScheduled;
     int m_reconnectAttempts;
     QString m_sessionLogPath;
-    QString m_outputBuffer;
-    QByteArray m_inputBuffer;
-    bool m_inEscapeSequence;
-    int m_lastSentRows = 0;
-    int m_lastSentCols = 0;
-    QTimer *m_sizeSyncTimer;
+
+    // Pastes and snippets go out in bounded chunks; keystrokes queue behind them
+    QByteArray m_pendingInput;
+    QTimer m_inputTimer;
+    bool m_pasteOpen;  // A bracketed paste start marker went out without its end
+
+    // The line being typed, for per-server command history
+    enum InputEscapeState {
+        NoEscape,
+        AfterEscape,
+        InEscapeSequence
+    };
+    static constexpr int TYPED_LINE_CAPACITY = 4096;
+    char m_typedLine[TYPED_LINE_CAPACITY];
+    int m_typedLength;
+    bool m_typedLineOverflow;
+    InputEscapeState m_inputEscape;
+
+    // Keystroke-to-painted-echo round trips, timed by the terminal
+    static constexpr int INPUT_LATENCY_SAMPLES = 64;
+    int m_latencySamples[INPUT_LATENCY_SAMPLES];
+    int m_latencySampleCount;
+    int m_latencySampleNext;
+
+    static constexpr int INPUT_CHUNK = 4096;
+    static constexpr int MAX_INPUT_PER_TICK = 16 * 1024;
+    static constexpr int INPUT_INTERVAL = 5;  // milliseconds
 };
 
 #endif // SSHTERMINAL_H
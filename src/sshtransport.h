@@ -0,0 +1,74 @@
+#ifndef SSHTRANSPORT_H
+#define SSHTRANSPORT_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QProcess>
+#include <QString>
+
+/**
+ * @brief Where SSH connections are made
+ */
+enum class SSHBackend {
+    OpenSSH,    // The ssh, scp and sftp binaries
+    LibSsh      // In process through libssh (builds with QTISSH_HAVE_LIBSSH)
+};
+
+/**
+ * @brief Byte stream to a remote shell or command
+ *
+ * Implemented by PtyProcess, which runs the ssh binary on a local pty,
+ * and by LibSshChannel, which is one channel of an in-process libssh
+ * session. Starting is specific to each; once running, users only see
+ * this interface. Exit and error reporting reuse QProcess's enums so a
+ * transport reads like the process it replaces.
+ */
+class SSHTransport : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SSHTransport(QObject *parent = nullptr) : QObject(parent) {}
+
+    virtual bool isRunning() const = 0;
+
+    /**
+     * @brief Queue data for the remote side; never blocks
+     */
+    virtual void write(const QByteArray &data) = 0;
+
+    /**
+     * @brief Input written but not yet taken by the remote side
+     */
+    virtual qint64 bytesToWrite() const = 0;
+
+    /**
+     * @brief Resize the remote terminal, if there is one
+     */
+    virtual void setWindowSize(int rows, int columns) = 0;
+
+    /**
+     * @brief Stop or resume reading remote output
+     *
+     * While reading is off no dataReceived is emitted; the remote side is
+     * held back by the pty's or the channel's flow control instead of the
+     * output piling up in memory.
+     */
+    virtual void setReadEnabled(bool enable) = 0;
+
+    virtual void terminate() = 0;
+    virtual void kill() = 0;
+    virtual bool waitForFinished(int msecs = 30000) = 0;
+
+    /**
+     * @brief Details of the last error, when the transport has them
+     */
+    virtual QString errorString() const { return QString(); }
+
+signals:
+    void dataReceived(const QByteArray &data);
+    void finished(int exitCode, QProcess::ExitStatus exitStatus);
+    void errorOccurred(QProcess::ProcessError error);
+};
+
+#endif // SSHTRANSPORT_H
@@ -39,17 +39,57 @@ QColor TerminalColorPalette::getColor(TerminalColor color, bool bright)
         return standardColors[colorIndex];
     }
     
-    // For extended colors (16-255), we'll use a simplified mapping
-    // In a full implementation, you'd want to support 256-color palette
+    // Extended colors (16-255): 6x6x6 color cube and grayscale ramp
     if (colorIndex >= 16 && colorIndex < 256) {
-        // Simplified: map to nearest standard color
-        return standardColors[colorIndex % 16];
+        return QColor(indexedColor(colorIndex));
     }
     
     // Fallback to default
     return bright ? defaultBackground : defaultForeground;
 }
 
+QRgb TerminalColorPalette::indexedColor(int index)
+{
+    if (index < 0 || index > 255) {
+        return defaultForeground.rgb();
+    }
+    if (index < 16) {
+        return standardColors[index].rgb();
+    }
+    if (index < 232) {
+        // 6x6x6 cube with the xterm channel levels 0, 95, 135, 175, 215, 255
+        static const int levels[6] = { 0, 95, 135, 175, 215, 255 };
+        const int cube = index - 16;
+        return qRgb(levels[cube / 36], levels[(cube / 6) % 6], levels[cube % 6]);
+    }
+    // 24-step grayscale ramp from 8 to 238
+    const int gray = 8 + (index - 232) * 10;
+    return qRgb(gray, gray, gray);
+}
+
+int TerminalColorPalette::nearestIndex(QRgb rgb)
+{
+    // Nearest cube level per channel, then compare against the gray ramp
+    const auto level = [](int value) {
+        return value < 48 ? 0 : (value < 115 ? 1 : (value - 35) / 40);
+    };
+    const int red = qRed(rgb);
+    const int green = qGreen(rgb);
+    const int blue = qBlue(rgb);
+    const int cubeIndex = 16 + 36 * level(red) + 6 * level(green) + level(blue);
+    
+    const int average = (red + green + blue) / 3;
+    const int grayIndex = 232 + qBound(0, (average - 3) / 10, 23);
+    
+    const auto distance = [red, green, blue](QRgb other) {
+        const int dr = qRed(other) - red;
+        const int dg = qGreen(other) - green;
+        const int db = qBlue(other) - blue;
+        return dr * dr + dg * dg + db * db;
+    };
+    return distance(indexedColor(grayIndex)) < distance(indexedColor(cubeIndex)) ? grayIndex : cubeIndex;
+}
+
 QColor TerminalColorPalette::getDefaultForeground()
 {
     return defaultForeground;
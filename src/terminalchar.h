@@ -4,11 +4,16 @@
 #include <QChar>
 #include <QColor>
 #include <QFont>
+#include <QVector>
 
 /**
- * @brief Terminal color enumeration for standard VT100 colors
+ * @brief Color stored in a terminal cell
+ *
+ * Values 0-15 are the standard VT100 colors and 16-255 the rest of the
+ * xterm 256-color palette. Values from TrueColorBase on index the RGB
+ * color table of the TerminalScreen that owns the cell.
  */
-enum class TerminalColor : int {
+enum class TerminalColor : quint16 {
     Black = 0,
     Red = 1,
     Green = 2,
@@ -25,9 +30,33 @@ enum class TerminalColor : int {
     BrightMagenta = 13,
     BrightCyan = 14,
     BrightWhite = 15,
-    Default = 256  // Use default terminal colors
+    Default = 256,  // Use default terminal colors
+    TrueColorBase = 257
 };
 
+/**
+ * @brief A color as decoded from SGR, before it is stored in a cell
+ *
+ * Either a TerminalColor value or a 24-bit RGB value tagged with
+ * RgbColorFlag. TerminalScreen interns RGB values into its color table so
+ * cells only keep a 16-bit TerminalColor.
+ */
+typedef quint32 ColorValue;
+
+const ColorValue RgbColorFlag = 0x01000000;
+
+inline ColorValue colorValue(TerminalColor color)
+{
+    return static_cast<ColorValue>(color);
+}
+
+inline ColorValue rgbColorValue(int red, int green, int blue)
+{
+    return RgbColorFlag | (static_cast<ColorValue>(red & 0xFF) << 16)
+                        | (static_cast<ColorValue>(green & 0xFF) << 8)
+                        | static_cast<ColorValue>(blue & 0xFF);
+}
+
 /**
  * @brief Text attribute flags for terminal characters
  */
@@ -115,6 +144,61 @@ struct TerminalChar {
     }
 };
 
+/**
+ * @brief Colors and attributes shared by cells, interned once per screen
+ */
+struct TerminalStyle {
+    TerminalColor foreground;
+    TerminalColor background;
+    TextAttributes attributes;
+    
+    TerminalStyle(TerminalColor fg = TerminalColor::Default,
+                  TerminalColor bg = TerminalColor::Default,
+                  TextAttributes attr = TextAttribute::None)
+        : foreground(fg)
+        , background(bg)
+        , attributes(attr)
+    {
+    }
+    
+    /**
+     * @brief Unique key for the style table lookup
+     */
+    quint64 key() const {
+        return (static_cast<quint64>(foreground) << 32) |
+               (static_cast<quint64>(background) << 16) |
+               static_cast<quint64>(static_cast<int>(attributes) & 0xFFFF);
+    }
+};
+
+/**
+ * @brief Packed storage form of a terminal cell (8 bytes)
+ *
+ * Holds the code point and the id of an interned TerminalStyle; the owning
+ * TerminalScreen expands it to a TerminalChar on access. Style 0 is always
+ * the default style, so a default-constructed cell is a blank.
+ */
+struct TerminalCell {
+    uint codepoint;
+    quint32 style;
+    
+    TerminalCell()
+        : codepoint(' ')
+        , style(0)
+    {
+    }
+    
+    TerminalCell(uint cp, quint32 styleId)
+        : codepoint(cp)
+        , style(styleId)
+    {
+    }
+};
+
+Q_DECLARE_TYPEINFO(TerminalCell, Q_MOVABLE_TYPE);
+
+typedef QVector<TerminalCell> TerminalLine;
+
 /**
  * @brief Cursor position in the terminal
  */
@@ -139,6 +223,16 @@ struct CursorPosition {
 class TerminalColorPalette {
 public:
     static QColor getColor(TerminalColor color, bool bright = false);
+    
+    /**
+     * @brief RGB value of an xterm 256-color palette index
+     */
+    static QRgb indexedColor(int index);
+    
+    /**
+     * @brief Closest palette index (16-255) for an RGB value
+     */
+    static int nearestIndex(QRgb rgb);
     static QColor getDefaultForeground();
     static QColor getDefaultBackground();
     
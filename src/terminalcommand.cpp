@@ -0,0 +1,70 @@
+#include "terminalcommand.h"
+
+TerminalCommandBuffer::TerminalCommandBuffer()
+    : m_hasText(false)
+    , m_hasTerminalEvents(false)
+    , m_reservedOffset(0)
+{
+}
+
+void TerminalCommandBuffer::append(TerminalCommand::Type type, int first, int second, int third)
+{
+    const TerminalCommand command = { type, first, second, third };
+    m_commands.append(command);
+    
+    switch (type) {
+    case TerminalCommand::SetPrivateMode:
+    case TerminalCommand::UseAlternateScreenBuffer:
+    case TerminalCommand::Bell:
+        m_hasTerminalEvents = true;
+        break;
+    default:
+        break;
+    }
+}
+
+void TerminalCommandBuffer::appendText(const uint *codepoints, int length)
+{
+    if (length <= 0) {
+        return;
+    }
+    
+    const int offset = m_text.size();
+    m_text.append(codepoints, length);
+    recordText(offset, length);
+}
+
+uint *TerminalCommandBuffer::reserveText(int capacity)
+{
+    m_reservedOffset = m_text.size();
+    m_text.resize(m_reservedOffset + capacity);
+    return m_text.data() + m_reservedOffset;
+}
+
+void TerminalCommandBuffer::commitText(int length)
+{
+    m_text.resize(m_reservedOffset + length);
+    if (length > 0) {
+        recordText(m_reservedOffset, length);
+    }
+}
+
+void TerminalCommandBuffer::recordText(int offset, int length)
+{
+    // Extend the previous run when nothing came in between
+    if (!m_commands.isEmpty() && m_commands.last().type == TerminalCommand::Text) {
+        m_commands.last().second += length;
+    } else {
+        append(TerminalCommand::Text, offset, length);
+    }
+    m_hasText = true;
+}
+
+void TerminalCommandBuffer::clear()
+{
+    // resize(0) keeps the allocated capacity for the next batch
+    m_commands.resize(0);
+    m_text.resize(0);
+    m_hasText = false;
+    m_hasTerminalEvents = false;
+}
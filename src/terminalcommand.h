@@ -0,0 +1,134 @@
+#ifndef TERMINALCOMMAND_H
+#define TERMINALCOMMAND_H
+
+#include <QtGlobal>
+#include <QVarLengthArray>
+
+/**
+ * @brief One screen operation decoded by VT100Parser
+ *
+ * Plain data so a whole read can be recorded into a TerminalCommandBuffer
+ * and applied in one pass. The meaning of the arguments depends on type.
+ */
+struct TerminalCommand
+{
+    enum Type : quint8 {
+        // Text: first = offset into the buffer's code points, second = length
+        Text,
+        
+        // Cursor operations
+        CursorUp,                   // first = lines
+        CursorDown,                 // first = lines
+        CursorForward,              // first = columns
+        CursorBackward,             // first = columns
+        CursorPosition,             // first = row, second = column (0-based)
+        CursorNextLine,             // first = lines
+        CursorPreviousLine,         // first = lines
+        CursorHorizontalAbsolute,   // first = column (0-based)
+        LineFeed,
+        ReverseIndex,
+        SaveCursor,
+        RestoreCursor,
+        HideCursor,
+        ShowCursor,
+        
+        // Screen operations
+        ClearScreen,
+        ClearScreenFromCursor,
+        ClearScreenToCursor,
+        ClearLine,
+        ClearLineFromCursor,
+        ClearLineToCursor,
+        InsertLines,                // first = count
+        DeleteLines,                // first = count
+        InsertCharacters,           // first = count
+        DeleteCharacters,           // first = count
+        EraseCharacters,            // first = count
+        ScrollUp,                   // first = lines
+        ScrollDown,                 // first = lines
+        ClearHistory,
+        FullReset,
+        
+        // first = foreground, second = background, third = TextAttributes
+        SetTextAttributes,
+        ResetTextAttributes,
+        SetScrollingRegion,         // first = top, second = bottom (0-based)
+        
+        // Tab operations
+        SetTabStop,
+        ClearTabStop,
+        ClearAllTabStops,
+        TabForward,                 // first = count
+        TabBackward,                // first = count
+        
+        // Character sets
+        SetCharacterSet,            // first = designator, second = charset
+        SelectCharacterSet,         // first = set
+        
+        // Modes: first = mode, second = enabled
+        SetMode,
+        SetPrivateMode,
+        UseAlternateScreenBuffer,   // first = use
+        
+        Bell,
+        DeviceStatusReport,
+        CursorPositionReport
+    };
+    
+    Type type;
+    int first;
+    int second;
+    int third;
+};
+
+Q_DECLARE_TYPEINFO(TerminalCommand, Q_PRIMITIVE_TYPE);
+
+/**
+ * @brief Reusable arena of TerminalCommands plus the code points of their text
+ *
+ * Storage is kept between batches, so steady-state parsing does not
+ * allocate. Consecutive text is merged into a single Text command.
+ */
+class TerminalCommandBuffer
+{
+public:
+    TerminalCommandBuffer();
+    
+    void append(TerminalCommand::Type type, int first = 0, int second = 0, int third = 0);
+    void appendText(const uint *codepoints, int length);
+    
+    /**
+     * @brief Space for up to capacity code points at the end of the text arena
+     *
+     * Lets the parser decode in place; the pointer is valid until the
+     * matching commitText().
+     */
+    uint *reserveText(int capacity);
+    void commitText(int length);
+    
+    void clear();
+    
+    bool isEmpty() const { return m_commands.isEmpty(); }
+    int size() const { return m_commands.size(); }
+    const TerminalCommand *begin() const { return m_commands.constData(); }
+    const TerminalCommand *end() const { return m_commands.constData() + m_commands.size(); }
+    
+    /** @brief Code points of a Text command */
+    const uint *text(const TerminalCommand &command) const { return m_text.constData() + command.first; }
+    
+    bool hasText() const { return m_hasText; }
+    
+    /** @brief Whether the batch holds bells or mode changes that concern the widget */
+    bool hasTerminalEvents() const { return m_hasTerminalEvents; }
+    
+private:
+    void recordText(int offset, int length);
+    
+    QVarLengthArray<TerminalCommand, 256> m_commands;
+    QVarLengthArray<uint, 4096> m_text;
+    bool m_hasText;
+    bool m_hasTerminalEvents;
+    int m_reservedOffset;
+};
+
+#endif // TERMINALCOMMAND_H
@@ -0,0 +1,445 @@
+#include "terminalglview.h"
+
+#ifndef QTISSH_NO_OPENGL
+
+#include "vt100terminal.h"
+#include <QOpenGLContext>
+#include <QOpenGLTexture>
+#include <QOffscreenSurface>
+#include <QSurfaceFormat>
+#include <QPainter>
+#include <QTimer>
+#include <QDebug>
+#include <cstddef>
+
+namespace {
+
+const char *const VERTEX_SHADER = R"(
+in vec2 a_corner;
+in vec4 a_rect;
+in vec4 a_uv;
+in vec4 a_color;
+uniform vec2 u_viewport;
+out vec2 v_uv;
+out vec4 v_color;
+void main()
+{
+    vec2 position = a_rect.xy + a_corner * a_rect.zw;
+    v_uv = a_uv.xy + a_corner * a_uv.zw;
+    v_color = a_color;
+    gl_Position = vec4(position.x / u_viewport.x * 2.0 - 1.0,
+                       1.0 - position.y / u_viewport.y * 2.0, 0.0, 1.0);
+}
+)";
+
+// Glyphs are rasterized white, so atlas alpha is the coverage to tint with
+const char *const FRAGMENT_SHADER = R"(
+in vec2 v_uv;
+in vec4 v_color;
+uniform sampler2D u_atlas;
+uniform bool u_textured;
+out vec4 fragColor;
+void main()
+{
+    float coverage = u_textured ? texture(u_atlas, v_uv).a : 1.0;
+    fragColor = v_color * coverage;
+}
+)";
+
+const GLfloat QUAD_CORNERS[] = {
+    0.0f, 0.0f,
+    1.0f, 0.0f,
+    0.0f, 1.0f,
+    1.0f, 1.0f
+};
+
+enum AttributeLocation {
+    CornerAttribute = 0,
+    RectAttribute = 1,
+    UvAttribute = 2,
+    ColorAttribute = 3
+};
+
+// A frame needing more glyphs than the atlas holds would otherwise rebuild forever
+const int MAX_BUILD_ATTEMPTS = 2;
+
+}
+
+TerminalGLView::TerminalGLView(VT100Terminal *terminal)
+    : QOpenGLWidget(terminal)
+    , m_terminal(terminal)
+    , m_ready(false)
+    , m_quadBuffer(QOpenGLBuffer::VertexBuffer)
+    , m_instanceBuffer(QOpenGLBuffer::VertexBuffer)
+{
+    setFormat(surfaceFormat());
+
+    // Keyboard and mouse input stays with the terminal widget
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setFocusPolicy(Qt::NoFocus);
+}
+
+TerminalGLView::~TerminalGLView()
+{
+    if (m_ready) {
+        makeCurrent();
+        releaseGL();
+        doneCurrent();
+    }
+}
+
+QSurfaceFormat TerminalGLView::surfaceFormat()
+{
+    QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+    if (QOpenGLContext::openGLModuleType() == QOpenGLContext::LibGLES) {
+        format.setRenderableType(QSurfaceFormat::OpenGLES);
+        format.setVersion(3, 0);
+    } else {
+        format.setRenderableType(QSurfaceFormat::OpenGL);
+        format.setVersion(3, 3);
+        format.setProfile(QSurfaceFormat::CoreProfile);
+    }
+    return format;
+}
+
+bool TerminalGLView::hasRequiredVersion(const QOpenGLContext *context)
+{
+    const QSurfaceFormat format = context->format();
+    if (context->isOpenGLES()) {
+        return format.majorVersion() >= 3;
+    }
+    return format.version() >= qMakePair(3, 3);
+}
+
+bool TerminalGLView::isSupported()
+{
+    static int supported = -1;
+    if (supported < 0) {
+        QOpenGLContext context;
+        context.setFormat(surfaceFormat());
+        QOffscreenSurface surface;
+        surface.setFormat(context.format());
+        surface.create();
+
+        supported = context.create() && context.makeCurrent(&surface) && hasRequiredVersion(&context);
+        if (supported) {
+            qDebug() << "Terminal OpenGL renderer:"
+                     << reinterpret_cast<const char *>(context.functions()->glGetString(GL_RENDERER));
+        }
+        context.doneCurrent();
+    }
+    return supported;
+}
+
+void TerminalGLView::setCellFont(const QFont &font)
+{
+    m_glyphCache.setFont(font);
+    update();
+}
+
+void TerminalGLView::initializeGL()
+{
+    initializeOpenGLFunctions();
+
+    if (!hasRequiredVersion(context()) || !buildProgram()) {
+        qWarning() << "Terminal OpenGL renderer unavailable, falling back to QPainter";
+        // The terminal deletes this view in response, so not from within a GL callback
+        QTimer::singleShot(0, this, [this]() { emit unavailable(); });
+        return;
+    }
+
+    m_vao.create();
+    m_vao.bind();
+
+    m_quadBuffer.create();
+    m_quadBuffer.bind();
+    m_quadBuffer.allocate(QUAD_CORNERS, sizeof(QUAD_CORNERS));
+    m_program.enableAttributeArray(CornerAttribute);
+    m_program.setAttributeBuffer(CornerAttribute, GL_FLOAT, 0, 2);
+
+    // Attribute pointers into this buffer are set for every draw
+    m_instanceBuffer.create();
+    m_instanceBuffer.setUsagePattern(QOpenGLBuffer::StreamDraw);
+    m_instanceBuffer.bind();
+    for (int location : {RectAttribute, UvAttribute, ColorAttribute}) {
+        m_program.enableAttributeArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+
+    m_vao.release();
+    m_ready = true;
+}
+
+bool TerminalGLView::buildProgram()
+{
+    const QByteArray header = context()->isOpenGLES()
+        ? QByteArrayLiteral("#version 300 es\nprecision mediump float;\n")
+        : QByteArrayLiteral("#version 330 core\n");
+
+    if (!m_program.addShaderFromSourceCode(QOpenGLShader::Vertex, header + VERTEX_SHADER)
+            || !m_program.addShaderFromSourceCode(QOpenGLShader::Fragment, header + FRAGMENT_SHADER)) {
+        return false;
+    }
+
+    m_program.bindAttributeLocation("a_corner", CornerAttribute);
+    m_program.bindAttributeLocation("a_rect", RectAttribute);
+    m_program.bindAttributeLocation("a_uv", UvAttribute);
+    m_program.bindAttributeLocation("a_color", ColorAttribute);
+    return m_program.link();
+}
+
+void TerminalGLView::releaseGL()
+{
+    qDeleteAll(m_pageTextures);
+    m_pageTextures.clear();
+    m_pageKeys.clear();
+    m_instanceBuffer.destroy();
+    m_quadBuffer.destroy();
+    m_vao.destroy();
+    m_program.removeAllShaders();
+}
+
+void TerminalGLView::paintGL()
+{
+    if (!m_ready) return;
+
+    m_glyphCache.setDevicePixelRatio(devicePixelRatioF());
+    buildInstances();
+    uploadPages();
+
+    const QColor background = m_terminal->m_defaultBackground;
+    glClearColor(background.redF(), background.greenF(), background.blueF(), 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    m_program.bind();
+    m_vao.bind();
+    m_program.setUniformValue("u_viewport", GLfloat(width()), GLfloat(height()));
+    m_program.setUniformValue("u_atlas", 0);
+
+    drawInstances(m_backgrounds, nullptr);
+    for (int page = 0; page < m_glyphs.size() && page < m_pageTextures.size(); ++page) {
+        drawInstances(m_glyphs.at(page), m_pageTextures.at(page));
+    }
+    drawInstances(m_decorations, nullptr);
+
+    m_vao.release();
+    m_program.release();
+    glDisable(GL_BLEND);
+
+    drawOverlay();
+    m_terminal->framePainted();
+}
+
+void TerminalGLView::buildInstances()
+{
+    const TerminalSnapshot &snapshot = m_terminal->m_snapshot;
+
+    for (int attempt = 0; attempt < MAX_BUILD_ATTEMPTS; ++attempt) {
+        const quint64 generation = m_glyphCache.generation();
+        m_backgrounds.clear();
+        for (QVector<Instance> &instances : m_glyphs) {
+            instances.clear();
+        }
+        m_decorations.clear();
+        m_textGlyphs.clear();
+
+        // Negative rows are scrollback shown above the screen
+        for (int row = -m_terminal->m_scrollOffset; row < snapshot.rows; ++row) {
+            if ((row + m_terminal->m_scrollOffset) * m_terminal->m_charHeight >= height()) {
+                break;
+            }
+            const TerminalCell *cells = snapshot.rowCells(row);
+            if (!cells) continue;
+
+            // Runs are split as in the raster path
+            int column = 0;
+            while (column < snapshot.columns) {
+                bool selected;
+                const int end = m_terminal->runEnd(row, cells, column, snapshot.columns - 1, &selected);
+                addRun(row, column, cells + column, end - column, snapshot.style(cells[column].style), selected);
+                column = end;
+            }
+        }
+        addCursor();
+
+        // Search matches are tinted over the text, as in the raster path
+        if (!m_terminal->m_searchMatches.isEmpty()) {
+            QVector<QRect> current;
+            for (const QRect &match : m_terminal->matchRects(-m_terminal->m_scrollOffset, snapshot.rows - 1, &current)) {
+                addSolid(m_decorations, match, VT100Terminal::searchMatchColor(false));
+            }
+            for (const QRect &match : current) {
+                addSolid(m_decorations, match, VT100Terminal::searchMatchColor(true));
+            }
+        }
+
+        // Slots handed out before the atlas started over now hold other glyphs
+        if (m_glyphCache.generation() == generation) {
+            break;
+        }
+    }
+}
+
+void TerminalGLView::addSolid(QVector<Instance> &instances, const QRectF &rect, const QColor &color)
+{
+    instances.append({
+        {float(rect.x()), float(rect.y()), float(rect.width()), float(rect.height())},
+        {0.0f, 0.0f, 0.0f, 0.0f},
+        // Blending expects premultiplied alpha
+        {float(color.redF() * color.alphaF()), float(color.greenF() * color.alphaF()),
+         float(color.blueF() * color.alphaF()), float(color.alphaF())}
+    });
+}
+
+void TerminalGLView::addRun(int row, int column, const TerminalCell *cells, int length,
+                            const TerminalStyle &style, bool selected)
+{
+    QColor fg = m_terminal->getCharacterColor(style.foreground, true);
+    QColor bg = m_terminal->getCharacterColor(style.background, false);
+    if (bool(style.attributes & TextAttribute::Reverse) != selected) {
+        qSwap(fg, bg);
+    }
+
+    const QRect runRect = m_terminal->getCharacterRect(row, column)
+                              .united(m_terminal->getCharacterRect(row, column + length - 1));
+    if (bg != m_terminal->m_defaultBackground) {
+        addSolid(m_backgrounds, runRect, bg);
+    }
+
+    const int variant = GlyphCache::variant(style.attributes);
+    const int cellWidth = m_terminal->m_charWidth;
+    const int cellHeight = m_terminal->m_charHeight;
+    const float red = fg.redF();
+    const float green = fg.greenF();
+    const float blue = fg.blueF();
+
+    for (int i = 0; i < length; ++i) {
+        const uint codepoint = cells[i].codepoint;
+        if (codepoint == ' ' || codepoint == 0) {
+            continue;
+        }
+
+        const QRect target(runRect.left() + i * cellWidth, runRect.top(), cellWidth, cellHeight);
+        const GlyphCache::Glyph glyph = m_glyphCache.glyph(codepoint, qRgb(255, 255, 255), variant);
+        if (glyph.page < 0) {
+            m_textGlyphs.append({target, codepoint, fg, variant});
+            continue;
+        }
+
+        if (glyph.page >= m_glyphs.size()) {
+            m_glyphs.resize(glyph.page + 1);
+        }
+        const QImage &page = m_glyphCache.pages().at(glyph.page);
+        m_glyphs[glyph.page].append({
+            {float(target.x()), float(target.y()), float(cellWidth), float(cellHeight)},
+            {float(glyph.source.x()) / page.width(), float(glyph.source.y()) / page.height(),
+             float(glyph.source.width()) / page.width(), float(glyph.source.height()) / page.height()},
+            {red, green, blue, 1.0f}
+        });
+    }
+
+    if (style.attributes & TextAttribute::Underline) {
+        addSolid(m_decorations, QRectF(runRect.left(), runRect.bottom(), runRect.width(), 1), fg);
+    }
+    if (style.attributes & TextAttribute::Strikethrough) {
+        addSolid(m_decorations, QRectF(runRect.left(), runRect.top() + runRect.height() / 2, runRect.width(), 1), fg);
+    }
+}
+
+void TerminalGLView::addCursor()
+{
+    const VT100Terminal *terminal = m_terminal;
+    if (!terminal->m_cursorVisible || !terminal->m_cursorBlinkState || !terminal->m_hasFocus
+            || terminal->m_scrollOffset != 0) {
+        return;
+    }
+
+    const CursorPosition pos = terminal->m_snapshot.cursor;
+    const QRect cell = terminal->getCharacterRect(pos.row, pos.column);
+    const QColor color = terminal->m_defaultForeground;
+
+    // Same strokes as the 1px QPainter outline and lines of the raster cursor
+    switch (terminal->m_cursorStyle) {
+    case VT100Terminal::Block:
+        addSolid(m_decorations, QRectF(cell.x(), cell.y(), cell.width() + 1, 1), color);
+        addSolid(m_decorations, QRectF(cell.x(), cell.y() + cell.height(), cell.width() + 1, 1), color);
+        addSolid(m_decorations, QRectF(cell.x(), cell.y(), 1, cell.height() + 1), color);
+        addSolid(m_decorations, QRectF(cell.x() + cell.width(), cell.y(), 1, cell.height() + 1), color);
+        break;
+    case VT100Terminal::Underline:
+        addSolid(m_decorations, QRectF(cell.x(), cell.bottom(), cell.width(), 1), color);
+        break;
+    case VT100Terminal::IBeam:
+        addSolid(m_decorations, QRectF(cell.x(), cell.y(), 1, cell.height()), color);
+        break;
+    }
+}
+
+void TerminalGLView::uploadPages()
+{
+    const QVector<QImage> &pages = m_glyphCache.pages();
+    while (m_pageTextures.size() > pages.size()) {
+        delete m_pageTextures.takeLast();
+        m_pageKeys.removeLast();
+    }
+
+    // Painting a glyph into a page changes its cache key
+    for (int page = 0; page < pages.size(); ++page) {
+        if (page == m_pageTextures.size()) {
+            m_pageTextures.append(nullptr);
+            m_pageKeys.append(0);
+        }
+        if (m_pageTextures.at(page) && m_pageKeys.at(page) == pages.at(page).cacheKey()) {
+            continue;
+        }
+
+        delete m_pageTextures.at(page);
+        QOpenGLTexture *texture = new QOpenGLTexture(pages.at(page), QOpenGLTexture::DontGenerateMipMaps);
+        // Slots are sampled 1:1 in device pixels; linear filtering would bleed neighbours in
+        texture->setMinMagFilters(QOpenGLTexture::Nearest, QOpenGLTexture::Nearest);
+        texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+        m_pageTextures[page] = texture;
+        m_pageKeys[page] = pages.at(page).cacheKey();
+    }
+}
+
+void TerminalGLView::drawInstances(const QVector<Instance> &instances, QOpenGLTexture *texture)
+{
+    if (instances.isEmpty()) {
+        return;
+    }
+
+    m_instanceBuffer.bind();
+    m_instanceBuffer.allocate(instances.constData(), instances.size() * int(sizeof(Instance)));
+    m_program.setAttributeBuffer(RectAttribute, GL_FLOAT, offsetof(Instance, rect), 4, sizeof(Instance));
+    m_program.setAttributeBuffer(UvAttribute, GL_FLOAT, offsetof(Instance, uv), 4, sizeof(Instance));
+    m_program.setAttributeBuffer(ColorAttribute, GL_FLOAT, offsetof(Instance, color), 4, sizeof(Instance));
+
+    m_program.setUniformValue("u_textured", GLint(texture != nullptr));
+    if (texture) {
+        texture->bind(0);
+    }
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instances.size());
+    if (texture) {
+        texture->release(0);
+    }
+}
+
+void TerminalGLView::drawOverlay()
+{
+    if (m_textGlyphs.isEmpty()) {
+        return;
+    }
+
+    QPainter painter(this);
+    for (const TextGlyph &glyph : m_textGlyphs) {
+        painter.setFont(m_glyphCache.font(glyph.variant));
+        painter.setPen(glyph.color);
+        painter.drawText(glyph.rect, Qt::AlignLeft | Qt::AlignTop,
+                         QString::fromUcs4(reinterpret_cast<const char32_t *>(&glyph.codepoint), 1));
+    }
+}
+
+#endif // QTISSH_NO_OPENGL
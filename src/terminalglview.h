@@ -0,0 +1,106 @@
+#ifndef TERMINALGLVIEW_H
+#define TERMINALGLVIEW_H
+
+#ifndef QTISSH_NO_OPENGL
+
+#include <QOpenGLWidget>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLBuffer>
+#include <QOpenGLVertexArrayObject>
+#include <QVector>
+#include "glyphcache.h"
+
+class QOpenGLContext;
+class QOpenGLTexture;
+class VT100Terminal;
+
+/**
+ * @brief GPU renderer for the cell grid of a VT100Terminal
+ *
+ * Covers the text area of its terminal and redraws the whole grid each
+ * frame as instanced quads: one per background run, one per glyph sampled
+ * from the glyph atlas (uploaded as textures), and one per underline,
+ * strikethrough or cursor stroke. Input stays with the terminal widget.
+ *
+ * Requires OpenGL 3.3 or OpenGL ES 3.0. Without a GPU driver Mesa provides
+ * these through llvmpipe (LIBGL_ALWAYS_SOFTWARE=1 forces it); if no such
+ * context can be created the view emits unavailable() and the terminal
+ * goes back to QPainter rendering.
+ */
+class TerminalGLView : public QOpenGLWidget, protected QOpenGLExtraFunctions
+{
+    Q_OBJECT
+
+public:
+    explicit TerminalGLView(VT100Terminal *terminal);
+    ~TerminalGLView();
+
+    /**
+     * @brief Set the font glyphs are rasterized with
+     */
+    void setCellFont(const QFont &font);
+
+    /**
+     * @brief Whether a context of the required version can be created here
+     */
+    static bool isSupported();
+
+signals:
+    void unavailable();
+
+protected:
+    void initializeGL() override;
+    void paintGL() override;
+
+private:
+    // Per-instance attributes; positions in logical pixels
+    struct Instance {
+        float rect[4];   // x, y, width, height
+        float uv[4];     // Atlas source, normalized; unused for solid quads
+        float color[4];  // Premultiplied RGBA
+    };
+
+    static QSurfaceFormat surfaceFormat();
+    static bool hasRequiredVersion(const QOpenGLContext *context);
+
+    bool buildProgram();
+    void buildInstances();
+    void addSolid(QVector<Instance> &instances, const QRectF &rect, const QColor &color);
+    void addRun(int row, int column, const TerminalCell *cells, int length, const TerminalStyle &style,
+                bool selected);
+    void addCursor();
+    void uploadPages();
+    void drawInstances(const QVector<Instance> &instances, QOpenGLTexture *texture);
+    void drawOverlay();
+    void releaseGL();
+
+    VT100Terminal *m_terminal;
+    GlyphCache m_glyphCache;
+    bool m_ready;
+
+    QOpenGLShaderProgram m_program;
+    QOpenGLVertexArrayObject m_vao;
+    QOpenGLBuffer m_quadBuffer;
+    QOpenGLBuffer m_instanceBuffer;
+    QVector<QOpenGLTexture *> m_pageTextures;
+    QVector<qint64> m_pageKeys;  // QImage::cacheKey of each page as uploaded
+
+    // Instances of the frame being drawn
+    QVector<Instance> m_backgrounds;
+    QVector<QVector<Instance>> m_glyphs;  // Indexed by atlas page
+    QVector<Instance> m_decorations;
+
+    // Glyphs too wide for an atlas slot, drawn with QPainter over the grid
+    struct TextGlyph {
+        QRect rect;
+        uint codepoint;
+        QColor color;
+        int variant;
+    };
+    QVector<TextGlyph> m_textGlyphs;
+};
+
+#endif // QTISSH_NO_OPENGL
+
+#endif // TERMINALGLVIEW_H
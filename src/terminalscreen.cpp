@@ -1,38 +1,55 @@
 #include "terminalscreen.h"
 #include <QDebug>
+#include <QRegularExpression>
+#include <algorithm>
 
 TerminalScreen::TerminalScreen(int rows, int columns, QObject *parent)
     : QObject(parent)
     , m_rows(rows)
     , m_columns(columns)
-    , m_maxHistorySize(1000)
     , m_cursorPos(0, 0)
     , m_savedCursorPos(0, 0)
     , m_cursorVisible(true)
+    , m_wrapPending(false)
     , m_currentForeground(TerminalColor::Default)
     , m_currentBackground(TerminalColor::Default)
     , m_currentAttributes(TextAttribute::None)
+    , m_currentStyle(0)
+    , m_colorRetryCountdown(0)
     , m_scrollTop(0)
     , m_scrollBottom(rows - 1)
     , m_useAlternateBuffer(false)
+    , m_reflowing(false)
+    , m_reflowScreenLine(0)
+    , m_reflowUsedRows(0)
+    , m_reflowCursorLine(-1)
+    , m_reflowCursorOffset(0)
+    , m_reflowSavedLine(-1)
+    , m_reflowSavedOffset(0)
+    , m_reflowTop(0)
+    , m_historyLines(0)
+    , m_batching(false)
+    , m_cursorMoved(false)
+    , m_generation(0)
 {
+    // Style 0 is the default style of blank cells
+    m_styles.append(TerminalStyle());
+    m_styleIndex.insert(m_styles.first().key(), 0);
+    
     initializeScreen();
     m_currentScreen = &m_mainScreen;
+    m_currentWrapped = &m_mainWrapped;
 }
 
 void TerminalScreen::initializeScreen()
 {
     // Initialize main screen buffer
-    m_mainScreen.resize(m_rows);
-    m_alternateScreen.resize(m_rows);
-    for (int i = 0; i < m_rows; ++i) {
-        m_mainScreen[i].resize(m_columns);
-        m_alternateScreen[i].resize(m_columns);
-        for (int j = 0; j < m_columns; ++j) {
-            m_mainScreen[i][j] = TerminalChar();
-            m_alternateScreen[i][j] = TerminalChar();
-        }
-    }
+    const TerminalLine blankLine(m_columns);
+    m_mainScreen.fill(blankLine, m_rows);
+    m_alternateScreen.fill(blankLine, m_rows);
+    m_mainWrapped.fill(false, m_rows);
+    m_alternateWrapped.fill(false, m_rows);
+    m_rowGenerations.fill(m_generation, m_rows);
     
     // Initialize tab stops (every 8 columns by default)
     m_tabStops.resize(m_columns);
@@ -46,45 +63,288 @@ void TerminalScreen::resize(int rows, int columns)
     if (rows == m_rows && columns == m_columns) {
         return;
     }
+    if (rows <= 0 || columns <= 0) {
+        return;
+    }
     
-    // Save current screen content
-    QVector<QVector<TerminalChar>> oldScreen = (*m_currentScreen);
-    int oldRows = m_rows;
-    int oldColumns = m_columns;
+    // Main screen: reflowed on width changes, otherwise rows added or removed in place
+    if (columns != m_columns || m_reflowing) {
+        if (!m_reflowing) {
+            beginReflow();
+        }
+        layoutReflow(rows, columns);
+    } else {
+        const int keepRow = m_useAlternateBuffer ? lastUsedRow(m_mainScreen, m_mainWrapped) : m_cursorPos.row;
+        const int removed = resizeRows(m_mainScreen, m_mainWrapped, rows, keepRow, true);
+        if (!m_useAlternateBuffer) {
+            m_cursorPos.row -= removed;
+        }
+    }
+    
+    // Alternate screen: cut or padded, never reflowed
+    const int keepRow = m_useAlternateBuffer ? m_cursorPos.row : -1;
+    const int removed = resizeRows(m_alternateScreen, m_alternateWrapped, rows, keepRow, false);
+    if (m_useAlternateBuffer) {
+        m_cursorPos.row -= removed;
+    }
+    if (columns != m_columns) {
+        for (TerminalLine &line : m_alternateScreen) {
+            line.resize(columns);
+        }
+        m_alternateWrapped.fill(false);
+    }
+    
+    // Tab stops past the old width get the default interval
+    m_tabStops.resize(columns);
+    for (int i = m_columns; i < columns; ++i) {
+        m_tabStops[i] = (i % DEFAULT_TAB_SIZE == 0);
+    }
     
-    // Update dimensions
     m_rows = rows;
     m_columns = columns;
+    m_scrollTop = 0;
     m_scrollBottom = rows - 1;
+    m_rowGenerations.resize(rows);
     
-    // Reinitialize screen
-    initializeScreen();
+    ensureCursorInBounds();
+    
+    emit screenResized(m_rows, m_columns);
+    notifyChanged(QRect(0, 0, m_columns, m_rows));
+}
+
+void TerminalScreen::beginReflow()
+{
+    // The newest history rows are rewrapped too, which also rejoins lines an
+    // earlier width change split between history and screen. A line cut by
+    // the limit is still taken whole, as far as uncompressed rows reach.
+    QVector<TerminalLine> historyRows;
+    QVector<bool> historyWrapped;
+    while (m_history.removableLines() > 0
+           && (historyRows.size() < REFLOW_HISTORY_ROWS || m_history.isWrapped(m_history.size() - 1))) {
+        const int index = m_history.size() - 1;
+        const TerminalCell *cells = m_history.line(index);
+        TerminalLine row(m_history.lineLength(index));
+        std::copy(cells, cells + row.size(), row.begin());
+        historyRows.append(row);
+        historyWrapped.append(m_history.isWrapped(index));
+        m_history.removeLast();
+        --m_historyLines;
+    }
+    std::reverse(historyRows.begin(), historyRows.end());
+    std::reverse(historyWrapped.begin(), historyWrapped.end());
     
-    // Copy old content to new screen
-    int copyRows = qMin(oldRows, m_rows);
-    int copyColumns = qMin(oldColumns, m_columns);
+    // Rows below the content and the cursors take no part; the saved cursor
+    // belongs to the main screen even while the alternate one is shown
+    const bool mainCursor = !m_useAlternateBuffer;
+    int usedRows = lastUsedRow(m_mainScreen, m_mainWrapped) + 1;
+    if (mainCursor) {
+        usedRows = qMax(usedRows, m_cursorPos.row + 1);
+    }
+    usedRows = qMax(usedRows, qMin(m_savedCursorPos.row + 1, m_mainScreen.size()));
     
-    for (int i = 0; i < copyRows; ++i) {
-        for (int j = 0; j < copyColumns; ++j) {
-            (*m_currentScreen)[i][j] = oldScreen[i][j];
+    m_reflowLines.clear();
+    m_reflowScreenLine = -1;
+    m_reflowUsedRows = usedRows;
+    m_reflowCursorLine = -1;
+    m_reflowSavedLine = -1;
+    
+    const int total = historyRows.size() + usedRows;
+    bool lineOpen = false;
+    for (int i = 0; i < total; ++i) {
+        const int row = i - historyRows.size();
+        const TerminalLine &source = row < 0 ? historyRows.at(i) : m_mainScreen.at(row);
+        if (!lineOpen) {
+            m_reflowLines.append(TerminalLine());
+            lineOpen = true;
+        }
+        TerminalLine &logical = m_reflowLines.last();
+        if (row == 0) {
+            m_reflowScreenLine = m_reflowLines.size() - 1;
         }
+        if (mainCursor && row == m_cursorPos.row) {
+            m_reflowCursorLine = m_reflowLines.size() - 1;
+            m_reflowCursorOffset = logical.size() + m_cursorPos.column;
+        }
+        if (row >= 0 && row == m_savedCursorPos.row) {
+            m_reflowSavedLine = m_reflowLines.size() - 1;
+            m_reflowSavedOffset = logical.size() + m_savedCursorPos.column;
+        }
+        
+        // Wrapped rows are full; the last row of a line loses its trailing blanks
+        int length = source.size();
+        const bool continues = (row < 0 ? historyWrapped.at(i) : m_mainWrapped.at(row)) && i + 1 < total;
+        if (!continues) {
+            while (length > 0 && source.at(length - 1).style == 0
+                   && (source.at(length - 1).codepoint == ' ' || source.at(length - 1).codepoint == 0)) {
+                --length;
+            }
+        }
+        const int offset = logical.size();
+        logical.resize(offset + length);
+        std::copy(source.constBegin(), source.constBegin() + length, logical.begin() + offset);
+        lineOpen = continues;
+    }
+    if (m_reflowScreenLine < 0) {
+        m_reflowScreenLine = m_reflowLines.size();
+    }
+    m_reflowing = true;
+}
+
+int TerminalScreen::reflowRows(int line, int columns) const
+{
+    int length = m_reflowLines.at(line).size();
+    if (line == m_reflowCursorLine) {
+        length = qMax(length, m_reflowCursorOffset + 1);
+    }
+    return qMax(1, (length + columns - 1) / columns);
+}
+
+void TerminalScreen::copyReflowRow(int line, int row, int columns, TerminalLine &target) const
+{
+    const TerminalLine &logical = m_reflowLines.at(line);
+    const int from = row * columns;
+    const int count = qBound(0, logical.size() - from, columns);
+    target.resize(columns);
+    std::copy(logical.constBegin() + from, logical.constBegin() + from + count, target.begin());
+    std::fill(target.begin() + count, target.end(), TerminalCell());
+}
+
+void TerminalScreen::layoutReflow(int rows, int columns)
+{
+    // Row counts are cheap; cells are copied only for the rows on the screen
+    int total = 0;
+    int screenStart = -1;
+    int cursorRow = -1;
+    int savedRow = -1;
+    int savedColumn = 0;
+    for (int line = 0; line < m_reflowLines.size(); ++line) {
+        const int count = reflowRows(line, columns);
+        if (line == m_reflowScreenLine) {
+            screenStart = total;
+        }
+        if (line == m_reflowCursorLine) {
+            cursorRow = total + m_reflowCursorOffset / columns;
+        }
+        if (line == m_reflowSavedLine) {
+            // Past the end of a line that got shorter it stays on the last row
+            const bool inside = m_reflowSavedOffset / columns < count;
+            savedRow = total + (inside ? m_reflowSavedOffset / columns : count - 1);
+            savedColumn = inside ? m_reflowSavedOffset % columns : columns - 1;
+        }
+        total += count;
+    }
+    if (screenStart < 0) {
+        screenStart = total;
     }
     
-    // Ensure cursor is in bounds
-    ensureCursorInBounds();
+    // Content that got shorter makes room for lines from history above it;
+    // rows that no longer fit leave through the top while the cursor stays in view
+    int top = qMax(0, total - qMax(total - screenStart, m_reflowUsedRows));
+    if (total - top > rows) {
+        top += cursorRow >= 0 ? qMin(total - top - rows, cursorRow - top) : total - top - rows;
+    }
+    m_reflowTop = top;
     
-    emit screenResized(m_rows, m_columns);
-    emit screenChanged(QRect(0, 0, m_columns, m_rows));
+    // Rows keep their storage where it is not shared with a published snapshot
+    m_mainScreen.resize(rows);
+    m_mainWrapped.resize(rows);
+    int row = 0;
+    int start = 0;
+    for (int line = 0; line < m_reflowLines.size() && row < rows; ++line) {
+        const int count = reflowRows(line, columns);
+        for (int i = qMax(0, top - start); i < count && row < rows; ++i, ++row) {
+            copyReflowRow(line, i, columns, m_mainScreen[row]);
+            m_mainWrapped[row] = i < count - 1;
+        }
+        start += count;
+    }
+    for (; row < rows; ++row) {
+        TerminalLine &blank = m_mainScreen[row];
+        blank.resize(columns);
+        std::fill(blank.begin(), blank.end(), TerminalCell());
+        m_mainWrapped[row] = false;
+    }
+    
+    if (cursorRow >= 0) {
+        m_cursorPos.row = cursorRow - top;
+        m_cursorPos.column = m_reflowCursorOffset % columns;
+    }
+    if (savedRow >= 0) {
+        m_savedCursorPos.row = qBound(0, savedRow - top, rows - 1);
+        m_savedCursorPos.column = savedColumn;
+    }
+}
+
+bool TerminalScreen::finishReflow()
+{
+    if (!m_reflowing) {
+        return false;
+    }
+    m_reflowing = false;
+    
+    // Rows laid out above the screen go to history at the settled width
+    TerminalLine row;
+    int start = 0;
+    for (int line = 0; line < m_reflowLines.size() && start < m_reflowTop; ++line) {
+        const int count = reflowRows(line, m_columns);
+        for (int i = 0; i < count && start + i < m_reflowTop; ++i) {
+            copyReflowRow(line, i, m_columns, row);
+            addLineToHistory(row, i < count - 1);
+        }
+        start += count;
+    }
+    m_reflowLines = QVector<TerminalLine>();
+    return true;
+}
+
+int TerminalScreen::resizeRows(QVector<TerminalLine> &screen, QVector<bool> &wrapped,
+                               int rows, int keepRow, bool toHistory)
+{
+    // Rows are only added or dropped, the others keep their storage
+    int removed = 0;
+    if (screen.size() > rows) {
+        removed = qBound(0, keepRow - rows + 1, screen.size() - rows);
+        if (toHistory) {
+            for (int i = 0; i < removed; ++i) {
+                addLineToHistory(screen.at(i), wrapped.at(i));
+            }
+        }
+        screen.remove(0, removed);
+        wrapped.remove(0, removed);
+        screen.resize(rows);
+        wrapped.resize(rows);
+    }
+    while (screen.size() < rows) {
+        screen.append(TerminalLine(m_columns));
+        wrapped.append(false);
+    }
+    return removed;
+}
+
+int TerminalScreen::lastUsedRow(const QVector<TerminalLine> &screen, const QVector<bool> &wrapped) const
+{
+    for (int row = screen.size() - 1; row >= 0; --row) {
+        if (wrapped.at(row)) {
+            return row;
+        }
+        for (const TerminalCell &cell : screen.at(row)) {
+            if (cell.style != 0 || (cell.codepoint != ' ' && cell.codepoint != 0)) {
+                return row;
+            }
+        }
+    }
+    return -1;
 }
 
 void TerminalScreen::setCursorPosition(int row, int column)
 {
+    m_wrapPending = false;
     CursorPosition oldPos = m_cursorPos;
     m_cursorPos.row = qBound(0, row, m_rows - 1);
     m_cursorPos.column = qBound(0, column, m_columns - 1);
     
     if (m_cursorPos != oldPos) {
-        emit cursorPositionChanged(m_cursorPos);
+        notifyCursorMoved();
     }
 }
 
@@ -131,7 +391,15 @@ TerminalChar TerminalScreen::getChar(int row, int column) const
     if (!isValidPosition(row, column)) {
         return TerminalChar();
     }
-    return (*m_currentScreen)[row][column];
+    return expandCell((*m_currentScreen)[row][column]);
+}
+
+const TerminalCell *TerminalScreen::rowCells(int row) const
+{
+    if (row < 0 || row >= m_rows) {
+        return nullptr;
+    }
+    return (*m_currentScreen)[row].constData();
 }
 
 void TerminalScreen::setChar(int row, int column, const TerminalChar &ch)
@@ -140,8 +408,8 @@ void TerminalScreen::setChar(int row, int column, const TerminalChar &ch)
         return;
     }
     
-    (*m_currentScreen)[row][column] = ch;
-    emit screenChanged(QRect(column, row, 1, 1));
+    (*m_currentScreen)[row][column] = packChar(ch);
+    notifyChanged(QRect(column, row, 1, 1));
 }
 
 void TerminalScreen::setChar(const TerminalChar &ch)
@@ -163,20 +431,18 @@ void TerminalScreen::insertChar(const TerminalChar &ch)
         charToInsert.attributes = m_currentAttributes;
     }
     
+    if (m_wrapPending) {
+        wrapCursor();
+        notifyCursorMoved();
+    }
+    
     setChar(charToInsert);
     
-    // Advance cursor
+    // Advance cursor; at the last column the wrap waits for the next character
     if (m_cursorPos.column < m_columns - 1) {
         moveCursor(0, 1);
     } else {
-        // Line wrap
-        if (m_cursorPos.row < m_rows - 1) {
-            setCursorPosition(m_cursorPos.row + 1, 0);
-        } else {
-            // Scroll up if at bottom
-            scrollUp(1);
-            setCursorPosition(m_rows - 1, 0);
-        }
+        m_wrapPending = true;
     }
 }
 
@@ -205,12 +471,61 @@ void TerminalScreen::insertText(const QString &text)
     }
 }
 
+void TerminalScreen::insertRun(const uint *codepoints, int length)
+{
+    const CursorPosition oldPos = m_cursorPos;
+    
+    int i = 0;
+    while (i < length) {
+        if (m_wrapPending) {
+            // Only a character that is actually written wraps the full row
+            while (i < length && !QChar::isPrint(codepoints[i])) {
+                ++i;
+            }
+            if (i == length) {
+                break;
+            }
+            wrapCursor();
+        }
+        
+        // Fill the current row in one pass, deferring the wrap like insertChar()
+        TerminalCell *line = (*m_currentScreen)[m_cursorPos.row].data();
+        const int startColumn = m_cursorPos.column;
+        int column = startColumn;
+        
+        while (i < length && column < m_columns) {
+            const uint codepoint = codepoints[i++];
+            if (!QChar::isPrint(codepoint)) {
+                continue;
+            }
+            line[column++] = TerminalCell(codepoint, m_currentStyle);
+        }
+        
+        if (column > startColumn) {
+            notifyChanged(QRect(startColumn, m_cursorPos.row, column - startColumn, 1));
+        }
+        
+        if (column < m_columns) {
+            m_cursorPos.column = column;
+            continue;
+        }
+        
+        // The row is full; the cursor stays on its last column until more text arrives
+        m_cursorPos.column = m_columns - 1;
+        m_wrapPending = true;
+    }
+    
+    if (m_cursorPos != oldPos) {
+        notifyCursorMoved();
+    }
+}
+
 QVector<TerminalChar> TerminalScreen::getLine(int row) const
 {
     if (row < 0 || row >= m_rows) {
         return QVector<TerminalChar>();
     }
-    return (*m_currentScreen)[row];
+    return expandLine((*m_currentScreen)[row]);
 }
 
 void TerminalScreen::setLine(int row, const QVector<TerminalChar> &line)
@@ -221,15 +536,16 @@ void TerminalScreen::setLine(int row, const QVector<TerminalChar> &line)
     
     int copyLength = qMin(line.size(), m_columns);
     for (int i = 0; i < copyLength; ++i) {
-        (*m_currentScreen)[row][i] = line[i];
+        (*m_currentScreen)[row][i] = packChar(line[i]);
     }
     
     // Clear remaining columns if line is shorter
     for (int i = copyLength; i < m_columns; ++i) {
-        (*m_currentScreen)[row][i] = TerminalChar();
+        (*m_currentScreen)[row][i] = TerminalCell();
     }
+    (*m_currentWrapped)[row] = false;
     
-    emit screenChanged(QRect(0, row, m_columns, 1));
+    notifyChanged(QRect(0, row, m_columns, 1));
 }
 
 void TerminalScreen::clearLine(int row)
@@ -238,73 +554,90 @@ void TerminalScreen::clearLine(int row)
         return;
     }
     
-    for (int i = 0; i < m_columns; ++i) {
-        (*m_currentScreen)[row][i] = TerminalChar();
-    }
-    
-    emit screenChanged(QRect(0, row, m_columns, 1));
+    blankRow(row);
+    notifyChanged(QRect(0, row, m_columns, 1));
 }
 
 void TerminalScreen::clearLineFromCursor()
 {
     for (int i = m_cursorPos.column; i < m_columns; ++i) {
-        (*m_currentScreen)[m_cursorPos.row][i] = TerminalChar();
+        (*m_currentScreen)[m_cursorPos.row][i] = TerminalCell();
     }
+    // The row now ends in blanks, so it no longer continues below
+    (*m_currentWrapped)[m_cursorPos.row] = false;
+    m_wrapPending = false;
     
-    emit screenChanged(QRect(m_cursorPos.column, m_cursorPos.row, 
+    notifyChanged(QRect(m_cursorPos.column, m_cursorPos.row, 
                             m_columns - m_cursorPos.column, 1));
 }
 
 void TerminalScreen::clearLineToCursor()
 {
     for (int i = 0; i <= m_cursorPos.column && i < m_columns; ++i) {
-        (*m_currentScreen)[m_cursorPos.row][i] = TerminalChar();
+        (*m_currentScreen)[m_cursorPos.row][i] = TerminalCell();
+    }
+    if (m_cursorPos.column >= m_columns - 1) {
+        (*m_currentWrapped)[m_cursorPos.row] = false;
     }
+    m_wrapPending = false;
     
-    emit screenChanged(QRect(0, m_cursorPos.row, m_cursorPos.column + 1, 1));
+    notifyChanged(QRect(0, m_cursorPos.row, m_cursorPos.column + 1, 1));
 }
 
 void TerminalScreen::insertLine(int row)
 {
-    if (row < m_scrollTop || row > m_scrollBottom) {
+    insertLines(row, 1);
+}
+
+void TerminalScreen::deleteLine(int row)
+{
+    deleteLines(row, 1);
+}
+
+void TerminalScreen::insertLines(int row, int count)
+{
+    if (row < m_scrollTop || row > m_scrollBottom || count <= 0) {
         return;
     }
     
-    // Save the bottom line for history if we're scrolling the whole screen
+    count = qMin(count, m_scrollBottom - row + 1);
+    
+    // Save the bottom lines for history if we're scrolling the whole screen
     if (m_scrollTop == 0 && m_scrollBottom == m_rows - 1) {
-        addLineToHistory((*m_currentScreen)[m_scrollBottom]);
+        for (int i = m_scrollBottom - count + 1; i <= m_scrollBottom; ++i) {
+            addLineToHistory((*m_currentScreen)[i], (*m_currentWrapped)[i]);
+        }
     }
     
-    // Shift lines down
-    for (int i = m_scrollBottom; i > row; --i) {
-        (*m_currentScreen)[i] = (*m_currentScreen)[i - 1];
+    // Rotate the pushed-out bottom rows up and reuse them as the inserted lines
+    rotateRows(row, m_scrollBottom - count + 1, m_scrollBottom + 1);
+    for (int i = row; i < row + count; ++i) {
+        blankRow(i);
     }
     
-    // Clear the inserted line
-    clearLine(row);
-    
     emitScreenChanged(row, m_scrollBottom);
 }
 
-void TerminalScreen::deleteLine(int row)
+void TerminalScreen::deleteLines(int row, int count)
 {
-    if (row < m_scrollTop || row > m_scrollBottom) {
+    if (row < m_scrollTop || row > m_scrollBottom || count <= 0) {
         return;
     }
     
-    // Shift lines up
-    for (int i = row; i < m_scrollBottom; ++i) {
-        (*m_currentScreen)[i] = (*m_currentScreen)[i + 1];
-    }
+    count = qMin(count, m_scrollBottom - row + 1);
     
-    // Clear the bottom line
-    clearLine(m_scrollBottom);
+    // Rotate the deleted rows to the bottom of the region and blank them
+    rotateRows(row, row + count, m_scrollBottom + 1);
+    for (int i = m_scrollBottom - count + 1; i <= m_scrollBottom; ++i) {
+        blankRow(i);
+    }
     
     emitScreenChanged(row, m_scrollBottom);
 }
 
 void TerminalScreen::clear()
 {
+    finishReflow();
     for (int i = 0; i < m_rows; ++i) {
         clearLine(i);
     }
@@ -341,6 +674,26 @@ void TerminalScreen::scrollDown(int lines)
     scrollDownInRegion(lines);
 }
 
+void TerminalScreen::lineFeed()
+{
+    m_wrapPending = false;
+    if (m_cursorPos.row == m_scrollBottom) {
+        scrollUp(1);
+    } else {
+        moveCursor(1, 0);
+    }
+}
+
+void TerminalScreen::reverseIndex()
+{
+    m_wrapPending = false;
+    if (m_cursorPos.row == m_scrollTop) {
+        scrollDown(1);
+    } else {
+        moveCursor(-1, 0);
+    }
+}
+
 void TerminalScreen::scrollUpInRegion(int lines)
 {
     if (lines <= 0) return;
@@ -349,17 +702,13 @@ void TerminalScreen::scrollUpInRegion(int lines)
     
     // Add scrolled lines to history
     for (int i = 0; i < lines; ++i) {
-        addLineToHistory((*m_currentScreen)[m_scrollTop + i]);
+        addLineToHistory((*m_currentScreen)[m_scrollTop + i], (*m_currentWrapped)[m_scrollTop + i]);
     }
     
-    // Shift lines up
-    for (int i = m_scrollTop; i <= m_scrollBottom - lines; ++i) {
-        (*m_currentScreen)[i] = (*m_currentScreen)[i + lines];
-    }
-    
-    // Clear bottom lines
+    // Rotate the scrolled-out rows to the bottom and reuse them as blank lines
+    rotateRows(m_scrollTop, m_scrollTop + lines, m_scrollBottom + 1);
     for (int i = m_scrollBottom - lines + 1; i <= m_scrollBottom; ++i) {
-        clearLine(i);
+        blankRow(i);
     }
     
     emitScreenChanged(m_scrollTop, m_scrollBottom);
@@ -371,39 +720,266 @@ void TerminalScreen::scrollDownInRegion(int lines)
     
     lines = qMin(lines, m_scrollBottom - m_scrollTop + 1);
     
-    // Shift lines down
-    for (int i = m_scrollBottom; i >= m_scrollTop + lines; --i) {
-        (*m_currentScreen)[i] = (*m_currentScreen)[i - lines];
-    }
-    
-    // Clear top lines
+    // Rotate the bottom rows to the top and reuse them as blank lines
+    rotateRows(m_scrollTop, m_scrollBottom - lines + 1, m_scrollBottom + 1);
     for (int i = m_scrollTop; i < m_scrollTop + lines; ++i) {
-        clearLine(i);
+        blankRow(i);
     }
     
     emitScreenChanged(m_scrollTop, m_scrollBottom);
 }
 
+void TerminalScreen::rotateRows(int first, int middle, int last)
+{
+    // Rows are implicitly shared vectors, so this only moves row handles
+    QVector<TerminalLine>::iterator rows = m_currentScreen->begin();
+    std::rotate(rows + first, rows + middle, rows + last);
+    QVector<bool>::iterator wrapped = m_currentWrapped->begin();
+    std::rotate(wrapped + first, wrapped + middle, wrapped + last);
+}
+
+void TerminalScreen::wrapCursor()
+{
+    (*m_currentWrapped)[m_cursorPos.row] = true;
+    if (m_cursorPos.row < m_rows - 1) {
+        m_cursorPos.row++;
+    } else {
+        scrollUp(1);
+    }
+    m_cursorPos.column = 0;
+    m_wrapPending = false;
+}
+
+void TerminalScreen::blankRow(int row)
+{
+    TerminalLine &line = (*m_currentScreen)[row];
+    std::fill(line.begin(), line.end(), TerminalCell());
+    (*m_currentWrapped)[row] = false;
+}
+
 void TerminalScreen::setCurrentAttributes(TerminalColor fg, TerminalColor bg, TextAttributes attr)
 {
     m_currentForeground = fg;
     m_currentBackground = bg;
     m_currentAttributes = attr;
+    updateCurrentStyle();
 }
 
 void TerminalScreen::setCurrentForegroundColor(TerminalColor color)
 {
     m_currentForeground = color;
+    updateCurrentStyle();
 }
 
 void TerminalScreen::setCurrentBackgroundColor(TerminalColor color)
 {
     m_currentBackground = color;
+    updateCurrentStyle();
 }
 
 void TerminalScreen::setCurrentTextAttributes(TextAttributes attr)
 {
     m_currentAttributes = attr;
+    updateCurrentStyle();
+}
+
+quint32 TerminalScreen::internStyle(const TerminalStyle &style)
+{
+    const quint64 key = style.key();
+    const auto it = m_styleIndex.constFind(key);
+    if (it != m_styleIndex.constEnd()) {
+        return it.value();
+    }
+    
+    quint32 id;
+    if (!m_freeStyles.isEmpty()) {
+        id = m_freeStyles.takeLast();
+        m_styles[id] = style;
+    } else {
+        id = static_cast<quint32>(m_styles.size());
+        m_styles.append(style);
+    }
+    m_styleIndex.insert(key, id);
+    return id;
+}
+
+const TerminalStyle &TerminalScreen::style(quint32 id) const
+{
+    return id < static_cast<quint32>(m_styles.size()) ? m_styles.at(id) : m_styles.first();
+}
+
+TerminalChar TerminalScreen::expandCell(const TerminalCell &cell) const
+{
+    const TerminalStyle &cellStyle = style(cell.style);
+    // QChar holds the BMP only; the cell keeps the full code point
+    const QChar ch = cell.codepoint == 0 ? QChar(' ')
+                   : cell.codepoint > 0xFFFF ? QChar(QChar::ReplacementCharacter)
+                   : QChar(static_cast<ushort>(cell.codepoint));
+    return TerminalChar(ch, cellStyle.foreground, cellStyle.background, cellStyle.attributes);
+}
+
+QVector<TerminalChar> TerminalScreen::expandLine(const TerminalLine &line) const
+{
+    return expandLine(line.constData(), line.size());
+}
+
+QVector<TerminalChar> TerminalScreen::expandLine(const TerminalCell *cells, int length) const
+{
+    QVector<TerminalChar> chars;
+    chars.reserve(length);
+    for (int i = 0; i < length; ++i) {
+        chars.append(expandCell(cells[i]));
+    }
+    return chars;
+}
+
+TerminalCell TerminalScreen::packChar(const TerminalChar &ch)
+{
+    return TerminalCell(ch.character.unicode(),
+                        internStyle(TerminalStyle(ch.foregroundColor, ch.backgroundColor, ch.attributes)));
+}
+
+void TerminalScreen::updateCurrentStyle()
+{
+    m_currentStyle = internStyle(TerminalStyle(m_currentForeground, m_currentBackground, m_currentAttributes));
+}
+
+qint64 TerminalScreen::memoryFootprint() const
+{
+    const auto linesSize = [](const QVector<TerminalLine> &lines) {
+        qint64 bytes = lines.capacity() * static_cast<qint64>(sizeof(TerminalLine));
+        for (const TerminalLine &line : lines) {
+            bytes += LINE_OVERHEAD + line.capacity() * static_cast<qint64>(sizeof(TerminalCell));
+        }
+        return bytes;
+    };
+    
+    qint64 bytes = sizeof(*this);
+    bytes += linesSize(m_mainScreen) + linesSize(m_alternateScreen) + m_history.memoryFootprint();
+    bytes += linesSize(m_reflowLines);
+    bytes += m_searchIndex.memoryFootprint();
+    bytes += m_mainWrapped.capacity() + m_alternateWrapped.capacity();
+    bytes += m_styles.capacity() * static_cast<qint64>(sizeof(TerminalStyle));
+    bytes += m_styleIndex.size() * static_cast<qint64>(sizeof(quint64) + sizeof(quint32) + HASH_NODE_OVERHEAD);
+    bytes += m_colorTable.capacity() * static_cast<qint64>(sizeof(QRgb));
+    bytes += m_colorIndex.size() * static_cast<qint64>(sizeof(QRgb) + sizeof(quint16) + HASH_NODE_OVERHEAD);
+    return bytes;
+}
+
+TerminalColor TerminalScreen::internColor(ColorValue value)
+{
+    if (!(value & RgbColorFlag)) {
+        return static_cast<TerminalColor>(value);
+    }
+    
+    const QRgb rgb = qRgb((value >> 16) & 0xFF, (value >> 8) & 0xFF, value & 0xFF);
+    const auto it = m_colorIndex.constFind(rgb);
+    if (it != m_colorIndex.constEnd()) {
+        return static_cast<TerminalColor>(it.value());
+    }
+    
+    // Once the 16-bit index space is used up, fall back to the 256-color palette
+    if (m_colorTable.size() >= MAX_TRUE_COLORS) {
+        return static_cast<TerminalColor>(TerminalColorPalette::nearestIndex(rgb));
+    }
+    
+    const quint16 index = static_cast<quint16>(static_cast<int>(TerminalColor::TrueColorBase) + m_colorTable.size());
+    m_colorTable.append(rgb);
+    m_colorIndex.insert(rgb, index);
+    return static_cast<TerminalColor>(index);
+}
+
+void TerminalScreen::ensureColorSpace()
+{
+    // Compact before interning, so indices already handed out stay valid
+    if (m_colorTable.size() + 2 <= MAX_TRUE_COLORS) {
+        return;
+    }
+    if (m_colorRetryCountdown > 0) {
+        --m_colorRetryCountdown;
+        return;
+    }
+    compactTables();
+    if (m_colorTable.size() + 2 > MAX_TRUE_COLORS) {
+        // Every color is still on screen or in history; fall back for a while
+        m_colorRetryCountdown = COMPACTION_RETRY;
+    }
+}
+
+void TerminalScreen::compactTables()
+{
+    QVector<bool> used(m_styles.size(), false);
+    used[0] = true;
+    used[m_currentStyle] = true;
+    const auto markCells = [&used](const TerminalCell *cells, int length) {
+        for (int i = 0; i < length; ++i) {
+            if (cells[i].style < static_cast<quint32>(used.size())) {
+                used[cells[i].style] = true;
+            }
+        }
+    };
+    for (const TerminalLine &line : m_mainScreen) {
+        markCells(line.constData(), line.size());
+    }
+    for (const TerminalLine &line : m_alternateScreen) {
+        markCells(line.constData(), line.size());
+    }
+    for (const TerminalLine &line : m_reflowLines) {
+        markCells(line.constData(), line.size());
+    }
+    // Without decompressing history: its blocks know which styles they hold
+    m_history.markStyles(used);
+    
+    // Rebuild the color table from the styles that survive
+    QVector<QRgb> colors;
+    QHash<QRgb, quint16> colorIndex;
+    const auto remap = [this, &colors, &colorIndex](TerminalColor color) {
+        const int index = static_cast<int>(color) - static_cast<int>(TerminalColor::TrueColorBase);
+        if (index < 0 || index >= m_colorTable.size()) {
+            return color;
+        }
+        const QRgb rgb = m_colorTable.at(index);
+        const auto it = colorIndex.constFind(rgb);
+        if (it != colorIndex.constEnd()) {
+            return static_cast<TerminalColor>(it.value());
+        }
+        const quint16 newIndex = static_cast<quint16>(static_cast<int>(TerminalColor::TrueColorBase) + colors.size());
+        colors.append(rgb);
+        colorIndex.insert(rgb, newIndex);
+        return static_cast<TerminalColor>(newIndex);
+    };
+    
+    while (m_styles.size() > 1 && !used.at(m_styles.size() - 1)) {
+        m_styles.removeLast();
+    }
+    m_styleIndex.clear();
+    m_freeStyles.clear();
+    for (int id = 0; id < m_styles.size(); ++id) {
+        TerminalStyle &entry = m_styles[id];
+        if (!used.at(id)) {
+            entry = TerminalStyle();
+            m_freeStyles.append(static_cast<quint32>(id));
+            continue;
+        }
+        entry.foreground = remap(entry.foreground);
+        entry.background = remap(entry.background);
+        m_styleIndex.insert(entry.key(), static_cast<quint32>(id));
+    }
+    m_currentForeground = remap(m_currentForeground);
+    m_currentBackground = remap(m_currentBackground);
+    
+    m_colorTable = colors;
+    m_colorIndex = colorIndex;
+    m_colorRetryCountdown = 0;
+}
+
+QRgb TerminalScreen::trueColor(TerminalColor color) const
+{
+    const int index = static_cast<int>(color) - static_cast<int>(TerminalColor::TrueColorBase);
+    if (index < 0 || index >= m_colorTable.size()) {
+        return TerminalColorPalette::getDefaultForeground().rgb();
+    }
+    return m_colorTable.at(index);
 }
 
 void TerminalScreen::resetAttributes()
@@ -411,6 +987,7 @@ void TerminalScreen::resetAttributes()
     m_currentForeground = TerminalColor::Default;
     m_currentBackground = TerminalColor::Default;
     m_currentAttributes = TextAttribute::None;
+    m_currentStyle = 0;
 }
 
 void TerminalScreen::setScrollingRegion(int top, int bottom)
@@ -477,17 +1054,193 @@ QVector<TerminalChar> TerminalScreen::getHistoryLine(int index) const
     if (index < 0 || index >= m_history.size()) {
         return QVector<TerminalChar>();
     }
-    return m_history[index];
+    return expandLine(m_history.line(index), m_history.lineLength(index));
 }
 
-void TerminalScreen::setMaxHistorySize(int size)
+TerminalLine TerminalScreen::historyRow(int index) const
 {
-    m_maxHistorySize = qMax(0, size);
+    TerminalLine row(m_columns);
+    if (index < 0 || index >= m_history.size()) {
+        return row;
+    }
+    const int length = qMin(m_history.lineLength(index), m_columns);
+    std::copy(m_history.line(index), m_history.line(index) + length, row.begin());
+    return row;
+}
+
+QString TerminalScreen::text(qint64 startLine, int startColumn, qint64 endLine, int endColumn) const
+{
+    const qint64 oldestLine = m_historyLines - m_history.size();
+    const qint64 firstLine = qMax(startLine, oldestLine);
+    const qint64 lastLine = qMin(endLine, m_historyLines + m_rows - 1);
     
-    // Trim history if necessary
-    while (m_history.size() > m_maxHistorySize) {
-        m_history.removeFirst();
+    // Code points are collected first and converted once
+    QVector<uint> buffer;
+    for (qint64 line = firstLine; line <= lastLine; ++line) {
+        int length;
+        bool wrapped;
+        const TerminalCell *cells = lineCells(line, &length, &wrapped);
+        
+        const int first = line == startLine ? qBound(0, startColumn, length) : 0;
+        const int last = line == endLine ? qBound(first, endColumn, length) : length;
+        for (int column = first; column < last; ++column) {
+            buffer.append(cells[column].codepoint ? cells[column].codepoint : ' ');
+        }
+        
+        // Soft-wrapped rows continue the same line
+        if (line != endLine && !wrapped) {
+            while (!buffer.isEmpty() && buffer.last() == ' ') {
+                buffer.removeLast();
+            }
+            buffer.append('\n');
+        }
+    }
+    
+    return QString::fromUcs4(reinterpret_cast<const char32_t *>(buffer.constData()), buffer.size());
+}
+
+qint64 TerminalScreen::find(const TerminalSearchQuery &query, qint64 fromLine, qint64 toLine,
+                            QVector<TerminalSearchMatch> &matches, int maxMatches) const
+{
+    const qint64 oldestLine = m_historyLines - m_history.size();
+    const qint64 lastLine = m_historyLines + m_rows;
+    const qint64 endLine = qMin(toLine, lastLine);
+    if (query.pattern.isEmpty()) {
+        return endLine;
+    }
+    
+    QRegularExpression expression;
+    if (query.regularExpression) {
+        expression.setPattern(query.pattern);
+        if (!query.caseSensitive) {
+            expression.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
+        }
+        if (!expression.isValid()) {
+            return endLine;
+        }
     }
+    const QVector<quint32> trigrams = TerminalSearchIndex::trigrams(query);
+    const Qt::CaseSensitivity sensitivity = query.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    
+    // Matches are searched in whole logical lines, so start where the one
+    // holding fromLine begins; only matches from fromLine on are reported
+    fromLine = qMax(fromLine, oldestLine);
+    qint64 line = fromLine;
+    while (line > oldestLine) {
+        int length;
+        bool wrapped;
+        lineCells(line - 1, &length, &wrapped);
+        if (!wrapped) {
+            break;
+        }
+        --line;
+    }
+    
+    QString text;
+    QVector<int> rowStarts;
+    qint64 resumeLine = endLine;
+    while (line < endLine) {
+        if (matches.size() >= maxMatches) {
+            return line;
+        }
+        
+        if (line < m_historyLines) {
+            const qint64 next = m_searchIndex.skip(line, trigrams);
+            if (next > line) {
+                line = qMin(next, m_historyLines);
+                continue;
+            }
+        }
+        
+        // Soft-wrapped rows are joined, with one QChar per cell so string
+        // positions map straight back to rows and columns
+        text.resize(0);
+        rowStarts.resize(0);
+        qint64 next = line;
+        bool wrapped = true;
+        while (wrapped && next < lastLine) {
+            int length;
+            const TerminalCell *cells = lineCells(next, &length, &wrapped);
+            const int offset = text.size();
+            rowStarts.append(offset);
+            text.resize(offset + length);
+            for (int column = 0; column < length; ++column) {
+                const uint codepoint = cells[column].codepoint;
+                text[offset + column] = codepoint == 0 ? QChar(' ')
+                    : codepoint > 0xFFFF ? QChar(QChar::ReplacementCharacter) : QChar(codepoint);
+            }
+            ++next;
+        }
+        
+        const auto addMatch = [&](int start, int length) {
+            const int row = int(std::upper_bound(rowStarts.constBegin(), rowStarts.constEnd(), start)
+                                - rowStarts.constBegin()) - 1;
+            if (line + row >= fromLine && line + row < endLine) {
+                matches.append({line + row, start - rowStarts.at(row), length});
+            }
+        };
+        if (query.regularExpression) {
+            QRegularExpressionMatchIterator it = expression.globalMatch(text);
+            while (it.hasNext()) {
+                const QRegularExpressionMatch match = it.next();
+                if (match.capturedLength() > 0) {
+                    addMatch(int(match.capturedStart()), int(match.capturedLength()));
+                }
+            }
+        } else {
+            int start = 0;
+            while ((start = int(text.indexOf(query.pattern, start, sensitivity))) >= 0) {
+                addMatch(start, int(query.pattern.size()));
+                start += int(query.pattern.size());
+            }
+        }
+        
+        // A line still continuing past toLine may gain matches as it grows
+        if (next > endLine) {
+            resumeLine = line;
+        }
+        line = next;
+    }
+    return resumeLine;
+}
+
+const TerminalCell *TerminalScreen::lineCells(qint64 line, int *length, bool *wrapped) const
+{
+    if (line < m_historyLines) {
+        const int index = static_cast<int>(line - (m_historyLines - m_history.size()));
+        if (wrapped) {
+            *wrapped = m_history.isWrapped(index);
+        }
+        *length = m_history.lineLength(index);
+        return m_history.line(index);
+    }
+    const int row = static_cast<int>(line - m_historyLines);
+    if (wrapped) {
+        *wrapped = m_currentWrapped->at(row);
+    }
+    *length = m_columns;
+    return (*m_currentScreen)[row].constData();
+}
+
+void TerminalScreen::setMaxHistorySize(int size)
+{
+    finishReflow();
+    // Keeps the newest lines when shrinking
+    m_history.setCapacity(size);
+    m_searchIndex.dropBefore(m_historyLines - m_history.size());
+}
+
+void TerminalScreen::clearHistory()
+{
+    finishReflow();
+    // Line numbers keep counting, so selections and matches stay unambiguous
+    m_history.clear();
+    m_searchIndex.clear();
+}
+
+void TerminalScreen::setHistorySpillDirectory(const QString &directory)
+{
+    m_history.setSpillDirectory(directory);
 }
 
 bool TerminalScreen::isValidPosition(int row, int column) const
@@ -500,40 +1253,210 @@ void TerminalScreen::ensureCursorInBounds()
     setCursorPosition(m_cursorPos.row, m_cursorPos.column);
 }
 
-void TerminalScreen::addLineToHistory(const QVector<TerminalChar> &line)
+void TerminalScreen::addLineToHistory(const TerminalLine &line, bool wrapped)
 {
-    if (m_maxHistorySize <= 0) {
-        return;
-    }
-    
-    m_history.append(line);
-    
-    // Trim history if it exceeds maximum size
-    while (m_history.size() > m_maxHistorySize) {
-        m_history.removeFirst();
-    }
+    // Evicts the oldest line in place once the buffer is full
+    m_history.push(line, wrapped);
+    m_searchIndex.addLine(m_historyLines, line.constData(), line.size(), wrapped);
+    m_searchIndex.dropBefore(m_historyLines - m_history.size() + 1);
+    ++m_historyLines;
 }
 
 void TerminalScreen::setUseAlternateBuffer(bool use)
 {
     if (m_useAlternateBuffer == use) return;
+    finishReflow();
     
     m_useAlternateBuffer = use;
+    m_wrapPending = false;
     m_currentScreen = use ? &m_alternateScreen : &m_mainScreen;
+    m_currentWrapped = use ? &m_alternateWrapped : &m_mainWrapped;
     
     // Clear alternate buffer when switching to it
     if (use) {
         for (int i = 0; i < m_rows; ++i) {
             for (int j = 0; j < m_columns; ++j) {
-                m_alternateScreen[i][j] = TerminalChar();
+                m_alternateScreen[i][j] = TerminalCell();
             }
         }
+        m_alternateWrapped.fill(false);
     }
     
-    emit screenChanged(QRect(0, 0, m_columns, m_rows));
+    notifyChanged(QRect(0, 0, m_columns, m_rows));
 }
 
 void TerminalScreen::emitScreenChanged(int startRow, int endRow)
 {
-    emit screenChanged(QRect(0, startRow, m_columns, endRow - startRow + 1));
+    notifyChanged(QRect(0, startRow, m_columns, endRow - startRow + 1));
+}
+
+void TerminalScreen::notifyChanged(const QRect &region)
+{
+    const int first = qMax(0, region.top());
+    const int last = qMin(m_rows - 1, region.bottom());
+    if (first <= last) {
+        ++m_generation;
+        std::fill(m_rowGenerations.begin() + first, m_rowGenerations.begin() + last + 1, m_generation);
+    }
+    
+    if (m_batching) {
+        m_pendingRegion |= region;
+    } else {
+        emit screenChanged(region);
+    }
+}
+
+void TerminalScreen::notifyCursorMoved()
+{
+    if (m_batching) {
+        m_cursorMoved = true;
+    } else {
+        emit cursorPositionChanged(m_cursorPos);
+    }
+}
+
+void TerminalScreen::applyCommands(const TerminalCommandBuffer &commands)
+{
+    // Output lands on the settled layout
+    finishReflow();
+    
+    // Changes are collected and reported once the whole batch is applied
+    m_batching = true;
+    
+    for (const TerminalCommand &command : commands) {
+        switch (command.type) {
+        case TerminalCommand::Text:
+            insertRun(commands.text(command), command.second);
+            break;
+        case TerminalCommand::CursorUp:
+            moveCursor(-command.first, 0);
+            break;
+        case TerminalCommand::CursorDown:
+            moveCursor(command.first, 0);
+            break;
+        case TerminalCommand::CursorForward:
+            moveCursor(0, command.first);
+            break;
+        case TerminalCommand::CursorBackward:
+            moveCursor(0, -command.first);
+            break;
+        case TerminalCommand::CursorPosition:
+            setCursorPosition(command.first, command.second);
+            break;
+        case TerminalCommand::CursorNextLine:
+            setCursorPosition(m_cursorPos.row + command.first, 0);
+            break;
+        case TerminalCommand::CursorPreviousLine:
+            setCursorPosition(m_cursorPos.row - command.first, 0);
+            break;
+        case TerminalCommand::CursorHorizontalAbsolute:
+            moveCursorToColumn(command.first);
+            break;
+        case TerminalCommand::LineFeed:
+            lineFeed();
+            break;
+        case TerminalCommand::ReverseIndex:
+            reverseIndex();
+            break;
+        case TerminalCommand::SaveCursor:
+            saveCursor();
+            break;
+        case TerminalCommand::RestoreCursor:
+            restoreCursor();
+            break;
+        case TerminalCommand::HideCursor:
+            setCursorVisible(false);
+            break;
+        case TerminalCommand::ShowCursor:
+            setCursorVisible(true);
+            break;
+        case TerminalCommand::ClearScreen:
+            clear();
+            break;
+        case TerminalCommand::ClearScreenFromCursor:
+            clearFromCursor();
+            break;
+        case TerminalCommand::ClearScreenToCursor:
+            clearToCursor();
+            break;
+        case TerminalCommand::ClearLine:
+            clearLine(m_cursorPos.row);
+            break;
+        case TerminalCommand::ClearLineFromCursor:
+            clearLineFromCursor();
+            break;
+        case TerminalCommand::ClearLineToCursor:
+            clearLineToCursor();
+            break;
+        case TerminalCommand::InsertLines:
+            insertLines(m_cursorPos.row, command.first);
+            break;
+        case TerminalCommand::DeleteLines:
+            deleteLines(m_cursorPos.row, command.first);
+            break;
+        case TerminalCommand::ScrollUp:
+            scrollUp(command.first);
+            break;
+        case TerminalCommand::ScrollDown:
+            scrollDown(command.first);
+            break;
+        case TerminalCommand::SetTextAttributes:
+            ensureColorSpace();
+            setCurrentAttributes(internColor(static_cast<ColorValue>(command.first)),
+                                 internColor(static_cast<ColorValue>(command.second)),
+                                 TextAttributes(command.third));
+            break;
+        case TerminalCommand::ResetTextAttributes:
+            resetAttributes();
+            break;
+        case TerminalCommand::SetScrollingRegion:
+            setScrollingRegion(command.first, command.second);
+            break;
+        case TerminalCommand::SetTabStop:
+            setTabStop(m_cursorPos.column);
+            break;
+        case TerminalCommand::ClearTabStop:
+            clearTabStop(m_cursorPos.column);
+            break;
+        case TerminalCommand::ClearAllTabStops:
+            clearAllTabStops();
+            break;
+        case TerminalCommand::TabForward:
+            for (int i = 0; i < command.first; ++i) {
+                tabToNextStop();
+            }
+            break;
+        case TerminalCommand::TabBackward:
+            for (int i = 0; i < command.first; ++i) {
+                tabToPreviousStop();
+            }
+            break;
+        case TerminalCommand::UseAlternateScreenBuffer:
+            setUseAlternateBuffer(command.first != 0);
+            break;
+        case TerminalCommand::ClearHistory:
+            clearHistory();
+            compactTables();
+            break;
+        case TerminalCommand::FullReset:
+            compactTables();
+            break;
+        default:
+            // Character insertion/deletion/erasure is not implemented yet;
+            // modes, character sets and reports are handled elsewhere
+            break;
+        }
+    }
+    
+    m_batching = false;
+    
+    if (!m_pendingRegion.isNull()) {
+        const QRect region = m_pendingRegion;
+        m_pendingRegion = QRect();
+        emit screenChanged(region);
+    }
+    if (m_cursorMoved) {
+        m_cursorMoved = false;
+        emit cursorPositionChanged(m_cursorPos);
+    }
 }
@@ -4,7 +4,11 @@
 #include <QObject>
 #include <QVector>
 #include <QRect>
+#include <QHash>
 #include "terminalchar.h"
+#include "terminalcommand.h"
+#include "scrollbackbuffer.h"
+#include "terminalsearchindex.h"
 
 /**
  * @brief Manages the terminal screen buffer, cursor, and scrolling
@@ -19,8 +23,38 @@ public:
     // Screen dimensions
     int rows() const { return m_rows; }
     int columns() const { return m_columns; }
+    
+    /**
+     * @brief Change the screen size in place
+     *
+     * A row count change only adds or removes rows; rows leaving at the top
+     * of the main screen go to history so the cursor stays in view. A width
+     * change reflows the main screen: the screen and the newest
+     * REFLOW_HISTORY_ROWS of scrollback are taken as logical lines, joined
+     * at their soft-wrap markers, and only the rows that land on the screen
+     * are laid out for each size. Lines that fit again when the terminal
+     * widens come back from history. Rows pushed above the screen reach
+     * history in finishReflow(). The alternate screen is cut or padded, its
+     * application redraws it anyway. Older scrollback keeps the width it was
+     * written at; its wrap markers join the rows again when text is copied.
+     */
     void resize(int rows, int columns);
     
+    /**
+     * @brief Settle a reflow begun by a width change
+     *
+     * Rows laid out above the screen go to history at the current width.
+     * Called by anything that writes to the screen or history and by the
+     * worker once the size settles; returns false when none was pending.
+     * History line numbers change along with the rows.
+     */
+    bool finishReflow();
+    
+    /**
+     * @brief Whether row was soft-wrapped, i.e. its line continues below
+     */
+    bool isRowWrapped(int row) const { return m_currentWrapped->value(row); }
+    
     // Cursor operations
     CursorPosition cursorPosition() const { return m_cursorPos; }
     void setCursorPosition(int row, int column);
@@ -35,10 +69,13 @@ public:
     
     // Character operations
     TerminalChar getChar(int row, int column) const;
+    const TerminalCell *rowCells(int row) const; // Packed cells of a visible row, for rendering
+    const QVector<TerminalLine> &lines() const { return *m_currentScreen; } // Visible rows, implicitly shared
     void setChar(int row, int column, const TerminalChar &ch);
     void setChar(const TerminalChar &ch); // At current cursor position
     void insertChar(const TerminalChar &ch); // Insert and advance cursor
     void insertText(const QString &text);
+    void insertRun(const uint *codepoints, int length); // Printable run with current attributes
     
     // Line operations
     QVector<TerminalChar> getLine(int row) const;
@@ -48,6 +85,8 @@ public:
     void clearLineToCursor();
     void insertLine(int row);
     void deleteLine(int row);
+    void insertLines(int row, int count);
+    void deleteLines(int row, int count);
     
     // Screen operations
     void clear();
@@ -55,6 +94,8 @@ public:
     void clearToCursor();
     void scrollUp(int lines = 1);
     void scrollDown(int lines = 1);
+    void lineFeed();     // Move down, scrolling at the bottom margin
+    void reverseIndex(); // Move up, scrolling at the top margin
     
     // Attributes
     void setCurrentAttributes(TerminalColor fg, TerminalColor bg, TextAttributes attr);
@@ -63,6 +104,41 @@ public:
     void setCurrentTextAttributes(TextAttributes attr);
     void resetAttributes();
     
+    /**
+     * @brief Map a parsed color to the 16-bit value stored in cells
+     *
+     * RGB values get an entry in this screen's color table, so a cell never
+     * holds more than a TerminalColor.
+     */
+    TerminalColor internColor(ColorValue value);
+    QRgb trueColor(TerminalColor color) const;
+    int colorTableSize() const { return m_colorTable.size(); }
+    const QVector<QRgb> &colorTable() const { return m_colorTable; }
+    
+    /**
+     * @brief Drop styles and colors no stored cell refers to any more
+     *
+     * Styles still in use keep their ids, so cells need no rewriting; freed
+     * ids are handed out again by internStyle(). The color table is rebuilt
+     * from the remaining styles. Scans the screens and the uncompressed
+     * history lines; compressed history is not read back.
+     */
+    void compactTables();
+    
+    // Cell storage
+    quint32 internStyle(const TerminalStyle &style);
+    const TerminalStyle &style(quint32 id) const;
+    int styleTableSize() const { return m_styles.size(); }
+    const QVector<TerminalStyle> &styles() const { return m_styles; }
+    TerminalChar expandCell(const TerminalCell &cell) const;
+    
+    /**
+     * @brief Approximate heap bytes used by screen buffers, history and tables
+     *
+     * Logged by TerminalWorker when QTISSH_MEMORY_STATS is set.
+     */
+    qint64 memoryFootprint() const;
+    
     // Scrolling region
     void setScrollingRegion(int top, int bottom);
     void resetScrollingRegion();
@@ -83,7 +159,62 @@ public:
     // History/scrollback
     int historySize() const { return m_history.size(); }
     QVector<TerminalChar> getHistoryLine(int index) const;
+    TerminalLine historyRow(int index) const; // Packed cells, padded or cut to the screen width
+    
+    /**
+     * @brief Line numbers shared by scrollback and screen
+     *
+     * Every line pushed to history keeps its number for as long as it is
+     * stored: screen row r is line firstLineNumber() + r and history index i
+     * is line firstLineNumber() - historySize() + i. Output only makes them
+     * grow, so they stay valid while it scrolls lines into history; a width
+     * change renumbers the lines it rewraps.
+     */
+    qint64 firstLineNumber() const { return m_historyLines; }
+    
+    /**
+     * @brief Text between two positions, straight from row storage
+     *
+     * Covers startColumn on startLine up to (not including) endColumn on
+     * endLine. Lines no longer stored are skipped; trailing blanks of lines
+     * taken up to their end are dropped.
+     */
+    QString text(qint64 startLine, int startColumn, qint64 endLine, int endColumn) const;
+    
+    /**
+     * @brief Append matches of query starting on lines [fromLine, toLine)
+     *
+     * Soft-wrapped rows are searched as one line, so a match may run past
+     * the end of its row. Scrollback blocks the search index rules out are
+     * skipped. Returns the line to go on from: toLine, the start of a line
+     * wrapping past toLine, or the first line not searched when matches
+     * reached maxMatches.
+     */
+    qint64 find(const TerminalSearchQuery &query, qint64 fromLine, qint64 toLine,
+                QVector<TerminalSearchMatch> &matches, int maxMatches) const;
     void setMaxHistorySize(int size);
+    void clearHistory();
+    void setHistorySpillDirectory(const QString &directory);
+    QString historySpillDirectory() const { return m_history.spillDirectory(); }
+    
+    /**
+     * @brief Damage tracking
+     *
+     * Every change stamps the affected rows with a new generation. A view
+     * remembers the generation it last repainted and only redraws rows whose
+     * stamp is newer.
+     */
+    quint64 generation() const { return m_generation; }
+    quint64 rowGeneration(int row) const { return m_rowGenerations.value(row); }
+    const QVector<quint64> &rowGenerations() const { return m_rowGenerations; }
+    
+    /**
+     * @brief Apply a batch of parsed operations in one pass
+     *
+     * screenChanged and cursorPositionChanged are emitted once at the end
+     * instead of once per operation.
+     */
+    void applyCommands(const TerminalCommandBuffer &commands);
     
     // Utility
     bool isValidPosition(int row, int column) const;
@@ -99,30 +230,73 @@ private:
     void initializeScreen();
     void scrollUpInRegion(int lines);
     void scrollDownInRegion(int lines);
-    void addLineToHistory(const QVector<TerminalChar> &line);
+    void rotateRows(int first, int middle, int last);
+    void blankRow(int row);
+    void wrapCursor(); // Soft-wrap onto the next row, scrolling at the bottom
+    void addLineToHistory(const TerminalLine &line, bool wrapped);
+    void beginReflow();
+    void layoutReflow(int rows, int columns);
+    int reflowRows(int line, int columns) const;
+    void copyReflowRow(int line, int row, int columns, TerminalLine &target) const;
+    int resizeRows(QVector<TerminalLine> &screen, QVector<bool> &wrapped, int rows, int keepRow, bool toHistory);
+    int lastUsedRow(const QVector<TerminalLine> &screen, const QVector<bool> &wrapped) const;
+    QVector<TerminalChar> expandLine(const TerminalLine &line) const;
+    QVector<TerminalChar> expandLine(const TerminalCell *cells, int length) const;
+    const TerminalCell *lineCells(qint64 line, int *length, bool *wrapped = nullptr) const;
+    TerminalCell packChar(const TerminalChar &ch);
+    void updateCurrentStyle();
+    void ensureColorSpace();
     void emitScreenChanged(int startRow, int endRow);
+    void notifyChanged(const QRect &region);
+    void notifyCursorMoved();
     
     // Screen buffers
-    QVector<QVector<TerminalChar>> m_mainScreen;
-    QVector<QVector<TerminalChar>> m_alternateScreen;
-    QVector<QVector<TerminalChar>> *m_currentScreen; // Pointer to either m_mainScreen or m_alternateScreen
-    QVector<QVector<TerminalChar>> m_history;
+    QVector<TerminalLine> m_mainScreen;
+    QVector<TerminalLine> m_alternateScreen;
+    QVector<TerminalLine> *m_currentScreen; // Pointer to either m_mainScreen or m_alternateScreen
+    
+    // Soft-wrap markers per row, rotated along with the rows
+    QVector<bool> m_mainWrapped;
+    QVector<bool> m_alternateWrapped;
+    QVector<bool> *m_currentWrapped;
+    
+    // Width change in progress: main screen and newest history as logical
+    // lines, laid out again for every size until finishReflow()
+    QVector<TerminalLine> m_reflowLines;
+    bool m_reflowing;
+    int m_reflowScreenLine;   // First logical line that was on the screen
+    int m_reflowUsedRows;     // Screen rows the content took when it began
+    int m_reflowCursorLine;   // Logical line and cell offset of the cursor, -1 for none
+    int m_reflowCursorOffset;
+    int m_reflowSavedLine;    // Same for the saved cursor
+    int m_reflowSavedOffset;
+    int m_reflowTop;          // First laid out row shown on the screen
+    
+    ScrollbackBuffer m_history;
+    qint64 m_historyLines;  // Lines ever added to history
+    TerminalSearchIndex m_searchIndex;
     bool m_useAlternateBuffer;
     
     // Dimensions
     int m_rows;
     int m_columns;
-    int m_maxHistorySize;
     
     // Cursor state
     CursorPosition m_cursorPos;
     CursorPosition m_savedCursorPos;
     bool m_cursorVisible;
+    bool m_wrapPending;  // Last column written; the next character wraps first
     
     // Current text attributes
     TerminalColor m_currentForeground;
     TerminalColor m_currentBackground;
     TextAttributes m_currentAttributes;
+    quint32 m_currentStyle;
+    
+    // Interned cell styles; id 0 is the default style
+    QVector<TerminalStyle> m_styles;
+    QHash<quint64, quint32> m_styleIndex;
+    QVector<quint32> m_freeStyles;  // Ids released by compactTables()
     
     // Scrolling region
     int m_scrollTop;
@@ -131,8 +305,35 @@ private:
     // Tab stops
     QVector<bool> m_tabStops;
     
+    // RGB colors referenced by cells, indexed from TerminalColor::TrueColorBase
+    QVector<QRgb> m_colorTable;
+    QHash<QRgb, quint16> m_colorIndex;
+    int m_colorRetryCountdown;  // Full-table SGRs left before compacting again
+    
+    // Batched update state
+    bool m_batching;
+    bool m_cursorMoved;
+    QRect m_pendingRegion;
+    
+    // Per-row change stamps for damage tracking
+    QVector<quint64> m_rowGenerations;
+    quint64 m_generation;
+    
     // Default tab stop interval
     static const int DEFAULT_TAB_SIZE = 8;
+    
+    // Indices left in quint16 above TerminalColor::TrueColorBase
+    static const int MAX_TRUE_COLORS = 65536 - 257;
+    
+    // Newest scrollback rows rewrapped along with the screen
+    static const int REFLOW_HISTORY_ROWS = 1000;
+    
+    // When compaction frees nothing, the SGRs to wait before scanning again
+    static const int COMPACTION_RETRY = 4096;
+    
+    // Rough allocation overhead used by memoryFootprint()
+    static const int LINE_OVERHEAD = 32;        // QVector header per line
+    static const int HASH_NODE_OVERHEAD = 16;   // QHash node bookkeeping
 };
 
 #endif // TERMINALSCREEN_H
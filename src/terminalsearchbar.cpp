@@ -0,0 +1,123 @@
+#include "terminalsearchbar.h"
+#include <QHBoxLayout>
+#include <QLineEdit>
+#include <QLabel>
+#include <QToolButton>
+#include <QKeyEvent>
+
+TerminalSearchBar::TerminalSearchBar(QWidget *parent)
+    : QFrame(parent)
+{
+    setFrameShape(QFrame::StyledPanel);
+    setAutoFillBackground(true);
+    setupUI();
+}
+
+void TerminalSearchBar::setupUI()
+{
+    auto *layout = new QHBoxLayout(this);
+    layout->setContentsMargins(4, 2, 4, 2);
+    layout->setSpacing(2);
+
+    m_patternEdit = new QLineEdit(this);
+    m_patternEdit->setPlaceholderText(tr("Find"));
+    m_patternEdit->setClearButtonEnabled(true);
+    m_patternEdit->setMinimumWidth(180);
+    connect(m_patternEdit, &QLineEdit::textChanged, this, &TerminalSearchBar::queryChanged);
+
+    m_caseButton = new QToolButton(this);
+    m_caseButton->setText("Aa");
+    m_caseButton->setCheckable(true);
+    m_caseButton->setToolTip(tr("Match case"));
+    connect(m_caseButton, &QToolButton::toggled, this, &TerminalSearchBar::queryChanged);
+
+    m_regexButton = new QToolButton(this);
+    m_regexButton->setText(".*");
+    m_regexButton->setCheckable(true);
+    m_regexButton->setToolTip(tr("Regular expression"));
+    connect(m_regexButton, &QToolButton::toggled, this, &TerminalSearchBar::queryChanged);
+
+    m_countLabel = new QLabel(this);
+    m_countLabel->setMinimumWidth(70);
+    m_countLabel->setAlignment(Qt::AlignCenter);
+
+    m_previousButton = new QToolButton(this);
+    m_previousButton->setArrowType(Qt::UpArrow);
+    m_previousButton->setToolTip(tr("Previous match (Shift+Enter)"));
+    connect(m_previousButton, &QToolButton::clicked, this, &TerminalSearchBar::previousRequested);
+
+    m_nextButton = new QToolButton(this);
+    m_nextButton->setArrowType(Qt::DownArrow);
+    m_nextButton->setToolTip(tr("Next match (Enter)"));
+    connect(m_nextButton, &QToolButton::clicked, this, &TerminalSearchBar::nextRequested);
+
+    m_closeButton = new QToolButton(this);
+    m_closeButton->setText(QString(QChar(0x2715)));
+    m_closeButton->setToolTip(tr("Close (Esc)"));
+    m_closeButton->setAutoRaise(true);
+    connect(m_closeButton, &QToolButton::clicked, this, [this]() {
+        hide();
+        emit closed();
+    });
+
+    layout->addWidget(m_patternEdit);
+    layout->addWidget(m_caseButton);
+    layout->addWidget(m_regexButton);
+    layout->addWidget(m_countLabel);
+    layout->addWidget(m_previousButton);
+    layout->addWidget(m_nextButton);
+    layout->addWidget(m_closeButton);
+}
+
+QString TerminalSearchBar::pattern() const
+{
+    return m_patternEdit->text();
+}
+
+bool TerminalSearchBar::isRegularExpression() const
+{
+    return m_regexButton->isChecked();
+}
+
+bool TerminalSearchBar::isCaseSensitive() const
+{
+    return m_caseButton->isChecked();
+}
+
+void TerminalSearchBar::setMatchCount(int current, int total, bool truncated)
+{
+    if (m_patternEdit->text().isEmpty()) {
+        m_countLabel->clear();
+    } else if (total == 0) {
+        m_countLabel->setText(tr("No matches"));
+    } else {
+        m_countLabel->setText(tr("%1 of %2%3").arg(current).arg(total).arg(truncated ? "+" : ""));
+    }
+}
+
+void TerminalSearchBar::activate()
+{
+    show();
+    raise();
+    m_patternEdit->setFocus(Qt::ShortcutFocusReason);
+    m_patternEdit->selectAll();
+}
+
+void TerminalSearchBar::keyPressEvent(QKeyEvent *event)
+{
+    switch (event->key()) {
+    case Qt::Key_Return:
+    case Qt::Key_Enter:
+        if (event->modifiers() & Qt::ShiftModifier) {
+            emit previousRequested();
+        } else {
+            emit nextRequested();
+        }
+        return;
+    case Qt::Key_Escape:
+        hide();
+        emit closed();
+        return;
+    }
+    QFrame::keyPressEvent(event);
+}
@@ -0,0 +1,55 @@
+#ifndef TERMINALSEARCHBAR_H
+#define TERMINALSEARCHBAR_H
+
+#include <QFrame>
+
+class QLineEdit;
+class QLabel;
+class QToolButton;
+
+/**
+ * @brief Find box shown over the top right corner of a terminal
+ *
+ * Only collects the query and reports navigation; the terminal runs the
+ * search and reports the count back through setMatchCount.
+ */
+class TerminalSearchBar : public QFrame
+{
+    Q_OBJECT
+
+public:
+    explicit TerminalSearchBar(QWidget *parent = nullptr);
+
+    QString pattern() const;
+    bool isRegularExpression() const;
+    bool isCaseSensitive() const;
+
+    /**
+     * @brief Show "current of total"; current is 0 when nothing is selected
+     */
+    void setMatchCount(int current, int total, bool truncated = false);
+
+    void activate();
+
+signals:
+    void queryChanged();
+    void nextRequested();
+    void previousRequested();
+    void closed();
+
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+
+private:
+    void setupUI();
+
+    QLineEdit *m_patternEdit;
+    QToolButton *m_caseButton;
+    QToolButton *m_regexButton;
+    QToolButton *m_previousButton;
+    QToolButton *m_nextButton;
+    QToolButton *m_closeButton;
+    QLabel *m_countLabel;
+};
+
+#endif // TERMINALSEARCHBAR_H
@@ -0,0 +1,329 @@
+#include "terminalsearchindex.h"
+#include <QChar>
+#include <algorithm>
+
+TerminalSearchIndex::TerminalSearchIndex()
+    : m_carryLine(-1)
+{
+    m_carry[0] = 0;
+    m_carry[1] = 0;
+}
+
+quint32 TerminalSearchIndex::hash(uint a, uint b, uint c)
+{
+    // FNV-1a over the three folded code points
+    quint32 h = 2166136261u;
+    for (uint codepoint : {a, b, c}) {
+        h = (h ^ codepoint) * 16777619u;
+    }
+    return h;
+}
+
+bool TerminalSearchIndex::testBit(const Block &block, quint32 hash)
+{
+    // Filter sizes are powers of two
+    const quint32 bit = hash & quint32(block.bits.size() * 64 - 1);
+    return block.bits.at(int(bit / 64)) & (quint64(1) << (bit % 64));
+}
+
+void TerminalSearchIndex::setBit(Block &block, quint32 hash)
+{
+    const quint32 bit = hash & quint32(block.bits.size() * 64 - 1);
+    block.bits[int(bit / 64)] |= quint64(1) << (bit % 64);
+}
+
+int TerminalSearchIndex::blockIndex(qint64 line) const
+{
+    if (m_blocks.isEmpty() || line < m_blocks.first().firstLine) {
+        return -1;
+    }
+    // Blocks are contiguous, so the position follows from the line number
+    const qint64 index = (line - m_blocks.first().firstLine) / BLOCK_LINES;
+    return index < m_blocks.size() ? int(index) : -1;
+}
+
+void TerminalSearchIndex::seal(Block &block)
+{
+    std::sort(m_open.begin(), m_open.end());
+    const int distinct = int(std::unique(m_open.begin(), m_open.end()) - m_open.begin());
+
+    // Mostly repeated or blank output gets a small filter
+    int bits = MIN_FILTER_BITS;
+    while (bits < distinct * BITS_PER_TRIGRAM && bits < MAX_FILTER_BITS) {
+        bits *= 2;
+    }
+    block.bits = QVector<quint64>(bits / 64, 0);
+    for (int i = 0; i < distinct; ++i) {
+        setBit(block, m_open.at(i));
+    }
+    m_open.clear();
+}
+
+void TerminalSearchIndex::addLine(qint64 line, const TerminalCell *cells, int length, bool wrapped)
+{
+    const qint64 firstLine = line - line % BLOCK_LINES;
+    if (m_blocks.isEmpty() || m_blocks.last().firstLine < firstLine) {
+        if (!m_blocks.isEmpty()) {
+            seal(m_blocks.last());
+        }
+        m_blocks.append({firstLine, QVector<quint64>(), false});
+    }
+    // A line taken back may belong to an earlier block
+    const int index = blockIndex(line);
+    if (index < 0) {
+        return;
+    }
+    Block &block = m_blocks[index];
+    if (line % BLOCK_LINES == BLOCK_LINES - 1) {
+        block.continues = wrapped;
+    }
+
+    // Trailing blanks add nothing a search could ask for, unless the line goes on
+    if (!wrapped) {
+        while (length > 0 && (cells[length - 1].codepoint == ' ' || cells[length - 1].codepoint == 0)) {
+            --length;
+        }
+    }
+
+    // The end of a wrapped line starts the first trigrams of this one
+    const bool carried = m_carryLine == line - 1;
+    uint a = carried ? m_carry[0] : 0;
+    uint b = carried ? m_carry[1] : 0;
+    const int seen = carried ? 2 : 0;
+    for (int i = 0; i < length; ++i) {
+        const uint c = QChar::toCaseFolded(cells[i].codepoint ? cells[i].codepoint : uint(' '));
+        if (seen + i >= 2) {
+            const quint32 h = hash(a, b, c);
+            if (block.bits.isEmpty()) {
+                m_open.append(h);
+            } else {
+                setBit(block, h);
+            }
+        }
+        a = b;
+        b = c;
+    }
+    m_carry[0] = a;
+    m_carry[1] = b;
+    m_carryLine = wrapped && seen + length >= 2 ? line : -1;
+}
+
+void TerminalSearchIndex::dropBefore(qint64 line)
+{
+    while (!m_blocks.isEmpty() && m_blocks.first().firstLine + BLOCK_LINES <= line) {
+        m_blocks.removeFirst();
+    }
+    if (m_blocks.isEmpty()) {
+        m_open.clear();
+    }
+}
+
+void TerminalSearchIndex::clear()
+{
+    m_blocks.clear();
+    m_open = QVector<quint32>();
+    m_carryLine = -1;
+}
+
+QString TerminalSearchIndex::requiredLiteral(const QString &pattern)
+{
+    // One pass: a run of plain characters ends at anything else, and a
+    // quantifier that allows zero takes back the character before it
+    QString best;
+    QString run;
+    const auto endRun = [&]() {
+        if (run.size() > best.size()) {
+            best = run;
+        }
+        run.clear();
+    };
+    const auto skipTo = [&](int i, QChar close) {
+        while (i < pattern.size() && pattern.at(i) != close) {
+            ++i;
+        }
+        return i;
+    };
+    // Index of the ']' closing the class opened at i; a leading one is a member
+    const auto skipClass = [&](int i) {
+        ++i;
+        if (i < pattern.size() && pattern.at(i) == QLatin1Char('^')) {
+            ++i;
+        }
+        if (i < pattern.size() && pattern.at(i) == QLatin1Char(']')) {
+            ++i;
+        }
+        while (i < pattern.size() && pattern.at(i) != QLatin1Char(']')) {
+            i += pattern.at(i) == QLatin1Char('\\') ? 2 : 1;
+        }
+        return i;
+    };
+    const auto isHexDigit = [](QChar ch) {
+        const char latin = ch.toLatin1();
+        return (latin >= '0' && latin <= '9') || (latin >= 'a' && latin <= 'f') || (latin >= 'A' && latin <= 'F');
+    };
+
+    const int size = pattern.size();
+    for (int i = 0; i < size; ++i) {
+        const QChar c = pattern.at(i);
+        switch (c.unicode()) {
+        case '|':
+            // Either side may match alone
+            return QString();
+        case '(': {
+            endRun();
+            // Extended mode makes whitespace in the pattern meaningless
+            if (i + 1 < size && pattern.at(i + 1) == QLatin1Char('?')) {
+                for (int j = i + 2; j < size && pattern.at(j).isLetter(); ++j) {
+                    if (pattern.at(j) == QLatin1Char('x')) {
+                        return QString();
+                    }
+                }
+            }
+            // Groups are skipped whole; they may be optional or hold alternatives
+            int depth = 1;
+            while (++i < size && depth > 0) {
+                if (pattern.at(i) == QLatin1Char('\\')) {
+                    ++i;
+                } else if (pattern.at(i) == QLatin1Char('[')) {
+                    i = skipClass(i);
+                } else if (pattern.at(i) == QLatin1Char('(')) {
+                    ++depth;
+                } else if (pattern.at(i) == QLatin1Char(')')) {
+                    --depth;
+                }
+            }
+            --i;
+            break;
+        }
+        case '[':
+            endRun();
+            i = skipClass(i);
+            break;
+        case '?':
+        case '*':
+        case '{':
+            if (!run.isEmpty()) {
+                run.chop(1);
+            }
+            endRun();
+            if (c == QLatin1Char('{')) {
+                i = skipTo(i, QLatin1Char('}'));
+            }
+            break;
+        case '+':
+        case '.':
+        case '^':
+        case '$':
+            endRun();
+            break;
+        case '\\': {
+            if (i + 1 >= size) {
+                break;
+            }
+            const QChar escaped = pattern.at(++i);
+            if (!escaped.isLetterOrNumber()) {
+                run.append(escaped);
+                break;
+            }
+            endRun();
+            switch (escaped.unicode()) {
+            case 'Q':
+                // Quoted up to \E
+                for (++i; i < size; ++i) {
+                    if (pattern.at(i) == QLatin1Char('\\') && i + 1 < size && pattern.at(i + 1) == QLatin1Char('E')) {
+                        ++i;
+                        break;
+                    }
+                    run.append(pattern.at(i));
+                }
+                break;
+            case 'x':
+            case 'o':
+            case 'p':
+            case 'P':
+            case 'N':
+            case 'g':
+            case 'k':
+                // Braced or named arguments, else the short forms below
+                if (i + 1 < size && (pattern.at(i + 1) == QLatin1Char('{') || pattern.at(i + 1) == QLatin1Char('<'))) {
+                    i = skipTo(i + 1, pattern.at(i + 1) == QLatin1Char('{') ? QLatin1Char('}') : QLatin1Char('>'));
+                } else if (escaped == QLatin1Char('x')) {
+                    for (int digits = 0; digits < 2 && i + 1 < size && isHexDigit(pattern.at(i + 1)); ++digits) {
+                        ++i;
+                    }
+                } else if (escaped != QLatin1Char('o')) {
+                    ++i;
+                }
+                break;
+            case 'c':
+                ++i;
+                break;
+            default:
+                // Octal and back references take up to two more digits
+                if (escaped.isDigit()) {
+                    for (int digits = 0; digits < 2 && i + 1 < size && pattern.at(i + 1).isDigit(); ++digits) {
+                        ++i;
+                    }
+                }
+                break;
+            }
+            break;
+        }
+        default:
+            run.append(c);
+            break;
+        }
+    }
+    endRun();
+    return best;
+}
+
+QVector<quint32> TerminalSearchIndex::trigrams(const TerminalSearchQuery &query)
+{
+    const QString literal = query.regularExpression ? requiredLiteral(query.pattern) : query.pattern;
+    const QVector<uint> codepoints = literal.toUcs4();
+    QVector<quint32> result;
+    for (int i = 2; i < codepoints.size(); ++i) {
+        result.append(hash(QChar::toCaseFolded(codepoints.at(i - 2)),
+                           QChar::toCaseFolded(codepoints.at(i - 1)),
+                           QChar::toCaseFolded(codepoints.at(i))));
+    }
+    return result;
+}
+
+qint64 TerminalSearchIndex::skip(qint64 line, const QVector<quint32> &trigrams) const
+{
+    const int first = blockIndex(line);
+    if (trigrams.isEmpty() || first < 0) {
+        return line;
+    }
+
+    // A match on a line wrapped across blocks can have its trigrams in
+    // either filter, so such blocks are ruled out only together
+    int last = first;
+    while (last + 1 < m_blocks.size() && m_blocks.at(last).continues) {
+        ++last;
+    }
+    if (m_blocks.at(last).bits.isEmpty()) {
+        return line;
+    }
+    for (quint32 h : trigrams) {
+        bool found = false;
+        for (int index = first; index <= last && !found; ++index) {
+            found = testBit(m_blocks.at(index), h);
+        }
+        if (!found) {
+            return m_blocks.at(last).firstLine + BLOCK_LINES;
+        }
+    }
+    return line;
+}
+
+qint64 TerminalSearchIndex::memoryFootprint() const
+{
+    qint64 bytes = m_open.capacity() * qint64(sizeof(quint32));
+    for (const Block &block : m_blocks) {
+        bytes += sizeof(Block) + block.bits.capacity() * qint64(sizeof(quint64));
+    }
+    return bytes;
+}
@@ -0,0 +1,123 @@
+#ifndef TERMINALSEARCHINDEX_H
+#define TERMINALSEARCHINDEX_H
+
+#include <QList>
+#include <QMetaType>
+#include <QString>
+#include <QVector>
+#include "terminalchar.h"
+
+/**
+ * @brief What to look for in the terminal
+ */
+struct TerminalSearchQuery {
+    QString pattern;
+    bool regularExpression = false;
+    bool caseSensitive = false;
+
+    bool operator==(const TerminalSearchQuery &other) const
+    {
+        return pattern == other.pattern && regularExpression == other.regularExpression
+            && caseSensitive == other.caseSensitive;
+    }
+    bool operator!=(const TerminalSearchQuery &other) const { return !(*this == other); }
+};
+
+/**
+ * @brief One hit, in TerminalScreen line numbers and cell columns
+ *
+ * A hit on a soft-wrapped line can be longer than the rest of its row and
+ * go on at the start of the rows below.
+ */
+struct TerminalSearchMatch {
+    qint64 line = 0;
+    int column = 0;
+    int length = 0;
+};
+
+Q_DECLARE_TYPEINFO(TerminalSearchMatch, Q_PRIMITIVE_TYPE);
+Q_DECLARE_METATYPE(TerminalSearchMatch)
+Q_DECLARE_METATYPE(QVector<TerminalSearchMatch>)
+
+/**
+ * @brief Trigram summaries of scrollback blocks
+ *
+ * Lines are summarized as they enter history: the case-folded trigrams of
+ * the lines of a block of BLOCK_LINES lines are collected, and once the
+ * block is complete they are folded into a Bloom filter sized to how many
+ * distinct trigrams the block has. Trigrams spanning a soft wrap count as
+ * well. A search then only reads blocks whose filter has all trigrams of a
+ * string every match must contain; the others are skipped without touching
+ * (or decompressing) their lines.
+ */
+class TerminalSearchIndex
+{
+public:
+    TerminalSearchIndex();
+
+    /**
+     * @brief Summarize the line numbered line
+     *
+     * wrapped marks a line that continues on the next one. Lines arrive in
+     * order. A line added again after a reflow took it back from history
+     * adds its trigrams to its block's summary; stale bits only cost a
+     * block read.
+     */
+    void addLine(qint64 line, const TerminalCell *cells, int length, bool wrapped);
+
+    /**
+     * @brief Forget blocks that only hold lines before line
+     */
+    void dropBefore(qint64 line);
+
+    void clear();
+
+    /**
+     * @brief Trigram hashes a search for query requires
+     *
+     * A literal pattern requires all of its own. A regular expression
+     * requires those of its longest run of plain characters outside groups,
+     * classes and optional parts, and nothing when it has a top-level
+     * alternative. Empty when fewer than three characters are required,
+     * which every block may contain.
+     */
+    static QVector<quint32> trigrams(const TerminalSearchQuery &query);
+
+    /**
+     * @brief First line at or after line that may hold a match
+     *
+     * Skips the blocks whose filters lack one of trigrams, along with the
+     * blocks their wrapped last lines continue into. Returns line itself
+     * when its block may match or is not summarized yet.
+     */
+    qint64 skip(qint64 line, const QVector<quint32> &trigrams) const;
+
+    qint64 memoryFootprint() const;
+
+    static constexpr int BLOCK_LINES = 128;
+
+private:
+    struct Block {
+        qint64 firstLine;
+        QVector<quint64> bits;  // Empty until the block is complete
+        bool continues;         // Its last line is wrapped
+    };
+
+    static quint32 hash(uint a, uint b, uint c);
+    static QString requiredLiteral(const QString &pattern);
+    static bool testBit(const Block &block, quint32 hash);
+    static void setBit(Block &block, quint32 hash);
+    int blockIndex(qint64 line) const;
+    void seal(Block &block);
+
+    QList<Block> m_blocks;      // Oldest first, BLOCK_LINES aligned
+    QVector<quint32> m_open;    // Trigrams of the last block while it fills
+    uint m_carry[2];            // Last two code points of a wrapped line
+    qint64 m_carryLine;         // The line they belong to, -1 for none
+
+    static constexpr int BITS_PER_TRIGRAM = 8;   // About 12% false positives per trigram
+    static constexpr int MIN_FILTER_BITS = 64;
+    static constexpr int MAX_FILTER_BITS = 16384;
+};
+
+#endif // TERMINALSEARCHINDEX_H
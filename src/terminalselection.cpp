@@ -0,0 +1,42 @@
+#include "terminalselection.h"
+#include <climits>
+
+TerminalSelection::TerminalSelection()
+{
+}
+
+void TerminalSelection::clear()
+{
+    m_active = m_anchor;
+}
+
+void TerminalSelection::start(const Point &point)
+{
+    m_anchor = point;
+    m_active = point;
+}
+
+void TerminalSelection::extend(const Point &point)
+{
+    m_active = point;
+}
+
+bool TerminalSelection::span(qint64 line, int &first, int &last) const
+{
+    const Point from = begin();
+    const Point to = end();
+    if (isEmpty() || line < from.line || line > to.line) {
+        return false;
+    }
+
+    first = line == from.line ? from.column : 0;
+    last = line == to.line ? to.column : INT_MAX;
+    return first < last;
+}
+
+bool TerminalSelection::contains(qint64 line, int column) const
+{
+    int first;
+    int last;
+    return span(line, first, last) && column >= first && column < last;
+}
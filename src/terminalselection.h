@@ -0,0 +1,65 @@
+#ifndef TERMINALSELECTION_H
+#define TERMINALSELECTION_H
+
+#include <QtGlobal>
+
+/**
+ * @brief Selected text range in terminal line numbers
+ *
+ * Positions are cell boundaries: column c lies before cell c of its line,
+ * and lines are numbered as in TerminalScreen::firstLineNumber(), so a
+ * selection can reach into scrollback and survives output scrolling it up.
+ * Each line's part of the selection is one span computed from the two end
+ * points, which makes hit tests O(1) and lets a drag repaint only the lines
+ * between the old and the new end.
+ */
+class TerminalSelection
+{
+public:
+    struct Point {
+        qint64 line;
+        int column;
+
+        Point(qint64 l = 0, int c = 0) : line(l), column(c) {}
+        bool operator<(const Point &other) const
+        {
+            return line < other.line || (line == other.line && column < other.column);
+        }
+        bool operator==(const Point &other) const { return line == other.line && column == other.column; }
+        bool operator!=(const Point &other) const { return !(*this == other); }
+    };
+
+    TerminalSelection();
+
+    bool isEmpty() const { return m_anchor == m_active; }
+    void clear();
+
+    /**
+     * @brief Start a new selection at point; it stays empty until extended
+     */
+    void start(const Point &point);
+
+    /**
+     * @brief Move the free end to point, keeping the anchor
+     */
+    void extend(const Point &point);
+
+    Point anchor() const { return m_anchor; }
+    Point active() const { return m_active; }
+    Point begin() const { return m_active < m_anchor ? m_active : m_anchor; }
+    Point end() const { return m_active < m_anchor ? m_anchor : m_active; }
+
+    /**
+     * @brief Selected cells [first, last) of line; false if none
+     *
+     * last is INT_MAX for lines selected through to their end.
+     */
+    bool span(qint64 line, int &first, int &last) const;
+    bool contains(qint64 line, int column) const;
+
+private:
+    Point m_anchor;
+    Point m_active;
+};
+
+#endif // TERMINALSELECTION_H
@@ -5,7 +5,6 @@
 #include <QList>
 #include <QVBoxLayout>
 #include <QDateTime>
-#include <QProcess>
 #include "serverconfig.h"
 #include "vt100terminal.h"
 #include "servermonitoringbar.h"
@@ -43,25 +42,20 @@ public:
                        VT100Terminal::CursorStyle style,
                        const QColor &foreground,
                        const QColor &background);
+    void setParserEngine(ParserEngine engine);
+    void setScrollback(int lines, bool onDisk);
+    void setRenderer(TerminalRenderer renderer);
 
 signals:
     void activeTerminalChanged(SSHTerminal *terminal);
     void allClosed();
 
 private slots:
-    void fetchMetrics();
-    void onMetricsProcessFinished(int exitCode, int exitStatus);
-    void onMetricsProcessError(int error);
-    void onMetricsReadyRead();
     void onTerminalConnectionChanged(bool connected);
 
 private:
     SSHTerminal *createTerminal();
     void setActive(SSHTerminal *terminal);
-    void startMetricsProcess();
-    void setupMetricsAskPass();
-    void cleanupMetricsAskPass();
-    ServerMetrics parseMetricsOutput(const QString &output);
     
     QSplitter *m_splitter;
     QVBoxLayout *m_mainLayout;
@@ -69,9 +63,6 @@ private:
     SSHTerminal *m_activeTerminal;
     ServerConfig m_config;
     ServerMonitoringBar *m_monitoringBar;
-    QProcess *m_metricsProcess;
-    QString m_metricsOutputBuffer;
-    QString m_metricsAskPassPath;
 };
 
 #endif // TERMINALSPLITWIDGET_H
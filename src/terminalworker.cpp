@@ -0,0 +1,300 @@
+#include "terminalworker.h"
+#include <QMutexLocker>
+#include <QDebug>
+
+const TerminalCell *TerminalSnapshot::rowCells(int row) const
+{
+    if (row < 0) {
+        const qint64 index = firstLine + row - historyFirstLine;
+        return index >= 0 && index < history.size() ? history.at(int(index)).constData() : nullptr;
+    }
+    if (row >= lines.size()) {
+        return nullptr;
+    }
+    return lines.at(row).constData();
+}
+
+const TerminalStyle &TerminalSnapshot::style(quint32 id) const
+{
+    return id < static_cast<quint32>(styles.size()) ? styles.at(id) : styles.first();
+}
+
+QRgb TerminalSnapshot::trueColor(TerminalColor color) const
+{
+    const int index = static_cast<int>(color) - static_cast<int>(TerminalColor::TrueColorBase);
+    if (index < 0 || index >= colorTable.size()) {
+        return TerminalColorPalette::getDefaultForeground().rgb();
+    }
+    return colorTable.at(index);
+}
+
+TerminalWorker::TerminalWorker(int rows, int columns, QObject *parent)
+    : QObject(parent)
+    , m_screen(new TerminalScreen(rows, columns, this))
+    , m_parser(new VT100Parser(this))
+    , m_snapshotPending(false)
+    , m_viewOffset(0)
+    , m_pendingRows(0)
+    , m_pendingColumns(0)
+    , m_searchedUntil(0)
+    , m_queuedBytes(0)
+    , m_memoryStats(qEnvironmentVariableIsSet("QTISSH_MEMORY_STATS"))
+{
+    // Parsed operations are recorded in m_commands and applied per read
+    m_parser->setCommandBuffer(&m_commands);
+
+    publishSnapshot();
+}
+
+TerminalSnapshot TerminalWorker::takeSnapshot()
+{
+    QMutexLocker locker(&m_snapshotMutex);
+    m_snapshotPending = false;
+
+    // Drop our references so the next write does not have to detach rows
+    TerminalSnapshot snapshot = m_snapshot;
+    m_snapshot = TerminalSnapshot();
+    return snapshot;
+}
+
+void TerminalWorker::queueData(const QByteArray &data)
+{
+    m_queuedBytes += data.size();
+    QMetaObject::invokeMethod(this, "processData", Qt::QueuedConnection, Q_ARG(QByteArray, data));
+}
+
+void TerminalWorker::processData(const QByteArray &data)
+{
+    applyResize();
+    finishReflow();
+    m_parser->processData(data);
+    applyCommands();
+
+    // Signalled on every crossing, so a feeder that paused above HIGH_WATER
+    // always hears about it, however its check and this one interleave
+    const qint64 before = m_queuedBytes.fetch_sub(data.size());
+    if (before > LOW_WATER && before - data.size() <= LOW_WATER) {
+        emit backlogDrained();
+    }
+}
+
+void TerminalWorker::processText(const QString &text)
+{
+    applyResize();
+    finishReflow();
+    m_parser->processData(text);
+    applyCommands();
+}
+
+void TerminalWorker::resize(int rows, int columns)
+{
+    // Later sizes queued behind this one replace it before it is applied
+    if (m_pendingRows == 0) {
+        QMetaObject::invokeMethod(this, "applyResize", Qt::QueuedConnection);
+    }
+    m_pendingRows = rows;
+    m_pendingColumns = columns;
+}
+
+void TerminalWorker::applyResize()
+{
+    if (m_pendingRows == 0) {
+        return;
+    }
+    // A width change renumbers the history lines it rewraps
+    if (m_pendingColumns != m_screen->columns()) {
+        m_historyMatches.clear();
+        m_searchedUntil = 0;
+    }
+    m_screen->resize(m_pendingRows, m_pendingColumns);
+    m_pendingRows = 0;
+    m_pendingColumns = 0;
+    publishSnapshot();
+}
+
+void TerminalWorker::finishReflow()
+{
+    if (m_screen->finishReflow()) {
+        m_historyMatches.clear();
+        m_searchedUntil = 0;
+        publishSnapshot();
+    }
+}
+
+void TerminalWorker::clear()
+{
+    m_screen->clear();
+    publishSnapshot();
+}
+
+void TerminalWorker::reset()
+{
+    m_parser->reset();
+    clear();
+}
+
+void TerminalWorker::setParserEngine(int engine)
+{
+    m_parser->setEngine(static_cast<ParserEngine>(engine));
+}
+
+void TerminalWorker::setMaxHistorySize(int lines)
+{
+    m_screen->setMaxHistorySize(lines);
+    publishSnapshot();
+}
+
+void TerminalWorker::setHistorySpillDirectory(const QString &directory)
+{
+    m_screen->setHistorySpillDirectory(directory);
+}
+
+void TerminalWorker::setViewOffset(int offset)
+{
+    m_viewOffset = offset;
+    publishSnapshot();
+}
+
+void TerminalWorker::search(int serial, const QString &pattern, bool regularExpression, bool caseSensitive)
+{
+    finishReflow();
+    const TerminalSearchQuery query{pattern, regularExpression, caseSensitive};
+    if (query != m_searchQuery) {
+        m_searchQuery = query;
+        m_historyMatches.clear();
+        m_searchedUntil = 0;
+    }
+
+    // Forget matches on lines that have left the scrollback
+    const qint64 firstLine = m_screen->firstLineNumber();
+    const qint64 oldestLine = firstLine - m_screen->historySize();
+    int dropped = 0;
+    while (dropped < m_historyMatches.size() && m_historyMatches.at(dropped).line < oldestLine) {
+        ++dropped;
+    }
+    m_historyMatches.remove(0, dropped);
+
+    // Lines only enter history once, so just the new ones need reading; a
+    // wrapped line that went on onto the screen is read again from its start
+    const qint64 fromLine = qMax(m_searchedUntil, oldestLine);
+    int kept = m_historyMatches.size();
+    while (kept > 0 && m_historyMatches.at(kept - 1).line >= fromLine) {
+        --kept;
+    }
+    m_historyMatches.resize(kept);
+    m_searchedUntil = m_screen->find(query, fromLine, firstLine, m_historyMatches, MAX_SEARCH_MATCHES);
+
+    // The screen itself can change anywhere and is always searched again
+    QVector<TerminalSearchMatch> matches = m_historyMatches;
+    m_screen->find(query, firstLine, firstLine + m_screen->rows(), matches, MAX_SEARCH_MATCHES);
+    emit searchFinished(serial, matches);
+}
+
+QString TerminalWorker::text(qint64 startLine, int startColumn, qint64 endLine, int endColumn) const
+{
+    return m_screen->text(startLine, startColumn, endLine, endColumn);
+}
+
+void TerminalWorker::requestText(int tag, qint64 startLine, int startColumn, qint64 endLine, int endColumn)
+{
+    finishReflow();
+    emit textReady(tag, text(startLine, startColumn, endLine, endColumn));
+}
+
+void TerminalWorker::applyCommands()
+{
+    if (m_commands.isEmpty()) {
+        return;
+    }
+
+    m_screen->applyCommands(m_commands);
+
+    // Bells and keyboard modes concern the widget rather than the screen
+    if (m_commands.hasTerminalEvents()) {
+        for (const TerminalCommand &command : m_commands) {
+            switch (command.type) {
+            case TerminalCommand::UseAlternateScreenBuffer:
+                // Track DECCKM state locally. The remote application (mc, vim, etc.) sends
+                // its own smkx/rmkx sequences which the parser follows; do not write DECCKM
+                // sequences back to the remote (the pty echo would flip this state again).
+                emit applicationCursorKeysChanged(command.first != 0);
+                break;
+            case TerminalCommand::SetPrivateMode:
+                if (command.first == 1) { // DECCKM - Cursor Keys Mode
+                    emit applicationCursorKeysChanged(command.second != 0);
+                } else if (command.first == 2004) { // Bracketed paste
+                    emit bracketedPasteChanged(command.second != 0);
+                }
+                break;
+            case TerminalCommand::Bell:
+                emit bell();
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    publishSnapshot(m_commands.hasText());
+    m_commands.clear();
+
+    if (m_memoryStats) {
+        logMemoryFootprint();
+    }
+}
+
+void TerminalWorker::logMemoryFootprint()
+{
+    if (m_memoryStatsTimer.isValid() && m_memoryStatsTimer.elapsed() < MEMORY_STATS_INTERVAL) {
+        return;
+    }
+    m_memoryStatsTimer.start();
+    qDebug() << "Terminal memory:" << m_screen->memoryFootprint() / 1024 << "KiB for"
+             << m_screen->historySize() << "history lines of" << m_screen->columns() << "columns,"
+             << m_screen->styleTableSize() << "styles," << m_screen->colorTableSize() << "colors";
+}
+
+void TerminalWorker::publishSnapshot(bool hasOutput)
+{
+    TerminalSnapshot snapshot;
+    snapshot.lines = m_screen->lines();
+    snapshot.rowGenerations = m_screen->rowGenerations();
+    snapshot.generation = m_screen->generation();
+    snapshot.styles = m_screen->styles();
+    snapshot.colorTable = m_screen->colorTable();
+    snapshot.rows = m_screen->rows();
+    snapshot.columns = m_screen->columns();
+    snapshot.cursor = m_screen->cursorPosition();
+    snapshot.cursorVisible = m_screen->isCursorVisible();
+    snapshot.alternateBuffer = m_screen->useAlternateBuffer();
+    snapshot.historySize = m_screen->historySize();
+    snapshot.firstLine = m_screen->firstLineNumber();
+
+    // Only the scrollback rows that fit in the view are copied
+    const int offset = qMin(m_viewOffset, snapshot.historySize);
+    const int first = snapshot.historySize - offset;
+    const int count = qMin(offset, snapshot.rows);
+    snapshot.historyFirstLine = snapshot.firstLine - offset;
+    snapshot.history.reserve(count);
+    for (int index = first; index < first + count; ++index) {
+        snapshot.history.append(m_screen->historyRow(index));
+    }
+    snapshot.hasOutput = hasOutput;
+
+    bool notify = false;
+    {
+        QMutexLocker locker(&m_snapshotMutex);
+        // A snapshot the widget has not taken yet is simply superseded
+        if (m_snapshotPending) {
+            snapshot.hasOutput |= m_snapshot.hasOutput;
+        } else {
+            m_snapshotPending = true;
+            notify = true;
+        }
+        m_snapshot = snapshot;
+    }
+
+    if (notify) {
+        emit snapshotReady();
+    }
+}
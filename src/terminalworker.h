@@ -0,0 +1,188 @@
+#ifndef TERMINALWORKER_H
+#define TERMINALWORKER_H
+
+#include <QObject>
+#include <QVector>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <atomic>
+#include "terminalscreen.h"
+#include "vt100parser.h"
+
+/**
+ * @brief Immutable copy of the visible screen state, published for painting
+ *
+ * Rows and tables are implicitly shared with the worker's screen, so taking
+ * a snapshot only bumps reference counts. The worker detaches a row when it
+ * next writes to it, leaving the snapshot untouched.
+ */
+struct TerminalSnapshot {
+    QVector<TerminalLine> lines;
+    QVector<quint64> rowGenerations;
+    quint64 generation = 0;
+    QVector<TerminalStyle> styles;
+    QVector<QRgb> colorTable;
+
+    int rows = 0;
+    int columns = 0;
+    CursorPosition cursor;
+    bool cursorVisible = true;
+    bool alternateBuffer = false;
+    int historySize = 0;
+    bool hasOutput = false;  // Text arrived since the previous snapshot was taken
+
+    // Line number of screen row 0, see TerminalScreen::firstLineNumber()
+    qint64 firstLine = 0;
+
+    // Scrollback rows in view while scrolled up, starting at line historyFirstLine
+    QVector<TerminalLine> history;
+    qint64 historyFirstLine = 0;
+
+    /**
+     * @brief Cells of a screen row; negative rows are scrollback above row 0
+     *
+     * Null for rows outside the screen and the scrollback rows carried.
+     */
+    const TerminalCell *rowCells(int row) const;
+    const TerminalStyle &style(quint32 id) const;
+    QRgb trueColor(TerminalColor color) const;
+};
+
+/**
+ * @brief Owns the parser and screen of one session on a background thread
+ *
+ * VT100Terminal moves the worker to its own QThread and feeds it output
+ * through queued calls, so a busy session parses on its own core instead of
+ * the GUI thread. After every batch the worker replaces its pending
+ * snapshot; only the newest one is handed to the widget, and snapshotReady
+ * is emitted once per hand-over rather than once per batch.
+ */
+class TerminalWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TerminalWorker(int rows = 24, int columns = 80, QObject *parent = nullptr);
+
+    /**
+     * @brief Take the latest snapshot; safe to call from any thread
+     */
+    TerminalSnapshot takeSnapshot();
+
+    /**
+     * @brief Queue output for parsing; call from the thread feeding the worker
+     *
+     * Counts the bytes until processData() has applied them, so the feeder
+     * can stop reading while isBacklogged().
+     */
+    void queueData(const QByteArray &data);
+
+    /**
+     * @brief More than HIGH_WATER bytes queued; safe to call from any thread
+     */
+    bool isBacklogged() const { return m_queuedBytes.load() > HIGH_WATER; }
+
+    /**
+     * @brief Text of a line range; call on the worker thread
+     */
+    QString text(qint64 startLine, int startColumn, qint64 endLine, int endColumn) const;
+
+    // Searches stop after this many matches
+    static constexpr int MAX_SEARCH_MATCHES = 100000;
+
+    // Queued output above which the feeder pauses, and below which it resumes
+    static constexpr qint64 HIGH_WATER = 4 * 1024 * 1024;
+    static constexpr qint64 LOW_WATER = 512 * 1024;
+
+public slots:
+    void processData(const QByteArray &data);
+    void processText(const QString &text);
+
+    /**
+     * @brief Request a new screen size
+     *
+     * Applied once the queued calls before it are handled, so a burst of
+     * sizes from a window or splitter drag reflows the screen only once.
+     */
+    void resize(int rows, int columns);
+
+    /**
+     * @brief Settle the reflow of the last width change
+     *
+     * Called once the size stops changing; output, searches and copies
+     * settle it earlier when they come first.
+     */
+    void finishReflow();
+    void clear();
+    void reset();
+    void setParserEngine(int engine);
+    void setMaxHistorySize(int lines);
+    void setHistorySpillDirectory(const QString &directory);
+    void setViewOffset(int offset);
+
+    /**
+     * @brief Find all matches on the screen and in scrollback
+     *
+     * Scrollback matches of the previous query are kept, so repeating it
+     * after more output only reads the lines added since. Results arrive
+     * through searchFinished tagged with serial.
+     */
+    void search(int serial, const QString &pattern, bool regularExpression, bool caseSensitive);
+
+    /**
+     * @brief Build the text of a line range and deliver it through textReady
+     *
+     * The caller never waits for the worker, however much output is queued
+     * in front of the request.
+     */
+    void requestText(int tag, qint64 startLine, int startColumn, qint64 endLine, int endColumn);
+
+signals:
+    void snapshotReady();
+    void backlogDrained();  // Queued output fell to LOW_WATER
+    void searchFinished(int serial, const QVector<TerminalSearchMatch> &matches);
+    void textReady(int tag, const QString &text);
+    void bell();
+    void applicationCursorKeysChanged(bool enable);
+    void bracketedPasteChanged(bool enable);
+
+private slots:
+    void applyResize();
+
+private:
+    void applyCommands();
+    void publishSnapshot(bool hasOutput = false);
+    void logMemoryFootprint();
+
+    TerminalScreen *m_screen;
+    VT100Parser *m_parser;
+    TerminalCommandBuffer m_commands;
+
+    // Latest snapshot not yet taken by the widget
+    QMutex m_snapshotMutex;
+    TerminalSnapshot m_snapshot;
+    bool m_snapshotPending;
+
+    // Lines the widget is scrolled up by; that much scrollback goes into snapshots
+    int m_viewOffset;
+
+    // Size requested but not applied yet; 0 when none is pending
+    int m_pendingRows;
+    int m_pendingColumns;
+
+    // Scrollback matches of the last search and the line it reached
+    TerminalSearchQuery m_searchQuery;
+    QVector<TerminalSearchMatch> m_historyMatches;
+    qint64 m_searchedUntil;
+
+    // Bytes passed to queueData() and not parsed yet
+    std::atomic<qint64> m_queuedBytes;
+
+    // QTISSH_MEMORY_STATS logs the screen's footprint while output arrives
+    bool m_memoryStats;
+    QElapsedTimer m_memoryStatsTimer;
+
+    static const int MEMORY_STATS_INTERVAL = 2000;  // ms between log lines
+};
+
+#endif // TERMINALWORKER_H
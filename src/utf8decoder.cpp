@@ -0,0 +1,86 @@
+#include "utf8decoder.h"
+#include <QVarLengthArray>
+
+Utf8Decoder::Utf8Decoder()
+    : m_codepoint(0)
+    , m_minimum(0)
+    , m_remaining(0)
+{
+}
+
+int Utf8Decoder::decode(const uchar *data, int length, uint *out, int &written)
+{
+    int i = 0;
+    while (i < length) {
+        const uchar byte = data[i];
+        
+        if (m_remaining > 0) {
+            if ((byte & 0xC0) != 0x80) {
+                // Sequence cut short; the byte is examined again as a new start
+                out[written++] = QChar::ReplacementCharacter;
+                m_remaining = 0;
+                continue;
+            }
+            m_codepoint = (m_codepoint << 6) | (byte & 0x3F);
+            ++i;
+            if (--m_remaining == 0) {
+                if (m_codepoint < m_minimum || m_codepoint > 0x10FFFF
+                    || (m_codepoint >= 0xD800 && m_codepoint <= 0xDFFF)) {
+                    out[written++] = QChar::ReplacementCharacter;
+                } else {
+                    out[written++] = m_codepoint;
+                }
+            }
+            continue;
+        }
+        
+        if (byte < 0x80) {
+            break;
+        }
+        ++i;
+        
+        if (byte >= 0xC2 && byte <= 0xDF) {
+            m_remaining = 1;
+            m_codepoint = byte & 0x1F;
+            m_minimum = 0x80;
+        } else if (byte >= 0xE0 && byte <= 0xEF) {
+            m_remaining = 2;
+            m_codepoint = byte & 0x0F;
+            m_minimum = 0x800;
+        } else if (byte >= 0xF0 && byte <= 0xF4) {
+            m_remaining = 3;
+            m_codepoint = byte & 0x07;
+            m_minimum = 0x10000;
+        } else {
+            // Stray continuation byte or invalid lead
+            out[written++] = QChar::ReplacementCharacter;
+        }
+    }
+    return i;
+}
+
+QString Utf8Decoder::toUnicode(const char *data, int length)
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(data);
+    QVarLengthArray<uint, 1024> buffer(length + 1);
+    uint *out = buffer.data();
+    int written = 0;
+    
+    int i = 0;
+    while (i < length) {
+        if (bytes[i] < 0x80 && m_remaining == 0) {
+            out[written++] = bytes[i++];
+        } else {
+            i += decode(bytes + i, length - i, out, written);
+        }
+    }
+    
+    return QString::fromUcs4(reinterpret_cast<const char32_t *>(out), written);
+}
+
+void Utf8Decoder::reset()
+{
+    m_codepoint = 0;
+    m_minimum = 0;
+    m_remaining = 0;
+}
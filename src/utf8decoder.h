@@ -0,0 +1,44 @@
+#ifndef UTF8DECODER_H
+#define UTF8DECODER_H
+
+#include <QString>
+
+/**
+ * @brief Incremental UTF-8 decoder that keeps state between chunks
+ *
+ * A multi-byte sequence split across two reads is completed when the rest
+ * of it arrives instead of turning into replacement characters. Malformed
+ * input yields U+FFFD, one per broken sequence.
+ */
+class Utf8Decoder
+{
+public:
+    Utf8Decoder();
+
+    /**
+     * @brief Decodes non-ASCII bytes from data into out
+     *
+     * Stops before the first ASCII byte that does not continue a pending
+     * sequence, or at the end of the input with the partial sequence kept.
+     * An ASCII byte interrupting a sequence emits U+FFFD without being
+     * consumed. At most length + 1 code points are written.
+     *
+     * @return Number of bytes consumed
+     */
+    int decode(const uchar *data, int length, uint *out, int &written);
+
+    /**
+     * @brief Decodes a whole chunk, ASCII included, carrying partial sequences
+     */
+    QString toUnicode(const char *data, int length);
+
+    bool hasPendingSequence() const { return m_remaining > 0; }
+    void reset();
+
+private:
+    uint m_codepoint;
+    uint m_minimum;
+    int m_remaining;
+};
+
+#endif // UTF8DECODER_H
@@ -1,12 +1,156 @@
 #include "vt100parser.h"
+#include "printablescanner.h"
 #include <QDebug>
 #include <QRegularExpression>
 
+namespace {
+
+// Transition actions of the table-driven engine. Entry and exit actions
+// (clear, hook, unhook, osc_start, osc_end) are handled in enterState().
+enum TableAction : quint8 {
+    ActionNone,
+    ActionIgnore,
+    ActionPrint,
+    ActionExecute,
+    ActionCollect,
+    ActionParam,
+    ActionEscDispatch,
+    ActionCsiDispatch,
+    ActionPut,
+    ActionOscPut
+};
+
+const int BYTE_PARSER_STATE_COUNT = static_cast<int>(ByteParserState::SosPmApcString) + 1;
+
+/**
+ * Transition table indexed by [state][byte]. Each entry packs the action in
+ * the high nibble and the next state in the low nibble.
+ *
+ * Bytes 0x80-0xFF are never treated as C1 controls: the stream is UTF-8, so
+ * they are printed in ground state and passed through inside strings.
+ */
+struct TransitionTable
+{
+    quint8 entries[BYTE_PARSER_STATE_COUNT][256];
+
+    TransitionTable()
+    {
+        using S = ByteParserState;
+
+        for (int s = 0; s < BYTE_PARSER_STATE_COUNT; ++s) {
+            set(static_cast<S>(s), 0x00, 0xFF, ActionIgnore, static_cast<S>(s));
+        }
+
+        setC0(S::Ground, ActionExecute);
+        set(S::Ground, 0x20, 0x7E, ActionPrint, S::Ground);
+        set(S::Ground, 0x80, 0xFF, ActionPrint, S::Ground);
+
+        setC0(S::Escape, ActionExecute);
+        set(S::Escape, 0x20, 0x2F, ActionCollect, S::EscapeIntermediate);
+        set(S::Escape, 0x30, 0x7E, ActionEscDispatch, S::Ground);
+        set(S::Escape, '[', '[', ActionNone, S::CsiEntry);
+        set(S::Escape, ']', ']', ActionNone, S::OscString);
+        set(S::Escape, 'P', 'P', ActionNone, S::DcsEntry);
+        set(S::Escape, 'X', 'X', ActionNone, S::SosPmApcString);
+        set(S::Escape, '^', '^', ActionNone, S::SosPmApcString);
+        set(S::Escape, '_', '_', ActionNone, S::SosPmApcString);
+
+        setC0(S::EscapeIntermediate, ActionExecute);
+        set(S::EscapeIntermediate, 0x20, 0x2F, ActionCollect, S::EscapeIntermediate);
+        set(S::EscapeIntermediate, 0x30, 0x7E, ActionEscDispatch, S::Ground);
+
+        // ':' is accepted as a parameter separator for SGR sub-parameters
+        setC0(S::CsiEntry, ActionExecute);
+        set(S::CsiEntry, 0x20, 0x2F, ActionCollect, S::CsiIntermediate);
+        set(S::CsiEntry, 0x30, 0x3B, ActionParam, S::CsiParam);
+        set(S::CsiEntry, 0x3C, 0x3F, ActionCollect, S::CsiParam);
+        set(S::CsiEntry, 0x40, 0x7E, ActionCsiDispatch, S::Ground);
+
+        setC0(S::CsiParam, ActionExecute);
+        set(S::CsiParam, 0x20, 0x2F, ActionCollect, S::CsiIntermediate);
+        set(S::CsiParam, 0x30, 0x3B, ActionParam, S::CsiParam);
+        set(S::CsiParam, 0x3C, 0x3F, ActionNone, S::CsiIgnore);
+        set(S::CsiParam, 0x40, 0x7E, ActionCsiDispatch, S::Ground);
+
+        setC0(S::CsiIntermediate, ActionExecute);
+        set(S::CsiIntermediate, 0x20, 0x2F, ActionCollect, S::CsiIntermediate);
+        set(S::CsiIntermediate, 0x30, 0x3F, ActionNone, S::CsiIgnore);
+        set(S::CsiIntermediate, 0x40, 0x7E, ActionCsiDispatch, S::Ground);
+
+        setC0(S::CsiIgnore, ActionExecute);
+        set(S::CsiIgnore, 0x40, 0x7E, ActionNone, S::Ground);
+
+        // The final byte of a DCS header is kept as the first byte of the string
+        set(S::DcsEntry, 0x20, 0x2F, ActionCollect, S::DcsIntermediate);
+        set(S::DcsEntry, 0x30, 0x3B, ActionParam, S::DcsParam);
+        set(S::DcsEntry, 0x3C, 0x3F, ActionCollect, S::DcsParam);
+        set(S::DcsEntry, 0x40, 0x7E, ActionPut, S::DcsPassthrough);
+
+        set(S::DcsParam, 0x20, 0x2F, ActionCollect, S::DcsIntermediate);
+        set(S::DcsParam, 0x30, 0x3B, ActionParam, S::DcsParam);
+        set(S::DcsParam, 0x3C, 0x3F, ActionNone, S::DcsIgnore);
+        set(S::DcsParam, 0x40, 0x7E, ActionPut, S::DcsPassthrough);
+
+        set(S::DcsIntermediate, 0x20, 0x2F, ActionCollect, S::DcsIntermediate);
+        set(S::DcsIntermediate, 0x30, 0x3F, ActionNone, S::DcsIgnore);
+        set(S::DcsIntermediate, 0x40, 0x7E, ActionPut, S::DcsPassthrough);
+
+        setC0(S::DcsPassthrough, ActionPut);
+        set(S::DcsPassthrough, 0x20, 0x7E, ActionPut, S::DcsPassthrough);
+        set(S::DcsPassthrough, 0x80, 0xFF, ActionPut, S::DcsPassthrough);
+
+        // BEL terminates an OSC string as well as ST (xterm extension)
+        set(S::OscString, 0x20, 0xFF, ActionOscPut, S::OscString);
+        set(S::OscString, 0x07, 0x07, ActionNone, S::Ground);
+
+        // Transitions valid from any state
+        for (int s = 0; s < BYTE_PARSER_STATE_COUNT; ++s) {
+            const S state = static_cast<S>(s);
+            set(state, 0x18, 0x18, ActionExecute, S::Ground);
+            set(state, 0x1A, 0x1A, ActionExecute, S::Ground);
+            set(state, 0x1B, 0x1B, ActionNone, S::Escape);
+            set(state, 0x7F, 0x7F, ActionIgnore, state);
+        }
+    }
+
+    void set(ByteParserState state, int first, int last, TableAction action, ByteParserState next)
+    {
+        const quint8 entry = static_cast<quint8>((action << 4) | static_cast<quint8>(next));
+        for (int byte = first; byte <= last; ++byte) {
+            entries[static_cast<int>(state)][byte] = entry;
+        }
+    }
+
+    // C0 controls except CAN, SUB and ESC, which are handled as "anywhere" transitions
+    void setC0(ByteParserState state, TableAction action)
+    {
+        set(state, 0x00, 0x17, action, state);
+        set(state, 0x19, 0x19, action, state);
+        set(state, 0x1C, 0x1F, action, state);
+    }
+};
+
+const TransitionTable &transitionTable()
+{
+    static const TransitionTable table;
+    return table;
+}
+
+} // namespace
+
 VT100Parser::VT100Parser(QObject *parent)
     : QObject(parent)
+    , m_engine(ParserEngine::TableDriven)
+    , m_commands(&m_ownCommands)
     , m_state(ParserState::Normal)
-    , m_currentForeground(TerminalColor::Default)
-    , m_currentBackground(TerminalColor::Default)
+    , m_parameterCount(0)
+    , m_subParameterMask(0)
+    , m_privateMarker(0)
+    , m_byteState(ByteParserState::Ground)
+    , m_intermediateCount(0)
+    , m_parameterOverflow(false)
+    , m_currentForeground(colorValue(TerminalColor::Default))
+    , m_currentBackground(colorValue(TerminalColor::Default))
     , m_currentAttributes(TextAttribute::None)
     , m_currentCharacterSet(0)
 {
@@ -18,32 +162,449 @@ VT100Parser::VT100Parser(QObject *parent)
     reset();
 }
 
+void VT100Parser::setEngine(ParserEngine engine)
+{
+    if (m_engine == engine) {
+        return;
+    }
+    
+    m_engine = engine;
+    m_state = ParserState::Normal;
+    m_byteState = ByteParserState::Ground;
+    m_utf8Decoder.reset();
+    resetSequence();
+    m_textBuffer.clear();
+}
+
+void VT100Parser::setCommandBuffer(TerminalCommandBuffer *buffer)
+{
+    m_ownCommands.clear();
+    m_commands = buffer ? buffer : &m_ownCommands;
+}
+
 void VT100Parser::processData(const QByteArray &data)
 {
-    processData(QString::fromUtf8(data));
+    if (m_engine == ParserEngine::TableDriven) {
+        processBytes(data.constData(), data.size());
+        finishBatch();
+        return;
+    }
+    
+    processData(m_utf8Decoder.toUnicode(data.constData(), data.size()));
 }
 
 void VT100Parser::processData(const QString &data)
 {
+    if (m_engine == ParserEngine::TableDriven) {
+        processData(data.toUtf8());
+        return;
+    }
+    
     for (const QChar &ch : data) {
         processCharacter(ch);
     }
     
-    // Emit any pending text
-    if (!m_textBuffer.isEmpty()) {
-        emit textReceived(m_textBuffer);
-        m_textBuffer.clear();
-    }
+    flushTextBuffer();
+    finishBatch();
 }
 
 void VT100Parser::reset()
 {
     m_state = ParserState::Normal;
+    m_byteState = ByteParserState::Ground;
+    m_utf8Decoder.reset();
     resetSequence();
     m_textBuffer.clear();
-    m_currentForeground = TerminalColor::Default;
-    m_currentBackground = TerminalColor::Default;
+    m_currentForeground = colorValue(TerminalColor::Default);
+    m_currentBackground = colorValue(TerminalColor::Default);
     m_currentAttributes = TextAttribute::None;
+    for (int i = 0; i < 4; ++i) {
+        m_characterSets[i] = 'B';
+    }
+    m_currentCharacterSet = 0;
+}
+
+void VT100Parser::flushTextBuffer()
+{
+    if (m_textBuffer.isEmpty()) {
+        return;
+    }
+    const QVector<uint> codepoints = m_textBuffer.toUcs4();
+    m_commands->appendText(codepoints.constData(), codepoints.size());
+    m_textBuffer.clear();
+}
+
+void VT100Parser::finishBatch()
+{
+    // Without an external buffer the batch is replayed as signals
+    if (m_commands == &m_ownCommands && !m_ownCommands.isEmpty()) {
+        emitCommands(m_ownCommands);
+        m_ownCommands.clear();
+    }
+}
+
+void VT100Parser::emitCommands(const TerminalCommandBuffer &commands)
+{
+    for (const TerminalCommand &command : commands) {
+        switch (command.type) {
+        case TerminalCommand::Text:
+            emit textRunReceived(commands.text(command), command.second);
+            break;
+        case TerminalCommand::CursorUp:
+            emit cursorUp(command.first);
+            break;
+        case TerminalCommand::CursorDown:
+            emit cursorDown(command.first);
+            break;
+        case TerminalCommand::CursorForward:
+            emit cursorForward(command.first);
+            break;
+        case TerminalCommand::CursorBackward:
+            emit cursorBackward(command.first);
+            break;
+        case TerminalCommand::CursorPosition:
+            emit cursorPosition(command.first, command.second);
+            break;
+        case TerminalCommand::CursorNextLine:
+            emit cursorNextLine(command.first);
+            break;
+        case TerminalCommand::CursorPreviousLine:
+            emit cursorPreviousLine(command.first);
+            break;
+        case TerminalCommand::CursorHorizontalAbsolute:
+            emit cursorHorizontalAbsolute(command.first);
+            break;
+        case TerminalCommand::LineFeed:
+            emit lineFeed();
+            break;
+        case TerminalCommand::ReverseIndex:
+            emit reverseIndex();
+            break;
+        case TerminalCommand::SaveCursor:
+            emit saveCursor();
+            break;
+        case TerminalCommand::RestoreCursor:
+            emit restoreCursor();
+            break;
+        case TerminalCommand::HideCursor:
+            emit hideCursor();
+            break;
+        case TerminalCommand::ShowCursor:
+            emit showCursor();
+            break;
+        case TerminalCommand::ClearScreen:
+            emit clearScreen();
+            break;
+        case TerminalCommand::ClearScreenFromCursor:
+            emit clearScreenFromCursor();
+            break;
+        case TerminalCommand::ClearScreenToCursor:
+            emit clearScreenToCursor();
+            break;
+        case TerminalCommand::ClearLine:
+            emit clearLine();
+            break;
+        case TerminalCommand::ClearLineFromCursor:
+            emit clearLineFromCursor();
+            break;
+        case TerminalCommand::ClearLineToCursor:
+            emit clearLineToCursor();
+            break;
+        case TerminalCommand::InsertLines:
+            emit insertLines(command.first);
+            break;
+        case TerminalCommand::DeleteLines:
+            emit deleteLines(command.first);
+            break;
+        case TerminalCommand::InsertCharacters:
+            emit insertCharacters(command.first);
+            break;
+        case TerminalCommand::DeleteCharacters:
+            emit deleteCharacters(command.first);
+            break;
+        case TerminalCommand::EraseCharacters:
+            emit eraseCharacters(command.first);
+            break;
+        case TerminalCommand::ScrollUp:
+            emit scrollUp(command.first);
+            break;
+        case TerminalCommand::ScrollDown:
+            emit scrollDown(command.first);
+            break;
+        case TerminalCommand::SetTextAttributes:
+            emit setTextAttributes(static_cast<ColorValue>(command.first),
+                                   static_cast<ColorValue>(command.second),
+                                   TextAttributes(command.third));
+            break;
+        case TerminalCommand::ResetTextAttributes:
+            emit resetTextAttributes();
+            break;
+        case TerminalCommand::SetScrollingRegion:
+            emit setScrollingRegion(command.first, command.second);
+            break;
+        case TerminalCommand::SetTabStop:
+            emit setTabStop();
+            break;
+        case TerminalCommand::ClearTabStop:
+            emit clearTabStop();
+            break;
+        case TerminalCommand::ClearAllTabStops:
+            emit clearAllTabStops();
+            break;
+        case TerminalCommand::TabForward:
+            emit tabForward(command.first);
+            break;
+        case TerminalCommand::TabBackward:
+            emit tabBackward(command.first);
+            break;
+        case TerminalCommand::SetCharacterSet:
+            emit setCharacterSet(static_cast<char>(command.first), static_cast<char>(command.second));
+            break;
+        case TerminalCommand::SelectCharacterSet:
+            emit selectCharacterSet(command.first);
+            break;
+        case TerminalCommand::SetMode:
+            emit setMode(command.first, command.second != 0);
+            break;
+        case TerminalCommand::SetPrivateMode:
+            emit setPrivateMode(command.first, command.second != 0);
+            break;
+        case TerminalCommand::UseAlternateScreenBuffer:
+            emit useAlternateScreenBuffer(command.first != 0);
+            break;
+        case TerminalCommand::Bell:
+            emit bell();
+            break;
+        case TerminalCommand::DeviceStatusReport:
+            emit deviceStatusReport();
+            break;
+        case TerminalCommand::CursorPositionReport:
+            emit cursorPositionReport();
+            break;
+        case TerminalCommand::ClearHistory:
+        case TerminalCommand::FullReset:
+            // Only the screen's own storage is affected
+            break;
+        }
+    }
+}
+
+void VT100Parser::processBytes(const char *data, int length)
+{
+    const TransitionTable &table = transitionTable();
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    const uchar *end = p + length;
+    
+    while (p < end) {
+        if (m_byteState == ByteParserState::Ground) {
+            // Fast path: hand everything up to the next C0 control or DEL
+            // to the screen as a single run. A sequence left incomplete by
+            // the previous chunk is finished (or replaced) here as well.
+            if ((*p >= 0x20 && *p != 0x7F) || m_utf8Decoder.hasPendingSequence()) {
+                p = printRun(p, end);
+                continue;
+            }
+        }
+        
+        const uchar byte = *p++;
+        const quint8 entry = table.entries[static_cast<int>(m_byteState)][byte];
+        const ByteParserState next = static_cast<ByteParserState>(entry & 0x0F);
+        
+        performAction(entry >> 4, byte);
+        
+        // ESC re-enters the escape state even from itself, to clear the sequence
+        if (next != m_byteState || byte == 0x1B) {
+            enterState(next);
+        }
+    }
+}
+
+const uchar *VT100Parser::printRun(const uchar *begin, const uchar *end)
+{
+    // A run never decodes to more code points than it has bytes, plus one
+    // replacement for a sequence carried over from the previous chunk
+    uint *out = m_commands->reserveText(static_cast<int>(end - begin) + 1);
+    int count = 0;
+    const bool graphics = m_characterSets[m_currentCharacterSet] == '0';
+    
+    const uchar *p = begin;
+    while (p < end) {
+        if (!m_utf8Decoder.hasPendingSequence()) {
+            // Plain ASCII stretches are located in 16/32-byte blocks and widened directly
+            const int ascii = PrintableScanner::asciiRunLength(p, static_cast<int>(end - p));
+            if (graphics) {
+                for (int i = 0; i < ascii; ++i) {
+                    out[count + i] = mapCharacter(QChar(p[i])).unicode();
+                }
+            } else {
+                for (int i = 0; i < ascii; ++i) {
+                    out[count + i] = p[i];
+                }
+            }
+            count += ascii;
+            p += ascii;
+            
+            // A C0 control or DEL ends the run; anything else is a UTF-8 lead byte
+            if (p == end || *p < 0x80) {
+                break;
+            }
+        }
+        // Incomplete trailing sequences stay in the decoder for the next chunk
+        p += m_utf8Decoder.decode(p, static_cast<int>(end - p), out, count);
+    }
+    
+    m_commands->commitText(count);
+    return p;
+}
+
+void VT100Parser::performAction(quint8 action, uchar byte)
+{
+    switch (action) {
+    case ActionExecute:
+        handleControlCharacter(QChar(byte));
+        break;
+    case ActionCollect:
+        if (byte >= 0x3C && byte <= 0x3F) {
+            m_privateMarker = static_cast<char>(byte);
+        } else {
+            if (m_intermediateCount < MAX_INTERMEDIATES) {
+                m_intermediates[m_intermediateCount] = static_cast<char>(byte);
+            }
+            ++m_intermediateCount;
+        }
+        break;
+    case ActionParam:
+        collectParameter(byte);
+        break;
+    case ActionEscDispatch:
+        dispatchEscape(byte);
+        break;
+    case ActionCsiDispatch:
+        // Sequences with intermediates (DECSCUSR, DECSTR, ...) are not supported
+        if (m_intermediateCount == 0) {
+            m_finalChar = QChar(byte);
+            dispatchCSICommand();
+        }
+        break;
+    case ActionPut:
+    case ActionOscPut:
+        if (m_stringBuffer.size() < MAX_STRING_LENGTH) {
+            m_stringBuffer.append(static_cast<char>(byte));
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void VT100Parser::enterState(ByteParserState state)
+{
+    // Exit actions
+    if (m_byteState == ByteParserState::OscString) {
+        m_sequence = QString::fromUtf8(m_stringBuffer);
+        executeOSCCommand();
+    } else if (m_byteState == ByteParserState::DcsPassthrough) {
+        m_sequence = QString::fromUtf8(m_stringBuffer);
+        executeDCSCommand();
+    }
+    
+    m_byteState = state;
+    
+    // Entry actions
+    switch (state) {
+    case ByteParserState::Escape:
+    case ByteParserState::CsiEntry:
+    case ByteParserState::DcsEntry:
+        resetSequence();
+        break;
+    default:
+        break;
+    }
+}
+
+void VT100Parser::collectParameter(uchar byte)
+{
+    if (m_parameterOverflow) {
+        return;
+    }
+    
+    if (m_parameterCount == 0) {
+        m_parameters[0] = DEFAULT_PARAMETER;
+        m_parameterCount = 1;
+    }
+    
+    if (byte >= '0' && byte <= '9') {
+        int &value = m_parameters[m_parameterCount - 1];
+        value = qMin((value == DEFAULT_PARAMETER ? 0 : value) * 10 + (byte - '0'), 65535);
+    } else if (m_parameterCount < MAX_PARAMETERS) {
+        // ';' starts the next parameter, ':' a sub-parameter of the current one
+        if (byte == ':') {
+            m_subParameterMask |= 1u << m_parameterCount;
+        }
+        m_parameters[m_parameterCount++] = DEFAULT_PARAMETER;
+    } else {
+        m_parameterOverflow = true;
+    }
+}
+
+void VT100Parser::dispatchEscape(uchar finalByte)
+{
+    if (m_intermediateCount == 1) {
+        // SCS - designate G0..G3 character set: ESC ( B, ESC ) 0, ...
+        const char designator = m_intermediates[0];
+        const int set = designator == '(' ? 0
+                      : designator == ')' ? 1
+                      : designator == '*' ? 2
+                      : designator == '+' ? 3 : -1;
+        if (set >= 0) {
+            m_characterSets[set] = static_cast<char>(finalByte);
+            m_commands->append(TerminalCommand::SetCharacterSet, designator, finalByte);
+        }
+        return;
+    }
+    if (m_intermediateCount > 0) {
+        return;
+    }
+    
+    // Single character escape sequences
+    switch (finalByte) {
+    case 'D':  // IND - Index
+        m_commands->append(TerminalCommand::LineFeed);
+        break;
+    case 'E':  // NEL - Next Line
+        m_commands->append(TerminalCommand::CursorHorizontalAbsolute, 0);
+        m_commands->append(TerminalCommand::LineFeed);
+        break;
+    case 'H':  // HTS - Horizontal Tab Set
+        m_commands->append(TerminalCommand::SetTabStop);
+        break;
+    case 'M':  // RI - Reverse Index
+        m_commands->append(TerminalCommand::ReverseIndex);
+        break;
+    case 'Z':  // DECID - Identify Terminal
+        // Should respond with device attributes
+        break;
+    case '7':  // DECSC - Save Cursor
+        m_commands->append(TerminalCommand::SaveCursor);
+        break;
+    case '8':  // DECRC - Restore Cursor
+        m_commands->append(TerminalCommand::RestoreCursor);
+        break;
+    case '=':  // DECKPAM - Keypad Application Mode (numeric keypad only, not DECCKM)
+        break;
+    case '>':  // DECKPNM - Keypad Numeric Mode (numeric keypad only, not DECCKM)
+        break;
+    case 'c':  // RIS - Reset to Initial State
+        for (int i = 0; i < 4; ++i) {
+            m_characterSets[i] = 'B';
+        }
+        m_currentCharacterSet = 0;
+        m_commands->append(TerminalCommand::ResetTextAttributes);
+        m_commands->append(TerminalCommand::ClearScreen);
+        m_commands->append(TerminalCommand::CursorPosition, 0, 0);
+        m_commands->append(TerminalCommand::FullReset);
+        break;
+    }
 }
 
 void VT100Parser::processCharacter(QChar ch)
@@ -77,19 +638,13 @@ void VT100Parser::processCharacter(QChar ch)
 void VT100Parser::processNormalCharacter(QChar ch)
 {
     if (ch == '\x1b') {  // ESC
-        // Emit any pending text before processing escape sequence
-        if (!m_textBuffer.isEmpty()) {
-            emit textReceived(m_textBuffer);
-            m_textBuffer.clear();
-        }
+        // Record any pending text before processing escape sequence
+        flushTextBuffer();
         m_state = ParserState::Escape;
         resetSequence();
     } else if (ch.unicode() < 32) {  // Control characters
-        // Emit any pending text before processing control character
-        if (!m_textBuffer.isEmpty()) {
-            emit textReceived(m_textBuffer);
-            m_textBuffer.clear();
-        }
+        // Record any pending text before processing control character
+        flushTextBuffer();
         handleControlCharacter(ch);
     } else {
         // Regular printable character
@@ -114,37 +669,8 @@ void VT100Parser::processEscapeSequence(QChar ch)
         m_state = ParserState::APC;
     } else {
         // Single character escape sequences
-        switch (ch.unicode()) {
-        case 'D':  // IND - Index
-            emit cursorDown(1);
-            break;
-        case 'E':  // NEL - Next Line
-            emit cursorNextLine(1);
-            break;
-        case 'H':  // HTS - Horizontal Tab Set
-            emit setTabStop();
-            break;
-        case 'M':  // RI - Reverse Index
-            emit cursorUp(1);
-            break;
-        case 'Z':  // DECID - Identify Terminal
-            // Should respond with device attributes
-            break;
-        case '7':  // DECSC - Save Cursor
-            emit saveCursor();
-            break;
-        case '8':  // DECRC - Restore Cursor
-            emit restoreCursor();
-            break;
-        case '=':  // DECKPAM - Keypad Application Mode (numeric keypad only, not DECCKM)
-            break;
-        case '>':  // DECKPNM - Keypad Numeric Mode (numeric keypad only, not DECCKM)
-            break;
-        case 'c':  // RIS - Reset to Initial State
-            emit resetTextAttributes();
-            emit clearScreen();
-            emit cursorPosition(0, 0);
-            break;
+        if (ch.unicode() < 0x80) {
+            dispatchEscape(static_cast<uchar>(ch.unicode()));
         }
         
         m_state = ParserState::Normal;
@@ -154,7 +680,7 @@ void VT100Parser::processEscapeSequence(QChar ch)
 
 void VT100Parser::processCSISequence(QChar ch)
 {
-    if (ch.isDigit() || ch == ';' || ch == '?') {
+    if (ch.isDigit() || ch == ';' || ch == ':' || ch == '?') {
         m_sequence.append(ch);
     } else if (ch.unicode() >= 0x20 && ch.unicode() <= 0x2F) {
         // Intermediate characters
@@ -197,6 +723,17 @@ void VT100Parser::processDCSSequence(QChar ch)
 void VT100Parser::executeCSICommand()
 {
     parseCSIParameters();
+    m_privateMarker = m_sequence.startsWith('?') ? '?' : 0;
+    dispatchCSICommand();
+}
+
+void VT100Parser::dispatchCSICommand()
+{
+    // Only DEC private ('?') sequences are understood; '>', '=' and '<'
+    // variants (secondary DA, modifyOtherKeys, ...) are ignored
+    if (m_privateMarker != 0 && m_privateMarker != '?') {
+        return;
+    }
     
     switch (m_finalChar.unicode()) {
     case 'A':  // CUU - Cursor Up
@@ -267,14 +804,14 @@ void VT100Parser::executeCSICommand()
         handleDeviceStatusReport();
         break;
     case 'h':  // SM - Set Mode
-        if (m_sequence.startsWith('?')) {
+        if (m_privateMarker == '?') {
             handleSetPrivateMode();
         } else {
             handleSetMode();
         }
         break;
     case 'l':  // RM - Reset Mode
-        if (m_sequence.startsWith('?')) {
+        if (m_privateMarker == '?') {
             handleResetPrivateMode();
         } else {
             handleResetMode();
@@ -299,7 +836,8 @@ void VT100Parser::executeDCSCommand()
 
 void VT100Parser::parseCSIParameters()
 {
-    m_parameters.clear();
+    m_parameterCount = 0;
+    m_subParameterMask = 0;
     
     QString paramString = m_sequence;
     if (paramString.startsWith('?')) {
@@ -310,14 +848,19 @@ void VT100Parser::parseCSIParameters()
         return;
     }
     
-    QStringList parts = paramString.split(';');
+    const QStringList parts = paramString.split(';');
     for (const QString &part : parts) {
-        bool ok;
-        int value = part.toInt(&ok);
-        if (ok) {
-            m_parameters.append(value);
-        } else {
-            m_parameters.append(DEFAULT_PARAMETER);
+        const QStringList subParts = part.split(':');
+        for (int i = 0; i < subParts.size(); ++i) {
+            if (m_parameterCount >= MAX_PARAMETERS) {
+                return;
+            }
+            if (i > 0) {
+                m_subParameterMask |= 1u << m_parameterCount;
+            }
+            bool ok;
+            int value = subParts.at(i).toInt(&ok);
+            m_parameters[m_parameterCount++] = ok ? value : DEFAULT_PARAMETER;
         }
     }
 }
@@ -331,9 +874,22 @@ void VT100Parser::parseOSCParameters()
 void VT100Parser::resetSequence()
 {
     m_sequence.clear();
-    m_parameters.clear();
     m_intermediateChars.clear();
     m_finalChar = QChar();
+    m_parameterCount = 0;
+    m_subParameterMask = 0;
+    m_privateMarker = 0;
+    m_intermediateCount = 0;
+    m_parameterOverflow = false;
+    m_stringBuffer.clear();
+}
+
+int VT100Parser::parameter(int index, int defaultValue) const
+{
+    if (index >= m_parameterCount || m_parameters[index] == DEFAULT_PARAMETER) {
+        return defaultValue;
+    }
+    return m_parameters[index];
 }
 
 void VT100Parser::handleControlCharacter(QChar ch)
@@ -360,257 +916,273 @@ void VT100Parser::handleControlCharacter(QChar ch)
     case 0x0D:  // CR - Carriage Return
         handleCarriageReturn();
         break;
+    case 0x0E:  // SO - Shift Out (invoke G1)
+        m_currentCharacterSet = 1;
+        m_commands->append(TerminalCommand::SelectCharacterSet, 1);
+        break;
+    case 0x0F:  // SI - Shift In (invoke G0)
+        m_currentCharacterSet = 0;
+        m_commands->append(TerminalCommand::SelectCharacterSet, 0);
+        break;
     }
 }
 
 void VT100Parser::handleBell()
 {
-    emit bell();
+    m_commands->append(TerminalCommand::Bell);
 }
 
 void VT100Parser::handleBackspace()
 {
-    emit cursorBackward(1);
+    m_commands->append(TerminalCommand::CursorBackward, 1);
 }
 
 void VT100Parser::handleTab()
 {
-    emit tabForward(1);
+    m_commands->append(TerminalCommand::TabForward, 1);
 }
 
 void VT100Parser::handleLineFeed()
 {
-    emit cursorDown(1);
+    m_commands->append(TerminalCommand::LineFeed);
 }
 
 void VT100Parser::handleVerticalTab()
 {
-    emit cursorDown(1);
+    m_commands->append(TerminalCommand::LineFeed);
 }
 
 void VT100Parser::handleFormFeed()
 {
-    emit clearScreen();
-    emit cursorPosition(0, 0);
+    m_commands->append(TerminalCommand::ClearScreen);
+    m_commands->append(TerminalCommand::CursorPosition, 0, 0);
 }
 
 void VT100Parser::handleCarriageReturn()
 {
-    emit cursorHorizontalAbsolute(0);
+    m_commands->append(TerminalCommand::CursorHorizontalAbsolute, 0);
 }
 
 // CSI command handlers
 void VT100Parser::handleCursorUp()
 {
-    int lines = m_parameters.isEmpty() ? 1 : qMax(1, m_parameters[0]);
-    emit cursorUp(lines);
+    int lines = qMax(1, parameter(0, 1));
+    m_commands->append(TerminalCommand::CursorUp, lines);
 }
 
 void VT100Parser::handleCursorDown()
 {
-    int lines = m_parameters.isEmpty() ? 1 : qMax(1, m_parameters[0]);
-    emit cursorDown(lines);
+    int lines = qMax(1, parameter(0, 1));
+    m_commands->append(TerminalCommand::CursorDown, lines);
 }
 
 void VT100Parser::handleCursorForward()
 {
-    int columns = m_parameters.isEmpty() ? 1 : qMax(1, m_parameters[0]);
-    emit cursorForward(columns);
+    int columns = qMax(1, parameter(0, 1));
+    m_commands->append(TerminalCommand::CursorForward, columns);
 }
 
 void VT100Parser::handleCursorBackward()
 {
-    int columns = m_parameters.isEmpty() ? 1 : qMax(1, m_parameters[0]);
-    emit cursorBackward(columns);
+    int columns = qMax(1, parameter(0, 1));
+    m_commands->append(TerminalCommand::CursorBackward, columns);
 }
 
 void VT100Parser::handleCursorNextLine()
 {
-    int lines = m_parameters.isEmpty() ? 1 : qMax(1, m_parameters[0]);
-    emit cursorNextLine(lines);
+    int lines = qMax(1, parameter(0, 1));
+    m_commands->append(TerminalCommand::CursorNextLine, lines);
 }
 
 void VT100Parser::handleCursorPreviousLine()
 {
-    int lines = m_parameters.isEmpty() ? 1 : qMax(1, m_parameters[0]);
-    emit cursorPreviousLine(lines);
+    int lines = qMax(1, parameter(0, 1));
+    m_commands->append(TerminalCommand::CursorPreviousLine, lines);
 }
 
 void VT100Parser::handleCursorHorizontalAbsolute()
 {
-    int column = m_parameters.isEmpty() ? 1 : qMax(1, m_parameters[0]);
-    emit cursorHorizontalAbsolute(column - 1);  // Convert to 0-based
+    int column = qMax(1, parameter(0, 1));
+    m_commands->append(TerminalCommand::CursorHorizontalAbsolute, column - 1);  // Convert to 0-based
 }
 
 void VT100Parser::handleCursorPosition()
 {
-    int row = m_parameters.size() > 0 ? qMax(1, m_parameters[0]) : 1;
-    int column = m_parameters.size() > 1 ? qMax(1, m_parameters[1]) : 1;
-    emit cursorPosition(row - 1, column - 1);  // Convert to 0-based
+    int row = qMax(1, parameter(0, 1));
+    int column = qMax(1, parameter(1, 1));
+    m_commands->append(TerminalCommand::CursorPosition, row - 1, column - 1);  // Convert to 0-based
 }
 
 void VT100Parser::handleEraseInDisplay()
 {
-    int mode = m_parameters.isEmpty() ? 0 : m_parameters[0];
+    int mode = parameter(0, 0);
     switch (mode) {
     case 0:  // Clear from cursor to end of screen
-        emit clearScreenFromCursor();
+        m_commands->append(TerminalCommand::ClearScreenFromCursor);
         break;
     case 1:  // Clear from beginning of screen to cursor
-        emit clearScreenToCursor();
+        m_commands->append(TerminalCommand::ClearScreenToCursor);
         break;
     case 2:  // Clear entire screen
+        m_commands->append(TerminalCommand::ClearScreen);
+        break;
     case 3:  // Clear entire screen and scrollback
-        emit clearScreen();
+        m_commands->append(TerminalCommand::ClearScreen);
+        m_commands->append(TerminalCommand::ClearHistory);
         break;
     }
 }
 
 void VT100Parser::handleEraseInLine()
 {
-    int mode = m_parameters.isEmpty() ? 0 : m_parameters[0];
+    int mode = parameter(0, 0);
     switch (mode) {
     case 0:  // Clear from cursor to end of line
-        emit clearLineFromCursor();
+        m_commands->append(TerminalCommand::ClearLineFromCursor);
         break;
     case 1:  // Clear from beginning of line to cursor
-        emit clearLineToCursor();
+        m_commands->append(TerminalCommand::ClearLineToCursor);
         break;
     case 2:  // Clear entire line
-        emit clearLine();
+        m_commands->append(TerminalCommand::ClearLine);
         break;
     }
 }
 
 void VT100Parser::handleInsertLines()
 {
-    int count = m_parameters.isEmpty() ? 1 : qMax(1, m_parameters[0]);
-    emit insertLines(count);
+    int count = qMax(1, parameter(0, 1));
+    m_commands->append(TerminalCommand::InsertLines, count);
 }
 
 void VT100Parser::handleDeleteLines()
 {
-    int count = m_parameters.isEmpty() ? 1 : qMax(1, m_parameters[0]);
-    emit deleteLines(count);
+    int count = qMax(1, parameter(0, 1));
+    m_commands->append(TerminalCommand::DeleteLines, count);
 }
 
 void VT100Parser::handleInsertCharacters()
 {
-    int count = m_parameters.isEmpty() ? 1 : qMax(1, m_parameters[0]);
-    emit insertCharacters(count);
+    int count = qMax(1, parameter(0, 1));
+    m_commands->append(TerminalCommand::InsertCharacters, count);
 }
 
 void VT100Parser::handleDeleteCharacters()
 {
-    int count = m_parameters.isEmpty() ? 1 : qMax(1, m_parameters[0]);
-    emit deleteCharacters(count);
+    int count = qMax(1, parameter(0, 1));
+    m_commands->append(TerminalCommand::DeleteCharacters, count);
 }
 
 void VT100Parser::handleEraseCharacters()
 {
-    int count = m_parameters.isEmpty() ? 1 : qMax(1, m_parameters[0]);
-    emit eraseCharacters(count);
+    int count = qMax(1, parameter(0, 1));
+    m_commands->append(TerminalCommand::EraseCharacters, count);
 }
 
 void VT100Parser::handleScrollUp()
 {
-    int lines = m_parameters.isEmpty() ? 1 : qMax(1, m_parameters[0]);
-    emit scrollUp(lines);
+    int lines = qMax(1, parameter(0, 1));
+    m_commands->append(TerminalCommand::ScrollUp, lines);
 }
 
 void VT100Parser::handleScrollDown()
 {
-    int lines = m_parameters.isEmpty() ? 1 : qMax(1, m_parameters[0]);
-    emit scrollDown(lines);
+    int lines = qMax(1, parameter(0, 1));
+    m_commands->append(TerminalCommand::ScrollDown, lines);
 }
 
 void VT100Parser::handleSelectGraphicRendition()
 {
-    if (m_parameters.isEmpty()) {
+    if (m_parameterCount == 0) {
         // Reset to default
-        m_currentForeground = TerminalColor::Default;
-        m_currentBackground = TerminalColor::Default;
+        m_currentForeground = colorValue(TerminalColor::Default);
+        m_currentBackground = colorValue(TerminalColor::Default);
         m_currentAttributes = TextAttribute::None;
     } else {
-        parseGraphicRendition(m_parameters);
+        parseGraphicRendition();
     }
     
-    emit setTextAttributes(m_currentForeground, m_currentBackground, m_currentAttributes);
+    m_commands->append(TerminalCommand::SetTextAttributes, static_cast<int>(m_currentForeground),
+                       static_cast<int>(m_currentBackground), static_cast<int>(m_currentAttributes));
 }
 
 void VT100Parser::handleSetScrollingRegion()
 {
-    int top = m_parameters.size() > 0 ? qMax(1, m_parameters[0]) : 1;
-    int bottom = m_parameters.size() > 1 ? qMax(1, m_parameters[1]) : 24;
-    emit setScrollingRegion(top - 1, bottom - 1);  // Convert to 0-based
+    int top = qMax(1, parameter(0, 1));
+    int bottom = qMax(1, parameter(1, 24));
+    m_commands->append(TerminalCommand::SetScrollingRegion, top - 1, bottom - 1);  // Convert to 0-based
 }
 
 void VT100Parser::handleSaveCursor()
 {
-    emit saveCursor();
+    m_commands->append(TerminalCommand::SaveCursor);
 }
 
 void VT100Parser::handleRestoreCursor()
 {
-    emit restoreCursor();
+    m_commands->append(TerminalCommand::RestoreCursor);
 }
 
 void VT100Parser::handleDeviceStatusReport()
 {
-    int mode = m_parameters.isEmpty() ? 0 : m_parameters[0];
+    int mode = parameter(0, 0);
     switch (mode) {
     case 5:  // Device status
-        emit deviceStatusReport();
+        m_commands->append(TerminalCommand::DeviceStatusReport);
         break;
     case 6:  // Cursor position
-        emit cursorPositionReport();
+        m_commands->append(TerminalCommand::CursorPositionReport);
         break;
     }
 }
 
 void VT100Parser::handleSetMode()
 {
-    for (int param : m_parameters) {
-        emit setMode(param, true);
+    for (int i = 0; i < m_parameterCount; ++i) {
+        const int param = m_parameters[i];
+        m_commands->append(TerminalCommand::SetMode, param, true);
     }
 }
 
 void VT100Parser::handleResetMode()
 {
-    for (int param : m_parameters) {
-        emit setMode(param, false);
+    for (int i = 0; i < m_parameterCount; ++i) {
+        const int param = m_parameters[i];
+        m_commands->append(TerminalCommand::SetMode, param, false);
     }
 }
 
 void VT100Parser::handleSetPrivateMode()
 {
-    for (int param : m_parameters) {
+    for (int i = 0; i < m_parameterCount; ++i) {
+        const int param = m_parameters[i];
         if (param == 1049 || param == 47) {
-            emit useAlternateScreenBuffer(true);
+            m_commands->append(TerminalCommand::UseAlternateScreenBuffer, true);
         }
-        emit setPrivateMode(param, true);
+        m_commands->append(TerminalCommand::SetPrivateMode, param, true);
     }
 }
 
 void VT100Parser::handleResetPrivateMode()
 {
-    for (int param : m_parameters) {
+    for (int i = 0; i < m_parameterCount; ++i) {
+        const int param = m_parameters[i];
         if (param == 1049 || param == 47) {
-            emit useAlternateScreenBuffer(false);
+            m_commands->append(TerminalCommand::UseAlternateScreenBuffer, false);
         }
-        emit setPrivateMode(param, false);
+        m_commands->append(TerminalCommand::SetPrivateMode, param, false);
     }
 }
 
-void VT100Parser::parseGraphicRendition(const QVector<int> &params)
+void VT100Parser::parseGraphicRendition()
 {
-    for (int i = 0; i < params.size(); ++i) {
-        int param = params[i];
+    for (int i = 0; i < m_parameterCount; ++i) {
+        int param = parameter(i, 0);
         
         switch (param) {
         case 0:  // Reset
-            m_currentForeground = TerminalColor::Default;
-            m_currentBackground = TerminalColor::Default;
+            m_currentForeground = colorValue(TerminalColor::Default);
+            m_currentBackground = colorValue(TerminalColor::Default);
             m_currentAttributes = TextAttribute::None;
             break;
         case 1:  // Bold
@@ -655,32 +1227,93 @@ void VT100Parser::parseGraphicRendition(const QVector<int> &params)
         default:
             if (param >= 30 && param <= 37) {
                 // Foreground colors
-                m_currentForeground = parseColor(param - 30);
+                m_currentForeground = colorValue(parseColor(param - 30));
             } else if (param >= 40 && param <= 47) {
                 // Background colors
-                m_currentBackground = parseColor(param - 40);
+                m_currentBackground = colorValue(parseColor(param - 40));
             } else if (param >= 90 && param <= 97) {
                 // Bright foreground colors
-                m_currentForeground = parseColor(param - 90, true);
+                m_currentForeground = colorValue(parseColor(param - 90, true));
             } else if (param >= 100 && param <= 107) {
                 // Bright background colors
-                m_currentBackground = parseColor(param - 100, true);
+                m_currentBackground = colorValue(parseColor(param - 100, true));
             } else if (param == 38 || param == 48) {
                 // Extended color sequences (256-color or RGB)
-                // This would require parsing additional parameters
-                // For now, skip to avoid complexity
+                ColorValue color;
+                if (parseExtendedColor(i, color)) {
+                    if (param == 38) {
+                        m_currentForeground = color;
+                    } else {
+                        m_currentBackground = color;
+                    }
+                }
+                continue;
             } else if (param == 39) {
                 // Default foreground
-                m_currentForeground = TerminalColor::Default;
+                m_currentForeground = colorValue(TerminalColor::Default);
             } else if (param == 49) {
                 // Default background
-                m_currentBackground = TerminalColor::Default;
+                m_currentBackground = colorValue(TerminalColor::Default);
             }
             break;
         }
+        
+        // Sub-parameters of other attributes (e.g. 4:3 curly underline) are ignored
+        while (isSubParameter(i + 1)) {
+            ++i;
+        }
     }
 }
 
+bool VT100Parser::parseExtendedColor(int &index, ColorValue &color)
+{
+    const int start = index;
+    
+    if (isSubParameter(start + 1)) {
+        // ITU T.416 form: 38:5:n or 38:2:[colorspace]:r:g:b
+        int end = start + 1;
+        while (isSubParameter(end)) {
+            ++end;
+        }
+        index = end - 1;
+        
+        const int count = end - start - 1;
+        const int mode = parameter(start + 1, 0);
+        if (mode == 5 && count >= 2) {
+            color = qBound(0, parameter(start + 2, 0), 255);
+            return true;
+        }
+        if (mode == 2 && count >= 4) {
+            // The color space id is present when there are four values after the mode
+            const int first = count >= 5 ? start + 3 : start + 2;
+            color = rgbColorValue(qBound(0, parameter(first, 0), 255),
+                                  qBound(0, parameter(first + 1, 0), 255),
+                                  qBound(0, parameter(first + 2, 0), 255));
+            return true;
+        }
+        return false;
+    }
+    
+    // Common semicolon form: 38;5;n or 38;2;r;g;b
+    const int mode = parameter(start + 1, 0);
+    if (mode == 5 && start + 2 < m_parameterCount) {
+        index = start + 2;
+        color = qBound(0, parameter(start + 2, 0), 255);
+        return true;
+    }
+    if (mode == 2 && start + 4 < m_parameterCount) {
+        index = start + 4;
+        color = rgbColorValue(qBound(0, parameter(start + 2, 0), 255),
+                              qBound(0, parameter(start + 3, 0), 255),
+                              qBound(0, parameter(start + 4, 0), 255));
+        return true;
+    }
+    
+    // Unknown or truncated: the remaining parameters cannot be interpreted
+    index = m_parameterCount;
+    return false;
+}
+
 TerminalColor VT100Parser::parseColor(int colorCode, bool bright)
 {
     if (bright) {
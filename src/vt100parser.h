@@ -5,6 +5,8 @@
 #include <QString>
 #include <QVector>
 #include "terminalchar.h"
+#include "utf8decoder.h"
+#include "terminalcommand.h"
 
 /**
  * @brief Parser state for VT100 escape sequence processing
@@ -20,11 +22,45 @@ enum class ParserState {
     APC              // Application Program Command (ESC _)
 };
 
+/**
+ * @brief States of the byte-level, table-driven parser engine
+ *
+ * Mirrors the DEC ANSI parser state diagram by Paul Williams
+ * (https://vt100.net/emu/dec_ansi_parser). The numeric values index the
+ * transition table, so they must stay below 16.
+ */
+enum class ByteParserState : quint8 {
+    Ground,
+    Escape,
+    EscapeIntermediate,
+    CsiEntry,
+    CsiParam,
+    CsiIntermediate,
+    CsiIgnore,
+    DcsEntry,
+    DcsParam,
+    DcsIntermediate,
+    DcsPassthrough,
+    DcsIgnore,
+    OscString,
+    SosPmApcString
+};
+
+/**
+ * @brief Selects which parser implementation processes incoming data
+ */
+enum class ParserEngine {
+    Legacy,          // QString based, one QChar at a time
+    TableDriven      // UTF-8 bytes through a state-transition table
+};
+
 /**
  * @brief VT100 escape sequence parser
  * 
- * This class parses VT100/ANSI escape sequences and emits signals
- * for terminal operations like cursor movement, text formatting, etc.
+ * This class parses VT100/ANSI escape sequences into TerminalCommands
+ * for operations like cursor movement, text formatting, etc. They are
+ * recorded into a command buffer when one is set, and emitted as signals
+ * at the end of each processData() call otherwise.
  */
 class VT100Parser : public QObject
 {
@@ -33,6 +69,20 @@ class VT100Parser : public QObject
 public:
     explicit VT100Parser(QObject *parent = nullptr);
     
+    /**
+     * @brief Select the parser engine; switching resets the parser state
+     */
+    void setEngine(ParserEngine engine);
+    ParserEngine engine() const { return m_engine; }
+    
+    /**
+     * @brief Record operations into buffer instead of emitting signals
+     *
+     * The caller applies and clears the buffer after each processData().
+     * Passing nullptr restores the signal interface.
+     */
+    void setCommandBuffer(TerminalCommandBuffer *buffer);
+    
     /**
      * @brief Process input data and parse escape sequences
      * @param data Input data to process
@@ -46,8 +96,13 @@ public:
     void reset();
 
 signals:
-    // Text output
-    void textReceived(const QString &text);
+    /**
+     * @brief A run of printable code points
+     *
+     * The buffer is owned by the parser and only valid for the duration of
+     * the emission, so receivers must be connected directly.
+     */
+    void textRunReceived(const uint *codepoints, int length);
     
     // Cursor operations
     void cursorUp(int lines);
@@ -58,6 +113,8 @@ signals:
     void cursorNextLine(int lines);
     void cursorPreviousLine(int lines);
     void cursorHorizontalAbsolute(int column);
+    void lineFeed();
+    void reverseIndex();
     void saveCursor();
     void restoreCursor();
     void hideCursor();
@@ -79,7 +136,7 @@ signals:
     void scrollDown(int lines);
     
     // Text attributes
-    void setTextAttributes(TerminalColor foreground, TerminalColor background, TextAttributes attributes);
+    void setTextAttributes(ColorValue foreground, ColorValue background, TextAttributes attributes);
     void resetTextAttributes();
     
     // Scrolling region
@@ -119,6 +176,7 @@ private:
     void processDCSSequence(QChar ch);
     
     void executeCSICommand();
+    void dispatchCSICommand();
     void executeOSCCommand();
     void executeDCSCommand();
     
@@ -126,6 +184,20 @@ private:
     void parseOSCParameters();
     
     void resetSequence();
+    int parameter(int index, int defaultValue) const;
+    
+    // Command recording
+    void flushTextBuffer();
+    void finishBatch();
+    void emitCommands(const TerminalCommandBuffer &commands);
+    
+    // Table-driven engine
+    void processBytes(const char *data, int length);
+    const uchar *printRun(const uchar *begin, const uchar *end);
+    void performAction(quint8 action, uchar byte);
+    void enterState(ByteParserState state);
+    void collectParameter(uchar byte);
+    void dispatchEscape(uchar finalByte);
     
     // Control character handlers
     void handleControlCharacter(QChar ch);
@@ -166,19 +238,46 @@ private:
     void handleResetPrivateMode();
     
     // Attribute parsing
-    void parseGraphicRendition(const QVector<int> &params);
+    void parseGraphicRendition();
     TerminalColor parseColor(int colorCode, bool bright = false);
+    bool parseExtendedColor(int &index, ColorValue &color);
+    bool isSubParameter(int index) const
+    {
+        return index < m_parameterCount && (m_subParameterMask & (1u << index));
+    }
+    
+    // Constants
+    static const int DEFAULT_PARAMETER = -1;
+    static const int MAX_PARAMETERS = 32;  // Bits of m_subParameterMask
+    static const int MAX_INTERMEDIATES = 2;
+    static const int MAX_STRING_LENGTH = 4096;
     
     // Parser state
+    ParserEngine m_engine;
+    TerminalCommandBuffer m_ownCommands;
+    TerminalCommandBuffer *m_commands;
     ParserState m_state;
     QString m_sequence;
-    QVector<int> m_parameters;
     QString m_intermediateChars;
     QChar m_finalChar;
     
+    // CSI parameters shared by both engines
+    int m_parameters[MAX_PARAMETERS];
+    int m_parameterCount;
+    quint32 m_subParameterMask;  // Parameters introduced by ':' rather than ';'
+    char m_privateMarker;
+    
+    // Table-driven engine state
+    ByteParserState m_byteState;
+    char m_intermediates[MAX_INTERMEDIATES];
+    int m_intermediateCount;
+    bool m_parameterOverflow;
+    QByteArray m_stringBuffer;
+    Utf8Decoder m_utf8Decoder;
+    
     // Current text attributes
-    TerminalColor m_currentForeground;
-    TerminalColor m_currentBackground;
+    ColorValue m_currentForeground;
+    ColorValue m_currentBackground;
     TextAttributes m_currentAttributes;
     
     // Character sets
@@ -189,10 +288,6 @@ private:
     QString m_textBuffer;
 
     QChar mapCharacter(QChar ch);
-    
-    // Constants
-    static const int DEFAULT_PARAMETER = -1;
-    static const int MAX_PARAMETERS = 16;
 };
 
 #endif // VT100PARSER_H
@@ -1,4 +1,7 @@
 #include "vt100terminal.h"
+#include "terminalglview.h"
+#include "terminalsearchbar.h"
+#include "scrollbacksegments.h"
 #include <QPainter>
 #include <QKeyEvent>
 #include <QMouseEvent>
@@ -7,15 +10,26 @@
 #include <QFocusEvent>
 #include <QScrollBar>
 #include <QApplication>
+#include <QScreen>
+#include <QSignalBlocker>
 #include <QClipboard>
-#include <QFontMetrics>
+#include <QPaintEvent>
+#include <QRegion>
+#include <QThread>
 #include <QDebug>
+#include <algorithm>
 
 VT100Terminal::VT100Terminal(QWidget *parent)
     : QWidget(parent)
-    , m_screen(nullptr)
-    , m_parser(nullptr)
+    , m_worker(nullptr)
+    , m_workerThread(nullptr)
     , m_scrollBar(nullptr)
+    , m_glView(nullptr)
+    , m_renderer(TerminalRenderer::Raster)
+    , m_rows(0)
+    , m_columns(0)
+    , m_parserEngine(ParserEngine::TableDriven)
+    , m_scrollbackOnDisk(false)
     , m_font("Courier New", 10)
     , m_charWidth(8)
     , m_charHeight(12)
@@ -27,12 +41,33 @@ VT100Terminal::VT100Terminal(QWidget *parent)
     , m_cursorBlinking(true)
     , m_cursorBlinkState(true)
     , m_cursorBlinkTimer(nullptr)
-    , m_hasSelection(false)
     , m_selecting(false)
+    , m_searchBar(nullptr)
+    , m_searchTimer(nullptr)
+    , m_searchSerial(0)
+    , m_currentMatch(-1)
     , m_scrollOffset(0)
+    , m_damageGeneration(0)
+    , m_frameTimer(nullptr)
+    , m_scrollBarDirty(false)
+    , m_resizeTimer(nullptr)
+    , m_settleTimer(nullptr)
+    , m_pendingRows(0)
+    , m_pendingColumns(0)
+    , m_echoLine(0)
+    , m_echoColumn(0)
+    , m_echoGeneration(0)
+    , m_echoShown(false)
     , m_hasFocus(false)
     , m_appCursorKeys(false)
+    , m_bracketedPaste(false)
 {
+    // Palette lookup table for cell colors 0-255
+    m_palette.reserve(256);
+    for (int i = 0; i < 256; ++i) {
+        m_palette.append(QColor(TerminalColorPalette::indexedColor(i)));
+    }
+    
     setupUI();
     setupConnections();
     
@@ -48,17 +83,21 @@ VT100Terminal::VT100Terminal(QWidget *parent)
 
 VT100Terminal::~VT100Terminal()
 {
-    delete m_screen;
-    delete m_parser;
+    // The worker is deleted on the thread's way out
+    m_workerThread->quit();
+    m_workerThread->wait();
 }
 
 void VT100Terminal::setupUI()
 {
-    // Create terminal screen
-    m_screen = new TerminalScreen(24, 80, this);
-    
-    // Create VT100 parser
-    m_parser = new VT100Parser(this);
+    // Create the parser and screen on a thread of their own
+    m_worker = new TerminalWorker(24, 80);
+    m_snapshot = m_worker->takeSnapshot();
+    m_rows = m_snapshot.rows;
+    m_columns = m_snapshot.columns;
+    m_workerThread = new QThread(this);
+    m_worker->moveToThread(m_workerThread);
+    m_workerThread->start();
     
     // Create scroll bar
     m_scrollBar = new QScrollBar(Qt::Vertical, this);
@@ -68,6 +107,33 @@ void VT100Terminal::setupUI()
     m_cursorBlinkTimer = new QTimer(this);
     m_cursorBlinkTimer->setInterval(CURSOR_BLINK_INTERVAL);
     
+    // Create frame timer; repaints are paced to the display refresh rate
+    qreal refreshRate = DEFAULT_REFRESH_RATE;
+    if (QScreen *screen = QGuiApplication::primaryScreen()) {
+        if (screen->refreshRate() > 1.0) {
+            refreshRate = screen->refreshRate();
+        }
+    }
+    m_frameTimer = new QTimer(this);
+    m_frameTimer->setSingleShot(true);
+    m_frameTimer->setTimerType(Qt::PreciseTimer);
+    m_frameTimer->setInterval(qMax(1, qRound(1000.0 / refreshRate)));
+    
+    // Create resize timers; a drag reflows the grid a few times per second, the remote once
+    m_resizeTimer = new QTimer(this);
+    m_resizeTimer->setSingleShot(true);
+    m_resizeTimer->setInterval(RESIZE_INTERVAL);
+    m_settleTimer = new QTimer(this);
+    m_settleTimer->setSingleShot(true);
+    m_settleTimer->setInterval(RESIZE_SETTLE_DELAY);
+    
+    // Create search bar, hidden until asked for
+    m_searchBar = new TerminalSearchBar(this);
+    m_searchBar->hide();
+    m_searchTimer = new QTimer(this);
+    m_searchTimer->setSingleShot(true);
+    m_searchTimer->setInterval(SEARCH_DELAY);
+    
     // Calculate character dimensions
     calculateCharacterSize();
     
@@ -80,57 +146,39 @@ void VT100Terminal::setupUI()
 
 void VT100Terminal::setupConnections()
 {
-    // Connect screen signals
-    connect(m_screen, &TerminalScreen::screenChanged, this, &VT100Terminal::onScreenChanged);
-    connect(m_screen, &TerminalScreen::cursorPositionChanged, this, &VT100Terminal::onCursorPositionChanged);
-    connect(m_screen, &TerminalScreen::cursorVisibilityChanged, this, &VT100Terminal::onCursorVisibilityChanged);
-    connect(m_screen, &TerminalScreen::screenResized, this, &VT100Terminal::onScreenResized);
-    
-    // Connect parser signals to screen operations
-    connect(m_parser, &VT100Parser::textReceived, this, &VT100Terminal::onTextReceived);
-    connect(m_parser, &VT100Parser::cursorUp, this, &VT100Terminal::onCursorUp);
-    connect(m_parser, &VT100Parser::cursorDown, this, &VT100Terminal::onCursorDown);
-    connect(m_parser, &VT100Parser::cursorForward, this, &VT100Terminal::onCursorForward);
-    connect(m_parser, &VT100Parser::cursorBackward, this, &VT100Terminal::onCursorBackward);
-    connect(m_parser, &VT100Parser::cursorPosition, this, &VT100Terminal::onCursorPosition);
-    connect(m_parser, &VT100Parser::cursorNextLine, this, &VT100Terminal::onCursorNextLine);
-    connect(m_parser, &VT100Parser::cursorPreviousLine, this, &VT100Terminal::onCursorPreviousLine);
-    connect(m_parser, &VT100Parser::cursorHorizontalAbsolute, this, &VT100Terminal::onCursorHorizontalAbsolute);
-    connect(m_parser, &VT100Parser::saveCursor, this, &VT100Terminal::onSaveCursor);
-    connect(m_parser, &VT100Parser::restoreCursor, this, &VT100Terminal::onRestoreCursor);
-    connect(m_parser, &VT100Parser::hideCursor, this, &VT100Terminal::onHideCursor);
-    connect(m_parser, &VT100Parser::showCursor, this, &VT100Terminal::onShowCursor);
-    connect(m_parser, &VT100Parser::useAlternateScreenBuffer, this, &VT100Terminal::onUseAlternateScreenBuffer);
-    connect(m_parser, &VT100Parser::clearScreen, this, &VT100Terminal::onClearScreen);
-    connect(m_parser, &VT100Parser::clearScreenFromCursor, this, &VT100Terminal::onClearScreenFromCursor);
-    connect(m_parser, &VT100Parser::clearScreenToCursor, this, &VT100Terminal::onClearScreenToCursor);
-    connect(m_parser, &VT100Parser::clearLine, this, &VT100Terminal::onClearLine);
-    connect(m_parser, &VT100Parser::clearLineFromCursor, this, &VT100Terminal::onClearLineFromCursor);
-    connect(m_parser, &VT100Parser::clearLineToCursor, this, &VT100Terminal::onClearLineToCursor);
-    connect(m_parser, &VT100Parser::insertLines, this, &VT100Terminal::onInsertLines);
-    connect(m_parser, &VT100Parser::deleteLines, this, &VT100Terminal::onDeleteLines);
-    connect(m_parser, &VT100Parser::insertCharacters, this, &VT100Terminal::onInsertCharacters);
-    connect(m_parser, &VT100Parser::deleteCharacters, this, &VT100Terminal::onDeleteCharacters);
-    connect(m_parser, &VT100Parser::eraseCharacters, this, &VT100Terminal::onEraseCharacters);
-    connect(m_parser, &VT100Parser::scrollUp, this, &VT100Terminal::onScrollUp);
-    connect(m_parser, &VT100Parser::scrollDown, this, &VT100Terminal::onScrollDown);
-    connect(m_parser, &VT100Parser::setTextAttributes, this, &VT100Terminal::onSetTextAttributes);
-    connect(m_parser, &VT100Parser::resetTextAttributes, this, &VT100Terminal::onResetTextAttributes);
-    connect(m_parser, &VT100Parser::setScrollingRegion, this, &VT100Terminal::onSetScrollingRegion);
-    connect(m_parser, &VT100Parser::setTabStop, this, &VT100Terminal::onSetTabStop);
-    connect(m_parser, &VT100Parser::clearTabStop, this, &VT100Terminal::onClearTabStop);
-    connect(m_parser, &VT100Parser::clearAllTabStops, this, &VT100Terminal::onClearAllTabStops);
-    connect(m_parser, &VT100Parser::tabForward, this, &VT100Terminal::onTabForward);
-    connect(m_parser, &VT100Parser::tabBackward, this, &VT100Terminal::onTabBackward);
-    connect(m_parser, &VT100Parser::setPrivateMode, this, &VT100Terminal::onSetPrivateMode);
-    connect(m_parser, &VT100Parser::bell, this, &VT100Terminal::onBell);
+    // Connect worker signals; they arrive queued from the worker thread
+    connect(m_workerThread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(m_worker, &TerminalWorker::snapshotReady, this, &VT100Terminal::onSnapshotReady);
+    connect(m_worker, &TerminalWorker::applicationCursorKeysChanged, this, &VT100Terminal::setApplicationCursorKeys);
+    connect(m_worker, &TerminalWorker::bracketedPasteChanged, this, [this](bool enable) {
+        m_bracketedPaste = enable;
+    });
+    connect(m_worker, &TerminalWorker::bell, this, &VT100Terminal::bell);
+    connect(m_worker, &TerminalWorker::backlogDrained, this, &VT100Terminal::backlogDrained);
+    qRegisterMetaType<QVector<TerminalSearchMatch>>();
+    connect(m_worker, &TerminalWorker::searchFinished, this, &VT100Terminal::onSearchFinished);
+    connect(m_worker, &TerminalWorker::textReady, this, [](int tag, const QString &text) {
+        if (!text.isEmpty()) {
+            QApplication::clipboard()->setText(text, static_cast<QClipboard::Mode>(tag));
+        }
+    });
     
     // Connect cursor blink timer
     connect(m_cursorBlinkTimer, &QTimer::timeout, this, &VT100Terminal::onCursorBlink);
+    connect(m_frameTimer, &QTimer::timeout, this, &VT100Terminal::onFrameTimeout);
+    connect(m_resizeTimer, &QTimer::timeout, this, &VT100Terminal::onResizeTimeout);
+    connect(m_settleTimer, &QTimer::timeout, this, &VT100Terminal::onResizeSettled);
     
     // Connect scroll bar
     connect(m_scrollBar, &QScrollBar::valueChanged, this, &VT100Terminal::onScrollBarValueChanged);
     
+    // Connect search bar
+    connect(m_searchBar, &TerminalSearchBar::queryChanged, this, &VT100Terminal::onSearchQueryChanged);
+    connect(m_searchBar, &TerminalSearchBar::nextRequested, this, &VT100Terminal::findNext);
+    connect(m_searchBar, &TerminalSearchBar::previousRequested, this, &VT100Terminal::findPrevious);
+    connect(m_searchBar, &TerminalSearchBar::closed, this, &VT100Terminal::onSearchBarClosed);
+    connect(m_searchTimer, &QTimer::timeout, this, &VT100Terminal::onSearchTimeout);
+    
     // Start cursor blinking if enabled
     if (m_cursorBlinking) {
         m_cursorBlinkTimer->start();
@@ -139,10 +187,16 @@ void VT100Terminal::setupConnections()
 
 void VT100Terminal::calculateCharacterSize()
 {
-    QFontMetrics metrics(m_font);
-    m_charWidth = metrics.horizontalAdvance('M');  // Use 'M' as it's typically the widest character
-    m_charHeight = metrics.height();
-    m_charBaseline = metrics.ascent();
+    // Font variants and metrics are measured once here, not while painting
+    m_glyphCache.setFont(m_font);
+    m_charWidth = m_glyphCache.cellWidth();
+    m_charHeight = m_glyphCache.cellHeight();
+    m_charBaseline = m_glyphCache.baseline();
+#ifndef QTISSH_NO_OPENGL
+    if (m_glView) {
+        m_glView->setCellFont(m_font);
+    }
+#endif
 }
 
 void VT100Terminal::setFont(const QFont &font)
@@ -150,41 +204,97 @@ void VT100Terminal::setFont(const QFont &font)
     m_font = font;
     calculateCharacterSize();
     updateTerminalSize();
-    update();
+    updateView();
 }
 
 void VT100Terminal::setTerminalSize(int rows, int columns)
 {
-    if (m_screen) {
-        m_screen->resize(rows, columns);
-        updateTerminalSize();
-        updateScrollBar();
-        emit terminalSizeChanged(rows, columns);
+    // A width change reflows the screen, which renumbers the selected lines
+    if (columns != m_columns) {
+        m_selection.clear();
     }
+    m_rows = rows;
+    m_columns = columns;
+    QMetaObject::invokeMethod(m_worker, "resize", Qt::QueuedConnection,
+                              Q_ARG(int, rows), Q_ARG(int, columns));
+    updateTerminalSize();
+    updateScrollBar();
+    emit terminalSizeChanged(rows, columns);
+    m_settleTimer->start();
 }
 
 int VT100Terminal::terminalRows() const
 {
-    return m_screen ? m_screen->rows() : 0;
+    return m_rows;
 }
 
 int VT100Terminal::terminalColumns() const
 {
-    return m_screen ? m_screen->columns() : 0;
+    return m_columns;
 }
 
 bool VT100Terminal::useAlternateBuffer() const
 {
-    return m_screen ? m_screen->useAlternateBuffer() : false;
+    // As of the last snapshot; the worker may already be further along
+    return m_snapshot.alternateBuffer;
 }
 
-void VT100Terminal::updateTerminalSize()
+void VT100Terminal::setParserEngine(ParserEngine engine)
 {
-    if (!m_screen) return;
+    m_parserEngine = engine;
+    QMetaObject::invokeMethod(m_worker, "setParserEngine", Qt::QueuedConnection,
+                              Q_ARG(int, static_cast<int>(engine)));
+}
+
+ParserEngine VT100Terminal::parserEngine() const
+{
+    return m_parserEngine;
+}
+
+void VT100Terminal::setRenderer(TerminalRenderer renderer)
+{
+#ifndef QTISSH_NO_OPENGL
+    if (renderer == TerminalRenderer::OpenGL && !TerminalGLView::isSupported()) {
+        qWarning() << "OpenGL 3.3 / ES 3.0 not available, using the QPainter renderer";
+        renderer = TerminalRenderer::Raster;
+    }
+#else
+    renderer = TerminalRenderer::Raster;
+#endif
     
+    if (renderer == m_renderer) {
+        return;
+    }
+    m_renderer = renderer;
+    
+#ifndef QTISSH_NO_OPENGL
+    if (renderer == TerminalRenderer::OpenGL) {
+        // The view covers the text area and redraws the whole grid per frame
+        m_glView = new TerminalGLView(this);
+        m_glView->setCellFont(m_font);
+        connect(m_glView, &TerminalGLView::unavailable, this, &VT100Terminal::onRendererUnavailable);
+        updateTerminalSize();
+        m_glView->show();
+        m_scrollBar->raise();
+        m_searchBar->raise();
+    } else {
+        delete m_glView;
+        m_glView = nullptr;
+    }
+#endif
+    updateView();
+}
+
+void VT100Terminal::onRendererUnavailable()
+{
+    setRenderer(TerminalRenderer::Raster);
+}
+
+void VT100Terminal::updateTerminalSize()
+{
     // Calculate required widget size
-    int requiredWidth = m_screen->columns() * m_charWidth + m_scrollBar->sizeHint().width();
-    int requiredHeight = m_screen->rows() * m_charHeight;
+    int requiredWidth = m_columns * m_charWidth + m_scrollBar->sizeHint().width();
+    int requiredHeight = m_rows * m_charHeight;
     
     // Update minimum size
     setMinimumSize(requiredWidth, requiredHeight);
@@ -192,15 +302,21 @@ void VT100Terminal::updateTerminalSize()
     // Position scroll bar
     m_scrollBar->setGeometry(width() - m_scrollBar->sizeHint().width(), 0, 
                             m_scrollBar->sizeHint().width(), height());
+#ifndef QTISSH_NO_OPENGL
+    if (m_glView) {
+        m_glView->setGeometry(0, 0, width() - m_scrollBar->sizeHint().width(), height());
+    }
+#endif
+    updateSearchBarGeometry();
 }
 
 void VT100Terminal::updateScrollBar()
 {
-    if (!m_screen) return;
-    
-    int historySize = m_screen->historySize();
-    int screenRows = m_screen->rows();
+    int historySize = m_snapshot.historySize;
+    int screenRows = m_rows;
     
+    // Mirrors our own state, so don't feed it back through valueChanged
+    const QSignalBlocker blocker(m_scrollBar);
     m_scrollBar->setRange(0, historySize);
     m_scrollBar->setPageStep(screenRows);
     m_scrollBar->setSingleStep(1);
@@ -209,34 +325,81 @@ void VT100Terminal::updateScrollBar()
 
 void VT100Terminal::writeData(const QByteArray &data)
 {
-    if (m_parser) {
-        m_parser->processData(data);
-    }
+    m_worker->queueData(data);
 }
 
 void VT100Terminal::writeData(const QString &data)
 {
-    if (m_parser) {
-        m_parser->processData(data);
+    QMetaObject::invokeMethod(m_worker, "processText", Qt::QueuedConnection, Q_ARG(QString, data));
+}
+
+bool VT100Terminal::isBacklogged() const
+{
+    return m_worker->isBacklogged();
+}
+
+void VT100Terminal::markInput()
+{
+    // A key that got no echo must not hold the timer for the next one
+    if (m_echoTimer.isValid() && m_echoTimer.elapsed() <= ECHO_TIMEOUT) {
+        return;
     }
+    m_echoTimer.start();
+    m_echoShown = false;
+    m_echoLine = m_snapshot.firstLine + m_snapshot.cursor.row;
+    m_echoColumn = m_snapshot.cursor.column;
+    m_echoGeneration = m_snapshot.rowGenerations.value(m_snapshot.cursor.row);
 }
 
-void VT100Terminal::clear()
+void VT100Terminal::checkInputEcho()
 {
-    if (m_screen) {
-        m_screen->clear();
-        m_scrollOffset = 0;
-        updateScrollBar();
-        update();
+    // Keys the remote side does not echo (passwords, some full-screen
+    // programs) would otherwise be paired with unrelated later output
+    if (m_echoTimer.elapsed() > ECHO_TIMEOUT) {
+        m_echoTimer.invalidate();
+        return;
+    }
+    const int row = m_snapshot.cursor.row;
+    const qint64 line = m_snapshot.firstLine + row;
+    if (line != m_echoLine) {
+        // Other output moved the cursor; the echo is still due on its new row
+        m_echoLine = line;
+        m_echoColumn = m_snapshot.cursor.column;
+        m_echoGeneration = m_snapshot.rowGenerations.value(row);
+        return;
+    }
+    // Output that leaves the cursor row alone is not the echo
+    if (m_snapshot.cursor.column != m_echoColumn
+            || m_snapshot.rowGenerations.value(row) > m_echoGeneration) {
+        m_echoShown = true;
     }
 }
 
+void VT100Terminal::framePainted()
+{
+    if (!m_echoShown) return;
+    const qint64 elapsed = m_echoTimer.elapsed();
+    m_echoTimer.invalidate();
+    m_echoShown = false;
+    emit inputEchoed(int(elapsed));
+}
+
+void VT100Terminal::clear()
+{
+    QMetaObject::invokeMethod(m_worker, "clear", Qt::QueuedConnection);
+    m_selection.clear();
+    m_scrollOffset = 0;
+    updateScrollBar();
+    updateView();
+}
+
 void VT100Terminal::reset()
 {
-    if (m_parser) {
-        m_parser->reset();
-    }
-    clear();
+    QMetaObject::invokeMethod(m_worker, "reset", Qt::QueuedConnection);
+    m_selection.clear();
+    m_scrollOffset = 0;
+    updateScrollBar();
+    updateView();
 }
 
 void VT100Terminal::setCursorBlinking(bool blink)
@@ -248,13 +411,13 @@ void VT100Terminal::setCursorBlinking(bool blink)
         m_cursorBlinkTimer->stop();
         m_cursorBlinkState = true;
     }
-    update();
+    updateView();
 }
 
 void VT100Terminal::setCursorStyle(CursorStyle style)
 {
     m_cursorStyle = style;
-    update();
+    updateView(cursorRect());
 }
 
 void VT100Terminal::setApplicationCursorKeys(bool enable)
@@ -272,10 +435,7 @@ void VT100Terminal::setApplicationCursorKeysLocal(bool enable)
 
 void VT100Terminal::copy()
 {
-    QString text = selectedText();
-    if (!text.isEmpty()) {
-        QApplication::clipboard()->setText(text);
-    }
+    copySelection(QClipboard::Clipboard);
 }
 
 void VT100Terminal::paste()
@@ -288,15 +448,25 @@ void VT100Terminal::paste()
 
 void VT100Terminal::setScrollbackLines(int lines)
 {
-    if (m_screen) {
-        m_screen->setMaxHistorySize(lines);
-        updateScrollBar();
-    }
+    QMetaObject::invokeMethod(m_worker, "setMaxHistorySize", Qt::QueuedConnection, Q_ARG(int, lines));
 }
 
 int VT100Terminal::scrollbackLines() const
 {
-    return m_screen ? m_screen->historySize() : 0;
+    return m_snapshot.historySize;
+}
+
+void VT100Terminal::setScrollbackOnDisk(bool enable)
+{
+    m_scrollbackOnDisk = enable;
+    const QString directory = enable ? ScrollbackSegments::defaultDirectory() : QString();
+    QMetaObject::invokeMethod(m_worker, "setHistorySpillDirectory", Qt::QueuedConnection,
+                              Q_ARG(QString, directory));
+}
+
+bool VT100Terminal::scrollbackOnDisk() const
+{
+    return m_scrollbackOnDisk;
 }
 
 void VT100Terminal::scrollToBottom()
@@ -322,14 +492,19 @@ void VT100Terminal::scrollDown(int lines)
 void VT100Terminal::setScrollOffset(int offset)
 {
     int maxOffset = maxScrollOffset();
-    m_scrollOffset = qBound(0, offset, maxOffset);
+    offset = qBound(0, offset, maxOffset);
+    if (offset != m_scrollOffset) {
+        // The worker sends the scrollback rows that come into view
+        QMetaObject::invokeMethod(m_worker, "setViewOffset", Qt::QueuedConnection, Q_ARG(int, offset));
+    }
+    m_scrollOffset = offset;
     updateScrollBar();
-    update();
+    updateView();
 }
 
 int VT100Terminal::maxScrollOffset() const
 {
-    return m_screen ? m_screen->historySize() : 0;
+    return m_snapshot.historySize;
 }
 
 void VT100Terminal::setColorScheme(const QColor &foreground, const QColor &background)
@@ -347,47 +522,52 @@ void VT100Terminal::setDefaultColors(const QColor &foreground, const QColor &bac
     palette.setColor(QPalette::Window, background);
     setPalette(palette);
     
-    update();
+    updateView();
 }
 
 // Event handlers will be implemented in the next part due to size constraints
 void VT100Terminal::paintEvent(QPaintEvent *event)
 {
-    Q_UNUSED(event)
-    
-    if (!m_screen) return;
+    if (m_glView) return;  // The OpenGL view draws the text area
     
     QPainter painter(this);
     painter.setFont(m_font);
     
-    // Fill background
-    painter.fillRect(rect(), m_defaultBackground);
-    
-    // Calculate visible area
-    int startRow = qMax(0, -m_scrollOffset);
-    int endRow = qMin(m_screen->rows() - 1, startRow + height() / m_charHeight);
-    
-    // Draw characters
-    for (int row = startRow; row <= endRow; ++row) {
-        for (int col = 0; col < m_screen->columns(); ++col) {
-            TerminalChar ch = m_screen->getChar(row, col);
-            QRect charRect = getCharacterRect(row, col);
-            
-            if (charRect.intersects(event->rect())) {
-                drawCharacter(painter, row, col, ch, charRect);
-            }
+    m_glyphCache.setDevicePixelRatio(devicePixelRatioF());
+    
+    // Only the cells under the damaged rectangles are redrawn
+    for (const QRect &damage : event->region()) {
+        painter.fillRect(damage, m_defaultBackground);
+        
+        const int startRow = qMax(-m_scrollOffset, damage.top() / m_charHeight - m_scrollOffset);
+        const int endRow = qMin(m_snapshot.rows - 1, damage.bottom() / m_charHeight - m_scrollOffset);
+        const int startColumn = qMax(0, damage.left() / m_charWidth);
+        const int endColumn = qMin(m_snapshot.columns - 1, damage.right() / m_charWidth);
+        
+        for (int row = startRow; row <= endRow; ++row) {
+            drawRow(painter, row, startColumn, endColumn);
         }
     }
     
-    // Draw selection
-    if (m_hasSelection) {
-        drawSelection(painter);
+    // Search matches are tinted over the text
+    if (!m_searchMatches.isEmpty()) {
+        const QRect bounds = event->region().boundingRect();
+        QVector<QRect> current;
+        for (const QRect &match : matchRects(bounds.top() / m_charHeight - m_scrollOffset,
+                                             bounds.bottom() / m_charHeight - m_scrollOffset, &current)) {
+            painter.fillRect(match, searchMatchColor(false));
+        }
+        for (const QRect &match : current) {
+            painter.fillRect(match, searchMatchColor(true));
+        }
     }
     
     // Draw cursor
-    if (m_cursorVisible && m_cursorBlinkState && m_hasFocus && m_scrollOffset == 0) {
+    if (m_cursorVisible && m_cursorBlinkState && m_hasFocus && m_scrollOffset == 0
+            && event->region().intersects(cursorRect())) {
         drawCursor(painter);
     }
+    framePainted();
 }
 
 QRect VT100Terminal::getCharacterRect(int row, int column) const
@@ -397,50 +577,93 @@ QRect VT100Terminal::getCharacterRect(int row, int column) const
     return QRect(x, y, m_charWidth, m_charHeight);
 }
 
-void VT100Terminal::drawCharacter(QPainter &painter, int row, int column, const TerminalChar &ch, const QRect &charRect)
+QRect VT100Terminal::cursorRect() const
+{
+    // The block outline is drawn one pixel past the cell on the right and bottom
+    const CursorPosition pos = m_snapshot.cursor;
+    return getCharacterRect(pos.row, pos.column).adjusted(0, 0, 1, 1);
+}
+
+void VT100Terminal::drawRow(QPainter &painter, int row, int startColumn, int endColumn)
+{
+    const TerminalCell *cells = m_snapshot.rowCells(row);
+    if (!cells) return;
+    
+    // Adjacent cells sharing a style id and selection state are drawn as one run
+    int column = startColumn;
+    while (column <= endColumn) {
+        bool selected;
+        const int end = runEnd(row, cells, column, endColumn, &selected);
+        drawRun(painter, row, column, cells + column, end - column,
+                m_snapshot.style(cells[column].style), selected);
+        column = end;
+    }
+}
+
+int VT100Terminal::runEnd(int row, const TerminalCell *cells, int column, int endColumn, bool *selected) const
+{
+    // Runs also break where the selected span of the line starts or ends
+    int limit = endColumn + 1;
+    int first;
+    int last;
+    *selected = false;
+    if (m_selection.span(m_snapshot.firstLine + row, first, last)) {
+        if (column < first) {
+            limit = qMin(limit, first);
+        } else if (column < last) {
+            *selected = true;
+            limit = qMin(limit, last);
+        }
+    }
+    
+    const quint32 styleId = cells[column].style;
+    int end = column + 1;
+    while (end < limit && cells[end].style == styleId) {
+        ++end;
+    }
+    return end;
+}
+
+void VT100Terminal::drawRun(QPainter &painter, int row, int column, const TerminalCell *cells, int length,
+                            const TerminalStyle &style, bool selected)
 {
-    Q_UNUSED(row)
-    Q_UNUSED(column)
     // Get colors
-    QColor fg = getCharacterColor(ch.foregroundColor, true);
-    QColor bg = getCharacterColor(ch.backgroundColor, false);
+    QColor fg = getCharacterColor(style.foreground, true);
+    QColor bg = getCharacterColor(style.background, false);
     
-    // Handle reverse attribute
-    if (ch.attributes & TextAttribute::Reverse) {
+    // Handle reverse attribute; selected cells are shown inverted
+    if (bool(style.attributes & TextAttribute::Reverse) != selected) {
         qSwap(fg, bg);
     }
     
+    const QRect runRect = getCharacterRect(row, column).united(getCharacterRect(row, column + length - 1));
+    
     // Draw background
     if (bg != m_defaultBackground) {
-        painter.fillRect(charRect, bg);
+        painter.fillRect(runRect, bg);
     }
     
-    // Draw character
-    if (ch.character != ' ') {
-        painter.setPen(fg);
-        painter.setFont(getCharacterFont(ch.attributes));
-        painter.drawText(charRect, Qt::AlignLeft | Qt::AlignTop, ch.character);
-    }
+    // Draw glyphs from the atlas
+    m_glyphCache.drawRun(painter, runRect.topLeft(), cells, length, fg.rgb(),
+                         GlyphCache::variant(style.attributes));
     
     // Draw underline
-    if (ch.attributes & TextAttribute::Underline) {
+    if (style.attributes & TextAttribute::Underline) {
         painter.setPen(fg);
-        painter.drawLine(charRect.bottomLeft(), charRect.bottomRight());
+        painter.drawLine(runRect.bottomLeft(), runRect.bottomRight());
     }
     
     // Draw strikethrough
-    if (ch.attributes & TextAttribute::Strikethrough) {
+    if (style.attributes & TextAttribute::Strikethrough) {
         painter.setPen(fg);
-        int y = charRect.top() + charRect.height() / 2;
-        painter.drawLine(charRect.left(), y, charRect.right(), y);
+        int y = runRect.top() + runRect.height() / 2;
+        painter.drawLine(runRect.left(), y, runRect.right(), y);
     }
 }
 
 void VT100Terminal::drawCursor(QPainter &painter)
 {
-    if (!m_screen) return;
-    
-    CursorPosition pos = m_screen->cursorPosition();
+    CursorPosition pos = m_snapshot.cursor;
     QRect cursorRect = getCharacterRect(pos.row, pos.column);
     
     painter.setPen(m_defaultForeground);
@@ -458,307 +681,157 @@ void VT100Terminal::drawCursor(QPainter &painter)
     }
 }
 
-void VT100Terminal::drawSelection(QPainter &painter)
-{
-    // Selection drawing implementation
-    painter.setCompositionMode(QPainter::CompositionMode_Difference);
-    painter.fillRect(rect(), QColor(255, 255, 255, 128));
-}
-
 QColor VT100Terminal::getCharacterColor(TerminalColor color, bool isForeground) const
 {
+    const int index = static_cast<int>(color);
+    if (index < m_palette.size()) {
+        return m_palette.at(index);
+    }
     if (color == TerminalColor::Default) {
         return isForeground ? m_defaultForeground : m_defaultBackground;
     }
-    return TerminalColorPalette::getColor(color);
-}
-
-QFont VT100Terminal::getCharacterFont(TextAttributes attributes) const
-{
-    QFont font = m_font;
-    
-    if (attributes & TextAttribute::Bold) {
-        font.setBold(true);
-    }
-    if (attributes & TextAttribute::Italic) {
-        font.setItalic(true);
-    }
-    
-    return font;
+    return QColor(m_snapshot.trueColor(color));
 }
 
 // Slot implementations
-void VT100Terminal::onTextReceived(const QString &text)
-{
-    if (m_screen) {
-        m_screen->insertText(text);
-        scrollToBottom();  // Auto-scroll to bottom when new text arrives
+void VT100Terminal::onSnapshotReady()
+{
+    TerminalSnapshot snapshot = m_worker->takeSnapshot();
+    const bool resized = snapshot.rows != m_snapshot.rows || snapshot.columns != m_snapshot.columns;
+    const bool cursorChanged = snapshot.cursor.row != m_snapshot.cursor.row
+        || snapshot.cursor.column != m_snapshot.cursor.column
+        || snapshot.cursorVisible != m_snapshot.cursorVisible;
+    if (snapshot.historySize != m_snapshot.historySize) {
+        m_scrollBarDirty = true;
     }
-}
-
-void VT100Terminal::onCursorPositionChanged(const CursorPosition &position)
-{
-    Q_UNUSED(position)
-    update();  // Redraw to show cursor in new position
-}
-
-void VT100Terminal::onCursorVisibilityChanged(bool visible)
-{
-    m_cursorVisible = visible;
-    update();
-}
-
-void VT100Terminal::onScreenChanged(const QRect &region)
-{
-    Q_UNUSED(region)
-    update();  // For now, just update the entire widget
-}
-
-void VT100Terminal::onScreenResized(int rows, int columns)
-{
-    updateTerminalSize();
-    updateScrollBar();
-    emit terminalSizeChanged(rows, columns);
-}
-
-void VT100Terminal::onCursorBlink()
-{
-    m_cursorBlinkState = !m_cursorBlinkState;
-    update();
-}
-
-void VT100Terminal::onScrollBarValueChanged(int value)
-{
-    if (m_screen) {
-        int historySize = m_screen->historySize();
-        setScrollOffset(historySize - value);
+    
+    // Scrollback rows in view arrive after the scroll that revealed them
+    QRegion damage;
+    if (snapshot.historyFirstLine != m_snapshot.historyFirstLine
+            || snapshot.history.size() != m_snapshot.history.size()) {
+        const int historyRows = qMax(snapshot.history.size(), m_snapshot.history.size());
+        damage += QRect(0, 0, width(), historyRows * m_charHeight);
     }
-}
-
-// VT100Parser signal handlers - delegate to screen
-void VT100Terminal::onCursorUp(int lines)
-{
-    if (m_screen) m_screen->moveCursor(-lines, 0);
-}
-
-void VT100Terminal::onCursorDown(int lines)
-{
-    if (m_screen) m_screen->moveCursor(lines, 0);
-}
-
-void VT100Terminal::onCursorForward(int columns)
-{
-    if (m_screen) m_screen->moveCursor(0, columns);
-}
-
-void VT100Terminal::onCursorBackward(int columns)
-{
-    if (m_screen) m_screen->moveCursor(0, -columns);
-}
-
-void VT100Terminal::onCursorPosition(int row, int column)
-{
-    if (m_screen) m_screen->setCursorPosition(row, column);
-}
-
-void VT100Terminal::onCursorNextLine(int lines)
-{
-    if (m_screen) {
-        CursorPosition pos = m_screen->cursorPosition();
-        m_screen->setCursorPosition(pos.row + lines, 0);
+    m_snapshot = snapshot;
+    m_cursorVisible = m_snapshot.cursorVisible;
+    if (m_echoTimer.isValid() && !m_echoShown) {
+        checkInputEcho();
     }
-}
-
-void VT100Terminal::onCursorPreviousLine(int lines)
-{
-    if (m_screen) {
-        CursorPosition pos = m_screen->cursorPosition();
-        m_screen->setCursorPosition(pos.row - lines, 0);
+    if (m_scrollOffset > m_snapshot.historySize) {
+        // Scrollback was cleared (ED 3) under the view
+        setScrollOffset(m_snapshot.historySize);
     }
-}
-
-void VT100Terminal::onCursorHorizontalAbsolute(int column)
-{
-    if (m_screen) m_screen->moveCursorToColumn(column);
-}
-
-void VT100Terminal::onSaveCursor()
-{
-    if (m_screen) m_screen->saveCursor();
-}
-
-void VT100Terminal::onRestoreCursor()
-{
-    if (m_screen) m_screen->restoreCursor();
-}
-
-void VT100Terminal::onHideCursor()
-{
-    if (m_screen) m_screen->setCursorVisible(false);
-}
-
-void VT100Terminal::onShowCursor()
-{
-    if (m_screen) m_screen->setCursorVisible(true);
-}
-
-void VT100Terminal::onUseAlternateScreenBuffer(bool use)
-{
-    if (m_screen) m_screen->setUseAlternateBuffer(use);
     
-    // Track DECCKM state locally. The remote application (mc, vim, etc.) sends
-    // its own smkx/rmkx sequences which the parser follows; do not write DECCKM
-    // sequences back to the remote (the pty echo would flip this state again).
-    setApplicationCursorKeys(use);
-}
-
-void VT100Terminal::onClearScreen()
-{
-    if (m_screen) m_screen->clear();
-}
-
-void VT100Terminal::onClearScreenFromCursor()
-{
-    if (m_screen) m_screen->clearFromCursor();
-}
-
-void VT100Terminal::onClearScreenToCursor()
-{
-    if (m_screen) m_screen->clearToCursor();
-}
-
-void VT100Terminal::onClearLine()
-{
-    if (m_screen) {
-        CursorPosition pos = m_screen->cursorPosition();
-        m_screen->clearLine(pos.row);
-    }
-}
-
-void VT100Terminal::onClearLineFromCursor()
-{
-    if (m_screen) m_screen->clearLineFromCursor();
-}
-
-void VT100Terminal::onClearLineToCursor()
-{
-    if (m_screen) m_screen->clearLineToCursor();
-}
-
-void VT100Terminal::onInsertLines(int count)
-{
-    if (m_screen) {
-        CursorPosition pos = m_screen->cursorPosition();
-        for (int i = 0; i < count; ++i) {
-            m_screen->insertLine(pos.row);
+    if (m_snapshot.hasOutput) {
+        // Auto-scroll to bottom when new text arrives, unless a match is being looked at
+        if (m_scrollOffset != 0 && !m_searchBar->isVisible()) {
+            scrollToBottom();
+        }
+        m_scrollBarDirty = true;
+        
+        // Matches follow the output; a steady stream still searches every SEARCH_DELAY
+        if (m_searchBar->isVisible() && !m_searchBar->pattern().isEmpty() && !m_searchTimer->isActive()) {
+            m_searchTimer->start();
         }
     }
-}
-
-void VT100Terminal::onDeleteLines(int count)
-{
-    if (m_screen) {
-        CursorPosition pos = m_screen->cursorPosition();
-        for (int i = 0; i < count; ++i) {
-            m_screen->deleteLine(pos.row);
+    
+    if (resized) {
+        damage = rect();
+    } else {
+        // Repaint only the rows that changed since the last scheduled repaint
+        const int lastColumn = m_snapshot.columns - 1;
+        int runStart = -1;
+        for (int row = 0; row <= m_snapshot.rows; ++row) {
+            const bool dirty = row < m_snapshot.rows
+                && m_snapshot.rowGenerations.value(row) > m_damageGeneration;
+            if (dirty && runStart < 0) {
+                runStart = row;
+            } else if (!dirty && runStart >= 0) {
+                damage += getCharacterRect(runStart, 0).united(getCharacterRect(row - 1, lastColumn));
+                runStart = -1;
+            }
         }
     }
-}
-
-void VT100Terminal::onInsertCharacters(int count)
-{
-    Q_UNUSED(count)
-    // Character insertion implementation would go here
-}
-
-void VT100Terminal::onDeleteCharacters(int count)
-{
-    Q_UNUSED(count)
-    // Character deletion implementation would go here
-}
-
-void VT100Terminal::onEraseCharacters(int count)
-{
-    Q_UNUSED(count)
-    // Character erasure implementation would go here
-}
-
-void VT100Terminal::onScrollUp(int lines)
-{
-    if (m_screen) m_screen->scrollUp(lines);
-}
-
-void VT100Terminal::onScrollDown(int lines)
-{
-    if (m_screen) m_screen->scrollDown(lines);
-}
-
-void VT100Terminal::onSetTextAttributes(TerminalColor foreground, TerminalColor background, TextAttributes attributes)
-{
-    if (m_screen) {
-        m_screen->setCurrentAttributes(foreground, background, attributes);
+    m_damageGeneration = m_snapshot.generation;
+    
+    // Erase the cursor at its old cell and draw it at the new one
+    if (cursorChanged || resized) {
+        damage += m_cursorRect;
+        m_cursorRect = cursorRect();
+        damage += m_cursorRect;
+    }
+    
+    if (!damage.isEmpty() || m_scrollBarDirty) {
+        scheduleRepaint(damage);
     }
 }
 
-void VT100Terminal::onResetTextAttributes()
-{
-    if (m_screen) m_screen->resetAttributes();
-}
-
-void VT100Terminal::onSetScrollingRegion(int top, int bottom)
+void VT100Terminal::onCursorBlink()
 {
-    if (m_screen) m_screen->setScrollingRegion(top, bottom);
+    m_cursorBlinkState = !m_cursorBlinkState;
+    updateView(cursorRect());
 }
 
-void VT100Terminal::onSetTabStop()
+void VT100Terminal::scheduleRepaint(const QRegion &damage)
 {
-    if (m_screen) {
-        CursorPosition pos = m_screen->cursorPosition();
-        m_screen->setTabStop(pos.column);
+    m_pendingDamage += damage;
+    
+    // Paint right away when idle so typing echoes without delay; while a
+    // frame is pending further damage just accumulates until it is due
+    if (!m_frameTimer->isActive()) {
+        flushFrame();
+        m_frameTimer->start();
     }
 }
 
-void VT100Terminal::onClearTabStop()
+void VT100Terminal::flushFrame()
 {
-    if (m_screen) {
-        CursorPosition pos = m_screen->cursorPosition();
-        m_screen->clearTabStop(pos.column);
+    if (m_scrollBarDirty) {
+        m_scrollBarDirty = false;
+        updateScrollBar();
+    }
+    
+    if (!m_pendingDamage.isEmpty()) {
+        updateView(m_pendingDamage);
+        m_pendingDamage = QRegion();
     }
 }
 
-void VT100Terminal::onClearAllTabStops()
-{
-    if (m_screen) m_screen->clearAllTabStops();
-}
-
-void VT100Terminal::onTabForward(int count)
+void VT100Terminal::updateView()
 {
-    if (m_screen) {
-        for (int i = 0; i < count; ++i) {
-            m_screen->tabToNextStop();
-        }
+#ifndef QTISSH_NO_OPENGL
+    if (m_glView) {
+        m_glView->update();
+        return;
     }
+#endif
+    update();
 }
 
-void VT100Terminal::onTabBackward(int count)
+void VT100Terminal::updateView(const QRegion &region)
 {
-    if (m_screen) {
-        for (int i = 0; i < count; ++i) {
-            m_screen->tabToPreviousStop();
-        }
+#ifndef QTISSH_NO_OPENGL
+    // The OpenGL view has no partial updates; it redraws at most once per frame
+    if (m_glView) {
+        m_glView->update();
+        return;
     }
+#endif
+    update(region);
 }
 
-void VT100Terminal::onSetPrivateMode(int mode, bool enabled)
+void VT100Terminal::onFrameTimeout()
 {
-    if (mode == 1) { // DECCKM - Cursor Keys Mode
-        m_appCursorKeys = enabled;
+    // Keep pacing while output continues; go idle after a quiet frame
+    if (!m_pendingDamage.isEmpty() || m_scrollBarDirty) {
+        flushFrame();
+        m_frameTimer->start();
     }
 }
 
-void VT100Terminal::onBell()
+void VT100Terminal::onScrollBarValueChanged(int value)
 {
-    emit bell();
+    setScrollOffset(m_snapshot.historySize - value);
 }
 
 // Event handlers - basic implementations
@@ -772,22 +845,34 @@ void VT100Terminal::keyPressEvent(QKeyEvent *event)
 
 void VT100Terminal::mousePressEvent(QMouseEvent *event)
 {
-    Q_UNUSED(event)
     // Ensure terminal gets focus when clicked
     setFocus(Qt::MouseFocusReason);
-    // Mouse handling implementation
+    
+    if (event->button() == Qt::LeftButton) {
+        clearSelection();
+        m_selection.start(selectionPointAt(event->pos()));
+        m_selecting = true;
+    }
 }
 
 void VT100Terminal::mouseMoveEvent(QMouseEvent *event)
 {
-    Q_UNUSED(event)
-    // Mouse handling implementation
+    if (m_selecting && (event->buttons() & Qt::LeftButton)) {
+        updateSelection(event->pos());
+    }
 }
 
 void VT100Terminal::mouseReleaseEvent(QMouseEvent *event)
 {
-    Q_UNUSED(event)
-    // Mouse handling implementation
+    if (m_selecting && event->button() == Qt::LeftButton) {
+        updateSelection(event->pos());
+        m_selecting = false;
+        
+        // X11 style primary selection
+        if (QApplication::clipboard()->supportsSelection()) {
+            copySelection(QClipboard::Selection);
+        }
+    }
 }
 
 void VT100Terminal::wheelEvent(QWheelEvent *event)
@@ -809,9 +894,41 @@ void VT100Terminal::resizeEvent(QResizeEvent *event)
     int newColumns = (width() - m_scrollBar->sizeHint().width()) / m_charWidth;
     int newRows = height() / m_charHeight;
     
-    if (newColumns > 0 && newRows > 0) {
-        setTerminalSize(newRows, newColumns);
+    if (newColumns <= 0 || newRows <= 0) {
+        return;
+    }
+    
+    // Apply the first size right away and later ones once per RESIZE_INTERVAL
+    m_pendingRows = newRows;
+    m_pendingColumns = newColumns;
+    if (!m_resizeTimer->isActive()) {
+        onResizeTimeout();
+    }
+}
+
+void VT100Terminal::onResizeTimeout()
+{
+    // Keep pacing while the size keeps changing; go idle after a quiet interval
+    if (m_pendingRows == 0) {
+        return;
+    }
+    if (m_pendingRows != m_rows || m_pendingColumns != m_columns) {
+        setTerminalSize(m_pendingRows, m_pendingColumns);
     }
+    m_pendingRows = 0;
+    m_pendingColumns = 0;
+    m_resizeTimer->start();
+}
+
+void VT100Terminal::onResizeSettled()
+{
+    // Rows a width change pushed above the screen reach history now, which
+    // renumbers lines, so matches are looked up again
+    QMetaObject::invokeMethod(m_worker, "finishReflow", Qt::QueuedConnection);
+    if (m_searchBar->isVisible() && !m_searchBar->pattern().isEmpty()) {
+        m_searchTimer->start();
+    }
+    emit terminalSizeSettled(m_rows, m_columns);
 }
 
 void VT100Terminal::focusInEvent(QFocusEvent *event)
@@ -821,7 +938,7 @@ void VT100Terminal::focusInEvent(QFocusEvent *event)
     if (m_cursorBlinking) {
         m_cursorBlinkTimer->start();
     }
-    update();
+    updateView(cursorRect());
 }
 
 void VT100Terminal::focusOutEvent(QFocusEvent *event)
@@ -830,7 +947,7 @@ void VT100Terminal::focusOutEvent(QFocusEvent *event)
     m_hasFocus = false;
     m_cursorBlinkTimer->stop();
     m_cursorBlinkState = true;
-    update();
+    updateView(cursorRect());
 }
 
 QByteArray VT100Terminal::keyEventToSequence(QKeyEvent *event)
@@ -921,12 +1038,225 @@ QByteArray VT100Terminal::functionKeyToSequence(int key)
     return QByteArray();
 }
 
-// Implement missing methods
-QString VT100Terminal::selectedText() const { return QString(); }
-void VT100Terminal::clearSelection() { m_hasSelection = false; update(); }
-void VT100Terminal::selectAll() { /* Implementation */ }
-CursorPosition VT100Terminal::pixelToPosition(const QPoint &pixel) const { Q_UNUSED(pixel) return CursorPosition(); }
-QPoint VT100Terminal::positionToPixel(const CursorPosition &position) const { Q_UNUSED(position) return QPoint(); }
-void VT100Terminal::updateSelection(const QPoint &pos) { Q_UNUSED(pos) }
-void VT100Terminal::normalizeSelection() { /* Implementation */ }
-bool VT100Terminal::isPositionSelected(int row, int column) const { Q_UNUSED(row) Q_UNUSED(column) return false; }
+// Selection
+void VT100Terminal::copySelection(QClipboard::Mode mode)
+{
+    if (!hasSelection()) {
+        return;
+    }
+    
+    // The worker reads its row storage, scrollback included, and answers
+    // through textReady; the GUI never waits behind queued output
+    const TerminalSelection::Point begin = m_selection.begin();
+    const TerminalSelection::Point end = m_selection.end();
+    TerminalWorker *worker = m_worker;
+    const int tag = static_cast<int>(mode);
+    QMetaObject::invokeMethod(m_worker, [worker, tag, begin, end]() {
+        worker->requestText(tag, begin.line, begin.column, end.line, end.column);
+    }, Qt::QueuedConnection);
+}
+
+void VT100Terminal::clearSelection()
+{
+    if (hasSelection()) {
+        invalidateLines(m_selection.begin().line, m_selection.end().line);
+    }
+    m_selection.clear();
+}
+
+void VT100Terminal::selectAll()
+{
+    // From the oldest stored line through the last screen row
+    m_selection.start(TerminalSelection::Point(m_snapshot.firstLine - m_snapshot.historySize, 0));
+    m_selection.extend(TerminalSelection::Point(m_snapshot.firstLine + m_snapshot.rows, 0));
+    updateView();
+}
+
+CursorPosition VT100Terminal::pixelToPosition(const QPoint &pixel) const
+{
+    // Rows above the screen are scrollback and come out negative
+    return CursorPosition(pixel.y() / m_charHeight - m_scrollOffset, pixel.x() / m_charWidth);
+}
+
+QPoint VT100Terminal::positionToPixel(const CursorPosition &position) const
+{
+    return getCharacterRect(position.row, position.column).topLeft();
+}
+
+TerminalSelection::Point VT100Terminal::selectionPointAt(const QPoint &pixel) const
+{
+    // Selection ends sit between cells, at the boundary nearest the pointer
+    const QPoint clamped(qBound(0, pixel.x() + m_charWidth / 2, m_snapshot.columns * m_charWidth),
+                         qBound(0, pixel.y(), qMax(0, height() - 1)));
+    const CursorPosition position = pixelToPosition(clamped);
+    return TerminalSelection::Point(m_snapshot.firstLine + position.row, position.column);
+}
+
+void VT100Terminal::updateSelection(const QPoint &pos)
+{
+    const TerminalSelection::Point previous = m_selection.active();
+    const TerminalSelection::Point point = selectionPointAt(pos);
+    if (point == previous) {
+        return;
+    }
+    
+    // Only lines between the old and new free end change their span
+    m_selection.extend(point);
+    invalidateLines(qMin(previous.line, point.line), qMax(previous.line, point.line));
+}
+
+void VT100Terminal::invalidateLines(qint64 first, qint64 last)
+{
+    const int firstRow = int(qBound<qint64>(-m_scrollOffset, first - m_snapshot.firstLine, m_snapshot.rows));
+    const int lastRow = int(qBound<qint64>(-m_scrollOffset - 1, last - m_snapshot.firstLine, m_snapshot.rows - 1));
+    if (firstRow > lastRow) {
+        return;
+    }
+    updateView(getCharacterRect(firstRow, 0).united(getCharacterRect(lastRow, m_snapshot.columns - 1)));
+}
+
+// Search
+void VT100Terminal::showSearchBar()
+{
+    updateSearchBarGeometry();
+    m_searchBar->activate();
+    onSearchQueryChanged();
+}
+
+void VT100Terminal::findNext()
+{
+    if (!m_searchMatches.isEmpty()) {
+        setCurrentMatch((m_currentMatch + 1) % m_searchMatches.size());
+    }
+}
+
+void VT100Terminal::findPrevious()
+{
+    if (!m_searchMatches.isEmpty()) {
+        setCurrentMatch((m_currentMatch + m_searchMatches.size() - 1) % m_searchMatches.size());
+    }
+}
+
+void VT100Terminal::onSearchQueryChanged()
+{
+    // A new query starts over from the newest match
+    m_currentMatch = -1;
+    m_searchTimer->start();
+}
+
+void VT100Terminal::onSearchTimeout()
+{
+    ++m_searchSerial;
+    if (m_searchBar->pattern().isEmpty()) {
+        onSearchFinished(m_searchSerial, QVector<TerminalSearchMatch>());
+        return;
+    }
+    QMetaObject::invokeMethod(m_worker, "search", Qt::QueuedConnection,
+                              Q_ARG(int, m_searchSerial),
+                              Q_ARG(QString, m_searchBar->pattern()),
+                              Q_ARG(bool, m_searchBar->isRegularExpression()),
+                              Q_ARG(bool, m_searchBar->isCaseSensitive()));
+}
+
+void VT100Terminal::onSearchFinished(int serial, const QVector<TerminalSearchMatch> &matches)
+{
+    // Results of a query typed over in the meantime are stale
+    if (serial != m_searchSerial) {
+        return;
+    }
+    
+    // Stay on the match the user was at if it is still there
+    const bool fresh = m_currentMatch < 0;
+    int current = int(matches.size()) - 1;
+    if (!fresh && m_currentMatch < m_searchMatches.size()) {
+        const TerminalSearchMatch previous = m_searchMatches.at(m_currentMatch);
+        const auto it = std::lower_bound(matches.begin(), matches.end(), previous,
+            [](const TerminalSearchMatch &a, const TerminalSearchMatch &b) {
+                return a.line < b.line || (a.line == b.line && a.column < b.column);
+            });
+        current = qMin(int(it - matches.begin()), int(matches.size()) - 1);
+    }
+    m_searchMatches = matches;
+    
+    if (matches.isEmpty()) {
+        m_currentMatch = -1;
+        m_searchBar->setMatchCount(0, 0);
+        updateView();
+    } else if (fresh) {
+        setCurrentMatch(current);
+    } else {
+        m_currentMatch = current;
+        m_searchBar->setMatchCount(current + 1, matches.size(),
+                                   matches.size() >= TerminalWorker::MAX_SEARCH_MATCHES);
+        updateView();
+    }
+}
+
+void VT100Terminal::onSearchBarClosed()
+{
+    m_searchTimer->stop();
+    ++m_searchSerial;
+    m_searchMatches.clear();
+    m_currentMatch = -1;
+    setFocus(Qt::OtherFocusReason);
+    updateView();
+}
+
+void VT100Terminal::setCurrentMatch(int index)
+{
+    m_currentMatch = index;
+    m_searchBar->setMatchCount(index + 1, m_searchMatches.size(),
+                               m_searchMatches.size() >= TerminalWorker::MAX_SEARCH_MATCHES);
+    
+    // Scroll a match outside the view to the middle of it
+    const int row = int(m_searchMatches.at(index).line - m_snapshot.firstLine);
+    if (row < -m_scrollOffset || row >= m_rows - m_scrollOffset) {
+        setScrollOffset(row >= 0 ? 0 : m_rows / 2 - row);
+    } else {
+        updateView();
+    }
+}
+
+QVector<QRect> VT100Terminal::matchRects(int firstRow, int lastRow, QVector<QRect> *current) const
+{
+    QVector<QRect> rects;
+    current->clear();
+    
+    // Matches are sorted by line, so the visible ones are a contiguous range;
+    // one on a wrapped line may start up to a screen above the view
+    TerminalSearchMatch first;
+    first.line = m_snapshot.firstLine + firstRow - m_snapshot.rows;
+    auto it = std::lower_bound(m_searchMatches.begin(), m_searchMatches.end(), first,
+        [](const TerminalSearchMatch &a, const TerminalSearchMatch &b) { return a.line < b.line; });
+    const int columns = qMax(1, m_snapshot.columns);
+    for (; it != m_searchMatches.end() && it->line <= m_snapshot.firstLine + lastRow; ++it) {
+        QVector<QRect> &target = it - m_searchMatches.begin() == m_currentMatch ? *current : rects;
+        
+        // A match running past the end of its row goes on at the start of the next
+        int row = int(it->line - m_snapshot.firstLine);
+        int column = it->column;
+        int remaining = it->length;
+        while (remaining > 0 && column < columns && row <= lastRow) {
+            const int count = qMin(remaining, columns - column);
+            if (row >= firstRow) {
+                target.append(getCharacterRect(row, column).united(getCharacterRect(row, column + count - 1)));
+            }
+            remaining -= count;
+            column = 0;
+            ++row;
+        }
+    }
+    return rects;
+}
+
+void VT100Terminal::updateSearchBarGeometry()
+{
+    const QSize size = m_searchBar->sizeHint();
+    const int right = width() - m_scrollBar->sizeHint().width();
+    m_searchBar->setGeometry(qMax(0, right - size.width() - 4), 4, qMin(size.width(), right), size.height());
+}
+
+QColor VT100Terminal::searchMatchColor(bool current)
+{
+    return current ? QColor(255, 140, 0, 150) : QColor(255, 210, 0, 80);
+}
@@ -5,14 +5,29 @@
 #include <QFont>
 #include <QTimer>
 #include <QScrollBar>
-#include "terminalscreen.h"
-#include "vt100parser.h"
+#include <QRegion>
+#include <QClipboard>
+#include <QElapsedTimer>
+#include "terminalworker.h"
+#include "glyphcache.h"
+#include "terminalselection.h"
 
 class QPaintEvent;
 class QKeyEvent;
 class QMouseEvent;
 class QWheelEvent;
 class QResizeEvent;
+class QThread;
+class TerminalGLView;
+class TerminalSearchBar;
+
+/**
+ * @brief Selects how VT100Terminal draws its cell grid
+ */
+enum class TerminalRenderer {
+    Raster,     // QPainter on the widget
+    OpenGL      // Instanced quads through QOpenGLWidget
+};
 
 /**
  * @brief VT100-compatible terminal widget
@@ -48,9 +63,32 @@ public:
     int terminalColumns() const;
     bool useAlternateBuffer() const;
     
+    void setParserEngine(ParserEngine engine);
+    ParserEngine parserEngine() const;
+    
+    // Falls back to Raster when no suitable OpenGL context is available
+    void setRenderer(TerminalRenderer renderer);
+    TerminalRenderer renderer() const { return m_renderer; }
+    
 // Terminal operations
     void writeData(const QByteArray &data);
     void writeData(const QString &data);
+
+    /**
+     * @brief Whether so much output waits to be parsed that the source should pause
+     *
+     * backlogDrained is emitted once the worker has caught up again.
+     */
+    bool isBacklogged() const;
+
+    /**
+     * @brief Start timing a keystroke just sent to the remote side
+     *
+     * inputEchoed reports the time until a frame showing a change on the
+     * cursor row has been painted. Keys sent while one is still being timed
+     * are not timed themselves.
+     */
+    void markInput();
     void clear();
     void reset();
     
@@ -65,23 +103,32 @@ public:
     void setApplicationCursorKeys(bool enable);
     void setApplicationCursorKeysLocal(bool enable);
     bool applicationCursorKeys() const { return m_appCursorKeys; }
+
+    // Bracketed paste mode (DECSET 2004), requested by readline, vim, etc.
+    bool bracketedPaste() const { return m_bracketedPaste; }
     
     // Scrollback
     void setScrollbackLines(int lines);
     int scrollbackLines() const;
+    void setScrollbackOnDisk(bool enable);
+    bool scrollbackOnDisk() const;
     void scrollToBottom();
     void scrollToTop();
     void scrollUp(int lines = 1);
     void scrollDown(int lines = 1);
     
     // Selection
-    bool hasSelection() const { return m_hasSelection; }
-    QString selectedText() const;
+    bool hasSelection() const { return !m_selection.isEmpty(); }
     void clearSelection();
     void selectAll();
     void copy();
     void paste();
     
+    // Search over the screen and scrollback
+    void showSearchBar();
+    void findNext();
+    void findPrevious();
+    
     // Colors
     void setColorScheme(const QColor &foreground, const QColor &background);
     void setDefaultColors(const QColor &foreground, const QColor &background);
@@ -89,8 +136,11 @@ public:
 signals:
     void keyPressed(const QByteArray &data);
     void terminalSizeChanged(int rows, int columns);
+    void terminalSizeSettled(int rows, int columns);  // No further change for RESIZE_SETTLE_DELAY
     void bell();
     void sendRawData(const QByteArray &data);
+    void backlogDrained();
+    void inputEchoed(int milliseconds);  // See markInput()
 
 protected:
     // Qt event handlers
@@ -105,75 +155,62 @@ protected:
     void focusOutEvent(QFocusEvent *event) override;
 
 private slots:
-    void onTextReceived(const QString &text);
-    void onCursorPositionChanged(const CursorPosition &position);
-    void onCursorVisibilityChanged(bool visible);
-    void onScreenChanged(const QRect &region);
-    void onScreenResized(int rows, int columns);
+    void onSnapshotReady();
     void onCursorBlink();
+    void onFrameTimeout();
+    void onResizeTimeout();
+    void onResizeSettled();
     void onScrollBarValueChanged(int value);
-    
-    // VT100Parser signal handlers
-    void onCursorUp(int lines);
-    void onCursorDown(int lines);
-    void onCursorForward(int columns);
-    void onCursorBackward(int columns);
-    void onCursorPosition(int row, int column);
-    void onCursorNextLine(int lines);
-    void onCursorPreviousLine(int lines);
-    void onCursorHorizontalAbsolute(int column);
-    void onSaveCursor();
-    void onRestoreCursor();
-    void onHideCursor();
-    void onShowCursor();
-    void onUseAlternateScreenBuffer(bool use);
-    void onClearScreen();
-    void onClearScreenFromCursor();
-    void onClearScreenToCursor();
-    void onClearLine();
-    void onClearLineFromCursor();
-    void onClearLineToCursor();
-    void onInsertLines(int count);
-    void onDeleteLines(int count);
-    void onInsertCharacters(int count);
-    void onDeleteCharacters(int count);
-    void onEraseCharacters(int count);
-    void onScrollUp(int lines);
-    void onScrollDown(int lines);
-    void onSetTextAttributes(TerminalColor foreground, TerminalColor background, TextAttributes attributes);
-    void onResetTextAttributes();
-    void onSetScrollingRegion(int top, int bottom);
-    void onSetTabStop();
-    void onClearTabStop();
-    void onClearAllTabStops();
-    void onTabForward(int count);
-    void onTabBackward(int count);
-    void onSetPrivateMode(int mode, bool enabled);
-    void onBell();
+    void onRendererUnavailable();
+    void onSearchQueryChanged();
+    void onSearchTimeout();
+    void onSearchFinished(int serial, const QVector<TerminalSearchMatch> &matches);
+    void onSearchBarClosed();
 
 private:
+    friend class TerminalGLView;
+    
     void setupUI();
     void setupConnections();
     void calculateCharacterSize();
     void updateTerminalSize();
     void updateScrollBar();
     
+    // Frame pacing
+    void scheduleRepaint(const QRegion &damage);
+    void flushFrame();
+    void updateView();
+    void updateView(const QRegion &region);
+    
     // Rendering
-    void drawCharacter(QPainter &painter, int row, int column, const TerminalChar &ch, const QRect &charRect);
+    void drawRow(QPainter &painter, int row, int startColumn, int endColumn);
+    int runEnd(int row, const TerminalCell *cells, int column, int endColumn, bool *selected) const;
+    void drawRun(QPainter &painter, int row, int column, const TerminalCell *cells, int length,
+                 const TerminalStyle &style, bool selected);
     void drawCursor(QPainter &painter);
-    void drawSelection(QPainter &painter);
+    void framePainted();
     QRect getCharacterRect(int row, int column) const;
+    QRect cursorRect() const;
     QColor getCharacterColor(TerminalColor color, bool isForeground) const;
-    QFont getCharacterFont(TextAttributes attributes) const;
+    
+    // Input latency
+    void checkInputEcho();
     
     // Coordinate conversion
     CursorPosition pixelToPosition(const QPoint &pixel) const;
     QPoint positionToPixel(const CursorPosition &position) const;
     
     // Selection
+    TerminalSelection::Point selectionPointAt(const QPoint &pixel) const;
+    void copySelection(QClipboard::Mode mode);
     void updateSelection(const QPoint &pos);
-    void normalizeSelection();
-    bool isPositionSelected(int row, int column) const;
+    void invalidateLines(qint64 first, qint64 last);
+    
+    // Search
+    QVector<QRect> matchRects(int firstRow, int lastRow, QVector<QRect> *current) const;
+    void setCurrentMatch(int index);
+    void updateSearchBarGeometry();
+    static QColor searchMatchColor(bool current);
     
     // Keyboard handling
     QByteArray keyEventToSequence(QKeyEvent *event);
@@ -184,20 +221,33 @@ private:
     void setScrollOffset(int offset);
     int maxScrollOffset() const;
     
-    // Components
-    TerminalScreen *m_screen;
-    VT100Parser *m_parser;
+    // Components; parsing and screen state live on the worker thread
+    TerminalWorker *m_worker;
+    QThread *m_workerThread;
     QScrollBar *m_scrollBar;
+    TerminalGLView *m_glView;  // Only while the OpenGL renderer is active
+    TerminalRenderer m_renderer;
+    
+    // Latest published screen state, painted from the GUI thread
+    TerminalSnapshot m_snapshot;
+    
+    // Requested geometry and settings, known before the worker catches up
+    int m_rows;
+    int m_columns;
+    ParserEngine m_parserEngine;
+    bool m_scrollbackOnDisk;
     
     // Display properties
     QFont m_font;
     int m_charWidth;
     int m_charHeight;
     int m_charBaseline;
+    GlyphCache m_glyphCache;
     
     // Colors
     QColor m_defaultForeground;
     QColor m_defaultBackground;
+    QVector<QColor> m_palette;
     
     // Cursor
     bool m_cursorVisible;
@@ -205,23 +255,56 @@ private:
     bool m_cursorBlinking;
     bool m_cursorBlinkState;
     QTimer *m_cursorBlinkTimer;
+    QRect m_cursorRect;  // Area covered by the last scheduled cursor paint
     
     // Selection
-    bool m_hasSelection;
+    TerminalSelection m_selection;
     bool m_selecting;
-    CursorPosition m_selectionStart;
-    CursorPosition m_selectionEnd;
+    
+    // Search; results older than m_searchSerial are ignored
+    TerminalSearchBar *m_searchBar;
+    QTimer *m_searchTimer;
+    int m_searchSerial;
+    QVector<TerminalSearchMatch> m_searchMatches;
+    int m_currentMatch;  // Index into m_searchMatches, -1 for none
     
     // Scrolling
     int m_scrollOffset;  // Number of lines scrolled up from bottom
     
+    // Screen generation already scheduled for repaint
+    quint64 m_damageGeneration;
+    
+    // Frame pacing: damage collected until the next frame is due
+    QTimer *m_frameTimer;
+    QRegion m_pendingDamage;
+    bool m_scrollBarDirty;
+    
+    // Resize pacing: the grid follows the widget at most once per RESIZE_INTERVAL
+    QTimer *m_resizeTimer;
+    QTimer *m_settleTimer;
+    int m_pendingRows;
+    int m_pendingColumns;
+    
+    // Keystroke-to-paint timing: the cursor cell when the key was sent
+    QElapsedTimer m_echoTimer;
+    qint64 m_echoLine;
+    int m_echoColumn;
+    quint64 m_echoGeneration;
+    bool m_echoShown;  // The echo is in m_snapshot and waits to be painted
+    
     // Terminal state
     bool m_hasFocus;
     bool m_appCursorKeys;
+    bool m_bracketedPaste;
     
     // Constants
     static const int CURSOR_BLINK_INTERVAL = 500;  // milliseconds
     static const int SCROLL_LINES_PER_WHEEL = 3;
+    static const int DEFAULT_REFRESH_RATE = 60;  // Hz, when the screen does not report one
+    static const int SEARCH_DELAY = 150;  // milliseconds after typing or output
+    static const int RESIZE_INTERVAL = 100;  // milliseconds between grid reflows during a drag
+    static const int RESIZE_SETTLE_DELAY = 250;  // milliseconds without a size change
+    static const int ECHO_TIMEOUT = 1000;  // milliseconds; longer means no echo
 };
 
 #endif // VT100TERMINAL_H